@@ -196,6 +196,7 @@ testScriptsExt = [
     # 'txn_clone.py --mineblock',
     # 'forknotify.py',
      'invalidateblock.py',
+    # 'rpc_loadtest.py', # load test, run manually with --mix/--clients/--duration
     # 'rpcbind_test.py',
     # 'smartfees.py',
     # 'maxblocksinflight.py',
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The FivegX Project developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Load test for the read-only RPC path.
+#
+# Replays a mix of RPC calls from several concurrent clients against a regtest
+# node while blocks keep being mined, then reports throughput and latency per
+# method. The mix is either the built-in explorer-like mix or a captured one
+# passed with --mix: a file with one JSON object per line,
+#
+#   {"method": "getblock", "params": ["$blockhash"], "weight": 5}
+#
+# where the placeholders $height, $blockhash and $txid are replaced with a
+# random height, block hash or coinbase txid of the regtest chain, so a mix
+# captured from a mainnet node can be replayed here unchanged otherwise.
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, start_nodes, rpc_url, get_rpc_proxy
+
+import json
+import random
+import threading
+import time
+
+DEFAULT_MIX = [
+    ("getblockcount", [], 10),
+    ("getbestblockhash", [], 10),
+    ("getdifficulty", [], 2),
+    ("getblockhash", ["$height"], 10),
+    ("getblockheader", ["$blockhash"], 5),
+    ("getblock", ["$blockhash"], 10),
+    ("getblock", ["$blockhash", False], 3),
+    ("getrawtransaction", ["$txid"], 5),
+    ("getrawtransaction", ["$txid", 1], 5),
+]
+
+class RPCLoadTest(BitcoinTestFramework):
+
+    def __init__(self):
+        super().__init__()
+        self.setup_clean_chain = False
+        self.num_nodes = 1
+
+    def add_options(self, parser):
+        parser.add_option("--mix", dest="mix", default=None,
+                          help="File with the captured RPC mix to replay (one JSON call per line)")
+        parser.add_option("--clients", dest="clients", default=8, type="int",
+                          help="Number of concurrent RPC clients (default: %default)")
+        parser.add_option("--duration", dest="duration", default=20, type="int",
+                          help="Seconds to run the load for (default: %default)")
+        parser.add_option("--rpcthreads", dest="rpcthreads", default=8, type="int",
+                          help="-rpcthreads for the node under test (default: %default)")
+        parser.add_option("--blockinterval", dest="blockinterval", default=1.0, type="float",
+                          help="Seconds between blocks mined during the run, 0 to disable (default: %default)")
+
+    def setup_network(self):
+        args = ["-txindex", "-rpcthreads=%d" % self.options.rpcthreads, "-rpcworkqueue=%d" % (4 * self.options.clients)]
+        self.nodes = start_nodes(self.num_nodes, self.options.tmpdir, [args])
+        self.is_network_split = False
+
+    def load_mix(self):
+        if self.options.mix is None:
+            return DEFAULT_MIX
+        mix = []
+        with open(self.options.mix, encoding="utf8") as f:
+            for line in f:
+                line = line.strip()
+                if not line or line.startswith("#"):
+                    continue
+                call = json.loads(line)
+                mix.append((call["method"], call.get("params", []), call.get("weight", 1)))
+        assert len(mix) > 0, "empty RPC mix"
+        return mix
+
+    def snapshot_chain(self):
+        node = self.nodes[0]
+        height = node.getblockcount()
+        hashes = [node.getblockhash(h) for h in range(height + 1)]
+        txids = [node.getblock(h)["tx"][0] for h in hashes[1:]]
+        return hashes, txids
+
+    def substitute(self, params, hashes, txids, rng):
+        out = []
+        for p in params:
+            if p == "$height":
+                p = rng.randrange(len(hashes))
+            elif p == "$blockhash":
+                p = rng.choice(hashes)
+            elif p == "$txid":
+                p = rng.choice(txids)
+            out.append(p)
+        return out
+
+    def client(self, n, mix, hashes, txids, deadline, results):
+        rng = random.Random(n)
+        proxy = get_rpc_proxy(rpc_url(0), 0, timeout=60)
+        methods = [m for m in mix]
+        weights = [w for (_, _, w) in mix]
+        stats = {}
+        while time.time() < deadline:
+            method, params, _ = rng.choices(methods, weights)[0]
+            params = self.substitute(params, hashes, txids, rng)
+            start = time.time()
+            try:
+                result = getattr(proxy, method)(*params)
+                ok = True
+            except Exception as e:
+                result = None
+                ok = False
+                print("client %d: %s%s failed: %s" % (n, method, params, e))
+            elapsed = time.time() - start
+            entry = stats.setdefault(method, {"latencies": [], "errors": 0})
+            entry["latencies"].append(elapsed)
+            if not ok:
+                entry["errors"] += 1
+            # Spot check that answers describe one consistent chain
+            elif method == "getblockhash":
+                assert_equal(result, hashes[params[0]])
+            elif method == "getblock" and (len(params) < 2 or params[1]):
+                assert_equal(hashes[result["height"]], result["hash"])
+        results[n] = stats
+
+    def miner(self, deadline):
+        proxy = get_rpc_proxy(rpc_url(0), 0, timeout=60)
+        while time.time() < deadline:
+            proxy.generate(1)
+            time.sleep(self.options.blockinterval)
+
+    def run_test(self):
+        mix = self.load_mix()
+        hashes, txids = self.snapshot_chain()
+        print("Replaying %d call types from %d clients for %ds against %d blocks" %
+              (len(mix), self.options.clients, self.options.duration, len(hashes)))
+
+        deadline = time.time() + self.options.duration
+        results = [None] * self.options.clients
+        threads = [threading.Thread(target=self.client, args=(n, mix, hashes, txids, deadline, results))
+                   for n in range(self.options.clients)]
+        if self.options.blockinterval > 0:
+            threads.append(threading.Thread(target=self.miner, args=(deadline,)))
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        merged = {}
+        for stats in results:
+            assert stats is not None, "client thread died"
+            for method, entry in stats.items():
+                m = merged.setdefault(method, {"latencies": [], "errors": 0})
+                m["latencies"].extend(entry["latencies"])
+                m["errors"] += entry["errors"]
+
+        total = 0
+        errors = 0
+        print("%-20s %8s %8s %10s %10s %10s" % ("method", "calls", "errors", "p50 ms", "p99 ms", "max ms"))
+        for method in sorted(merged):
+            latencies = sorted(merged[method]["latencies"])
+            total += len(latencies)
+            errors += merged[method]["errors"]
+            print("%-20s %8d %8d %10.2f %10.2f %10.2f" % (method, len(latencies), merged[method]["errors"],
+                  1000 * latencies[len(latencies) // 2],
+                  1000 * latencies[min(len(latencies) - 1, len(latencies) * 99 // 100)],
+                  1000 * latencies[-1]))
+        print("Total: %d calls, %.1f calls/s" % (total, total / float(self.options.duration)))
+        assert_equal(errors, 0)
+
+if __name__ == '__main__':
+    RPCLoadTest().main()
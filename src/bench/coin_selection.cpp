@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "amount.h"
+#include "random.h"
+#include "wallet/coinselection.h"
+
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Coin selection over synthetic wallets of 1k to 1M outputs of 0.01 to 1.
+// With whole cent outputs there are exact matches for branch and bound to find,
+// with a few satoshis on top of every output the knapsack search has to run.
+// The Sigma case picks spends and re-mints like CWallet::GetCoinsToSpend.
+
+static const CAmount SELECTION_TARGET = 1234 * CENT;
+
+static void CoinSelection(benchmark::State& state, size_t nOutputs, bool fExact)
+{
+    seed_insecure_rand(true);
+    std::vector<CAmount> vValues;
+    for (size_t i = 0; i < nOutputs; ++i)
+        vValues.push_back((1 + insecure_rand() % 100) * CENT + (fExact ? 0 : insecure_rand() % 1000));
+
+    CAmount nTarget = SELECTION_TARGET + (fExact ? 0 : 567);
+    std::vector<size_t> vSelected;
+    CAmount nValueRet;
+    while (state.KeepRunning()) {
+        if (!SelectCoinsForValue(vValues, nTarget, vSelected, nValueRet))
+            throw std::runtime_error("no coins selected");
+    }
+}
+
+// Sigma denominations in units of 0.05, largest first
+static const std::vector<int64_t> SIGMA_DENOMINATIONS = {2000, 500, 200, 20, 10, 2, 1};
+
+static void SigmaCoinSelection(benchmark::State& state, size_t nCoins)
+{
+    seed_insecure_rand(true);
+    std::vector<size_t> available(SIGMA_DENOMINATIONS.size(), 0);
+    for (size_t i = 0; i < nCoins; ++i)
+        ++available[insecure_rand() % SIGMA_DENOMINATIONS.size()];
+
+    // 123.45, and up to one largest coin more to re-mint from
+    int64_t required = 2469;
+    int64_t maxAmount = required + SIGMA_DENOMINATIONS[0];
+    std::vector<size_t> unlimited(SIGMA_DENOMINATIONS.size(), CDenominationSelector::UNLIMITED);
+    std::vector<size_t> spendCounts, mintCounts;
+
+    while (state.KeepRunning()) {
+        CDenominationSelector spendSelector(SIGMA_DENOMINATIONS, available, maxAmount);
+        CDenominationSelector mintSelector(SIGMA_DENOMINATIONS, unlimited, maxAmount - required);
+
+        int64_t best = -1;
+        uint64_t minimum = std::numeric_limits<uint64_t>::max();
+        for (int64_t amount = maxAmount; amount >= required; --amount) {
+            uint32_t spendCount = spendSelector.GetCoinCount(amount);
+            if (spendCount == CDenominationSelector::UNREACHABLE)
+                continue;
+            uint64_t count = uint64_t(spendCount) + mintSelector.GetCoinCount(amount - required);
+            if (count < minimum) {
+                best = amount;
+                minimum = count;
+            }
+        }
+
+        if (best < 0 || !spendSelector.GetCoins(best, spendCounts) || !mintSelector.GetCoins(best - required, mintCounts))
+            throw std::runtime_error("no coins selected");
+    }
+}
+
+static void CoinSelectionExact1k(benchmark::State& state) { CoinSelection(state, 1000, true); }
+static void CoinSelectionExact10k(benchmark::State& state) { CoinSelection(state, 10000, true); }
+static void CoinSelectionExact100k(benchmark::State& state) { CoinSelection(state, 100000, true); }
+static void CoinSelectionExact1M(benchmark::State& state) { CoinSelection(state, 1000000, true); }
+
+static void CoinSelectionKnapsack1k(benchmark::State& state) { CoinSelection(state, 1000, false); }
+static void CoinSelectionKnapsack10k(benchmark::State& state) { CoinSelection(state, 10000, false); }
+static void CoinSelectionKnapsack100k(benchmark::State& state) { CoinSelection(state, 100000, false); }
+static void CoinSelectionKnapsack1M(benchmark::State& state) { CoinSelection(state, 1000000, false); }
+
+static void SigmaCoinSelection1k(benchmark::State& state) { SigmaCoinSelection(state, 1000); }
+static void SigmaCoinSelection1M(benchmark::State& state) { SigmaCoinSelection(state, 1000000); }
+
+BENCHMARK(CoinSelectionExact1k);
+BENCHMARK(CoinSelectionExact10k);
+BENCHMARK(CoinSelectionExact100k);
+BENCHMARK(CoinSelectionExact1M);
+
+BENCHMARK(CoinSelectionKnapsack1k);
+BENCHMARK(CoinSelectionKnapsack10k);
+BENCHMARK(CoinSelectionKnapsack100k);
+BENCHMARK(CoinSelectionKnapsack1M);
+
+BENCHMARK(SigmaCoinSelection1k);
+BENCHMARK(SigmaCoinSelection1M);
@@ -0,0 +1,50 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "hdmint/hdmint.h"
+#include "hdmint/tracker.h"
+#include "primitives/zerocoin.h"
+#include "wallet/wallet.h"
+
+#include <vector>
+
+// Syncing a wallet with many HD mints: every pass over the mint pool checks
+// each pool entry against the tracker by pubcoin hash, and every mint found
+// in a block is looked up by pubcoin hash to update its state.
+
+static const int WALLET_MINTS = 10000;
+
+static void HDMintTrackerSync(benchmark::State& state)
+{
+    CWallet wallet;
+    CWallet* walletMain = pwalletMain;
+    pwalletMain = &wallet;
+
+    CHDMintTracker tracker("bench_hdmint.dat");
+    std::vector<uint256> pubcoinHashes;
+    CKeyID seedId;
+    for (int i = 0; i < WALLET_MINTS; ++i) {
+        GroupElement pubcoin;
+        pubcoin.randomize();
+        CHDMint dMint(i, seedId, ArithToUint256(arith_uint256(i)), pubcoin);
+        dMint.SetDenomination(sigma::CoinDenomination::SIGMA_DENOM_1);
+        tracker.Add(dMint);
+        pubcoinHashes.push_back(primitives::GetPubCoinValueHash(pubcoin));
+    }
+
+    while (state.KeepRunning()) {
+        for (const uint256& hashPubcoin : pubcoinHashes) {
+            CMintMeta meta;
+            if (!tracker.HasPubcoinHash(hashPubcoin) || !tracker.GetMetaFromPubcoin(hashPubcoin, meta))
+                throw std::runtime_error("mint not tracked");
+        }
+    }
+
+    pwalletMain = walletMain;
+}
+
+BENCHMARK(HDMintTrackerSync);
@@ -0,0 +1,61 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+
+#include "elysium/elysium.h"
+#include "elysium/mdex.h"
+#include "elysium/tally.h"
+
+#include <boost/filesystem.hpp>
+
+using namespace elysium;
+
+// Matching a taker order in a busy market: the token is also offered against
+// many other properties, at prices below the ones of the pair being traded,
+// and each trade takes the oldest order of the pair before an equal order is
+// put back, so the book keeps its size.
+
+static const uint32_t PROPERTY_TOKEN = 3;
+static const int OTHER_PAIR_ORDERS = 10000;
+static const int PAIR_ORDERS = 1000;
+
+static void MetaDExMatch(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("bench_mdex_%%%%%%%%");
+    CMPTradeList* tradelistdb = t_tradelistdb;
+    t_tradelistdb = new CMPTradeList(path, true);
+    MetaDEx_CLEAR();
+
+    update_tally_map("maker", PROPERTY_TOKEN, 1000000000000000LL, BALANCE);
+    update_tally_map("taker", ELYSIUM_PROPERTY_ELYSIUM, 1000000000000000LL, BALANCE);
+
+    int n = 0;
+    for (; n < OTHER_PAIR_ORDERS; ++n) {
+        MetaDEx_ADD("maker", PROPERTY_TOKEN, 100, n, 4 + n % 100, 100 + n % 900, ArithToUint256(arith_uint256(n)), 0);
+    }
+    for (; n < OTHER_PAIR_ORDERS + PAIR_ORDERS; ++n) {
+        MetaDEx_ADD("maker", PROPERTY_TOKEN, 100, n, ELYSIUM_PROPERTY_ELYSIUM, 1000, ArithToUint256(arith_uint256(n)), 0);
+    }
+
+    while (state.KeepRunning()) {
+        MetaDEx_ADD("taker", ELYSIUM_PROPERTY_ELYSIUM, 1000, n, PROPERTY_TOKEN, 100, ArithToUint256(arith_uint256(n)), 0);
+        ++n;
+        MetaDEx_ADD("maker", PROPERTY_TOKEN, 100, n, ELYSIUM_PROPERTY_ELYSIUM, 1000, ArithToUint256(arith_uint256(n)), 0);
+        ++n;
+    }
+
+    MetaDEx_CLEAR();
+    clear_tally_map();
+    delete t_tradelistdb;
+    t_tradelistdb = tradelistdb;
+    boost::filesystem::remove_all(path);
+}
+
+BENCHMARK(MetaDExMatch);
@@ -0,0 +1,127 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "netbase.h"
+#include "socketevents.h"
+#include "util.h"
+
+#include <vector>
+
+#ifndef WIN32
+
+// Relay latency of the socket event loop with many mostly idle peers: one
+// peer sends a byte, the loop waits for it to become readable and reads it.
+// Peers are loopback TCP connections, rotating which one is active.
+
+struct LoopbackPeers
+{
+    std::vector<SOCKET> vLocal;
+    std::vector<SOCKET> vRemote;
+
+    bool Open(int nPeers)
+    {
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (hListen == INVALID_SOCKET)
+            return false;
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (bind(hListen, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+                listen(hListen, SOMAXCONN) != 0 ||
+                getsockname(hListen, (struct sockaddr*)&addr, &len) != 0) {
+            CloseSocket(hListen);
+            return false;
+        }
+
+        for (int i = 0; i < nPeers; i++) {
+            SOCKET hRemote = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (hRemote == INVALID_SOCKET || connect(hRemote, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+                CloseSocket(hRemote);
+                break;
+            }
+            SOCKET hLocal = accept(hListen, NULL, NULL);
+            if (hLocal == INVALID_SOCKET) {
+                CloseSocket(hRemote);
+                break;
+            }
+            int set = 1;
+            setsockopt(hRemote, IPPROTO_TCP, TCP_NODELAY, (void*)&set, sizeof(int));
+            SetSocketNonBlocking(hLocal, true);
+            vRemote.push_back(hRemote);
+            vLocal.push_back(hLocal);
+        }
+        CloseSocket(hListen);
+        return (int)vLocal.size() == nPeers;
+    }
+
+    ~LoopbackPeers()
+    {
+        for (size_t i = 0; i < vLocal.size(); i++) {
+            CloseSocket(vLocal[i]);
+            CloseSocket(vRemote[i]);
+        }
+    }
+};
+
+static void RelayLatency(benchmark::State& state, SocketEventsMode mode, int nPeers)
+{
+    RaiseFileDescriptorLimit(2 * nPeers + 64);
+
+    LoopbackPeers peers;
+    CSocketEvents* pevents = CSocketEvents::Create(mode);
+    if (!pevents || !peers.Open(nPeers) || (mode == SOCKETEVENTS_SELECT && !IsSelectableSocket(peers.vLocal.back()))) {
+        // not enough descriptors for this configuration, nothing to measure
+        delete pevents;
+        while (state.KeepRunning()) {}
+        return;
+    }
+
+    CSocketEvents::InterestMap mapInterest;
+    for (int i = 0; i < nPeers; i++)
+        mapInterest[peers.vLocal[i]] = CSocketEvents::EVENT_RECV | CSocketEvents::EVENT_ERR;
+
+    CSocketEvents::ReadyList vReady;
+    int nActive = 0;
+    char c = 0;
+    while (state.KeepRunning()) {
+        nActive = (nActive + 7919) % nPeers;
+        if (send(peers.vRemote[nActive], &c, 1, MSG_NOSIGNAL) != 1)
+            break;
+        bool fReceived = false;
+        while (!fReceived && pevents->Wait(mapInterest, 1000, vReady)) {
+            for (size_t i = 0; i < vReady.size(); i++) {
+                if (recv(vReady[i].first, &c, 1, MSG_DONTWAIT) == 1)
+                    fReceived = true;
+            }
+        }
+    }
+
+    delete pevents;
+}
+
+static void SocketEventsSelect125(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_SELECT, 125); }
+static void SocketEventsSelect500(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_SELECT, 500); }
+static void SocketEventsSelect1000(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_SELECT, 1000); }
+
+BENCHMARK(SocketEventsSelect125);
+BENCHMARK(SocketEventsSelect500);
+BENCHMARK(SocketEventsSelect1000);
+
+#ifdef USE_EPOLL
+static void SocketEventsEpoll125(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_EPOLL, 125); }
+static void SocketEventsEpoll500(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_EPOLL, 500); }
+static void SocketEventsEpoll1000(benchmark::State& state) { RelayLatency(state, SOCKETEVENTS_EPOLL, 1000); }
+
+BENCHMARK(SocketEventsEpoll125);
+BENCHMARK(SocketEventsEpoll500);
+BENCHMARK(SocketEventsEpoll1000);
+#endif
+
+#endif // WIN32
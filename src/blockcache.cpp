@@ -0,0 +1,102 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "blockencodings.h"
+#include "net.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+#include "version.h"
+
+CRecentBlockCache recentBlockCache;
+
+CRecentBlockCache::CRecentBlockCache(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn), nHits(0), nMisses(0)
+{
+}
+
+void CRecentBlockCache::SetMaxSize(size_t nMaxSizeIn)
+{
+    LOCK(cs);
+    nMaxSize = nMaxSizeIn;
+    Trim();
+}
+
+void CRecentBlockCache::Add(const CBlock& block, const uint256& hash)
+{
+    {
+        LOCK(cs);
+        if (nMaxSize == 0 || mapEntries.count(hash))
+            return;
+    }
+
+    // Serialize outside the lock, requests for other blocks can still be served meanwhile
+    Entry entry;
+    entry.block = std::make_shared<const CBlock>(block);
+    entry.blockMsg = SerializeNetMessage(NetMsgType::BLOCK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, block);
+    entry.cmpctBlock = std::make_shared<const CBlockHeaderAndShortTxIDs>(block, false);
+    entry.cmpctBlockMsg = SerializeNetMessage(NetMsgType::CMPCTBLOCK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, *entry.cmpctBlock);
+
+    LOCK(cs);
+    if (mapEntries.count(hash))
+        return;
+    listEntries.push_front(std::make_pair(hash, entry));
+    mapEntries[hash] = listEntries.begin();
+    Trim();
+}
+
+bool CRecentBlockCache::Get(const uint256& hash, Entry& entryOut)
+{
+    LOCK(cs);
+    std::map<uint256, EntryList::iterator>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end()) {
+        nMisses++;
+        return false;
+    }
+    nHits++;
+    listEntries.splice(listEntries.begin(), listEntries, it->second);
+    entryOut = it->second->second;
+    return true;
+}
+
+void CRecentBlockCache::Clear()
+{
+    LOCK(cs);
+    listEntries.clear();
+    mapEntries.clear();
+}
+
+void CRecentBlockCache::Trim()
+{
+    AssertLockHeld(cs);
+    while (listEntries.size() > nMaxSize) {
+        mapEntries.erase(listEntries.back().first);
+        listEntries.pop_back();
+    }
+}
+
+size_t CRecentBlockCache::Size() const
+{
+    LOCK(cs);
+    return listEntries.size();
+}
+
+size_t CRecentBlockCache::MaxSize() const
+{
+    LOCK(cs);
+    return nMaxSize;
+}
+
+uint64_t CRecentBlockCache::GetHits() const
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t CRecentBlockCache::GetMisses() const
+{
+    LOCK(cs);
+    return nMisses;
+}
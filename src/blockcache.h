@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include "support/allocators/zeroafterfree.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+#include <stdint.h>
+
+class CBlock;
+class CBlockHeaderAndShortTxIDs;
+
+/** Default for -recentblockcache, the number of recently connected blocks kept ready to serve */
+static const unsigned int DEFAULT_RECENT_BLOCK_CACHE = 10;
+
+/**
+ * LRU cache of the most recently connected blocks, kept together with their
+ * ready to send "block" and "cmpctblock" messages. A new block is usually
+ * requested by most peers right after it is announced; serving those requests
+ * from here avoids reading, hashing and reserializing it once per peer.
+ */
+class CRecentBlockCache
+{
+public:
+    struct Entry {
+        std::shared_ptr<const CBlock> block;
+        //! NetMsgType::BLOCK message, serialized without witness
+        std::shared_ptr<const CSerializeData> blockMsg;
+        std::shared_ptr<const CBlockHeaderAndShortTxIDs> cmpctBlock;
+        //! NetMsgType::CMPCTBLOCK message built from cmpctBlock, serialized without witness
+        std::shared_ptr<const CSerializeData> cmpctBlockMsg;
+    };
+
+    explicit CRecentBlockCache(size_t nMaxSizeIn = DEFAULT_RECENT_BLOCK_CACHE);
+
+    /** Change the number of blocks kept, 0 disables the cache */
+    void SetMaxSize(size_t nMaxSizeIn);
+
+    /** Serialize and store a block, evicting the least recently used one if full */
+    void Add(const CBlock& block, const uint256& hash);
+
+    /** Look up a block, counting a hit or miss; returns false if it is not cached */
+    bool Get(const uint256& hash, Entry& entryOut);
+
+    void Clear();
+
+    size_t Size() const;
+    size_t MaxSize() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+
+private:
+    typedef std::list<std::pair<uint256, Entry> > EntryList;
+
+    mutable CCriticalSection cs;
+    size_t nMaxSize;
+    //! Most recently used first
+    EntryList listEntries;
+    std::map<uint256, EntryList::iterator> mapEntries;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    void Trim();
+};
+
+extern CRecentBlockCache recentBlockCache;
+
+#endif // BITCOIN_BLOCKCACHE_H
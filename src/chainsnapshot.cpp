@@ -0,0 +1,82 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainsnapshot.h"
+
+#include "chain.h"
+#include "sync.h"
+
+namespace {
+
+CCriticalSection cs_snapshot;
+std::shared_ptr<const CChainTipSnapshot> latestSnapshot(new CChainTipSnapshot(NULL));
+
+}
+
+CChainTipSnapshot::CChainTipSnapshot(const CBlockIndex *pindexTipIn, const CChainTipSnapshot *prev)
+    : pindexTip(pindexTipIn),
+      pindexLastPoW(FindLastBlock(prev, false)),
+      pindexLastPoS(FindLastBlock(prev, true)),
+      dDifficultyPoW(pindexLastPoW ? pindexLastPoW->GetBlockDifficulty() : 1.0),
+      dDifficultyPoS(pindexLastPoS ? pindexLastPoS->GetBlockDifficulty() : 1.0)
+{
+}
+
+const CBlockIndex *CChainTipSnapshot::FindLastBlock(const CChainTipSnapshot *prev, bool fProofOfStake) const
+{
+    if (pindexTip == NULL)
+        return NULL;
+
+    if (prev && prev->pindexTip) {
+        const CBlockIndex *pindexPrevLast = fProofOfStake ? prev->pindexLastPoS : prev->pindexLastPoW;
+        // A block connected on top of the previous tip
+        if (pindexTip->pprev == prev->pindexTip)
+            return pindexTip->IsProofOfStake() == fProofOfStake ? pindexTip : pindexPrevLast;
+        // The previous tip disconnected, unless it was the last block of its kind
+        if (prev->pindexTip->pprev == pindexTip && pindexPrevLast != prev->pindexTip)
+            return pindexPrevLast;
+    }
+
+    // Startup or a reorg
+    return GetLastBlockIndex(pindexTip, fProofOfStake);
+}
+
+int CChainTipSnapshot::Height() const
+{
+    return pindexTip ? pindexTip->nHeight : -1;
+}
+
+const CBlockIndex *CChainTipSnapshot::operator[](int nHeight) const
+{
+    if (nHeight < 0 || nHeight > Height())
+        return NULL;
+    return pindexTip->GetAncestor(nHeight);
+}
+
+bool CChainTipSnapshot::Contains(const CBlockIndex *pindex) const
+{
+    return pindex != NULL && (*this)[pindex->nHeight] == pindex;
+}
+
+const CBlockIndex *CChainTipSnapshot::Next(const CBlockIndex *pindex) const
+{
+    if (Contains(pindex))
+        return (*this)[pindex->nHeight + 1];
+    return NULL;
+}
+
+void PublishChainTipSnapshot(const CBlockIndex *pindexTip)
+{
+    // Snapshots are only published under cs_main, so the latest one can't
+    // change between reading it here and replacing it below
+    std::shared_ptr<const CChainTipSnapshot> snapshot(new CChainTipSnapshot(pindexTip, GetChainTipSnapshot().get()));
+    LOCK(cs_snapshot);
+    latestSnapshot.swap(snapshot);
+}
+
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot()
+{
+    LOCK(cs_snapshot);
+    return latestSnapshot;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CHAINSNAPSHOT_H
+#define BITCOIN_CHAINSNAPSHOT_H
+
+#include <memory>
+
+class CBlockIndex;
+
+/**
+ * Immutable view of the active chain as of one tip, published whenever the
+ * tip changes so read-only RPCs can answer without holding cs_main.
+ *
+ * Block index entries are never freed while the node runs and their height,
+ * hash, pprev and pskip never change once they are in mapBlockIndex, so the
+ * chain below the snapshot tip can be walked without locks. Lookups by height
+ * use the skip list and cost O(log n) rather than CChain's O(1).
+ */
+class CChainTipSnapshot
+{
+private:
+    const CBlockIndex *pindexTip;
+    //! Last proof-of-work and proof-of-stake blocks up to the tip
+    const CBlockIndex *pindexLastPoW;
+    const CBlockIndex *pindexLastPoS;
+    double dDifficultyPoW;
+    double dDifficultyPoS;
+
+    const CBlockIndex *FindLastBlock(const CChainTipSnapshot *prev, bool fProofOfStake) const;
+
+public:
+    /**
+     * Finding the last block of each kind walks back over the chain, prev is
+     * the snapshot published before this one so that a tip moving by one
+     * block can take them over from it instead.
+     */
+    explicit CChainTipSnapshot(const CBlockIndex *pindexTipIn, const CChainTipSnapshot *prev = NULL);
+
+    /** Returns the tip of this snapshot, or NULL before a chain is loaded */
+    const CBlockIndex *Tip() const { return pindexTip; }
+
+    /** Returns the height of the tip, -1 if there is none */
+    int Height() const;
+
+    /** Returns the block at height nHeight on this chain, or NULL if out of range */
+    const CBlockIndex *operator[](int nHeight) const;
+
+    /** Whether pindex is part of this chain */
+    bool Contains(const CBlockIndex *pindex) const;
+
+    /** Successor of pindex on this chain, or NULL if pindex is the tip or not on this chain */
+    const CBlockIndex *Next(const CBlockIndex *pindex) const;
+
+    /** Difficulty of the last proof-of-work and proof-of-stake blocks up to the tip */
+    double GetDifficultyPoW() const { return dDifficultyPoW; }
+    double GetDifficultyPoS() const { return dDifficultyPoS; }
+};
+
+/** Publish a snapshot of the new active chain tip. Call with cs_main held whenever chainActive's tip changes. */
+void PublishChainTipSnapshot(const CBlockIndex *pindexTip);
+
+/** Latest published snapshot, never NULL. Does not require cs_main. */
+std::shared_ptr<const CChainTipSnapshot> GetChainTipSnapshot();
+
+#endif // BITCOIN_CHAINSNAPSHOT_H
@@ -15,25 +15,14 @@
 #include "univalue.h"
 #include <fstream>
 
+#include <boost/algorithm/string.hpp>
+
 namespace fs = boost::filesystem;
 using namespace boost::chrono;
 using namespace std;
 
 void GetSigmaBalance(CAmount& sigmaAll, CAmount& sigmaConfirmed) {
-    auto coins = zwalletMain->GetTracker().ListMints(true, false, false);
-    for (const auto& coin : coins) {
-        // ignore spent coin
-        if (coin.isUsed)
-            continue;
-
-        int64_t coinValue;
-        DenominationToInteger(coin.denom, coinValue);
-
-        sigmaAll += coinValue;
-        if (coin.nHeight > 0
-            && coin.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height())
-            sigmaConfirmed += coinValue;
-    }
+    zwalletMain->GetTracker().GetUnusedBalance(sigmaAll, sigmaConfirmed);
 }
 
 UniValue getTxMetadataEntry(string txid, string address, CAmount amount){
@@ -67,28 +56,6 @@ UniValue getTxMetadataEntry(string txid, string address, CAmount amount){
 }
 
 
-CAmount getLockUnspentAmount()
-{
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-
-    CTransaction tx;
-    uint256 hashBlock;
-    uint256 hash;
-    vector<COutPoint> vOutpts;
-    CAmount total = 0;
-
-    pwalletMain->ListLockedCoins(vOutpts);
-
-    BOOST_FOREACH(COutPoint &outpt, vOutpts) {
-        uint256 hash = outpt.hash;
-        if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
-            continue;
-        total += tx.vout[outpt.n].nValue;
-    }
-
-    return total;
-}
-
 UniValue getInitialTimestamp(string hash){
     fs::path const &path = CreateTxTimestampFile();
 
@@ -414,19 +381,97 @@ UniValue StateSinceBlock(UniValue& ret, std::string block){
     if (it != mapBlockIndex.end())
         pindex = it->second;
 
-    int depth = pindex ? (1 + chainActive.Height() - pindex->nHeight) : -1;
-
     UniValue transactions(UniValue::VOBJ);
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++)
+    CWalletHistoryPos pos;
+    BOOST_FOREACH(const CWalletTx* pwtx, pwalletMain->GetHistory(pos, pindex ? pindex->nHeight : 0, std::numeric_limits<size_t>::max()))
     {
-        CWalletTx tx = (*it).second;
+        ListAPITransactions(*pwtx, transactions, filter);
+    }
+
+    ret.push_back(Pair("addresses", transactions));
+    ret.push_back(Pair("cursor", pwalletMain->GetHistoryChange()));
+
+    return ret;
+}
+
+std::string HistoryPosToString(const CWalletHistoryPos& pos){
+    return strprintf("%d:%d:%s", pos.nHeight, pos.nOrderPos, pos.hash.GetHex());
+}
+
+bool HistoryPosFromString(const std::string& str, CWalletHistoryPos& pos){
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of(":"));
+    if (parts.size() != 3 || !ParseInt32(parts[0], &pos.nHeight) || !ParseInt64(parts[1], &pos.nOrderPos) || !IsHex(parts[2]))
+        return false;
+    pos.hash.SetHex(parts[2]);
+    return true;
+}
 
-        if (depth == -1 || tx.GetDepthInMainChain() <= depth)
-            ListAPITransactions(tx, transactions, filter);
+/*
+ * The wallet history a page of "limit" transactions at a time, newest first, or the transactions
+ * changed since "since". Pages after the first are asked for with the "next" of the previous one.
+ * "cursor" is the last change to the history; the one returned with the first page of a listing,
+ * passed as "since" later, gets what changed after it.
+ */
+UniValue StateWalletHistory(UniValue& ret, const UniValue& data){
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    isminefilter filter = ISMINE_SPENDABLE;
+
+    size_t nLimit = std::numeric_limits<size_t>::max();
+    UniValue limit = find_value(data, "limit");
+    if (!limit.isNull()) {
+        if (limit.get_int() <= 0)
+            throw JSONAPIError(API_INVALID_PARAMETER, "Invalid limit");
+        nLimit = limit.get_int();
+    }
+
+    UniValue transactions(UniValue::VOBJ);
+
+    UniValue since = find_value(data, "since");
+    if (!since.isNull()) {
+        int64_t nChange = since.get_int64();
+        std::vector<const CWalletTx*> vChanged;
+        std::vector<uint256> vRemoved;
+        pwalletMain->GetHistoryChanges(nChange, nLimit, vChanged, vRemoved);
+
+        BOOST_FOREACH(const CWalletTx* pwtx, vChanged)
+        {
+            ListAPITransactions(*pwtx, transactions, filter);
+        }
+
+        UniValue removed(UniValue::VARR);
+        BOOST_FOREACH(const uint256& hash, vRemoved)
+        {
+            removed.push_back(hash.GetHex());
+        }
+
+        ret.push_back(Pair("addresses", transactions));
+        ret.push_back(Pair("removed", removed));
+        ret.push_back(Pair("cursor", nChange));
+        if (vChanged.size() + vRemoved.size() == nLimit)
+            ret.push_back(Pair("more", true));
+
+        return ret;
+    }
+
+    CWalletHistoryPos pos;
+    UniValue page = find_value(data, "page");
+    if (!page.isNull() && !HistoryPosFromString(page.get_str(), pos))
+        throw JSONAPIError(API_INVALID_PARAMETER, "Invalid page");
+
+    std::vector<const CWalletTx*> vHistory = pwalletMain->GetHistory(pos, 0, nLimit);
+    BOOST_FOREACH(const CWalletTx* pwtx, vHistory)
+    {
+        ListAPITransactions(*pwtx, transactions, filter);
     }
 
     ret.push_back(Pair("addresses", transactions));
+    ret.push_back(Pair("cursor", pwalletMain->GetHistoryChange()));
+    if (vHistory.size() == nLimit)
+        ret.push_back(Pair("next", HistoryPosToString(pos)));
 
     return ret;
 }
@@ -475,6 +520,11 @@ UniValue statewallet(Type type, const UniValue& data, const UniValue& auth, bool
 
     UniValue ret(UniValue::VOBJ);
 
+    if (!find_value(data, "limit").isNull() || !find_value(data, "since").isNull()) {
+        StateWalletHistory(ret, data);
+        return ret;
+    }
+
     std::string genesisBlock = chainActive[0]->GetBlockHash().ToString();
 
     StateSinceBlock(ret, genesisBlock);
@@ -633,10 +683,11 @@ UniValue balance(Type type, const UniValue& data, const UniValue& auth, bool fHe
     UniValue sigmaObj(UniValue::VOBJ);
 
     // various balances
-    CAmount xzcConfirmed = pwalletMain->GetBalance();
-    CAmount xzcUnconfirmed = pwalletMain->GetUnconfirmedBalance();
-    CAmount xzcLocked = getLockUnspentAmount();
-    CAmount xzcImmature = pwalletMain->GetImmatureBalance();
+    CWalletBalances balances = pwalletMain->GetBalances();
+    CAmount xzcConfirmed = balances.nTrusted;
+    CAmount xzcUnconfirmed = balances.nUnconfirmed;
+    CAmount xzcLocked = balances.nLocked;
+    CAmount xzcImmature = balances.nImmature;
 
     //get private confirmed
     CAmount sigmaAll = 0;
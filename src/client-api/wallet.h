@@ -10,4 +10,5 @@
 void ListAPITransactions(const CWalletTx& wtx, UniValue& ret, const isminefilter& filter);
 
 UniValue StateSinceBlock(UniValue& ret, std::string block);
-UniValue StateBlock(UniValue& ret, std::string blockhash);
\ No newline at end of file
+UniValue StateBlock(UniValue& ret, std::string blockhash);
+UniValue StateWalletHistory(UniValue& ret, const UniValue& data);
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "arith_uint256.h"
 #include "uint256.h"
 
+#include <assert.h>
 #include <stdint.h>
 #include <algorithm>
 #include <string>
@@ -286,7 +287,7 @@ uint256 GetMetaDExHash(const uint32_t propertyId)
 
     std::vector<std::pair<arith_uint256, std::string> > vecMetaDExTrades;
     for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyId == 0 || propertyId == my_it->first) {
+        if (propertyId == 0 || propertyId == my_it->first.first) {
             const md_PricesMap& prices = my_it->second;
             for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
                 const md_Set& indexes = it->second;
@@ -318,22 +319,16 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
 
     LOCK(cs_main);
 
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
+    // the holders are sorted alphabetically
+    const HolderMap& holders = getHolders(hashPropertyId);
+    for (HolderMap::const_iterator my_it = holders.begin(); my_it != holders.end(); ++my_it) {
         const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            if (propertyId != hashPropertyId) continue;
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue;
-            if (elysium_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
-            SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
-        }
+        const CMPTally* tally = getTally(address);
+        assert(tally != NULL);
+        std::string dataStr = GenerateConsensusString(*tally, address, hashPropertyId);
+        if (dataStr.empty()) continue;
+        if (elysium_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
+        SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
     }
 
     uint256 balancesHash;
@@ -12,6 +12,7 @@
 #include "elysium/elysium.h"
 #include "elysium/rules.h"
 #include "elysium/uint256_extensions.h"
+#include "elysium/undo.h"
 
 #include "arith_uint256.h"
 #include "main.h"
@@ -196,6 +197,7 @@ int DEx_offerCreate(const std::string& addressSeller, uint32_t propertyId, int64
         assert(update_tally_map(addressSeller, propertyId, amountOffered, SELLOFFER_RESERVE));
 
         CMPOffer sellOffer(block, amountOffered, propertyId, amountDesired, minAcceptFee, paymentWindow, txid);
+        RecordOfferUndo(key);
         my_offers.insert(std::make_pair(key, sellOffer));
 
         rc = 0;
@@ -228,6 +230,7 @@ int DEx_offerDestroy(const std::string& addressSeller, uint32_t propertyId)
     // delete the offer
     const std::string key = STR_SELLOFFER_ADDR_PROP_COMBO(addressSeller, propertyId);
     OfferMap::iterator it = my_offers.find(key);
+    RecordOfferUndo(key);
     my_offers.erase(it);
 
     if (elysium_debug_dex) PrintToLog("%s(%s|%s)\n", __func__, addressSeller, key);
@@ -312,6 +315,7 @@ int DEx_acceptCreate(const std::string& addressBuyer, const std::string& address
         assert(update_tally_map(addressSeller, propertyId, amountReserved, ACCEPT_RESERVE));
 
         CMPAccept acceptOffer(amountReserved, block, offer.getBlockTimeLimit(), offer.getProperty(), offer.getOfferAmountOriginal(), offer.getXZCDesiredOriginal(), offer.getHash());
+        RecordAcceptUndo(keyAcceptOrder);
         my_accepts.insert(std::make_pair(keyAcceptOrder, acceptOffer));
 
         rc = 0;
@@ -376,6 +380,7 @@ int DEx_acceptDestroy(const std::string& addressBuyer, const std::string& addres
         AcceptMap::iterator it = my_accepts.find(key);
 
         if (my_accepts.end() != it) {
+            RecordAcceptUndo(key);
             my_accepts.erase(it);
         }
     }
@@ -522,6 +527,7 @@ int DEx_payment(const uint256& txid, unsigned int vout, const std::string& addre
     }
 
     // reduce the amount of units still desired by the buyer and if 0 destroy the Accept order
+    RecordAcceptUndo(STR_ACCEPT_ADDR_PROP_ADDR_COMBO(addressSeller, addressBuyer, propertyId));
     if (p_accept->reduceAcceptAmountRemaining_andIsZero(amountPurchased)) {
         const int64_t reserveSell = getMPbalance(addressSeller, propertyId, SELLOFFER_RESERVE);
         const int64_t reserveAccept = getMPbalance(addressSeller, propertyId, ACCEPT_RESERVE);
@@ -562,6 +568,7 @@ unsigned int eraseExpiredAccepts(int blockNow)
 
             DEx_acceptDestroy(addressBuyer, addressSeller, propertyId);
 
+            RecordAcceptUndo(it->first);
             my_accepts.erase(it++);
 
             ++how_many_erased;
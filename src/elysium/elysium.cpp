@@ -6,6 +6,7 @@
 #include "dex.h"
 #include "errors.h"
 #include "fees.h"
+#include "fetchwallettx.h"
 #include "log.h"
 #include "mdex.h"
 #include "notifications.h"
@@ -19,6 +20,7 @@
 #include "tally.h"
 #include "tx.h"
 #include "txprocessor.h"
+#include "undo.h"
 #include "utils.h"
 #include "utilsbitcoin.h"
 #include "version.h"
@@ -30,6 +32,7 @@
 
 #include "../base58.h"
 #include "../chainparams.h"
+#include "../checkqueue.h"
 #include "../coincontrol.h"
 #include "../coins.h"
 #include "../core_io.h"
@@ -63,6 +66,7 @@
 #include <openssl/sha.h>
 
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 
 #include <assert.h>
 #include <stdint.h>
@@ -70,6 +74,7 @@
 
 #include <fstream>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -122,6 +127,8 @@ static int elysiumInitialized = 0;
 
 static int reorgRecoveryMode = 0;
 static int reorgRecoveryMaxHeight = 0;
+//! Whether all blocks disconnected in the reorg were rolled back with their undo records
+static bool reorgRecoveryUndone = false;
 
 CMPTxList *elysium::p_txlistdb;
 CMPTradeList *elysium::t_tradelistdb;
@@ -244,6 +251,14 @@ CrowdMap elysium::my_crowds;
 // this is the master list of all amounts for all addresses for all properties, map is unsorted
 std::unordered_map<std::string, CMPTally> elysium::mp_tally_map;
 
+// index of the tally map by property, maintained by update_tally_map
+static std::unordered_map<uint32_t, HolderMap> mp_holders_map;
+// sum of the holder index of each property, so the total doesn't need a walk over all holders
+static std::unordered_map<uint32_t, int64_t> mp_holdings_total;
+
+boost::signals2::signal<void(const std::string&, uint32_t)> elysium::TallyChanged;
+boost::signals2::signal<void()> elysium::TallyCleared;
+
 CMPTally* elysium::getTally(const std::string& address)
 {
     std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.find(address);
@@ -253,6 +268,19 @@ CMPTally* elysium::getTally(const std::string& address)
     return (CMPTally *) NULL;
 }
 
+const HolderMap& elysium::getHolders(uint32_t propertyId)
+{
+    static const HolderMap noHolders;
+
+    AssertLockHeld(cs_main);
+
+    std::unordered_map<uint32_t, HolderMap>::const_iterator it = mp_holders_map.find(propertyId);
+
+    if (it != mp_holders_map.end()) return it->second;
+
+    return noHolders;
+}
+
 // look at balance for an address
 int64_t getMPbalance(const std::string& address, uint32_t propertyId, TallyType ttype)
 {
@@ -332,6 +360,7 @@ void elysium::PrintFreezeState()
 
 void elysium::enableFreezing(uint32_t propertyId, int liveBlock)
 {
+    RecordFreezingUndo(propertyId, liveBlock, setFreezingEnabledProperties.count(std::make_pair(propertyId, liveBlock)) > 0);
     setFreezingEnabledProperties.insert(std::make_pair(propertyId, liveBlock));
     assert(isFreezingEnabled(propertyId, liveBlock));
     PrintToLog("Freezing for property %d will be enabled at block %d.\n", propertyId, liveBlock);
@@ -347,6 +376,7 @@ void elysium::disableFreezing(uint32_t propertyId)
     }
     assert(liveBlock > 0);
 
+    RecordFreezingUndo(propertyId, liveBlock, true);
     setFreezingEnabledProperties.erase(std::make_pair(propertyId, liveBlock));
     PrintToLog("Freezing for property %d has been disabled.\n", propertyId);
 
@@ -354,6 +384,7 @@ void elysium::disableFreezing(uint32_t propertyId)
     for (std::set<std::pair<std::string,uint32_t> >::iterator it = setFrozenAddresses.begin(); it != setFrozenAddresses.end(); ) {
         if ((*it).second == propertyId) {
             PrintToLog("Address %s has been unfrozen for property %d.\n", (*it).first, propertyId);
+            RecordFrozenAddressUndo((*it).first, propertyId);
             it = setFrozenAddresses.erase(it);
             assert(!isAddressFrozen((*it).first, (*it).second));
         } else {
@@ -378,6 +409,7 @@ bool elysium::isFreezingEnabled(uint32_t propertyId, int block)
 
 void elysium::freezeAddress(const std::string& address, uint32_t propertyId)
 {
+    RecordFrozenAddressUndo(address, propertyId);
     setFrozenAddresses.insert(std::make_pair(address, propertyId));
     assert(isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been frozen for property %d.\n", address, propertyId);
@@ -385,6 +417,7 @@ void elysium::freezeAddress(const std::string& address, uint32_t propertyId)
 
 void elysium::unfreezeAddress(const std::string& address, uint32_t propertyId)
 {
+    RecordFrozenAddressUndo(address, propertyId);
     setFrozenAddresses.erase(std::make_pair(address, propertyId));
     assert(!isAddressFrozen(address, propertyId));
     PrintToLog("Address %s has been unfrozen for property %d.\n", address, propertyId);
@@ -429,18 +462,19 @@ int64_t elysium::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     }
 
     if (!property.fixed || n_owners_total) {
-        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const CMPTally& tally = it->second;
-
-            totalTokens += tally.getMoney(propertyId, BALANCE);
-            totalTokens += tally.getMoney(propertyId, SELLOFFER_RESERVE);
-            totalTokens += tally.getMoney(propertyId, ACCEPT_RESERVE);
-            totalTokens += tally.getMoney(propertyId, METADEX_RESERVE);
-
-            if (prev != totalTokens) {
-                prev = totalTokens;
-                owners++;
+        if (n_owners_total) {
+            const HolderMap& holders = getHolders(propertyId);
+            for (HolderMap::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+                totalTokens += it->second;
+
+                if (prev != totalTokens) {
+                    prev = totalTokens;
+                    owners++;
+                }
             }
+        } else {
+            std::unordered_map<uint32_t, int64_t>::const_iterator it = mp_holdings_total.find(propertyId);
+            if (it != mp_holdings_total.end()) totalTokens = it->second;
         }
         int64_t cachedFee = p_feecache->GetCachedAmount(propertyId);
         totalTokens += cachedFee;
@@ -488,6 +522,17 @@ bool elysium::update_tally_map(const std::string& who, uint32_t propertyId, int6
     CMPTally& tally = my_it->second;
     bRet = tally.updateMoney(propertyId, amount, ttype);
 
+    // the tally now has a record for the property, even if the update failed
+    int64_t& holding = mp_holders_map[propertyId][who];
+    if (bRet && ttype != PENDING) {
+        holding += amount;
+        mp_holdings_total[propertyId] += amount;
+        RecordTallyUndo(who, propertyId, amount, ttype);
+    }
+    if (bRet) {
+        TallyChanged(who, propertyId);
+    }
+
     after = getMPbalance(who, propertyId, ttype);
     if (!bRet) {
         assert(before == after);
@@ -500,6 +545,17 @@ bool elysium::update_tally_map(const std::string& who, uint32_t propertyId, int6
     return bRet;
 }
 
+void elysium::clear_tally_map()
+{
+    LOCK(cs_main);
+
+    mp_tally_map.clear();
+    mp_holders_map.clear();
+    mp_holdings_total.clear();
+
+    TallyCleared();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // some old TODOs
@@ -581,6 +637,7 @@ void NotifyTotalTokensChanged(uint32_t propertyId, int block)
 
 void CheckWalletUpdate(bool forceUpdate)
 {
+    // the wallet totals are updated by the wallet cache, with the balances that changed
     if (!WalletCacheUpdate()) {
         // no balance changes were detected that affect wallet addresses, signal a generic change to overall Elysium state
         if (!forceUpdate) {
@@ -589,33 +646,6 @@ void CheckWalletUpdate(bool forceUpdate)
         }
     }
 #ifdef ENABLE_WALLET
-    LOCK(cs_main);
-
-    // balance changes were found in the wallet, update the global totals and signal a Elysium balance change
-    global_balance_money.clear();
-    global_balance_reserved.clear();
-
-    // populate global balance totals and wallet property list - note global balances do not include additional balances from watch-only addresses
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        // check if the address is a wallet address (including watched addresses)
-        std::string address = my_it->first;
-        int addressIsMine = IsMyAddress(address);
-        if (!addressIsMine) continue;
-        // iterate only those properties in the TokenMap for this address
-        my_it->second.init();
-        uint32_t propertyId;
-        while (0 != (propertyId = (my_it->second).next())) {
-            // add to the global wallet property list
-            global_wallet_property_list.insert(propertyId);
-            // check if the address is spendable (only spendable balances are included in totals)
-            if (addressIsMine != ISMINE_SPENDABLE) continue;
-            // work out the balances and add to globals
-            global_balance_money[propertyId] += getUserAvailableMPbalance(address, propertyId);
-            global_balance_reserved[propertyId] += getMPbalance(address, propertyId, SELLOFFER_RESERVE);
-            global_balance_reserved[propertyId] += getMPbalance(address, propertyId, METADEX_RESERVE);
-            global_balance_reserved[propertyId] += getMPbalance(address, propertyId, ACCEPT_RESERVE);
-        }
-    }
     // signal an Elysium balance change
     uiInterface.ElysiumBalanceChanged();
 #endif
@@ -682,39 +712,30 @@ static bool FillTxInputCache(const CTransaction& tx)
     return true;
 }
 
-// vgc is position within the block, 0-based
-// int elysium_tx_push(const CTransaction &wtx, int nBlock, unsigned int vgc)
-// INPUT: bRPConly -- set to true to avoid moving funds; to be called from various RPC calls like this
-// RETURNS: 0 if parsed a MP TX
-// RETURNS: < 0 if a non-MP-TX or invalid
-// RETURNS: >0 if 1 or more payments have been made
-static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock, unsigned int vgc, CMPTransaction& mp_tx, unsigned int nTime)
+/**
+ * Logs the start of parsing a transaction with marker.
+ */
+static void LogParseStart(int nBlock, unsigned int vgc, unsigned int nTime, const uint256& txid)
 {
-    InputMode inputMode = InputMode::NORMAL;
-    if (wtx.IsSigmaSpend()) {
-        inputMode = InputMode::SIGMA;
-    }
-
-    assert(bRPConly == mp_tx.isRpcOnly());
-    mp_tx.Set(wtx.GetHash(), nBlock, vgc, nTime);
-
-    // ### CLASS IDENTIFICATION AND MARKER CHECK ###
-    auto elysiumClass = DeterminePacketClass(wtx, nBlock);
-
-    if (!elysiumClass) {
-        return -1; // No Elysium/Elysium marker, thus not a valid Elysium transaction
-    }
-
-    if (!bRPConly || elysium_debug_parser_readonly) {
-        PrintToLog("____________________________________________________________________________________________________________________________________\n");
-        PrintToLog("%s(block=%d, %s vgc= %d); txid: %s\n", __FUNCTION__, nBlock, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTime), vgc, wtx.GetHash().GetHex());
-    }
-
-    // ### SENDER IDENTIFICATION ###
-    boost::optional<CBitcoinAddress> sender;
-    int64_t inAll = 0;
+    PrintToLog("____________________________________________________________________________________________________________________________________\n");
+    PrintToLog("parseTransaction(block=%d, %s vgc= %d); txid: %s\n", nBlock, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTime), vgc, txid.GetHex());
+}
 
-    { // needed to ensure the cache isn't cleared in the meantime when doing parallel queries
+/**
+ * Fetches the outputs spent by a transaction, and the amount of its inputs.
+ *
+ * This is the only part of parsing a transaction, which depends on the chain
+ * and the coins view cache, everything else only depends on the transaction.
+ *
+ * @param wtx[in]        The transaction to fetch inputs for
+ * @param inputMode[in]  The kind of inputs of the transaction
+ * @param prevOuts[out]  The spent outputs, in the order of the inputs, for normal inputs only
+ * @param inAll[out]     The sum of all inputs
+ * @return 0 on success, or -101, if the inputs can't be fetched
+ */
+static int fetchTransactionInputs(const CTransaction& wtx, InputMode inputMode, std::vector<CTxOut>& prevOuts, int64_t& inAll)
+{
+    // needed to ensure the cache isn't cleared in the meantime when doing parallel queries
     LOCK(cs_tx_cache);
 
     // Add previous transaction inputs to the cache
@@ -725,7 +746,38 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
 
     assert(view.HaveInputs(wtx));
 
-    if (*elysiumClass != PacketClass::C) {
+    switch (inputMode) {
+    case InputMode::SIGMA:
+        inAll = sigma::GetSpendAmount(wtx);
+        break;
+    case InputMode::NORMAL:
+    default:
+        prevOuts.reserve(wtx.vin.size());
+        for (unsigned int i = 0; i < wtx.vin.size(); ++i) {
+            prevOuts.push_back(view.GetOutputFor(wtx.vin[i]));
+        }
+        inAll = view.GetValueIn(wtx);
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Identifies the sender, reference and payload of a transaction with marker.
+ *
+ * Only the transaction and its spent outputs are used, so transactions of a
+ * block can be parsed in parallel.
+ *
+ * @see fetchTransactionInputs()
+ */
+static int parseTransactionPayload(const CTransaction& wtx, int nBlock, unsigned int vgc, PacketClass elysiumClass,
+        InputMode inputMode, const std::vector<CTxOut>& prevOuts, int64_t inAll, CMPTransaction& mp_tx)
+{
+    // ### SENDER IDENTIFICATION ###
+    boost::optional<CBitcoinAddress> sender;
+
+    if (elysiumClass != PacketClass::C) {
         if (inputMode != InputMode::NORMAL) {
             PrintToLog("%s() ERROR: other input than normal is not allowed when packet class is not C\n", __func__, wtx.GetHash().GetHex());
             return -101;
@@ -737,8 +789,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
         for (unsigned int i = 0; i < wtx.vin.size(); ++i) {
             if (elysium_debug_vin) PrintToLog("vin=%d:%s\n", i, ScriptToAsmStr(wtx.vin[i].scriptSig));
 
-            const CTxIn& txIn = wtx.vin[i];
-            const CTxOut& txOut = view.GetOutputFor(txIn);
+            const CTxOut& txOut = prevOuts[i];
 
             assert(!txOut.IsNull());
 
@@ -782,8 +833,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
         unsigned int vin_n = 0; // the first input
         if (elysium_debug_vin) PrintToLog("vin=%d:%s\n", vin_n, ScriptToAsmStr(wtx.vin[vin_n].scriptSig));
 
-        const CTxIn& txIn = wtx.vin[vin_n];
-        const CTxOut& txOut = view.GetOutputFor(txIn);
+        const CTxOut& txOut = prevOuts[vin_n];
 
         assert(!txOut.IsNull());
 
@@ -801,18 +851,6 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
         else return -110;
     }
 
-    switch (inputMode) {
-    case InputMode::SIGMA:
-        inAll = sigma::GetSpendAmount(wtx);
-        break;
-    case InputMode::NORMAL:
-    default:
-        inAll = view.GetValueIn(wtx);
-        break;
-    }
-
-    } // end of LOCK(cs_tx_cache)
-
     int64_t outAll = wtx.GetValueOut();
 
     // ### DATA POPULATION ### - save output addresses, values and scripts
@@ -879,7 +917,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
         }
     }
 
-    if (*elysiumClass == PacketClass::B) {
+    if (elysiumClass == PacketClass::B) {
         // ### CLASS B SPECIFC PARSING ###
         std::vector<std::vector<unsigned char>> multisig_script_data;
 
@@ -968,7 +1006,7 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
 
             payload.insert(payload.end(), packets[m] + 1, packets[m] + CLASS_B_CHUNK_SIZE);
         }
-    } else if (*elysiumClass == PacketClass::C) {
+    } else if (elysiumClass == PacketClass::C) {
         // ### CLASS C SPECIFIC PARSING ###
         std::vector<std::vector<unsigned char>> op_return_script_data;
 
@@ -1047,6 +1085,44 @@ static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock,
     return 0;
 }
 
+// vgc is position within the block, 0-based
+// int elysium_tx_push(const CTransaction &wtx, int nBlock, unsigned int vgc)
+// INPUT: bRPConly -- set to true to avoid moving funds; to be called from various RPC calls like this
+// RETURNS: 0 if parsed a MP TX
+// RETURNS: < 0 if a non-MP-TX or invalid
+// RETURNS: >0 if 1 or more payments have been made
+static int parseTransaction(bool bRPConly, const CTransaction& wtx, int nBlock, unsigned int vgc, CMPTransaction& mp_tx, unsigned int nTime)
+{
+    InputMode inputMode = InputMode::NORMAL;
+    if (wtx.IsSigmaSpend()) {
+        inputMode = InputMode::SIGMA;
+    }
+
+    assert(bRPConly == mp_tx.isRpcOnly());
+    mp_tx.Set(wtx.GetHash(), nBlock, vgc, nTime);
+
+    // ### CLASS IDENTIFICATION AND MARKER CHECK ###
+    auto elysiumClass = DeterminePacketClass(wtx, nBlock);
+
+    if (!elysiumClass) {
+        return -1; // No Elysium/Elysium marker, thus not a valid Elysium transaction
+    }
+
+    if (!bRPConly || elysium_debug_parser_readonly) {
+        LogParseStart(nBlock, vgc, nTime, wtx.GetHash());
+    }
+
+    std::vector<CTxOut> prevOuts;
+    int64_t inAll = 0;
+
+    int rc = fetchTransactionInputs(wtx, inputMode, prevOuts, inAll);
+    if (rc != 0) {
+        return rc;
+    }
+
+    return parseTransactionPayload(wtx, nBlock, vgc, *elysiumClass, inputMode, prevOuts, inAll, mp_tx);
+}
+
 /**
  * Provides access to parseTransaction in read-only mode.
  */
@@ -1143,6 +1219,7 @@ public:
  * Likewise, global shutdown requests are honored, and stop the scan progress.
  *
  * @see elysium_handler_block_begin()
+ * @see elysium_handler_block_prepare()
  * @see elysium_handler_tx()
  * @see elysium_handler_block_end()
  *
@@ -1194,6 +1271,7 @@ static int elysium_initial_scan(int nFirstBlock)
         unsigned parsed = 0;
 
         elysium_handler_block_begin(nBlock, pblockindex);
+        elysium_handler_block_prepare(block, nBlock, pblockindex);
 
         for (unsigned i = 0; i < block.vtx.size(); i++) {
             if (elysium_handler_tx(block.vtx[i], nBlock, i, pblockindex)) {
@@ -1436,7 +1514,7 @@ static int elysium_file_load(const string &filename, int what, bool verifyHash =
   switch (what)
   {
     case FILETYPE_BALANCES:
-      mp_tally_map.clear();
+      clear_tally_map();
       inputLineFunc = input_elysium_balances_string;
       break;
 
@@ -1460,11 +1538,7 @@ static int elysium_file_load(const string &filename, int what, bool verifyHash =
       break;
 
     case FILETYPE_MDEXORDERS:
-      // FIXME
-      // memory leak ... gotta unallocate inner layers first....
-      // TODO
-      // ...
-      metadex.clear();
+      MetaDEx_CLEAR();
       inputLineFunc = input_mp_mdexorder_string;
       break;
 
@@ -1549,6 +1623,85 @@ static char const * const statePrefix[NUM_FILETYPES] = {
     "mdexorders",
 };
 
+/**
+ * Puts back the in-memory state as it was before a block.
+ */
+static void ApplyBlockUndo(const BlockUndo& undo)
+{
+    // balances are restored directly, as frozen addresses may have received tokens in the block
+    for (std::map<BlockUndo::TallyKey, int64_t>::const_iterator it = undo.tallies.begin(); it != undo.tallies.end(); ++it) {
+        const std::string& address = std::get<0>(it->first);
+        uint32_t propertyId = std::get<1>(it->first);
+        if (0 == it->second) continue;
+        assert(mp_tally_map[address].updateMoney(propertyId, -it->second, std::get<2>(it->first)));
+        mp_holders_map[propertyId][address] -= it->second;
+        mp_holdings_total[propertyId] -= it->second;
+        TallyChanged(address, propertyId);
+    }
+
+    for (std::map<std::string, boost::optional<CMPOffer>>::const_iterator it = undo.offers.begin(); it != undo.offers.end(); ++it) {
+        my_offers.erase(it->first);
+        if (it->second) my_offers.insert(std::make_pair(it->first, *it->second));
+    }
+
+    for (std::map<std::string, boost::optional<CMPAccept>>::const_iterator it = undo.accepts.begin(); it != undo.accepts.end(); ++it) {
+        my_accepts.erase(it->first);
+        if (it->second) my_accepts.insert(std::make_pair(it->first, *it->second));
+    }
+
+    for (std::map<std::string, boost::optional<CMPCrowd>>::const_iterator it = undo.crowdsales.begin(); it != undo.crowdsales.end(); ++it) {
+        my_crowds.erase(it->first);
+        if (it->second) my_crowds.insert(std::make_pair(it->first, *it->second));
+    }
+
+    for (std::map<uint256, boost::optional<CMPMetaDEx>>::const_iterator it = undo.orders.begin(); it != undo.orders.end(); ++it) {
+        MetaDEx_ERASE(it->first);
+        if (it->second) assert(MetaDEx_INSERT(*it->second));
+    }
+
+    for (std::map<BlockUndo::AddressProperty, bool>::const_iterator it = undo.frozenAddresses.begin(); it != undo.frozenAddresses.end(); ++it) {
+        if (it->second) {
+            setFrozenAddresses.insert(it->first);
+        } else {
+            setFrozenAddresses.erase(it->first);
+        }
+    }
+
+    for (std::map<BlockUndo::FreezingEntry, bool>::const_iterator it = undo.freezingEnabled.begin(); it != undo.freezingEnabled.end(); ++it) {
+        if (it->second) {
+            setFreezingEnabledProperties.insert(it->first);
+        } else {
+            setFreezingEnabledProperties.erase(it->first);
+        }
+    }
+
+    elysium_prev = undo.develysium;
+}
+
+/**
+ * Rolls back the state of a block that is being disconnected.
+ *
+ * @return false, if there is no undo record for the block, in which case the state is unchanged
+ */
+static bool undo_block(CBlockIndex const *pBlockIndex)
+{
+    BlockUndo undo;
+    if (!PopBlockUndo(pBlockIndex->GetBlockHash(), undo)) {
+        return false;
+    }
+
+    if (0 > _my_sps->popBlock(pBlockIndex->GetBlockHash())) {
+        return false;
+    }
+    if (pBlockIndex->pprev != NULL) {
+        _my_sps->setWatermark(pBlockIndex->pprev->GetBlockHash());
+    }
+
+    ApplyBlockUndo(undo);
+
+    return true;
+}
+
 // returns the height of the state loaded
 static int load_most_relevant_state()
 {
@@ -1922,11 +2075,11 @@ void clear_all_state()
     LOCK(cs_main);
 
     // Memory based storage
-    mp_tally_map.clear();
+    clear_tally_map();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
-    metadex.clear();
+    MetaDEx_CLEAR();
     my_pending.clear();
     ResetConsensusParams();
     ClearActivations();
@@ -1942,8 +2095,10 @@ void clear_all_state()
     p_ElysiumTXDB->Clear();
     p_feecache->Clear();
     p_feehistory->Clear();
+    WalletTxIndexClear();
     assert(p_txlistdb->setDBVersion() == DB_VERSION); // new set of databases, set DB version
     elysium_prev = 0;
+    ClearBlockUndo();
 
     // Clear wallet state
 #ifdef ENABLE_WALLET
@@ -2034,6 +2189,10 @@ int elysium_init()
     }
 #endif
 
+    // follow the balances of wallet addresses from now on
+    WalletCacheInit();
+    WalletTxIndexInit();
+
     bool wrongDBVersion = (p_txlistdb->getDBVersion() != DB_VERSION);
 
     ++elysiumInitialized;
@@ -2119,6 +2278,9 @@ int elysium_shutdown()
 {
     LOCK(cs_main);
 
+    WalletCacheShutdown();
+    WalletTxIndexShutdown();
+
 #ifdef ENABLE_WALLET
     delete wallet; wallet = nullptr;
 #endif
@@ -2140,6 +2302,212 @@ int elysium_shutdown()
     return 0;
 }
 
+namespace {
+
+/**
+ * A transaction of a block, parsed ahead of applying it.
+ */
+struct PreparedTransaction
+{
+    const CTransaction* tx;
+    unsigned int vgc;
+    boost::optional<PacketClass> packetClass;
+    InputMode inputMode;
+    std::vector<CTxOut> prevOuts;
+    int64_t inAll;
+    //! Result of parseTransaction
+    int result;
+    //! Only set for transactions with marker
+    std::unique_ptr<CMPTransaction> mp_tx;
+
+    PreparedTransaction() : tx(nullptr), vgc(0), inputMode(InputMode::NORMAL), inAll(0), result(-1) {}
+};
+
+/**
+ * Runs the stateless part of parsing a transaction, by the parse queue.
+ */
+class CElysiumParseCheck
+{
+private:
+    PreparedTransaction* prepared;
+    int nBlock;
+    unsigned int nTime;
+    bool fClassify;
+
+public:
+    CElysiumParseCheck() : prepared(nullptr), nBlock(0), nTime(0), fClassify(false) {}
+    CElysiumParseCheck(PreparedTransaction& prepared, int nBlock, unsigned int nTime, bool fClassify) :
+        prepared(&prepared), nBlock(nBlock), nTime(nTime), fClassify(fClassify) {}
+
+    bool operator()()
+    {
+        PreparedTransaction& p = *prepared;
+
+        if (fClassify) {
+            p.packetClass = DeterminePacketClass(*p.tx, nBlock);
+            p.inputMode = p.tx->IsSigmaSpend() ? InputMode::SIGMA : InputMode::NORMAL;
+            return true;
+        }
+
+        p.mp_tx.reset(new CMPTransaction());
+        p.mp_tx->unlockLogic();
+        p.mp_tx->Set(p.tx->GetHash(), nBlock, p.vgc, nTime);
+
+        p.result = parseTransactionPayload(*p.tx, nBlock, p.vgc, *p.packetClass, p.inputMode, p.prevOuts, p.inAll, *p.mp_tx);
+        if (p.result == 0) {
+            p.mp_tx->interpretPayload();
+        }
+
+        // invalid transactions are recorded in the result, the check itself never fails
+        return true;
+    }
+
+    void swap(CElysiumParseCheck& check)
+    {
+        std::swap(prepared, check.prepared);
+        std::swap(nBlock, check.nBlock);
+        std::swap(nTime, check.nTime);
+        std::swap(fClassify, check.fClassify);
+    }
+};
+
+CCheckQueue<CElysiumParseCheck> parseQueue(16);
+// CCheckQueueControl requires the queue to have a single controller at a time
+CCriticalSection cs_parse;
+
+//! Block of the prepared transactions
+uint256 preparedBlockHash;
+int preparedBlockHeight = -1;
+std::vector<PreparedTransaction> preparedTxs;
+
+//! Time spent in each stage of parsing the current block, in microseconds
+int64_t nTimeClassify = 0;
+int64_t nTimeInputs = 0;
+int64_t nTimeParse = 0;
+int64_t nTimeApply = 0;
+
+/**
+ * Takes the result of parsing a transaction, if the transaction was prepared.
+ */
+bool TakePreparedTransaction(const CTransaction& tx, int nBlock, unsigned int vgc, const CBlockIndex* pBlockIndex,
+        std::unique_ptr<CMPTransaction>& mp_tx, int& result)
+{
+    if (vgc >= preparedTxs.size() || preparedBlockHash != pBlockIndex->GetBlockHash()) {
+        return false;
+    }
+
+    // the transactions were parsed at the height of the block, anything else has to be parsed again
+    if (nBlock != pBlockIndex->nHeight || preparedBlockHeight != nBlock) {
+        return false;
+    }
+
+    PreparedTransaction& prepared = preparedTxs[vgc];
+    if (prepared.tx == nullptr || prepared.tx->GetHash() != tx.GetHash()) {
+        return false;
+    }
+
+    if (prepared.mp_tx && prepared.mp_tx->getBlock() != nBlock) {
+        return false;
+    }
+
+    if (prepared.packetClass) {
+        LogParseStart(nBlock, vgc, pBlockIndex->GetBlockTime(), tx.GetHash());
+    }
+
+    result = prepared.result;
+    mp_tx = std::move(prepared.mp_tx);
+    prepared.tx = nullptr;
+
+    return true;
+}
+
+} // anonymous namespace
+
+void ThreadElysiumParse()
+{
+    RenameThread("elysium-parse");
+    parseQueue.Thread();
+}
+
+/**
+ * This handler is called after elysium_handler_block_begin() with the transactions of the block.
+ *
+ * The transactions are classified, and the ones with marker are decoded and interpreted in
+ * parallel, so elysium_handler_tx() only has to apply them in order. Only fetching the inputs
+ * happens on the calling thread, because it needs the chain.
+ *
+ * @return The number of transactions with marker
+ */
+int elysium_handler_block_prepare(const CBlock& block, int nBlock, CBlockIndex const * pBlockIndex)
+{
+    LOCK2(cs_main, cs_parse);
+
+    preparedTxs.clear();
+    preparedBlockHash.SetNull();
+    preparedBlockHeight = -1;
+    nTimeClassify = nTimeInputs = nTimeParse = nTimeApply = 0;
+
+    if (!elysiumInitialized || nBlock < nWaterlineBlock) return 0;
+    if (nBlock != pBlockIndex->nHeight) {
+        PrintToLog("%s(): height %d does not match block %s at height %d, not preparing\n",
+                __func__, nBlock, pBlockIndex->GetBlockHash().GetHex(), pBlockIndex->nHeight);
+        return 0;
+    }
+
+    unsigned int nTime = pBlockIndex->GetBlockTime();
+    int64_t nTimeStart = GetTimeMicros();
+
+    preparedTxs.resize(block.vtx.size());
+    for (unsigned int i = 0; i < block.vtx.size(); ++i) {
+        preparedTxs[i].tx = &block.vtx[i];
+        preparedTxs[i].vgc = i;
+    }
+
+    // ### CLASS IDENTIFICATION AND MARKER CHECK ###
+    {
+        CCheckQueueControl<CElysiumParseCheck> control(&parseQueue);
+        std::vector<CElysiumParseCheck> vChecks;
+        vChecks.reserve(preparedTxs.size());
+        for (PreparedTransaction& prepared : preparedTxs) {
+            vChecks.push_back(CElysiumParseCheck(prepared, nBlock, nTime, true));
+        }
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    int64_t nTimeClassified = GetTimeMicros();
+    nTimeClassify = nTimeClassified - nTimeStart;
+
+    // ### INPUTS ###
+    std::vector<CElysiumParseCheck> vChecks;
+    int nMarkers = 0;
+    for (PreparedTransaction& prepared : preparedTxs) {
+        if (!prepared.packetClass) continue;
+        ++nMarkers;
+
+        prepared.result = fetchTransactionInputs(*prepared.tx, prepared.inputMode, prepared.prevOuts, prepared.inAll);
+        if (prepared.result == 0) {
+            vChecks.push_back(CElysiumParseCheck(prepared, nBlock, nTime, false));
+        }
+    }
+
+    int64_t nTimeFetched = GetTimeMicros();
+    nTimeInputs = nTimeFetched - nTimeClassified;
+
+    // ### SENDER IDENTIFICATION, PAYLOAD EXTRACTION AND INTERPRETATION ###
+    {
+        CCheckQueueControl<CElysiumParseCheck> control(&parseQueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    nTimeParse = GetTimeMicros() - nTimeFetched;
+    preparedBlockHash = pBlockIndex->GetBlockHash();
+    preparedBlockHeight = nBlock;
+
+    return nMarkers;
+}
+
 /**
  * This handler is called for every new transaction that comes in (actually in block parsing loop).
  *
@@ -2162,15 +2530,21 @@ bool elysium_handler_tx(const CTransaction& tx, int nBlock, unsigned int vgc, co
     // we do not care about parsing blocks prior to our waterline (empty blockchain defense)
     if (nBlock < nWaterlineBlock) return false;
     int64_t nBlockTime = pBlockIndex->GetBlockTime();
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::unique_ptr<CMPTransaction> mp_obj;
+    int pop_ret;
 
-    CMPTransaction mp_obj;
-    mp_obj.unlockLogic();
+    if (!TakePreparedTransaction(tx, nBlock, vgc, pBlockIndex, mp_obj, pop_ret)) {
+        mp_obj.reset(new CMPTransaction());
+        mp_obj->unlockLogic();
+        pop_ret = parseTransaction(false, tx, nBlock, vgc, *mp_obj, nBlockTime);
+    }
 
     bool fFoundTx = false;
-    int pop_ret = parseTransaction(false, tx, nBlock, vgc, mp_obj, nBlockTime);
 
     if (0 == pop_ret) {
-        int interp_ret = txProcessor->ProcessTx(mp_obj);
+        int interp_ret = txProcessor->ProcessTx(*mp_obj);
         if (interp_ret) {
             PrintToLog("!!! interpretPacket() returned %d !!!\n", interp_ret);
         }
@@ -2179,8 +2553,11 @@ bool elysium_handler_tx(const CTransaction& tx, int nBlock, unsigned int vgc, co
         // PKT_ERROR - 2 = interpret_Transaction failed, structurally invalid payload
         if (interp_ret != PKT_ERROR - 2) {
             bool bValid = (0 <= interp_ret);
-            p_txlistdb->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount());
+            p_txlistdb->recordTX(tx.GetHash(), bValid, nBlock, mp_obj->getType(), mp_obj->getNewAmount());
             p_ElysiumTXDB->RecordTransaction(tx.GetHash(), vgc, interp_ret);
+            if (IsWalletTransaction(*mp_obj)) {
+                WalletTxIndexAdd(tx.GetHash(), nBlock, vgc);
+            }
         }
         fFoundTx |= (interp_ret == 0);
     }
@@ -2190,6 +2567,8 @@ bool elysium_handler_tx(const CTransaction& tx, int nBlock, unsigned int vgc, co
         PrintToLog("Consensus hash for transaction %s: %s\n", tx.GetHash().GetHex(), consensusHash.GetHex());
     }
 
+    nTimeApply += GetTimeMicros() - nTimeStart;
+
     return fFoundTx;
 }
 
@@ -2405,23 +2784,242 @@ std::string CElysiumTransactionDB::FetchInvalidReason(const uint256& txid)
     return error_str(processingResult);
 }
 
+namespace {
+
+/**
+ * The trade, STO and transaction databases keep their records under the string
+ * keys they always used, next to secondary index entries. Index keys start with
+ * a type byte below '0', so they sort before all record keys (hex txids, base58
+ * addresses and "dbversion"), followed by big-endian integers, raw hashes and
+ * length prefixed strings, so that the entries of one address, property pair
+ * or block are adjacent and in order, and can be listed with a prefix seek.
+ */
+enum class IndexType : uint8_t
+{
+    Version = 0x01,
+    TradeByAddress = 0x02,
+    TradeByPair = 0x03,
+    TradeByTxid = 0x04,
+    TradeByBlock = 0x05,
+    STOByTxid = 0x06,
+    STOByBlock = 0x07,
+    TxByBlock = 0x08,
+};
+
+//! Records start at this key, index entries are before it
+const char FIRST_RECORD_KEY[] = "0";
+//! Layout of the index entries, a database with another version is reindexed
+const char INDEX_VERSION[] = "1";
+//! Number of records indexed per batch when building indexes
+const unsigned int INDEX_BATCH_SIZE = 10000;
+
+typedef std::vector<std::pair<std::string, std::string> > IndexEntries;
+
+void AppendKeyPart(std::string& key, uint32_t n)
+{
+    key.push_back(static_cast<char>(n >> 24));
+    key.push_back(static_cast<char>(n >> 16));
+    key.push_back(static_cast<char>(n >> 8));
+    key.push_back(static_cast<char>(n));
+}
+
+void AppendKeyPart(std::string& key, const uint256& hash)
+{
+    key.append(reinterpret_cast<const char*>(hash.begin()), hash.size());
+}
+
+void AppendKeyPart(std::string& key, const std::string& str)
+{
+    assert(str.size() <= 0xff);
+    key.push_back(static_cast<char>(str.size()));
+    key.append(str);
+}
+
+void AppendKeyParts(std::string& key)
+{
+}
+
+template<typename T, typename... Parts>
+void AppendKeyParts(std::string& key, const T& part, const Parts&... parts)
+{
+    AppendKeyPart(key, part);
+    AppendKeyParts(key, parts...);
+}
+
+template<typename... Parts>
+std::string CreateIndexKey(IndexType type, const Parts&... parts)
+{
+    std::string key(1, static_cast<char>(type));
+    AppendKeyParts(key, parts...);
+    return key;
+}
+
+/** Reads the parts of an index key, or of an index value, in order. */
+class IndexKeyReader
+{
+public:
+    explicit IndexKeyReader(const leveldb::Slice& key, size_t start = 1) : key(key), pos(start)
+    {
+    }
+
+    bool Read(uint32_t& n)
+    {
+        if (key.size() < pos + 4) return false;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(key.data()) + pos;
+        n = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        pos += 4;
+        return true;
+    }
+
+    bool Read(uint256& hash)
+    {
+        if (key.size() < pos + hash.size()) return false;
+        std::copy(key.data() + pos, key.data() + pos + hash.size(), hash.begin());
+        pos += hash.size();
+        return true;
+    }
+
+    bool Read(std::string& str)
+    {
+        if (key.size() < pos + 1) return false;
+        size_t size = static_cast<unsigned char>(key[pos]);
+        if (key.size() < pos + 1 + size) return false;
+        str.assign(key.data() + pos + 1, size);
+        pos += 1 + size;
+        return true;
+    }
+
+private:
+    leveldb::Slice key;
+    size_t pos;
+};
+
+/** Returns the index entries of a trade or a trade match record. */
+bool GetTradeIndexEntries(const std::string& key, const std::string& value, IndexEntries& entries)
+{
+    std::vector<std::string> vstr;
+    boost::split(vstr, value, boost::is_any_of(":"), boost::token_compress_on);
+
+    try {
+        if (key.size() == 64 && vstr.size() == 5) {
+            uint256 txid = uint256S(key);
+            uint32_t propertyIdForSale = boost::lexical_cast<uint32_t>(vstr[1]);
+            uint32_t propertyIdDesired = boost::lexical_cast<uint32_t>(vstr[2]);
+            uint32_t block = boost::lexical_cast<uint32_t>(vstr[3]);
+            uint32_t blockIndex = boost::lexical_cast<uint32_t>(vstr[4]);
+            std::string properties;
+            AppendKeyParts(properties, propertyIdForSale, propertyIdDesired);
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByAddress, vstr[0], block, blockIndex, txid), properties));
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByBlock, block, key), std::string()));
+            return true;
+        }
+        if (key.size() == 129 && vstr.size() == 8) {
+            uint256 txid1 = uint256S(key.substr(0, 64));
+            uint256 txid2 = uint256S(key.substr(65, 64));
+            uint32_t prop1 = boost::lexical_cast<uint32_t>(vstr[2]);
+            uint32_t prop2 = boost::lexical_cast<uint32_t>(vstr[3]);
+            uint32_t block = boost::lexical_cast<uint32_t>(vstr[6]);
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByPair, prop1, prop2, block, txid1, txid2), std::string()));
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByTxid, txid1, txid2), key));
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByTxid, txid2, txid1), key));
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TradeByBlock, block, key), std::string()));
+            return true;
+        }
+    } catch (const boost::bad_lexical_cast& e) {
+        PrintToLog("TRADEDB error - unexpected value (%s:%s)\n", key, value);
+    }
+
+    return false;
+}
+
+/** Returns the index entries of one STO receipt. */
+void GetSTOIndexEntries(const std::string& address, const uint256& txid, uint32_t block, IndexEntries& entries)
+{
+    entries.push_back(std::make_pair(CreateIndexKey(IndexType::STOByTxid, txid, address), std::string()));
+    entries.push_back(std::make_pair(CreateIndexKey(IndexType::STOByBlock, block, address, txid), std::string()));
+}
+
+/**
+ * Indexes all records of a database written without indexes, or with another
+ * layout of them, which happens once on the first start after an upgrade.
+ */
+template<typename IndexRecord>
+void BuildIndexesOnce(leveldb::DB* pdb, leveldb::Iterator* it, const leveldb::ReadOptions& readoptions,
+        const leveldb::WriteOptions& writeoptions, const std::string& name, IndexRecord indexRecord)
+{
+    const std::string versionKey = CreateIndexKey(IndexType::Version);
+    std::string version;
+    if (pdb->Get(readoptions, versionKey, &version).ok() && version == INDEX_VERSION) {
+        delete it;
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMillis();
+    unsigned int nRecords = 0;
+    leveldb::WriteBatch batch;
+
+    // drop index entries of another layout, or of an interrupted build
+    for (it->SeekToFirst(); it->Valid() && it->key().compare(FIRST_RECORD_KEY) < 0; it->Next()) {
+        batch.Delete(it->key());
+    }
+
+    IndexEntries entries;
+    for (it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next()) {
+        entries.clear();
+        indexRecord(it->key().ToString(), it->value().ToString(), entries);
+        for (IndexEntries::const_iterator entry = entries.begin(); entry != entries.end(); ++entry) {
+            batch.Put(entry->first, entry->second);
+        }
+        if (++nRecords % INDEX_BATCH_SIZE == 0) {
+            pdb->Write(writeoptions, &batch);
+            batch.Clear();
+        }
+    }
+    delete it;
+
+    batch.Put(versionKey, INDEX_VERSION);
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
+
+    PrintToLog("Built %s indexes for %d records: %s [%d ms]\n", name, nRecords, status.ToString(), GetTimeMillis() - nTimeStart);
+}
+
+} // anonymous namespace
+
+void CMPTxList::BuildIndexes()
+{
+    BuildIndexesOnce(pdb, NewIterator(), readoptions, writeoptions, "tx meta-info",
+        [this](const std::string& key, const std::string& value, IndexEntries& entries) {
+            // sub records are indexed under the block of their master record, "txid" or "txid-C"
+            std::string masterValue = value;
+            if (key.size() > 64 && key.compare(64, std::string::npos, "-C") != 0) {
+                std::string masterKey = key.substr(0, key.compare(64, 2, "-C") == 0 ? 66 : 64);
+                if (!pdb->Get(readoptions, masterKey, &masterValue).ok()) return;
+            } else if (key.size() < 64) {
+                return; // "dbversion"
+            }
+            std::vector<std::string> vstr;
+            boost::split(vstr, masterValue, boost::is_any_of(":"), boost::token_compress_on);
+            if (4 != vstr.size()) return;
+            uint32_t block = atoi(vstr[1]);
+            entries.push_back(std::make_pair(CreateIndexKey(IndexType::TxByBlock, block, key), std::string()));
+        });
+}
+
 std::set<int> CMPTxList::GetSeedBlocks(int startHeight, int endHeight)
 {
     std::set<int> setSeedBlocks;
 
     if (!pdb) return setSeedBlocks;
 
+    // every record is indexed with the block of its transaction
     Iterator* it = NewIterator();
+    const std::string prefix = CreateIndexKey(IndexType::TxByBlock);
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
-        std::vector<std::string> vstr;
-        boost::split(vstr, itData, boost::is_any_of(":"), boost::token_compress_on);
-        if (4 != vstr.size()) continue; // unexpected number of tokens
-        int block = atoi(vstr[1]);
-        if (block >= startHeight && block <= endHeight) {
-            setSeedBlocks.insert(block);
-        }
+    for (it->Seek(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(std::max(startHeight, 0)))); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        uint32_t block = 0;
+        IndexKeyReader(it->key()).Read(block);
+        if (static_cast<int>(block) > endHeight) break;
+        setSeedBlocks.insert(block);
     }
 
     delete it;
@@ -2433,14 +3031,17 @@ bool CMPTxList::CheckForFreezeTxs(int blockHeight)
 {
     assert(pdb);
     Iterator* it = NewIterator();
-
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
-        std::string itData = it->value().ToString();
+    const std::string prefix = CreateIndexKey(IndexType::TxByBlock);
+
+    for (it->Seek(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(std::max(blockHeight, 0)))); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        uint32_t block = 0;
+        std::string key, itData;
+        IndexKeyReader reader(it->key());
+        if (!reader.Read(block) || !reader.Read(key) || key.size() != 64) continue;
+        if (!pdb->Get(readoptions, key, &itData).ok()) continue;
         std::vector<std::string> vstr;
         boost::split(vstr, itData, boost::is_any_of(":"), token_compress_on);
         if (4 != vstr.size()) continue;
-        int block = atoi(vstr[1]);
-        if (block < blockHeight) continue;
         uint16_t txtype = atoi(vstr[2]);
         if (txtype == ELYSIUM_TYPE_FREEZE_PROPERTY_TOKENS || txtype == ELYSIUM_TYPE_UNFREEZE_PROPERTY_TOKENS ||
             txtype == ELYSIUM_TYPE_ENABLE_FREEZING || txtype == ELYSIUM_TYPE_DISABLE_FREEZING) {
@@ -2461,7 +3062,7 @@ bool CMPTxList::LoadFreezeState(int blockHeight)
     Iterator* it = NewIterator();
     PrintToLog("Loading freeze state from levelDB\n");
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    for (it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next()) {
         std::string itData = it->value().ToString();
         std::vector<std::string> vstr;
         boost::split(vstr, itData, boost::is_any_of(":"), token_compress_on);
@@ -2543,7 +3144,7 @@ void CMPTxList::LoadActivations(int blockHeight)
 
     std::vector<std::pair<int64_t, uint256> > loadOrder;
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    for (it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next()) {
         std::string itData = it->value().ToString();
         std::vector<std::string> vstr;
         boost::split(vstr, itData, boost::is_any_of(":"), token_compress_on);
@@ -2611,7 +3212,7 @@ void CMPTxList::LoadAlerts(int blockHeight)
 
     std::vector<std::pair<int64_t, uint256> > loadOrder;
 
-    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    for (it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next()) {
         std::string itData = it->value().ToString();
         std::vector<std::string> vstr;
         boost::split(vstr, itData, boost::is_any_of(":"), token_compress_on);
@@ -2674,7 +3275,7 @@ uint256 CMPTxList::findMetaDExCancel(const uint256 txid)
   Slice skey, svalue;
   uint256 cancelTxid;
   Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
   {
       skey = it->key();
       svalue = it->value();
@@ -2771,7 +3372,7 @@ int CMPTxList::getMPTransactionCountTotal()
     int count = 0;
     Slice skey, svalue;
     Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next())
+    for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
     {
         skey = it->key();
         if (skey.ToString().length() == 64) { ++count; } //extra entries for cancels and purchases are more than 64 chars long
@@ -2783,27 +3384,35 @@ int CMPTxList::getMPTransactionCountTotal()
 int CMPTxList::getMPTransactionCountBlock(int block)
 {
     int count = 0;
-    Slice skey, svalue;
+    if (block < 0) return count;
     Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next())
+    const std::string prefix = CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(block));
+    for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
     {
-        skey = it->key();
-        svalue = it->value();
-        if (skey.ToString().length() == 64)
-        {
-            string strValue = svalue.ToString();
-            std::vector<std::string> vstr;
-            boost::split(vstr, strValue, boost::is_any_of(":"), token_compress_on);
-            if (4 == vstr.size())
-            {
-                if (atoi(vstr[1]) == block) { ++count; }
-            }
-        }
+        std::string key;
+        IndexKeyReader reader(it->key(), prefix.size());
+        if (reader.Read(key) && key.length() == 64) { ++count; } //extra entries for cancels and purchases are more than 64 chars long
     }
     delete it;
     return count;
 }
 
+std::vector<uint256> CMPTxList::getMPTransactionsBlock(int block)
+{
+    std::vector<uint256> transactions;
+    if (block < 0) return transactions;
+    Iterator* it = NewIterator();
+    const std::string prefix = CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(block));
+    for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
+    {
+        std::string key;
+        IndexKeyReader reader(it->key(), prefix.size());
+        if (reader.Read(key) && key.length() == 64) { transactions.push_back(uint256S(key)); }
+    }
+    delete it;
+    return transactions;
+}
+
 string CMPTxList::getKeyValue(string key)
 {
     if (!pdb) return "";
@@ -2889,34 +3498,34 @@ void CMPTxList::recordMetaDExCancelTX(const uint256 &txidMaster, const uint256 &
        const string key = txidMasterStr;
        const string value = strprintf("%u:%d:%u:%lu", fValid ? 1:0, nBlock, type, refNumber);
        PrintToLog("METADEXCANCELDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of affected transactions= %d)\n", __FUNCTION__, txidMaster.ToString(), fValid ? "YES":"NO", nBlock, type, refNumber);
-       if (pdb)
-       {
-           status = pdb->Put(writeoptions, key, value);
-           PrintToLog("METADEXCANCELDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-       }
+       leveldb::WriteBatch batch;
+       batch.Put(key, value);
+       batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), key), "");
 
        // Step 4 - Write sub-record with cancel details
        const string txidStr = txidMaster.ToString() + "-C";
        const string subKey = STR_REF_SUBKEY_TXID_REF_COMBO(txidStr, refNumber);
        const string subValue = strprintf("%s:%d:%lu", txidSub.ToString(), propertyId, nValue);
-       Status subStatus;
        PrintToLog("METADEXCANCELDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-       if (pdb)
-       {
-           subStatus = pdb->Put(writeoptions, subKey, subValue);
-           PrintToLog("METADEXCANCELDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, subStatus.ToString(), __LINE__, __FILE__);
-       }
+       batch.Put(subKey, subValue);
+       batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), subKey), "");
+
+       status = pdb->Write(writeoptions, &batch);
+       PrintToLog("METADEXCANCELDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
 }
 
 /**
  * Records a "send all" sub record.
  */
-void CMPTxList::recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nValue)
+void CMPTxList::recordSendAllSubRecord(const uint256& txid, int nBlock, int subRecordNumber, uint32_t propertyId, int64_t nValue)
 {
     std::string strKey = strprintf("%s-%d", txid.ToString(), subRecordNumber);
     std::string strValue = strprintf("%d:%d", propertyId, nValue);
 
-    leveldb::Status status = pdb->Put(writeoptions, strKey, strValue);
+    leveldb::WriteBatch batch;
+    batch.Put(strKey, strValue);
+    batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), strKey), "");
+    leveldb::Status status = pdb->Write(writeoptions, &batch);
     ++nWritten;
     if (elysium_debug_txdb) PrintToLog("%s(): store: %s=%s, status: %s\n", __func__, strKey, strValue, status.ToString());
 }
@@ -2960,25 +3569,21 @@ void CMPTxList::recordPaymentTX(const uint256 &txid, bool fValid, int nBlock, un
        // Step 3 - Create new/update master record for payment tx in TXList
        const string key = txid.ToString();
        const string value = strprintf("%u:%d:%u:%lu", fValid ? 1:0, nBlock, type, numberOfPayments);
-       Status status;
        PrintToLog("DEXPAYDEBUG : Writing master record %s(%s, valid=%s, block= %d, type= %d, number of payments= %lu)\n", __FUNCTION__, txid.ToString(), fValid ? "YES":"NO", nBlock, type, numberOfPayments);
-       if (pdb)
-       {
-           status = pdb->Put(writeoptions, key, value);
-           PrintToLog("DEXPAYDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-       }
+       leveldb::WriteBatch batch;
+       batch.Put(key, value);
+       batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), key), "");
 
        // Step 4 - Write sub-record with payment details
        const string txidStr = txid.ToString();
        const string subKey = STR_PAYMENT_SUBKEY_TXID_PAYMENT_COMBO(txidStr, paymentNumber);
        const string subValue = strprintf("%d:%s:%s:%d:%lu", vout, buyer, seller, propertyId, nValue);
-       Status subStatus;
        PrintToLog("DEXPAYDEBUG : Writing sub-record %s with value %s\n", subKey, subValue);
-       if (pdb)
-       {
-           subStatus = pdb->Put(writeoptions, subKey, subValue);
-           PrintToLog("DEXPAYDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, subStatus.ToString(), __LINE__, __FILE__);
-       }
+       batch.Put(subKey, subValue);
+       batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), subKey), "");
+
+       Status status = pdb->Write(writeoptions, &batch);
+       PrintToLog("DEXPAYDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
 }
 
 void CMPTxList::recordTX(const uint256 &txid, bool fValid, int nBlock, unsigned int type, uint64_t nValue)
@@ -2998,7 +3603,10 @@ Status status;
 
   if (pdb)
   {
-    status = pdb->Put(writeoptions, key, value);
+    leveldb::WriteBatch batch;
+    batch.Put(key, value);
+    batch.Put(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(nBlock), key), "");
+    status = pdb->Write(writeoptions, &batch);
     ++nWritten;
     if (elysium_debug_txdb) PrintToLog("%s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
   }
@@ -3044,7 +3652,7 @@ int count = 0;
 Slice skey, svalue;
   Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
   {
     skey = it->key();
     svalue = it->value();
@@ -3060,81 +3668,114 @@ Slice skey, svalue;
 // pass in bDeleteFound = true to erase each entry found within the block range
 bool CMPTxList::isMPinBlockRange(int starting_block, int ending_block, bool bDeleteFound)
 {
-leveldb::Slice skey, svalue;
-unsigned int count = 0;
-std::vector<std::string> vstr;
-int block;
-unsigned int n_found = 0;
+  unsigned int n_found = 0;
+  leveldb::WriteBatch batch;
+  const std::string prefix = CreateIndexKey(IndexType::TxByBlock);
 
   leveldb::Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  // sub records are indexed under the block of their master record, so they go with it
+  for(it->Seek(CreateIndexKey(IndexType::TxByBlock, static_cast<uint32_t>(std::max(starting_block, 0)))); it->Valid() && it->key().starts_with(prefix); it->Next())
   {
-    skey = it->key();
-    svalue = it->value();
-
-    ++count;
-
-    string strvalue = it->value().ToString();
-
-    // parse the string returned, find the validity flag/bit & other parameters
-    boost::split(vstr, strvalue, boost::is_any_of(":"), token_compress_on);
-
-    // only care about the block number/height here
-    if (2 <= vstr.size())
+    uint32_t block = 0;
+    std::string key;
+    IndexKeyReader reader(it->key());
+    if (!reader.Read(block) || !reader.Read(key)) continue;
+    if (static_cast<int>(block) > ending_block) break;
+
+    ++n_found;
+    PrintToLog("%s() DELETING: %s\n", __FUNCTION__, key);
+    if (bDeleteFound)
     {
-      block = atoi(vstr[1]);
-
-      if ((starting_block <= block) && (block <= ending_block))
-      {
-        ++n_found;
-        PrintToLog("%s() DELETING: %s=%s\n", __FUNCTION__, skey.ToString(), svalue.ToString());
-        if (bDeleteFound) pdb->Delete(writeoptions, skey);
-      }
+      batch.Delete(key);
+      batch.Delete(it->key());
     }
   }
 
-  PrintToLog("%s(%d, %d); n_found= %d\n", __FUNCTION__, starting_block, ending_block, n_found);
-
   delete it;
 
+  if (bDeleteFound) pdb->Write(writeoptions, &batch);
+
+  PrintToLog("%s(%d, %d); n_found= %d\n", __FUNCTION__, starting_block, ending_block, n_found);
+
   return (n_found);
 }
 
 // MPSTOList here
+void CMPSTOList::BuildIndexes()
+{
+    BuildIndexesOnce(pdb, NewIterator(), readoptions, writeoptions, "send-to-owners",
+        [](const std::string& address, const std::string& value, IndexEntries& entries) {
+            std::vector<std::string> vstr;
+            boost::split(vstr, value, boost::is_any_of(","), boost::token_compress_on);
+            for (uint32_t i = 0; i < vstr.size(); i++) {
+                std::vector<std::string> svstr;
+                boost::split(svstr, vstr[i], boost::is_any_of(":"), boost::token_compress_on);
+                if (4 != svstr.size()) continue;
+                GetSTOIndexEntries(address, uint256S(svstr[0]), atoi(svstr[1]), entries);
+            }
+        });
+}
+
+// adds the receipts of a recipient to the list, skipping STOs already in it
+static void AppendSTOReceipts(const std::string& recipientAddress, const std::string& strValue, std::string& mySTOReceipts)
+{
+  // break into individual receipts
+  std::vector<std::string> vstr;
+  boost::split(vstr, strValue, boost::is_any_of(","), token_compress_on);
+  for(uint32_t i = 0; i<vstr.size(); i++) {
+      // add to array
+      std::vector<std::string> svstr;
+      boost::split(svstr, vstr[i], boost::is_any_of(":"), token_compress_on);
+      if(4 == svstr.size()) {
+          size_t txidMatch = mySTOReceipts.find(svstr[0]);
+          if(txidMatch==std::string::npos) mySTOReceipts += svstr[0]+":"+svstr[1]+":"+recipientAddress+":"+svstr[2]+",";
+      }
+  }
+}
+
 std::string CMPSTOList::getMySTOReceipts(string filterAddress)
 {
   if (!pdb) return "";
   string mySTOReceipts = "";
-  Slice skey, svalue;
-  Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      skey = it->key();
-      string recipientAddress = skey.ToString();
-      if(!IsMyAddress(recipientAddress)) continue; // not ours, not interested
-      if((!filterAddress.empty()) && (filterAddress != recipientAddress)) continue; // not the filtered address
-      // ours, get info
-      svalue = it->value();
-      string strValue = svalue.ToString();
-      // break into individual receipts
-      std::vector<std::string> vstr;
-      boost::split(vstr, strValue, boost::is_any_of(","), token_compress_on);
-      for(uint32_t i = 0; i<vstr.size(); i++) {
-          // add to array
-          std::vector<std::string> svstr;
-          boost::split(svstr, vstr[i], boost::is_any_of(":"), token_compress_on);
-          if(4 == svstr.size()) {
-              size_t txidMatch = mySTOReceipts.find(svstr[0]);
-              if(txidMatch==std::string::npos) mySTOReceipts += svstr[0]+":"+svstr[1]+":"+recipientAddress+":"+svstr[2]+",";
-          }
+  if (!filterAddress.empty()) {
+      // the filtered address is the key of its record
+      string strValue;
+      if (IsMyAddress(filterAddress) && pdb->Get(readoptions, filterAddress, &strValue).ok()) {
+          AppendSTOReceipts(filterAddress, strValue, mySTOReceipts);
+      }
+  } else {
+      Iterator* it = NewIterator();
+      for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next()) {
+          string recipientAddress = it->key().ToString();
+          if(!IsMyAddress(recipientAddress)) continue; // not ours, not interested
+          AppendSTOReceipts(recipientAddress, it->value().ToString(), mySTOReceipts);
       }
+      delete it;
   }
-  delete it;
   // above code will leave a trailing comma - strip it
   if (mySTOReceipts.size() > 0) mySTOReceipts.resize(mySTOReceipts.size()-1);
   return mySTOReceipts;
 }
 
+bool CMPSTOList::hasMyReceipt(const uint256& txid)
+{
+  if (!pdb) return false;
+  bool fFound = false;
+  const std::string prefix = CreateIndexKey(IndexType::STOByTxid, txid);
+  Iterator* it = NewIterator();
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      string recipientAddress;
+      if (!IndexKeyReader(it->key(), prefix.size()).Read(recipientAddress)) continue;
+      if (IsMyAddress(recipientAddress)) {
+          fFound = true;
+          break;
+      }
+  }
+  delete it;
+  return fFound;
+}
+
 void CMPSTOList::getRecipients(const uint256 txid, string filterAddress, UniValue *recipientArray, uint64_t *total, uint64_t *numRecipients)
 {
   if (!pdb) return;
@@ -3152,17 +3793,15 @@ void CMPSTOList::getRecipients(const uint256 txid, string filterAddress, UniValu
   // the fee is variable based on version of STO - provide number of recipients and allow calling function to work out fee
   *numRecipients = 0;
 
-  Slice skey, svalue;
+  // the index lists the recipients of the STO
+  const std::string prefix = CreateIndexKey(IndexType::STOByTxid, txid);
   Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next())
   {
-      skey = it->key();
-      string recipientAddress = skey.ToString();
-      svalue = it->value();
-      string strValue = svalue.ToString();
-      // see if txid is in the data
-      size_t txidMatch = strValue.find(txid.ToString());
-      if(txidMatch!=std::string::npos)
+      string recipientAddress;
+      if (!IndexKeyReader(it->key(), prefix.size()).Read(recipientAddress)) continue;
+      string strValue;
+      if (pdb->Get(readoptions, recipientAddress, &strValue).ok())
       {
           ++*numRecipients;
           // the txid exists inside the data, this address was a recipient of this STO, check filter and add the details
@@ -3236,43 +3875,29 @@ void CMPSTOList::recordSTOReceive(string address, const uint256 &txid, int nBloc
 {
   if (!pdb) return;
 
-  bool addressExists = s_stolistdb->exists(address);
-  if (addressExists)
+  const string key = address;
+  const string newValue = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
+  string strValue;
+  Status status = pdb->Get(readoptions, key, &strValue);
+  if (status.ok())
   {
-      //retrieve existing record
-      std::vector<std::string> vstr;
-      string strValue;
-      Status status = pdb->Get(readoptions, address, &strValue);
-      if (status.ok())
-      {
-          // add details to record
-          // see if we are overwriting (check)
-          size_t txidMatch = strValue.find(txid.ToString());
-          if(txidMatch!=std::string::npos) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n",address,txid.ToString());
-
-          const string key = address;
-          const string newValue = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-          strValue += newValue;
-          // write updated record
-          Status status;
-          if (pdb)
-          {
-              status = pdb->Put(writeoptions, key, strValue);
-              PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-          }
-      }
+      // add details to record
+      // see if we are overwriting (check)
+      size_t txidMatch = strValue.find(txid.ToString());
+      if(txidMatch!=std::string::npos) PrintToLog("STODEBUG : Duplicating entry for %s : %s\n",address,txid.ToString());
   }
-  else
-  {
-      const string key = address;
-      const string value = strprintf("%s:%d:%u:%lu,", txid.ToString(), nBlock, propertyId, amount);
-      Status status;
-      if (pdb)
-      {
-          status = pdb->Put(writeoptions, key, value);
-          PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-      }
+  strValue += newValue;
+
+  // write updated record, and index the receipt
+  IndexEntries entries;
+  GetSTOIndexEntries(address, txid, nBlock, entries);
+  leveldb::WriteBatch batch;
+  batch.Put(key, strValue);
+  for (IndexEntries::const_iterator entry = entries.begin(); entry != entries.end(); ++entry) {
+      batch.Put(entry->first, entry->second);
   }
+  status = pdb->Write(writeoptions, &batch);
+  PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
 }
 
 void CMPSTOList::printAll()
@@ -3281,7 +3906,7 @@ void CMPSTOList::printAll()
   Slice skey, svalue;
   Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
   {
     skey = it->key();
     svalue = it->value();
@@ -3305,12 +3930,28 @@ void CMPSTOList::printStats()
 int CMPSTOList::deleteAboveBlock(int blockNum)
 {
   unsigned int n_found = 0;
-  std::vector<std::string> vecSTORecords;
+  std::set<std::string> setAddresses;
+  leveldb::WriteBatch batch;
+  const std::string prefix = CreateIndexKey(IndexType::STOByBlock);
   leveldb::Iterator* it = NewIterator();
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+  // find the recipients of STOs in the removed blocks, and drop the index entries of the receipts
+  for (it->Seek(CreateIndexKey(IndexType::STOByBlock, static_cast<uint32_t>(std::max(blockNum, 0)))); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      uint32_t block = 0;
+      std::string address;
+      uint256 txid;
+      IndexKeyReader reader(it->key());
+      if (!reader.Read(block) || !reader.Read(address) || !reader.Read(txid)) continue;
+      batch.Delete(it->key());
+      batch.Delete(CreateIndexKey(IndexType::STOByTxid, txid, address));
+      setAddresses.insert(address);
+  }
+  delete it;
+
+  std::vector<std::string> vecSTORecords;
+  for (std::set<std::string>::const_iterator address = setAddresses.begin(); address != setAddresses.end(); ++address) {
       std::string newValue;
-      std::string oldValue = it->value().ToString();
-      bool needsUpdate = false;
+      std::string oldValue;
+      if (!pdb->Get(readoptions, *address, &oldValue).ok()) continue;
       boost::split(vecSTORecords, oldValue, boost::is_any_of(","), boost::token_compress_on);
       for (uint32_t i = 0; i<vecSTORecords.size(); i++) {
           std::vector<std::string> vecSTORecordFields;
@@ -3318,21 +3959,18 @@ int CMPSTOList::deleteAboveBlock(int blockNum)
           if (4 != vecSTORecordFields.size()) continue;
           if (atoi(vecSTORecordFields[1]) < blockNum) {
               newValue += vecSTORecords[i].append(","); // STO before the reorg, add data back to new value string
-          } else {
-              needsUpdate = true;
           }
       }
-      if (needsUpdate) { // rewrite record with existing key and new value
-          ++n_found;
-          leveldb::Status status = pdb->Put(writeoptions, it->key().ToString(), newValue);
-          PrintToLog("DEBUG STO - rewriting STO data after reorg\n");
-          PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
-      }
+      // rewrite record with existing key and new value
+      ++n_found;
+      batch.Put(*address, newValue);
+      PrintToLog("DEBUG STO - rewriting STO data after reorg\n");
   }
 
-  PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
+  leveldb::Status status = pdb->Write(writeoptions, &batch);
+  PrintToLog("STODBDEBUG : %s(): %s, line %d, file: %s\n", __FUNCTION__, status.ToString(), __LINE__, __FILE__);
 
-  delete it;
+  PrintToLog("%s(%d); stodb updated records= %d\n", __FUNCTION__, blockNum, n_found);
 
   return (n_found);
 }
@@ -3348,12 +3986,21 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
 
   std::vector<std::string> vstr;
   string txidStr = txid.ToString();
+  // the index lists the matches of the trade, with the key of the match record as value
+  std::vector<std::string> vecMatchKeys;
+  const std::string prefix = CreateIndexKey(IndexType::TradeByTxid, txid);
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      // search key to see if this is a matching trade
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      vecMatchKeys.push_back(it->value().ToString());
+  }
+  delete it;
+  std::sort(vecMatchKeys.begin(), vecMatchKeys.end()); // in order of the match records
+
+  for (std::vector<std::string>::const_iterator itKey = vecMatchKeys.begin(); itKey != vecMatchKeys.end(); ++itKey) {
+      const std::string& strKey = *itKey;
+      std::string strValue;
       std::string matchTxid;
+      if (!pdb->Get(readoptions, strKey, &strValue).ok()) continue;
       size_t txidMatch = strKey.find(txidStr);
       if (txidMatch == std::string::npos) continue; // no match
 
@@ -3408,8 +4055,6 @@ bool CMPTradeList::getMatchingTrades(const uint256& txid, uint32_t propertyId, U
       ++count;
   }
 
-  // clean up
-  delete it;
   if (count) { return true; } else { return false; }
 }
 
@@ -3422,13 +4067,31 @@ bool CompareTradePair(const std::pair<int64_t, UniValue>& firstJSONObj, const st
 void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& responseArray, uint64_t count)
 {
   if (!pdb) return;
-  leveldb::Iterator* it = NewIterator();
   std::vector<std::pair<int64_t, UniValue> > vecResponse;
   bool propertyIdSideAIsDivisible = isPropertyDivisible(propertyIdSideA);
   bool propertyIdSideBIsDivisible = isPropertyDivisible(propertyIdSideB);
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
+
+  // the index lists the matches of each orientation of the pair
+  std::vector<std::string> vecMatchKeys;
+  leveldb::Iterator* it = NewIterator();
+  for (int side = 0; side < 2; ++side) {
+      const std::string prefix = side == 0 ? CreateIndexKey(IndexType::TradeByPair, propertyIdSideA, propertyIdSideB)
+                                           : CreateIndexKey(IndexType::TradeByPair, propertyIdSideB, propertyIdSideA);
+      for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+          uint32_t block = 0;
+          uint256 txid1, txid2;
+          IndexKeyReader reader(it->key(), prefix.size());
+          if (!reader.Read(block) || !reader.Read(txid1) || !reader.Read(txid2)) continue;
+          vecMatchKeys.push_back(txid1.ToString() + "+" + txid2.ToString());
+      }
+      if (propertyIdSideA == propertyIdSideB) break;
+  }
+  delete it;
+
+  for (std::vector<std::string>::const_iterator itKey = vecMatchKeys.begin(); itKey != vecMatchKeys.end(); ++itKey) {
+      const std::string& strKey = *itKey;
+      std::string strValue;
+      if (!pdb->Get(readoptions, strKey, &strValue).ok()) continue;
       std::vector<std::string> vecKeys;
       std::vector<std::string> vecValues;
       uint256 sellerTxid, matchingTxid;
@@ -3506,8 +4169,6 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
   for (std::vector<UniValue>::iterator it = responseArrayValues.begin(); it != responseArrayValues.end(); ++it) {
       responseArray.push_back(*it);
   }
-
-  delete it;
 }
 
 // obtains a vector of txids where the supplied address participated in a trade (needed for gettradehistory_MP)
@@ -3516,40 +4177,71 @@ void CMPTradeList::getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyI
 void CMPTradeList::getTradesForAddress(std::string address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter)
 {
   if (!pdb) return;
-  std::map<std::string,uint256> mapTrades;
+  // the index lists the trades of the address by block then index
+  const std::string prefix = CreateIndexKey(IndexType::TradeByAddress, address);
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next()) {
-      std::string strKey = it->key().ToString();
-      std::string strValue = it->value().ToString();
-      std::vector<std::string> vecValues;
-      if (strKey.size() != 64) continue; // only interested in trades
-      uint256 txid = uint256S(strKey);
-      size_t addressMatch = strValue.find(address);
-      if (addressMatch == std::string::npos) continue;
-      boost::split(vecValues, strValue, boost::is_any_of(":"), token_compress_on);
-      if (vecValues.size() != 5) {
-          PrintToLog("TRADEDB error - unexpected number of tokens in value (%s)\n", strValue);
+  for(it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+      uint32_t blockNum = 0, txIndex = 0;
+      uint256 txid;
+      uint32_t propertyIdForSale = 0, propertyIdDesired = 0;
+      IndexKeyReader keyReader(it->key(), prefix.size());
+      IndexKeyReader valueReader(it->value(), 0);
+      if (!keyReader.Read(blockNum) || !keyReader.Read(txIndex) || !keyReader.Read(txid) ||
+          !valueReader.Read(propertyIdForSale) || !valueReader.Read(propertyIdDesired)) {
+          PrintToLog("TRADEDB error - unexpected index entry for address %s\n", address);
           continue;
       }
-      uint32_t propertyIdForSale = boost::lexical_cast<uint32_t>(vecValues[1]);
-      uint32_t propertyIdDesired = boost::lexical_cast<uint32_t>(vecValues[2]);
-      int64_t blockNum = boost::lexical_cast<uint32_t>(vecValues[3]);
-      int64_t txIndex = boost::lexical_cast<uint32_t>(vecValues[4]);
       if (propertyIdFilter != 0 && propertyIdFilter != propertyIdForSale && propertyIdFilter != propertyIdDesired) continue;
-      std::string sortKey = strprintf("%06d%010d", blockNum, txIndex);
-      mapTrades.insert(std::make_pair(sortKey, txid));
+      vecTransactions.push_back(txid);
   }
   delete it;
-  for (std::map<std::string,uint256>::iterator it = mapTrades.begin(); it != mapTrades.end(); it++) {
-      vecTransactions.push_back(it->second);
+}
+
+void CMPTradeList::forEachTradeForAddress(const std::string& address, uint32_t propertyIdFilter, const std::function<bool(const uint256&)>& fn)
+{
+  if (!pdb) return;
+  // walk the index of the address backwards, from the first key after it
+  const std::string prefix = CreateIndexKey(IndexType::TradeByAddress, address);
+  std::string end = prefix;
+  end.push_back('\xff');
+  leveldb::Iterator* it = NewIterator();
+  it->Seek(end);
+  if (it->Valid()) it->Prev(); else it->SeekToLast();
+  for(; it->Valid() && it->key().starts_with(prefix); it->Prev()) {
+      uint32_t blockNum = 0, txIndex = 0;
+      uint256 txid;
+      uint32_t propertyIdForSale = 0, propertyIdDesired = 0;
+      IndexKeyReader keyReader(it->key(), prefix.size());
+      IndexKeyReader valueReader(it->value(), 0);
+      if (!keyReader.Read(blockNum) || !keyReader.Read(txIndex) || !keyReader.Read(txid) ||
+          !valueReader.Read(propertyIdForSale) || !valueReader.Read(propertyIdDesired)) {
+          PrintToLog("TRADEDB error - unexpected index entry for address %s\n", address);
+          continue;
+      }
+      if (propertyIdFilter != 0 && propertyIdFilter != propertyIdForSale && propertyIdFilter != propertyIdDesired) continue;
+      if (!fn(txid)) break;
   }
+  delete it;
+}
+
+void CMPTradeList::BuildIndexes()
+{
+    BuildIndexesOnce(pdb, NewIterator(), readoptions, writeoptions, "trades", GetTradeIndexEntries);
 }
 
 void CMPTradeList::recordNewTrade(const uint256& txid, const std::string& address, uint32_t propertyIdForSale, uint32_t propertyIdDesired, int blockNum, int blockIndex)
 {
   if (!pdb) return;
+  const std::string strKey = txid.ToString();
   std::string strValue = strprintf("%s:%d:%d:%d:%d", address, propertyIdForSale, propertyIdDesired, blockNum, blockIndex);
-  Status status = pdb->Put(writeoptions, txid.ToString(), strValue);
+  IndexEntries entries;
+  GetTradeIndexEntries(strKey, strValue, entries);
+  leveldb::WriteBatch batch;
+  batch.Put(strKey, strValue);
+  for (IndexEntries::const_iterator entry = entries.begin(); entry != entries.end(); ++entry) {
+      batch.Put(entry->first, entry->second);
+  }
+  Status status = pdb->Write(writeoptions, &batch);
   ++nWritten;
   if (elysium_debug_tradedb) PrintToLog("%s(): %s\n", __FUNCTION__, status.ToString());
 }
@@ -3559,10 +4251,17 @@ void CMPTradeList::recordMatchedTrade(const uint256 txid1, const uint256 txid2,
   if (!pdb) return;
   const string key = txid1.ToString() + "+" + txid2.ToString();
   const string value = strprintf("%s:%s:%u:%u:%lu:%lu:%d:%d", address1, address2, prop1, prop2, amount1, amount2, blockNum, fee);
+  IndexEntries entries;
+  GetTradeIndexEntries(key, value, entries);
+  leveldb::WriteBatch batch;
+  batch.Put(key, value);
+  for (IndexEntries::const_iterator entry = entries.begin(); entry != entries.end(); ++entry) {
+      batch.Put(entry->first, entry->second);
+  }
   Status status;
   if (pdb)
   {
-    status = pdb->Put(writeoptions, key, value);
+    status = pdb->Write(writeoptions, &batch);
     ++nWritten;
     if (elysium_debug_tradedb) PrintToLog("%s(): %s\n", __FUNCTION__, status.ToString());
   }
@@ -3575,32 +4274,36 @@ void CMPTradeList::recordMatchedTrade(const uint256 txid1, const uint256 txid2,
  */
 int CMPTradeList::deleteAboveBlock(int blockNum)
 {
-  leveldb::Slice skey, svalue;
-  unsigned int count = 0;
-  std::vector<std::string> vstr;
-  int block = 0;
   unsigned int n_found = 0;
+  leveldb::WriteBatch batch;
+  IndexEntries entries;
+  const std::string prefix = CreateIndexKey(IndexType::TradeByBlock);
   leveldb::Iterator* it = NewIterator();
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(CreateIndexKey(IndexType::TradeByBlock, static_cast<uint32_t>(std::max(blockNum, 0)))); it->Valid() && it->key().starts_with(prefix); it->Next())
   {
-    skey = it->key();
-    svalue = it->value();
-    ++count;
-    string strvalue = it->value().ToString();
-    boost::split(vstr, strvalue, boost::is_any_of(":"), token_compress_on);
-    if (7 == vstr.size()) block = atoi(vstr[6]); // trade matches have 7 tokens, key is txid+txid, only care about block
-    if (5 == vstr.size()) block = atoi(vstr[3]); // trades have 5 tokens, key is txid, only care about block
-    if (block >= blockNum) {
-        ++n_found;
-        PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __FUNCTION__, skey.ToString(), svalue.ToString());
-        pdb->Delete(writeoptions, skey);
+    uint32_t block = 0;
+    std::string key, value;
+    IndexKeyReader reader(it->key());
+    if (!reader.Read(block) || !reader.Read(key)) continue;
+    batch.Delete(it->key());
+    if (!pdb->Get(readoptions, key, &value).ok()) continue;
+    ++n_found;
+    PrintToLog("%s() DELETING FROM TRADEDB: %s=%s\n", __FUNCTION__, key, value);
+    batch.Delete(key);
+    // remove the other index entries of the record
+    entries.clear();
+    GetTradeIndexEntries(key, value, entries);
+    for (IndexEntries::const_iterator entry = entries.begin(); entry != entries.end(); ++entry) {
+        batch.Delete(entry->first);
     }
   }
 
-  PrintToLog("%s(%d); tradedb n_found= %d\n", __FUNCTION__, blockNum, n_found);
-
   delete it;
 
+  pdb->Write(writeoptions, &batch);
+
+  PrintToLog("%s(%d); tradedb n_found= %d\n", __FUNCTION__, blockNum, n_found);
+
   return (n_found);
 }
 
@@ -3614,7 +4317,7 @@ int CMPTradeList::getMPTradeCountTotal()
     int count = 0;
     Slice skey, svalue;
     Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next())
+    for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
     {
         ++count;
     }
@@ -3628,7 +4331,7 @@ void CMPTradeList::printAll()
   Slice skey, svalue;
   Iterator* it = NewIterator();
 
-  for(it->SeekToFirst(); it->Valid(); it->Next())
+  for(it->Seek(FIRST_RECORD_KEY); it->Valid(); it->Next())
   {
     skey = it->key();
     svalue = it->value();
@@ -3708,7 +4411,8 @@ int elysium_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
         reorgRecoveryMode = 0; // clear reorgRecovery here as this is likely re-entrant
 
         // Check if any freeze related transactions would be rolled back - if so wipe the state and startclean
-        bool reorgContainsFreeze = p_txlistdb->CheckForFreezeTxs(pBlockIndex->nHeight);
+        // Undo records cover the freeze state, so this is only needed without them
+        bool reorgContainsFreeze = !reorgRecoveryUndone && p_txlistdb->CheckForFreezeTxs(pBlockIndex->nHeight);
 
         // NOTE: The blockNum parameter is inclusive, so deleteAboveBlock(1000) will delete records in block 1000 and above.
         p_txlistdb->isMPinBlockRange(pBlockIndex->nHeight, reorgRecoveryMaxHeight, true);
@@ -3716,15 +4420,20 @@ int elysium_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
         s_stolistdb->deleteAboveBlock(pBlockIndex->nHeight);
         p_feecache->RollBackCache(pBlockIndex->nHeight);
         p_feehistory->RollBackHistory(pBlockIndex->nHeight);
+        WalletTxIndexRemoveAbove(pBlockIndex->nHeight);
         sigmaDb->DeleteAll(pBlockIndex->nHeight);
         reorgRecoveryMaxHeight = 0;
 
         nWaterlineBlock = ConsensusParams().GENESIS_BLOCK - 1;
 
-        if (reorgContainsFreeze) {
+        if (reorgRecoveryUndone) {
+            // the disconnected blocks were already rolled back one by one, the state is the one of the previous block
+            nWaterlineBlock = nBlockPrev;
+        } else if (reorgContainsFreeze) {
             PrintToLog("Reorganization containing freeze related transactions detected, forcing a reparse...\n");
             clear_all_state(); // unable to reorg freezes safely, clear state and reparse
         } else {
+            ClearBlockUndo();
             int best_state_block = load_most_relevant_state();
             if (best_state_block < 0) {
                 // unable to recover easily, remove stale stale state bits and reparse from the beginning.
@@ -3745,6 +4454,9 @@ int elysium_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
         }
     }
 
+    // record what this block changes, so it can be disconnected without reloading the state
+    StartBlockUndo(pBlockIndex->GetBlockHash(), elysium_prev);
+
     // handle any features that go live with this block
     CheckLiveActivations(pBlockIndex->nHeight);
 
@@ -3786,6 +4498,19 @@ int elysium_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         PrintToLog("develysium for block %d: %d, Elysium balance: %d\n", nBlockNow, develysium, FormatDivisibleMP(balance));
     }
 
+    // the state of this block is final, keep its undo record
+    FinishBlockUndo(pBlockIndex->GetBlockHash());
+
+    if (elysium_debug_bench) {
+        PrintToLog("Parsed block %d [%u txs found]: classify %.2fms, inputs %.2fms, parse %.2fms, apply %.2fms\n", nBlockNow, countMP,
+            nTimeClassify * 0.001, nTimeInputs * 0.001, nTimeParse * 0.001, nTimeApply * 0.001);
+    }
+
+    // the transactions of the block were applied, the prepared ones refer to the block
+    preparedTxs.clear();
+    preparedBlockHash.SetNull();
+    nTimeClassify = nTimeInputs = nTimeParse = nTimeApply = 0;
+
     // check the alert status, do we need to do anything else here?
     CheckExpiredAlerts(nBlockNow, pBlockIndex->GetBlockTime());
 
@@ -3826,8 +4551,20 @@ int elysium_handler_disc_begin(int nBlockNow, CBlockIndex const * pBlockIndex)
 {
     LOCK(cs_main);
 
+    if (reorgRecoveryMode == 0) {
+        reorgRecoveryUndone = true;
+    }
+
     reorgRecoveryMode = 1;
     reorgRecoveryMaxHeight = (pBlockIndex->nHeight > reorgRecoveryMaxHeight) ? pBlockIndex->nHeight: reorgRecoveryMaxHeight;
+
+    // roll back the in-memory state right away, as long as there are undo records for the disconnected blocks
+    if (reorgRecoveryUndone && !undo_block(pBlockIndex)) {
+        PrintToLog("No undo record for block %s, the state will be reloaded\n", pBlockIndex->GetBlockHash().GetHex());
+        reorgRecoveryUndone = false;
+        ClearBlockUndo();
+    }
+
     return 0;
 }
 
@@ -1,6 +1,7 @@
 #ifndef ZCOIN_ELYSIUM_ELYSIUM_H
 #define ZCOIN_ELYSIUM_ELYSIUM_H
 
+class CBlock;
 class CBlockIndex;
 class CCoinsView;
 class CCoinsViewCache;
@@ -20,9 +21,11 @@ class CTransaction;
 #include <univalue.h>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/signals2/signal.hpp>
 
 #include <leveldb/status.h>
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -35,6 +38,9 @@ using std::string;
 
 int const MAX_STATE_HISTORY = 50;
 
+//! -elysiumparsethreads default (threads parsing the transactions of a block, 0 = auto)
+int const DEFAULT_ELYSIUM_PARSE_THREADS = 0;
+
 constexpr size_t ELYSIUM_MAX_SIMPLE_MINTS = std::numeric_limits<uint8_t>::max();
 
 // increment this value to force a refresh of the state (similar to --startclean)
@@ -130,15 +136,22 @@ public:
     std::string FetchInvalidReason(const uint256& txid);
 };
 
-/** LevelDB based storage for STO recipients.
+/** LevelDB based storage for STO recipients, with the address as key.
+ *
+ * Receipts are also indexed by txid and by block, see BuildIndexes().
  */
 class CMPSTOList : public CDBBase
 {
+private:
+    /** Builds the secondary indexes, if the database was written without them. */
+    void BuildIndexes();
+
 public:
     CMPSTOList(const boost::filesystem::path& path, bool fWipe)
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading send-to-owners database: %s\n", status.ToString());
+        if (status.ok()) BuildIndexes();
     }
 
     virtual ~CMPSTOList()
@@ -148,6 +161,8 @@ public:
 
     void getRecipients(const uint256 txid, string filterAddress, UniValue *recipientArray, uint64_t *total, uint64_t *numRecipients);
     std::string getMySTOReceipts(string filterAddress);
+    /** Returns whether an address of the wallet received tokens of the STO. */
+    bool hasMyReceipt(const uint256& txid);
     int deleteAboveBlock(int blockNum);
     void printStats();
     void printAll();
@@ -156,14 +171,21 @@ public:
 };
 
 /** LevelDB based storage for the trade history. Trades are listed with key "txid1+txid2".
+ *
+ * Trades are also indexed by address, property pair, txid and block, see BuildIndexes().
  */
 class CMPTradeList : public CDBBase
 {
+private:
+    /** Builds the secondary indexes, if the database was written without them. */
+    void BuildIndexes();
+
 public:
     CMPTradeList(const boost::filesystem::path& path, bool fWipe)
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading trades database: %s\n", status.ToString());
+        if (status.ok()) BuildIndexes();
     }
 
     virtual ~CMPTradeList()
@@ -179,19 +201,28 @@ public:
     void printAll();
     bool getMatchingTrades(const uint256& txid, uint32_t propertyId, UniValue& tradeArray, int64_t& totalSold, int64_t& totalBought);
     void getTradesForAddress(std::string address, std::vector<uint256>& vecTransactions, uint32_t propertyIdFilter = 0);
+    /** Calls fn with the trades of the address, newest first, until it returns false. */
+    void forEachTradeForAddress(const std::string& address, uint32_t propertyIdFilter, const std::function<bool(const uint256&)>& fn);
     void getTradesForPair(uint32_t propertyIdSideA, uint32_t propertyIdSideB, UniValue& response, uint64_t count);
     int getMPTradeCountTotal();
 };
 
 /** LevelDB based storage for transactions, with txid as key and validity bit, and other data as value.
+ *
+ * Records are also indexed by block, see BuildIndexes().
  */
 class CMPTxList : public CDBBase
 {
+private:
+    /** Builds the block index, if the database was written without it. */
+    void BuildIndexes();
+
 public:
     CMPTxList(const boost::filesystem::path& path, bool fWipe)
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading tx meta-info database: %s\n", status.ToString());
+        if (status.ok()) BuildIndexes();
     }
 
     virtual ~CMPTxList()
@@ -203,7 +234,7 @@ public:
     void recordPaymentTX(const uint256 &txid, bool fValid, int nBlock, unsigned int vout, unsigned int propertyId, uint64_t nValue, string buyer, string seller);
     void recordMetaDExCancelTX(const uint256 &txidMaster, const uint256 &txidSub, bool fValid, int nBlock, unsigned int propertyId, uint64_t nValue);
     /** Records a "send all" sub record. */
-    void recordSendAllSubRecord(const uint256& txid, int subRecordNumber, uint32_t propertyId, int64_t nvalue);
+    void recordSendAllSubRecord(const uint256& txid, int nBlock, int subRecordNumber, uint32_t propertyId, int64_t nvalue);
 
     string getKeyValue(string key);
     uint256 findMetaDExCancel(const uint256 txid);
@@ -215,6 +246,8 @@ public:
     bool getSendAllDetails(const uint256& txid, int subSend, uint32_t& propertyId, int64_t& amount);
     int getMPTransactionCountTotal();
     int getMPTransactionCountBlock(int block);
+    /** Returns the transactions recorded in the block, without sub records. */
+    std::vector<uint256> getMPTransactionsBlock(int block);
 
     int getDBVersion();
     int setDBVersion();
@@ -263,11 +296,18 @@ int elysium_handler_disc_begin(int nBlockNow, CBlockIndex const * pBlockIndex);
 int elysium_handler_disc_end(int nBlockNow, CBlockIndex const * pBlockIndex);
 int elysium_handler_block_begin(int nBlockNow, CBlockIndex const * pBlockIndex);
 int elysium_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex, unsigned int);
+int elysium_handler_block_prepare(const CBlock& block, int nBlock, CBlockIndex const * pBlockIndex);
 bool elysium_handler_tx(const CTransaction& tx, int nBlock, unsigned int vgc, const CBlockIndex* pBlockIndex);
 int elysium_save_state( CBlockIndex const *pBlockIndex );
 
+/** Runs an instance of the thread parsing the transactions of a block. */
+void ThreadElysiumParse();
+
 namespace elysium
 {
+//! Addresses with a balance record for a property, with the tokens they hold, including reserved ones
+typedef std::map<std::string, int64_t> HolderMap;
+
 extern std::unordered_map<std::string, CMPTally> mp_tally_map;
 extern CMPTxList *p_txlistdb;
 extern CMPTradeList *t_tradelistdb;
@@ -301,6 +341,9 @@ uint32_t GetNextPropertyId(bool maineco); // maybe move into sp
 
 CMPTally* getTally(const std::string& address);
 
+/** Returns the holders of a property, ordered by address. */
+const HolderMap& getHolders(uint32_t propertyId);
+
 int64_t getTotalTokens(uint32_t propertyId, int64_t* n_owners_total = NULL);
 
 std::string strTransactionType(uint16_t txType);
@@ -311,6 +354,13 @@ bool UseEncodingClassC(size_t nDataSize);
 bool getValidMPTX(const uint256 &txid, int *block = NULL, unsigned int *type = NULL, uint64_t *nAmended = NULL);
 
 bool update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
+/** Removes all balances, and the holder index built from them. */
+void clear_tally_map();
+
+//! Signals a change of any balance of an address for a property, including reserved and pending ones
+extern boost::signals2::signal<void(const std::string& address, uint32_t propertyId)> TallyChanged;
+//! Signals that all balances were removed
+extern boost::signals2::signal<void()> TallyCleared;
 
 std::string getTokenLabel(uint32_t propertyId);
 
@@ -13,8 +13,11 @@
 #include "elysium/sto.h"
 
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 
+#include "clientversion.h"
 #include "main.h"
+#include "streams.h"
 
 #include <limits.h>
 #include <stdint.h>
@@ -26,6 +29,149 @@ using namespace elysium;
 
 std::map<uint32_t, int64_t> distributionThresholds;
 
+namespace {
+
+//! Fee cache entries are keyed by this byte, followed by the big-endian property ID
+const char FEE_CACHE_ENTRY_KEY = 0x01;
+
+std::string CreateEntryKey(uint32_t propertyId)
+{
+    std::string key(1, FEE_CACHE_ENTRY_KEY);
+    key.push_back(static_cast<char>(propertyId >> 24));
+    key.push_back(static_cast<char>(propertyId >> 16));
+    key.push_back(static_cast<char>(propertyId >> 8));
+    key.push_back(static_cast<char>(propertyId));
+    return key;
+}
+
+bool ParseEntryKey(const leveldb::Slice& key, uint32_t& propertyId)
+{
+    if (key.size() != 5 || key[0] != FEE_CACHE_ENTRY_KEY) return false;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(key.data()) + 1;
+    propertyId = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    return true;
+}
+
+/**
+ * Converts an entry of the old format, which is keyed by the zero padded property ID and
+ * holds the cached amount after each block as "block:amount,block:amount,...".
+ */
+bool ParseLegacyEntry(const std::string& key, const std::string& value, uint32_t& propertyId, CFeeCacheEntry& entry)
+{
+    if (key.size() != 10 || key.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    std::set<feeCacheItem> sCacheHistoryItems;
+    std::vector<std::string> vCacheHistoryItems;
+    boost::split(vCacheHistoryItems, value, boost::is_any_of(","), boost::token_compress_on);
+    try {
+        propertyId = boost::lexical_cast<uint32_t>(key);
+        for (std::vector<std::string>::iterator it = vCacheHistoryItems.begin(); it != vCacheHistoryItems.end(); ++it) {
+            std::vector<std::string> vCacheHistoryItem;
+            boost::split(vCacheHistoryItem, *it, boost::is_any_of(":"), boost::token_compress_on);
+            if (2 != vCacheHistoryItem.size()) continue;
+            int cacheItemBlock = boost::lexical_cast<int>(vCacheHistoryItem[0]);
+            int64_t cacheItemAmount = boost::lexical_cast<int64_t>(vCacheHistoryItem[1]);
+            sCacheHistoryItems.insert(std::make_pair(cacheItemBlock, cacheItemAmount));
+        }
+    } catch (const boost::bad_lexical_cast& e) {
+        return false;
+    }
+
+    // the amount before the oldest entry is unknown, rolling back past it empties the cache, as before
+    int64_t previousAmount = 0;
+    for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); ++it) {
+        entry.deltas.push_back(std::make_pair(it->first, it->second - previousAmount));
+        previousAmount = it->second;
+    }
+    entry.total = previousAmount;
+
+    return true;
+}
+
+// Adds a change of the amount to the entry, changes in the same block are combined
+void AddDelta(CFeeCacheEntry& entry, int block, int64_t amount)
+{
+    entry.total += amount;
+    if (!entry.deltas.empty() && entry.deltas.back().first == block) {
+        entry.deltas.back().second += amount;
+    } else {
+        entry.deltas.push_back(std::make_pair(block, amount));
+    }
+}
+
+// Removes changes over MAX_STATE_HISTORY blocks old, returns whether there were any
+bool PruneDeltas(CFeeCacheEntry& entry, int block)
+{
+    int pruneBlock = block - MAX_STATE_HISTORY;
+    std::vector<feeCacheItem>::iterator it = entry.deltas.begin();
+    while (it != entry.deltas.end() && it->first < pruneBlock) {
+        if (elysium_debug_fees) PrintToLog("      Skipping matured entry: block %d change %d\n", it->first, it->second);
+        ++it;
+    }
+    if (it == entry.deltas.begin()) return false;
+    entry.deltas.erase(entry.deltas.begin(), it);
+    return true;
+}
+
+} // anonymous namespace
+
+// Reads all entries into memory, converting entries in the old string format
+void CElysiumFeeCache::Load()
+{
+    assert(pdb);
+
+    entries.clear();
+
+    unsigned int nConverted = 0;
+    leveldb::WriteBatch batch;
+    leveldb::Iterator* it = NewIterator();
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        uint32_t propertyId = 0;
+        CFeeCacheEntry entry;
+        if (ParseEntryKey(it->key(), propertyId)) {
+            CDataStream deserialized(it->value().data(), it->value().data() + it->value().size(), SER_DISK, CLIENT_VERSION);
+            deserialized >> entry;
+        } else if (ParseLegacyEntry(it->key().ToString(), it->value().ToString(), propertyId, entry)) {
+            CDataStream serialized(SER_DISK, CLIENT_VERSION);
+            serialized << entry;
+            batch.Delete(it->key());
+            batch.Put(CreateEntryKey(propertyId), serialized.str());
+            ++nConverted;
+        } else {
+            PrintToLog("ERROR: unexpected fee cache entry (raw %s:%s)!\n", it->key().ToString(), it->value().ToString());
+            continue;
+        }
+        entries[propertyId] = entry;
+        ++nRead;
+    }
+    delete it;
+
+    if (nConverted > 0) {
+        leveldb::Status status = pdb->Write(syncoptions, &batch);
+        assert(status.ok());
+        PrintToLog("Converted %d fee cache entries to the binary format [%s]\n", nConverted, status.ToString());
+    }
+}
+
+// Stores the entry of a property
+void CElysiumFeeCache::WriteEntry(const uint32_t &propertyId, const CFeeCacheEntry &entry)
+{
+    assert(pdb);
+
+    CDataStream serialized(SER_DISK, CLIENT_VERSION);
+    serialized << entry;
+    leveldb::Status status = pdb->Put(writeoptions, CreateEntryKey(propertyId), serialized.str());
+    assert(status.ok());
+    ++nWritten;
+}
+
+// Deletes all entries, including the ones held in memory
+void CElysiumFeeCache::Clear()
+{
+    entries.clear();
+    CDBBase::Clear();
+}
+
 // Returns the distribution threshold for a property
 int64_t CElysiumFeeCache::GetDistributionThreshold(const uint32_t &propertyId)
 {
@@ -46,46 +192,25 @@ void CElysiumFeeCache::UpdateDistributionThresholds(uint32_t propertyId)
 // Gets the current amount of the fee cache for a property
 int64_t CElysiumFeeCache::GetCachedAmount(const uint32_t &propertyId)
 {
-    assert(pdb);
-    // Get the fee history, set is sorted by block so last entry is most recent
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator endIt = sCacheHistoryItems.end();
-        --endIt;
-        feeCacheItem mostRecentItem = *endIt;
-        return mostRecentItem.second;
-    } else {
+    std::unordered_map<uint32_t, CFeeCacheEntry>::const_iterator it = entries.find(propertyId);
+    if (it == entries.end()) {
         return 0; // property has never generated a fee
     }
+    return it->second.total;
 }
 
 // Zeros a property in the fee cache
 void CElysiumFeeCache::ClearCache(const uint32_t &propertyId, int block)
 {
     if (elysium_debug_fees) PrintToLog("ClearCache starting (block %d, property ID %d)...\n", block, propertyId);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (elysium_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue;
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (elysium_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        if (!newValue.empty()) newValue += ",";
-    }
-    if (elysium_debug_fees) PrintToLog("   Adding zero valued entry: block %d\n", block);
-    newValue += strprintf("%d:%d", block, 0);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-    assert(status.ok());
-    ++nWritten;
 
-    PruneCache(propertyId, block);
+    CFeeCacheEntry& entry = entries[propertyId];
+    if (elysium_debug_fees) PrintToLog("   Adding zero valued entry: block %d (change %d)\n", block, -entry.total);
+    AddDelta(entry, block, -entry.total);
+    PruneDeltas(entry, block);
+    WriteEntry(propertyId, entry);
 
-    if (elysium_debug_fees) PrintToLog("Cleared cache for property %d block %d [%s]\n", propertyId, block, status.ToString());
+    if (elysium_debug_fees) PrintToLog("Cleared cache for property %d block %d\n", propertyId, block);
 }
 
 // Adds a fee to the cache (eg on a completed trade)
@@ -94,7 +219,8 @@ void CElysiumFeeCache::AddFee(const uint32_t &propertyId, int block, const int64
     if (elysium_debug_fees) PrintToLog("Starting AddFee for prop %d (block %d amount %d)...\n", propertyId, block, amount);
 
     // Get current cached fee
-    int64_t currentCachedAmount = GetCachedAmount(propertyId);
+    CFeeCacheEntry& entry = entries[propertyId];
+    int64_t currentCachedAmount = entry.total;
     if (elysium_debug_fees) PrintToLog("   Current cached amount %d\n", currentCachedAmount);
 
     // Add new fee and rewrite record
@@ -108,32 +234,12 @@ void CElysiumFeeCache::AddFee(const uint32_t &propertyId, int block, const int64
             AbortNode(msg, msg);
         }
     }
-    int64_t newCachedAmount = currentCachedAmount + amount;
-
-    if (elysium_debug_fees) PrintToLog("   New cached amount %d\n", newCachedAmount);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (elysium_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    std::string newValue;
-    if (!sCacheHistoryItems.empty()) {
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first == block) continue; // this is an older entry for the same block, discard it
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (elysium_debug_fees) PrintToLog("      Readding entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        if (!newValue.empty()) newValue += ",";
-    }
-    if (elysium_debug_fees) PrintToLog("   Adding requested entry: block %d new amount %d\n", block, newCachedAmount);
-    newValue += strprintf("%d:%d", block, newCachedAmount);
-    leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-    assert(status.ok());
-    ++nWritten;
-    if (elysium_debug_fees) PrintToLog("AddFee completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
+    AddDelta(entry, block, amount);
 
-    // Call for pruning (we only prune when we update a record)
-    PruneCache(propertyId, block);
+    // Prune before writing the record, so that it's only written once
+    PruneDeltas(entry, block);
+    WriteEntry(propertyId, entry);
+    if (elysium_debug_fees) PrintToLog("AddFee completed for property %d (new amount %d, %d changes kept)\n", propertyId, entry.total, entry.deltas.size());
 
     // Call for cache evaluation (we only need to do this each time a fee cache is increased)
     EvalCache(propertyId, block);
@@ -144,29 +250,16 @@ void CElysiumFeeCache::AddFee(const uint32_t &propertyId, int block, const int64
 // Rolls back the cache to an earlier state (eg in event of a reorg) - block is *inclusive* (ie entries=block will get deleted)
 void CElysiumFeeCache::RollBackCache(int block)
 {
-    assert(pdb);
-    for (uint8_t ecosystem = 1; ecosystem <= 2; ecosystem++) {
-        uint32_t startPropertyId = (ecosystem == 1) ? 1 : TEST_ECO_PROPERTY_1;
-        for (uint32_t propertyId = startPropertyId; propertyId < elysium::_my_sps->peekNextSPID(ecosystem); propertyId++) {
-            const std::string key = strprintf("%010d", propertyId);
-            std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-            if (!sCacheHistoryItems.empty()) {
-                std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-                std::string newValue;
-                --mostRecentIt;
-                feeCacheItem mostRecentItem = *mostRecentIt;
-                if (mostRecentItem.first < block) continue; // all entries are unaffected by this rollback, nothing to do
-                for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-                    feeCacheItem tempItem = *it;
-                    if (tempItem.first >= block) continue; // discard this entry
-                    if (!newValue.empty()) newValue += ",";
-                    newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-                }
-                leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-                assert(status.ok());
-                PrintToLog("Rolling back fee cache for property %d, new=%s [%s])\n", propertyId, newValue, status.ToString());
-            }
+    // only properties which ever generated a fee have an entry
+    for (std::unordered_map<uint32_t, CFeeCacheEntry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        CFeeCacheEntry& entry = it->second;
+        if (entry.deltas.empty() || entry.deltas.back().first < block) continue; // all entries are unaffected by this rollback, nothing to do
+        while (!entry.deltas.empty() && entry.deltas.back().first >= block) {
+            entry.total -= entry.deltas.back().second;
+            entry.deltas.pop_back();
         }
+        WriteEntry(it->first, entry);
+        PrintToLog("Rolling back fee cache for property %d, new amount %d\n", it->first, entry.total);
     }
 }
 
@@ -189,6 +282,7 @@ void CElysiumFeeCache::DistributeCache(const uint32_t &propertyId, int block)
         PrintToLog("Aborting fee distribution for property %d, the fee cache is empty!\n", propertyId);
     }
 
+    // the receivers are taken from the holder index of ELYSIUM or TELYSIUM, not from all addresses
     OwnerAddrType receiversSet;
     if (isTestEcosystemProperty(propertyId)) {
         receiversSet = STO_GetReceivers("FEEDISTRIBUTION", ELYSIUM_PROPERTY_TELYSIUM, cachedAmount);
@@ -225,47 +319,14 @@ void CElysiumFeeCache::DistributeCache(const uint32_t &propertyId, int block)
 void CElysiumFeeCache::PruneCache(const uint32_t &propertyId, int block)
 {
     if (elysium_debug_fees) PrintToLog("Starting PruneCache for prop %d block %d...\n", propertyId, block);
-    assert(pdb);
 
-    int pruneBlock = block - MAX_STATE_HISTORY;
-    if (elysium_debug_fees) PrintToLog("Removing entries prior to block %d...\n", pruneBlock);
-    const std::string key = strprintf("%010d", propertyId);
-    std::set<feeCacheItem> sCacheHistoryItems = GetCacheHistory(propertyId);
-    if (elysium_debug_fees) PrintToLog("   Iterating cache history (%d items)...\n",sCacheHistoryItems.size());
-    if (!sCacheHistoryItems.empty()) {
-        std::set<feeCacheItem>::iterator startIt = sCacheHistoryItems.begin();
-        feeCacheItem firstItem = *startIt;
-        if (firstItem.first >= pruneBlock) {
-            if (elysium_debug_fees) PrintToLog("Endingg PruneCache - no matured entries found.\n");
-            return; // all entries are above supplied block value, nothing to do
-        }
-        std::string newValue;
-        for (std::set<feeCacheItem>::iterator it = sCacheHistoryItems.begin(); it != sCacheHistoryItems.end(); it++) {
-            feeCacheItem tempItem = *it;
-            if (tempItem.first < pruneBlock) {
-                if (elysium_debug_fees) {
-                    PrintToLog("      Skipping matured entry: block %d amount %d\n", tempItem.first, tempItem.second);
-                    continue; // discard this entry
-                }
-            }
-            if (!newValue.empty()) newValue += ",";
-            newValue += strprintf("%d:%d", tempItem.first, tempItem.second);
-            if (elysium_debug_fees) PrintToLog("      Readding immature entry: block %d amount %d\n", tempItem.first, tempItem.second);
-        }
-        // make sure the pruned cache isn't completely empty, if it is, prune down to just the most recent entry
-        if (newValue.empty()) {
-            std::set<feeCacheItem>::iterator mostRecentIt = sCacheHistoryItems.end();
-            --mostRecentIt;
-            feeCacheItem mostRecentItem = *mostRecentIt;
-            newValue = strprintf("%d:%d", mostRecentItem.first, mostRecentItem.second);
-            if (elysium_debug_fees) PrintToLog("   All entries matured and pruned - readding most recent entry: block %d amount %d\n", mostRecentItem.first, mostRecentItem.second);
-        }
-        leveldb::Status status = pdb->Put(writeoptions, key, newValue);
-        assert(status.ok());
-        if (elysium_debug_fees) PrintToLog("PruneCache completed for property %d (new=%s [%s])\n", propertyId, newValue, status.ToString());
-    } else {
+    std::unordered_map<uint32_t, CFeeCacheEntry>::iterator it = entries.find(propertyId);
+    if (it == entries.end() || !PruneDeltas(it->second, block)) {
+        if (elysium_debug_fees) PrintToLog("Ending PruneCache - no matured entries found.\n");
         return; // nothing to do
     }
+    WriteEntry(propertyId, it->second);
+    if (elysium_debug_fees) PrintToLog("PruneCache completed for property %d (%d changes kept)\n", propertyId, it->second.deltas.size());
 }
 
 // Show Fee Cache DB statistics
@@ -278,41 +339,32 @@ void CElysiumFeeCache::printStats()
 void CElysiumFeeCache::printAll()
 {
     int count = 0;
-    leveldb::Iterator* it = NewIterator();
-    for(it->SeekToFirst(); it->Valid(); it->Next()) {
+    for (std::unordered_map<uint32_t, CFeeCacheEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
         ++count;
-        PrintToLog("entry #%8d= %s:%s\n", count, it->key().ToString(), it->value().ToString());
+        std::string changes;
+        for (std::vector<feeCacheItem>::const_iterator delta = it->second.deltas.begin(); delta != it->second.deltas.end(); ++delta) {
+            if (!changes.empty()) changes += ",";
+            changes += strprintf("%d:%+d", delta->first, delta->second);
+        }
+        PrintToLog("entry #%8d= %d:%d (%s)\n", count, it->first, it->second.total, changes);
     }
-    delete it;
 }
 
-// Return a set containing fee cache history items
+// Return a set containing the fee cache amount after each block of the history
 std::set<feeCacheItem> CElysiumFeeCache::GetCacheHistory(const uint32_t &propertyId)
 {
-    assert(pdb);
-
-    const std::string key = strprintf("%010d", propertyId);
-
     std::set<feeCacheItem> sCacheHistoryItems;
-    std::string strValue;
-    leveldb::Status status = pdb->Get(readoptions, key, &strValue);
-    if (status.IsNotFound()) {
+
+    std::unordered_map<uint32_t, CFeeCacheEntry>::const_iterator it = entries.find(propertyId);
+    if (it == entries.end()) {
         return sCacheHistoryItems; // no cache, return empty set
     }
-    assert(status.ok());
-    std::vector<std::string> vCacheHistoryItems;
-    boost::split(vCacheHistoryItems, strValue, boost::is_any_of(","), boost::token_compress_on);
-    for (std::vector<std::string>::iterator it = vCacheHistoryItems.begin(); it != vCacheHistoryItems.end(); ++it) {
-        std::vector<std::string> vCacheHistoryItem;
-        boost::split(vCacheHistoryItem, *it, boost::is_any_of(":"), boost::token_compress_on);
-        if (2 != vCacheHistoryItem.size()) {
-            PrintToLog("ERROR: vCacheHistoryItem has unexpected number of elements: %d (raw %s)!\n", vCacheHistoryItem.size(), *it);
-            printAll();
-            continue;
-        }
-        int64_t cacheItemBlock = boost::lexical_cast<int64_t>(vCacheHistoryItem[0]);
-        int64_t cacheItemAmount = boost::lexical_cast<int64_t>(vCacheHistoryItem[1]);
-        sCacheHistoryItems.insert(std::make_pair(cacheItemBlock, cacheItemAmount));
+
+    // walk back from the current amount
+    int64_t amount = it->second.total;
+    for (std::vector<feeCacheItem>::const_reverse_iterator delta = it->second.deltas.rbegin(); delta != it->second.deltas.rend(); ++delta) {
+        sCacheHistoryItems.insert(std::make_pair(delta->first, amount));
+        amount -= delta->second;
     }
 
     return sCacheHistoryItems;
@@ -337,16 +389,27 @@ void CElysiumFeeHistory::printAll()
     delete it;
 }
 
+// Deletes all entries and resets the record count
+void CElysiumFeeHistory::Clear()
+{
+    CDBBase::Clear();
+    nRecords = 0;
+}
+
 // Count Fee History DB records
 int CElysiumFeeHistory::CountRecords()
 {
+    if (nRecords >= 0) return nRecords;
+
     // No faster way to count than to iterate - "There is no way to implement Count more efficiently inside leveldb than outside."
+    // so it's only done once, records are counted as they are added or removed afterwards
     int count = 0;
     leveldb::Iterator* it = NewIterator();
     for(it->SeekToFirst(); it->Valid(); it->Next()) {
         ++count;
     }
     delete it;
+    nRecords = count;
     return count;
 }
 
@@ -370,6 +433,7 @@ void CElysiumFeeHistory::RollBackHistory(int block)
         if (feeBlock >= block) {
             PrintToLog("%s() deleting from fee history DB: %s %s\n", __FUNCTION__, strKey, strValue);
             pdb->Delete(writeoptions, strKey);
+            if (nRecords > 0) --nRecords;
         }
     }
     delete it;
@@ -485,5 +549,6 @@ void CElysiumFeeHistory::RecordFeeDistribution(const uint32_t &propertyId, int b
 
     std::string value = strprintf("%d:%d:%d:%s", block, propertyId, total, feeRecipientsStr);
     leveldb::Status status = pdb->Put(writeoptions, key, value);
+    if (status.ok()) nRecords = count;
     if (elysium_debug_fees) PrintToLog("Added fee distribution to feeCacheHistory - key=%s value=%s [%s]\n", key, value, status.ToString());
 }
@@ -6,13 +6,38 @@
 #include "elysium/log.h"
 #include "elysium/persistence.h"
 
+#include "serialize.h"
+
 #include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <stdint.h>
 #include <boost/filesystem.hpp>
 
 typedef std::pair<int, int64_t> feeCacheItem;
 typedef std::pair<std::string, int64_t> feeHistoryItem;
 
+/** The fee cache of a property, stored in binary form
+ */
+struct CFeeCacheEntry
+{
+    //! Current amount of the cache
+    int64_t total;
+    //! Changes of the amount by block, in block order, for the last MAX_STATE_HISTORY blocks
+    std::vector<feeCacheItem> deltas;
+
+    CFeeCacheEntry() : total(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(total);
+        READWRITE(deltas);
+    }
+};
+
 /** LevelDB based storage for the MetaDEx fee cache
  */
 class CElysiumFeeCache : public CDBBase
@@ -22,6 +47,7 @@ public:
     {
         leveldb::Status status = Open(path, fWipe);
         PrintToLog("Loading fee cache database: %s\n", status.ToString());
+        Load();
     }
 
     virtual ~CElysiumFeeCache()
@@ -33,12 +59,14 @@ public:
     void printStats();
     // Show Fee Cache DB records
     void printAll();
+    // Deletes all entries, including the ones held in memory
+    void Clear() override;
 
     // Sets the distribution thresholds to total tokens for a property / ELYSIUM_FEE_THRESHOLD
     void UpdateDistributionThresholds(uint32_t propertyId);
     // Returns the distribution threshold for a property
     int64_t GetDistributionThreshold(const uint32_t &propertyId);
-    // Return a set containing fee cache history items
+    // Return a set containing the fee cache amount after each block of the history
     std::set<feeCacheItem> GetCacheHistory(const uint32_t &propertyId);
     // Gets the current amount of the fee cache for a property
     int64_t GetCachedAmount(const uint32_t &propertyId);
@@ -54,6 +82,15 @@ public:
     void EvalCache(const uint32_t &propertyId, int block);
     // Performs distribution of fees
     void DistributeCache(const uint32_t &propertyId, int block);
+
+private:
+    //! All entries of the database by property, so that lookups don't hit the database
+    std::unordered_map<uint32_t, CFeeCacheEntry> entries;
+
+    // Reads all entries into memory, converting entries in the old string format
+    void Load();
+    // Stores the entry of a property
+    void WriteEntry(const uint32_t &propertyId, const CFeeCacheEntry &entry);
 };
 
 /** LevelDB based storage for the MetaDEx fee distributions
@@ -76,6 +113,8 @@ public:
     void printStats();
     // Show Fee History DB records
     void printAll();
+    // Deletes all entries and resets the record count
+    void Clear() override;
 
     // Roll back history in event of reorg
     void RollBackHistory(int block);
@@ -90,6 +129,10 @@ public:
     // Populate data about a fee distribution
     bool GetDistributionData(int id, uint32_t *propertyId, int *block, int64_t *total);
     // Retrieve fee distribution receipts for an address
+
+private:
+    //! Number of records, counted once and then kept up to date, or -1 if not counted yet
+    int nRecords = -1;
 };
 
 namespace elysium
@@ -3,6 +3,10 @@
  *
  * The fetch functions provide a sorted list of transaction hashes ordered by block,
  * position in block and position in wallet including STO receipts.
+ *
+ * They are served from an in-memory index of the wallet's Elysium transactions, which
+ * is filled by elysium_handler_tx() as transactions are processed, and loaded from the
+ * wallet once for the transactions processed before.
  */
 
 #include "elysium/fetchwallettx.h"
@@ -10,20 +14,26 @@
 #include "elysium/log.h"
 #include "elysium/elysium.h"
 #include "elysium/pending.h"
+#include "elysium/tx.h"
 #include "elysium/utilsbitcoin.h"
+#include "elysium/wallettxs.h"
 
 #include "init.h"
 #include "main.h"
 #include "sync.h"
 #include "tinyformat.h"
 #include "txdb.h"
+#include "utiltime.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
 #endif
 
 #include <boost/algorithm/string.hpp>
+#include <boost/signals2/connection.hpp>
 
 #include <stdint.h>
+#include <algorithm>
+#include <limits>
 #include <list>
 #include <map>
 #include <set>
@@ -48,53 +58,137 @@ unsigned int GetTransactionByteOffset(const uint256& txid)
     return 0;
 }
 
+//! Elysium transactions of the wallet, including STO receipts, by block and position in the block
+typedef std::map<std::pair<int, uint32_t>, uint256> WalletTxIndex;
+
+//! Guards the wallet transaction index
+static CCriticalSection cs_walletTxIndex;
+static WalletTxIndex walletTxIndex;
+//! Whether the index was loaded from the wallet, it's loaded when it's first used
+static bool fWalletTxIndexLoaded = false;
+//! Transactions added to the wallet, which may have to be added to the index
+static std::set<uint256> uncheckedWalletTxs;
+
+static boost::signals2::scoped_connection walletTxConnection;
+
+void WalletTxIndexAdd(const uint256& txid, int block, uint32_t position)
+{
+    LOCK(cs_walletTxIndex);
+    walletTxIndex[std::make_pair(block, position)] = txid;
+}
+
+void WalletTxIndexRemoveAbove(int block)
+{
+    LOCK(cs_walletTxIndex);
+    walletTxIndex.erase(walletTxIndex.lower_bound(std::make_pair(block, 0U)), walletTxIndex.end());
+}
+
+void WalletTxIndexClear()
+{
+    LOCK(cs_walletTxIndex);
+    walletTxIndex.clear();
+    uncheckedWalletTxs.clear();
+    fWalletTxIndexLoaded = false;
+}
+
+#ifdef ENABLE_WALLET
+static void OnWalletTransactionChanged(CWallet* wallet, const uint256& txid, ChangeType status)
+{
+    // the wallet lock may be held, so the transaction is only checked when the index is used next
+    if (status == CT_DELETED) return;
+
+    LOCK(cs_walletTxIndex);
+    if (fWalletTxIndexLoaded) uncheckedWalletTxs.insert(txid);
+}
+#endif
+
+void WalletTxIndexInit()
+{
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        walletTxConnection = pwalletMain->NotifyTransactionChanged.connect(&OnWalletTransactionChanged);
+    }
+#endif
+}
+
+void WalletTxIndexShutdown()
+{
+    walletTxConnection.disconnect();
+    WalletTxIndexClear();
+}
+
 /**
- * Returns an ordered list of Elysium transactions including STO receipts that are relevant to the wallet.
- *
- * Ignores order in the wallet (which can be skewed by watch addresses) and utilizes block height and position within block.
+ * Returns whether a processed Elysium transaction is relevant to the wallet: it's in the
+ * wallet, an address of the wallet sent or received it, or received tokens of an STO.
  */
-std::map<std::string, uint256> FetchWalletElysiumTransactions(unsigned int count, int startBlock, int endBlock)
+bool IsWalletTransaction(const CMPTransaction& mp_obj)
 {
-    std::map<std::string, uint256> mapResponse;
 #ifdef ENABLE_WALLET
     if (pwalletMain == NULL) {
-        return mapResponse;
+        return false;
     }
-    std::set<uint256> seenHashes;
-    std::list<CAccountingEntry> acentries;
-    CWallet::TxItems txOrdered;
     {
         LOCK(pwalletMain->cs_wallet);
-        txOrdered = pwalletMain->wtxOrdered;
-    }
-    // Iterate backwards through wallet transactions until we have count items to return:
-    for (CWallet::TxItems::reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
-        const CWalletTx* pwtx = it->second.first;
-        if (pwtx == NULL) continue;
-        const uint256& txHash = pwtx->GetHash();
-        {
-            LOCK(cs_main);
-            if (!p_txlistdb->exists(txHash)) continue;
-        }
-        const uint256& blockHash = pwtx->hashBlock;
-        if (blockHash.IsNull() || (NULL == GetBlockIndex(blockHash))) continue;
-        const CBlockIndex* pBlockIndex = GetBlockIndex(blockHash);
-        if (NULL == pBlockIndex) continue;
-        int blockHeight = pBlockIndex->nHeight;
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
-        seenHashes.insert(txHash);
-        if (mapResponse.size() >= count) break;
-    }
-
-    // Insert STO receipts - receiving an STO has no inbound transaction to the wallet, so we will insert these manually into the response
-    std::string mySTOReceipts;
-    {
+        if (pwalletMain->mapWallet.count(mp_obj.getHash())) return true;
+    }
+    if (IsMyAddress(mp_obj.getSender())) return true;
+    if (!mp_obj.getReceiver().empty() && IsMyAddress(mp_obj.getReceiver())) return true;
+    if (mp_obj.getType() == ELYSIUM_TYPE_SEND_TO_OWNERS) {
         LOCK(cs_main);
-        mySTOReceipts = s_stolistdb->getMySTOReceipts("");
+        return s_stolistdb->hasMyReceipt(mp_obj.getHash());
     }
+#endif
+    return false;
+}
+
+#ifdef ENABLE_WALLET
+/**
+ * Adds a confirmed Elysium transaction of the wallet to the index.
+ */
+static void IndexWalletTransaction(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_main);
+
+    const uint256& txHash = wtx.GetHash();
+    if (wtx.hashBlock.IsNull() || !p_txlistdb->exists(txHash)) return;
+    const CBlockIndex* pBlockIndex = GetBlockIndex(wtx.hashBlock);
+    if (NULL == pBlockIndex || !chainActive.Contains(pBlockIndex)) return;
+    WalletTxIndexAdd(txHash, pBlockIndex->nHeight, p_ElysiumTXDB->FetchTransactionPosition(txHash));
+}
+
+/**
+ * Loads the index from the wallet the first time, and afterwards checks the transactions
+ * added to the wallet since the last use, for example by a rescan.
+ */
+static void UpdateWalletTxIndex()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pwalletMain->cs_wallet);
+
+    bool fLoad = false;
+    std::set<uint256> txids;
+    {
+        LOCK(cs_walletTxIndex);
+        fLoad = !fWalletTxIndexLoaded;
+        fWalletTxIndexLoaded = true;
+        txids.swap(uncheckedWalletTxs);
+    }
+
+    if (!fLoad) {
+        for (std::set<uint256>::const_iterator it = txids.begin(); it != txids.end(); ++it) {
+            std::map<uint256, CWalletTx>::const_iterator walletIt = pwalletMain->mapWallet.find(*it);
+            if (walletIt != pwalletMain->mapWallet.end()) IndexWalletTransaction(walletIt->second);
+        }
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMillis();
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        IndexWalletTransaction(it->second);
+    }
+
+    // Insert STO receipts - receiving an STO has no inbound transaction to the wallet, so we will insert these manually
+    std::string mySTOReceipts = s_stolistdb->getMySTOReceipts("");
     std::vector<std::string> vecReceipts;
     if (!mySTOReceipts.empty()) {
         boost::split(vecReceipts, mySTOReceipts, boost::is_any_of(","), boost::token_compress_on);
@@ -106,35 +200,87 @@ std::map<std::string, uint256> FetchWalletElysiumTransactions(unsigned int count
             PrintToLog("STODB Error - number of tokens is not as expected (%s)\n", vecReceipts[i]);
             continue;
         }
-        int blockHeight = atoi(svstr[1]);
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
         uint256 txHash = uint256S(svstr[0]);
-        if (seenHashes.find(txHash) != seenHashes.end()) continue; // an STO may already be in the wallet if we sent it
-        int blockPosition = GetTransactionByteOffset(txHash);
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
+        WalletTxIndexAdd(txHash, atoi(svstr[1]), p_ElysiumTXDB->FetchTransactionPosition(txHash));
     }
 
-    // Insert pending transactions (sets block as 999999 and position as wallet position)
-    LOCK(cs_main);
+    LOCK(cs_walletTxIndex);
+    PrintToLog("Loaded %d Elysium wallet transactions [%d ms]\n", walletTxIndex.size(), GetTimeMillis() - nTimeStart);
+}
+#endif
 
-    for (PendingMap::const_iterator it = my_pending.begin(); it != my_pending.end(); ++it) {
-        const uint256& txHash = it->first;
-        int blockHeight = 999999;
-        if (blockHeight < startBlock || blockHeight > endBlock) continue;
-        int blockPosition = 0;
-        {
-            LOCK(pwalletMain->cs_wallet);
-            std::map<uint256, CWalletTx>::const_iterator walletIt = pwalletMain->mapWallet.find(txHash);
+WalletTxCursor::WalletTxCursor(int startBlock, int endBlock)
+  : startBlock(startBlock), endBlock(endBlock), nextPending(0), position(endBlock, 0), fStarted(false)
+{
+#ifdef ENABLE_WALLET
+    if (pwalletMain == NULL) {
+        return;
+    }
+
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    UpdateWalletTxIndex();
+
+    // Insert pending transactions (sets block as 999999 and position as wallet position)
+    if (startBlock <= 999999 && 999999 <= endBlock) {
+        for (PendingMap::const_iterator it = my_pending.begin(); it != my_pending.end(); ++it) {
+            uint32_t walletPosition = 0;
+            std::map<uint256, CWalletTx>::const_iterator walletIt = pwalletMain->mapWallet.find(it->first);
             if (walletIt != pwalletMain->mapWallet.end()) {
-                const CWalletTx& wtx = walletIt->second;
-                blockPosition = wtx.nOrderPos;
+                walletPosition = walletIt->second.nOrderPos;
             }
+            pending.push_back(std::make_pair(walletPosition, it->first));
         }
-        std::string sortKey = strprintf("%06d%010d", blockHeight, blockPosition);
-        mapResponse.insert(std::make_pair(sortKey, txHash));
+        std::sort(pending.rbegin(), pending.rend());
     }
 #endif
+}
+
+bool WalletTxCursor::Next()
+{
+    if (nextPending < pending.size()) {
+        position = std::make_pair(999999, pending[nextPending].first);
+        txid = pending[nextPending].second;
+        ++nextPending;
+        return true;
+    }
+
+    LOCK(cs_walletTxIndex);
+
+    // the newest entry older than the current one, looked up again as the index may have changed
+    WalletTxIndex::const_iterator it = fStarted
+        ? walletTxIndex.lower_bound(position)
+        : walletTxIndex.upper_bound(std::make_pair(endBlock, std::numeric_limits<uint32_t>::max()));
+    if (it == walletTxIndex.begin()) {
+        return false;
+    }
+    --it;
+    if (it->first.first < startBlock) {
+        return false;
+    }
+
+    position = it->first;
+    txid = it->second;
+    fStarted = true;
+
+    return true;
+}
+
+/**
+ * Returns an ordered list of Elysium transactions including STO receipts that are relevant to the wallet.
+ *
+ * Ignores order in the wallet (which can be skewed by watch addresses) and utilizes block height and position within block.
+ */
+std::map<std::string, uint256> FetchWalletElysiumTransactions(unsigned int count, int startBlock, int endBlock)
+{
+    std::map<std::string, uint256> mapResponse;
+
+    WalletTxCursor cursor(startBlock, endBlock);
+    while (mapResponse.size() < count && cursor.Next()) {
+        std::string sortKey = strprintf("%06d%010d", cursor.GetBlock(), cursor.GetPosition());
+        mapResponse.insert(std::make_pair(sortKey, cursor.GetTxid()));
+    }
+
     return mapResponse;
 }
 
@@ -1,10 +1,16 @@
 #ifndef ELYSIUM_FETCHWALLETTX_H
 #define ELYSIUM_FETCHWALLETTX_H
 
-class uint256;
+class CMPTransaction;
+
+#include "uint256.h"
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
 
 namespace elysium
 {
@@ -13,6 +19,56 @@ unsigned int GetTransactionByteOffset(const uint256& txid);
 
 /** Returns an ordered list of Elysium transactions that are relevant to the wallet. */
 std::map<std::string, uint256> FetchWalletElysiumTransactions(unsigned int count, int startBlock = 0, int endBlock = 999999);
+
+/** Returns whether a processed Elysium transaction is relevant to the wallet. */
+bool IsWalletTransaction(const CMPTransaction& mp_obj);
+
+/** Adds an Elysium transaction of the wallet to the index, at its block and position in the block. */
+void WalletTxIndexAdd(const uint256& txid, int block, uint32_t position);
+
+/** Removes the transactions in and above the block from the index. */
+void WalletTxIndexRemoveAbove(int block);
+
+/** Empties the index, it is loaded from the wallet again when it's used next. */
+void WalletTxIndexClear();
+
+/** Starts following transactions added to the wallet. */
+void WalletTxIndexInit();
+
+/** Stops following transactions added to the wallet. */
+void WalletTxIndexShutdown();
+
+/**
+ * Lists the Elysium transactions of the wallet, newest first.
+ *
+ * Pending transactions come first, then confirmed transactions by block and
+ * position in the block, taken from the index one at a time, so that callers can
+ * stop as soon as they have what they need. Transactions added to the index
+ * while listing, at positions not listed yet, are included.
+ */
+class WalletTxCursor
+{
+public:
+    WalletTxCursor(int startBlock = 0, int endBlock = 999999);
+
+    /** Moves to the next older transaction, returns false when there is none. */
+    bool Next();
+
+    const uint256& GetTxid() const { return txid; }
+    int GetBlock() const { return position.first; }
+    uint32_t GetPosition() const { return position.second; }
+
+private:
+    int startBlock;
+    int endBlock;
+    //! Pending transactions with their position in the wallet, newest first
+    std::vector<std::pair<uint32_t, uint256>> pending;
+    size_t nextPending;
+    //! Block and position of the current transaction
+    std::pair<int, uint32_t> position;
+    bool fStarted;
+    uint256 txid;
+};
 }
 
 #endif // ELYSIUM_FETCHWALLETTX_H
@@ -8,6 +8,7 @@
 #include "elysium/sp.h"
 #include "elysium/tx.h"
 #include "elysium/uint256_extensions.h"
+#include "elysium/undo.h"
 
 #include "arith_uint256.h"
 #include "chain.h"
@@ -25,11 +26,13 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 typedef boost::multiprecision::cpp_dec_float_100 dec_float;
 typedef boost::multiprecision::checked_int128_t int128_t;
@@ -42,9 +45,12 @@ using namespace elysium;
 //! Global map for price and order data
 md_PropertiesMap elysium::metadex;
 
-md_PricesMap* elysium::get_Prices(uint32_t prop)
+//! Index of the open orders by transaction hash
+static std::map<uint256, md_Set::iterator> metadexTxIndex;
+
+md_PricesMap* elysium::get_Prices(uint32_t prop, uint32_t desprop)
 {
-    md_PropertiesMap::iterator it = metadex.find(prop);
+    md_PropertiesMap::iterator it = metadex.find(md_PropertyPair(prop, desprop));
 
     if (it != metadex.end()) return &(it->second);
 
@@ -60,6 +66,30 @@ md_Set* elysium::get_Indexes(md_PricesMap* p, rational_t price)
     return (md_Set*) NULL;
 }
 
+/**
+ * Removes an order from its price level and from the txid index.
+ *
+ * @return the next order of the price level
+ */
+static md_Set::iterator EraseOrder(md_Set& indexes, md_Set::iterator it)
+{
+    RecordMetaDExUndo(it->getHash());
+    metadexTxIndex.erase(it->getHash());
+    indexes.erase(it++);
+    return it;
+}
+
+/**
+ * Removes the price level if it has no orders left, and the pair if it has no
+ * price levels left, so the maps only ever hold open orders.
+ */
+static void PruneLevel(md_PropertiesMap::iterator pairIt, md_PricesMap::iterator priceIt)
+{
+    if (!priceIt->second.empty()) return;
+    pairIt->second.erase(priceIt);
+    if (pairIt->second.empty()) metadex.erase(pairIt);
+}
+
 enum MatchReturnType
 {
     NOTHING = 0,
@@ -142,24 +172,29 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     if (elysium_debug_metadex1) PrintToLog("%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
         __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(pnew->inversePrice()), pnew->ToString());
 
-    md_PricesMap* const ppriceMap = get_Prices(propertyDesired);
+    // the offers that can match sell the desired property for the property offered
+    md_PropertiesMap::iterator pairIt = metadex.find(md_PropertyPair(propertyDesired, propertyForSale));
 
     // nothing for the desired property exists in the market, sorry!
-    if (!ppriceMap) {
+    if (pairIt == metadex.end()) {
         PrintToLog("%s()=%d:%s NOT FOUND ON THE MARKET\n", __FUNCTION__, NewReturn, getTradeReturnType(NewReturn));
         return NewReturn;
     }
 
-    // within the desired property map (given one property) iterate over the items looking at prices
-    for (md_PricesMap::iterator priceIt = ppriceMap->begin(); priceIt != ppriceMap->end(); ++priceIt) { // check all prices
+    md_PricesMap* const ppriceMap = &(pairIt->second);
+
+    // within the pair iterate over the price levels, cheapest first
+    md_PricesMap::iterator priceIt = ppriceMap->begin();
+    while (priceIt != ppriceMap->end()) { // check all prices
         const rational_t sellersPrice = priceIt->first;
 
         if (elysium_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
             xToString(pnew->inversePrice()), xToString(sellersPrice));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
+        // Prices only go up from here, so none of the remaining levels can match either.
         if (pnew->inversePrice() < sellersPrice) {
-            continue;
+            break;
         }
 
         md_Set* const pofferSet = &(priceIt->second);
@@ -173,12 +208,6 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             if (elysium_debug_metadex1) PrintToLog("Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
                 xToString(sellersPrice), pold->getProperty(), pold->getDesProperty(), pold->ToString());
 
-            // does the desired property match?
-            if (pold->getDesProperty() != propertyForSale) {
-                ++offerIt;
-                continue;
-            }
-
             if (elysium_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
 
             // match found, execute trade now!
@@ -315,12 +344,12 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             if (elysium_debug_metadex1) PrintToLog("++ erased old: %s\n", offerIt->ToString());
             // erase the old seller element
-            pofferSet->erase(offerIt++);
+            offerIt = EraseOrder(*pofferSet, offerIt);
 
             // insert the updated one in place of the old
             if (0 < seller_replacement.getAmountRemaining()) {
                 PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
-                pofferSet->insert(seller_replacement);
+                metadexTxIndex[seller_replacement.getHash()] = pofferSet->insert(seller_replacement).first;
             }
 
             if (bBuyerSatisfied) {
@@ -329,9 +358,18 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             }
         } // specific price, check all properties
 
+        // drop the price level once all of its offers are filled
+        if (pofferSet->empty()) {
+            ppriceMap->erase(priceIt++);
+        } else {
+            ++priceIt;
+        }
+
         if (bBuyerSatisfied) break;
     } // check all prices
 
+    if (ppriceMap->empty()) metadex.erase(pairIt);
+
     PrintToLog("%s()=%d:%s\n", __FUNCTION__, NewReturn, getTradeReturnType(NewReturn));
 
     return NewReturn;
@@ -456,39 +494,41 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool elysium::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
-
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = NULL;
-
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
+    // Obtain the price level of the pair, both are created if they don't exist yet
+    md_PricesMap& prices = metadex[md_PropertyPair(objMetaDEx.getProperty(), objMetaDEx.getDesProperty())];
+    md_Set& indexes = prices[objMetaDEx.unitPrice()];
 
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
+    RecordMetaDExUndo(objMetaDEx.getHash());
 
-    // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
+    // Attempt to insert the metadex object into the set, the level is not empty if this fails
+    std::pair<md_Set::iterator, bool> ret = indexes.insert(objMetaDEx);
     if (false == ret.second) return false;
 
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
+    metadexTxIndex[objMetaDEx.getHash()] = ret.first;
 
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
+    return true;
+}
+
+bool elysium::MetaDEx_ERASE(const uint256& txid)
+{
+    std::map<uint256, md_Set::iterator>::iterator it = metadexTxIndex.find(txid);
+    if (it == metadexTxIndex.end()) return false;
 
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    metadex[objMetaDEx.getProperty()] = *p_prices;
+    const CMPMetaDEx& order = *it->second;
+    md_PropertiesMap::iterator pairIt = metadex.find(md_PropertyPair(order.getProperty(), order.getDesProperty()));
+    md_PricesMap::iterator priceIt = pairIt->second.find(order.unitPrice());
+    EraseOrder(priceIt->second, it->second);
+    PruneLevel(pairIt, priceIt);
 
     return true;
 }
 
+void elysium::MetaDEx_CLEAR()
+{
+    metadexTxIndex.clear();
+    metadex.clear();
+}
+
 // pretty much directly linked to the ADD TX21 command off the wire
 int elysium::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64_t amount, int block, uint32_t property_desired, int64_t amount_desired, const uint256& txid, unsigned int vgc)
 {
@@ -529,51 +569,52 @@ int elysium::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block, co
 {
     int rc = METADEX_ERROR -20;
     CMPMetaDEx mdex(sender_addr, 0, prop, amount, property_desired, amount_desired, uint256(), 0, CMPTransaction::CANCEL_AT_PRICE);
-    md_PricesMap* prices = get_Prices(prop);
+    md_PropertiesMap::iterator pairIt = metadex.find(md_PropertyPair(prop, property_desired));
     const CMPMetaDEx* p_mdex = NULL;
 
     if (elysium_debug_metadex1) PrintToLog("%s():%s\n", __FUNCTION__, mdex.ToString());
 
     if (elysium_debug_metadex2) MetaDEx_debug_print();
 
-    if (!prices) {
+    if (pairIt == metadex.end()) {
         PrintToLog("%s() NOTHING FOUND for %s\n", __FUNCTION__, mdex.ToString());
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        rational_t sellers_price = my_it->first;
-
-        if (mdex.unitPrice() != sellers_price) continue;
+    // within the pair only the price level of the cancelled offer is relevant
+    md_PricesMap::iterator my_it = pairIt->second.find(mdex.unitPrice());
+    if (my_it == pairIt->second.end()) {
+        return rc;
+    }
 
-        md_Set* indexes = &(my_it->second);
+    md_Set* indexes = &(my_it->second);
 
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
+    for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
+        p_mdex = &(*iitt);
 
-            if (elysium_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
+        if (elysium_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
+        if (p_mdex->getAddr() != sender_addr) {
+            ++iitt;
+            continue;
+        }
 
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
 
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
+        // move from reserve to main
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
 
-            // record the cancellation
-            bool bValid = true;
-            p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            indexes->erase(iitt++);
-        }
+        iitt = EraseOrder(*indexes, iitt);
     }
 
+    PruneLevel(pairIt, my_it);
+
     if (elysium_debug_metadex2) MetaDEx_debug_print();
 
     return rc;
@@ -582,20 +623,22 @@ int elysium::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block, co
 int elysium::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block, const std::string& sender_addr, uint32_t prop, uint32_t property_desired)
 {
     int rc = METADEX_ERROR -30;
-    md_PricesMap* prices = get_Prices(prop);
+    md_PropertiesMap::iterator pairIt = metadex.find(md_PropertyPair(prop, property_desired));
     const CMPMetaDEx* p_mdex = NULL;
 
     PrintToLog("%s(%d,%d)\n", __FUNCTION__, prop, property_desired);
 
     if (elysium_debug_metadex3) MetaDEx_debug_print();
 
-    if (!prices) {
+    if (pairIt == metadex.end()) {
         PrintToLog("%s() NOTHING FOUND\n", __FUNCTION__);
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
+    md_PricesMap& prices = pairIt->second;
+
+    // within the pair iterate over the items
+    for (md_PricesMap::iterator my_it = prices.begin(); my_it != prices.end();) {
         md_Set* indexes = &(my_it->second);
 
         for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
@@ -603,7 +646,7 @@ int elysium::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block
 
             if (elysium_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
+            if (p_mdex->getAddr() != sender_addr) {
                 ++iitt;
                 continue;
             }
@@ -619,15 +662,38 @@ int elysium::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block
             bool bValid = true;
             p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            indexes->erase(iitt++);
+            iitt = EraseOrder(*indexes, iitt);
+        }
+
+        if (indexes->empty()) {
+            prices.erase(my_it++);
+        } else {
+            ++my_it;
         }
     }
 
+    if (prices.empty()) metadex.erase(pairIt);
+
     if (elysium_debug_metadex3) MetaDEx_debug_print();
 
     return rc;
 }
 
+/**
+ * Orders cancelled for an address are processed in the order of the former
+ * single property order book: by property for sale, unit price, block and
+ * position in block, regardless of the desired property.
+ */
+struct MetaDEx_compare_cancel
+{
+    bool operator()(const CMPMetaDEx* lhs, const CMPMetaDEx* rhs) const
+    {
+        if (lhs->getProperty() != rhs->getProperty()) return lhs->getProperty() < rhs->getProperty();
+        if (lhs->unitPrice() != rhs->unitPrice()) return lhs->unitPrice() < rhs->unitPrice();
+        return MetaDEx_compare()(*lhs, *rhs);
+    }
+};
+
 /**
  * Scans the orderbook and remove everything for an address.
  */
@@ -641,44 +707,46 @@ int elysium::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block,
 
     PrintToLog("<<<<<<\n");
 
+    std::vector<const CMPMetaDEx*> vecCancel;
+
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        unsigned int prop = my_it->first;
+        unsigned int prop = my_it->first.first;
 
         // skip property, if it is not in the expected ecosystem
         if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
         if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
 
-        PrintToLog(" ## property: %u\n", prop);
         md_PricesMap& prices = my_it->second;
 
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
             md_Set& indexes = it->second;
 
-            PrintToLog("  # Price Level: %s\n", xToString(price));
+            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                if (it->getAddr() == sender_addr) vecCancel.push_back(&(*it));
+            }
+        }
+    }
 
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
+    std::sort(vecCancel.begin(), vecCancel.end(), MetaDEx_compare_cancel());
 
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
+    for (std::vector<const CMPMetaDEx*>::iterator it = vecCancel.begin(); it != vecCancel.end(); ++it) {
+        const CMPMetaDEx* p_mdex = *it;
 
-                rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
 
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+        // move from reserve to balance
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
 
-                // record the cancellation
-                bool bValid = true;
-                p_txlistdb->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-                indexes.erase(it++);
-            }
-        }
+        md_PropertiesMap::iterator pairIt = metadex.find(md_PropertyPair(p_mdex->getProperty(), p_mdex->getDesProperty()));
+        md_PricesMap::iterator priceIt = pairIt->second.find(p_mdex->unitPrice());
+        EraseOrder(priceIt->second, metadexTxIndex.find(p_mdex->getHash())->second);
+        PruneLevel(pairIt, priceIt);
     }
     PrintToLog(">>>>>>\n");
 
@@ -694,20 +762,24 @@ int elysium::MetaDEx_SHUTDOWN_ALLPAIR()
 {
     int rc = 0;
     PrintToLog("%s()\n", __FUNCTION__);
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end();) {
+        // no ELYSIUM/TELYSIUM side to the trade
+        if (my_it->first.first <= ELYSIUM_PROPERTY_TELYSIUM || my_it->first.second <= ELYSIUM_PROPERTY_TELYSIUM) {
+            ++my_it;
+            continue;
+        }
         md_PricesMap& prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set& indexes = it->second;
             for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                if (it->getDesProperty() > ELYSIUM_PROPERTY_TELYSIUM && it->getProperty() > ELYSIUM_PROPERTY_TELYSIUM) { // no ELYSIUM/TELYSIUM side to the trade
-                    PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
-                    // move from reserve to balance
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                    assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                    indexes.erase(it++);
-                }
+                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+                // move from reserve to balance
+                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
+                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                it = EraseOrder(indexes, it);
             }
         }
+        metadex.erase(my_it++);
     }
     return rc;
 }
@@ -723,15 +795,16 @@ int elysium::MetaDEx_SHUTDOWN()
         md_PricesMap& prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
             md_Set& indexes = it->second;
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
+            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
                 PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
                 // move from reserve to balance
                 assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                 assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-                indexes.erase(it++);
+                RecordMetaDExUndo(it->getHash());
             }
         }
     }
+    MetaDEx_CLEAR();
     return rc;
 }
 
@@ -739,18 +812,9 @@ int elysium::MetaDEx_SHUTDOWN()
 // allows search to be optimized if propertyIdForSale is specified
 bool elysium::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 {
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
-        md_PricesMap & prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set & indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                CMPMetaDEx obj = *it;
-                if( obj.getHash().GetHex() == txid.GetHex() ) return true;
-            }
-        }
-    }
-    return false;
+    std::map<uint256, md_Set::iterator>::const_iterator it = metadexTxIndex.find(txid);
+    if (it == metadexTxIndex.end()) return false;
+    return (propertyIdForSale == 0 || propertyIdForSale == it->second->getProperty());
 }
 
 /**
@@ -809,9 +873,10 @@ void elysium::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
 {
     PrintToLog("<<<\n");
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        uint32_t prop = my_it->first;
+        uint32_t prop = my_it->first.first;
+        uint32_t desprop = my_it->first.second;
 
-        PrintToLog(" ## property: %u\n", prop);
+        PrintToLog(" ## property: %u, desired: %u\n", prop, desprop);
         md_PricesMap& prices = my_it->second;
 
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
@@ -837,14 +902,7 @@ void elysium::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
  */
 const CMPMetaDEx* elysium::MetaDEx_RetrieveTrade(const uint256& txid)
 {
-    for (md_PropertiesMap::iterator propIter = metadex.begin(); propIter != metadex.end(); ++propIter) {
-        md_PricesMap & prices = propIter->second;
-        for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
-            md_Set & indexes = pricesIter->second;
-            for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
-                if (txid == (*tradesIter).getHash()) return &(*tradesIter);
-            }
-        }
-    }
+    std::map<uint256, md_Set::iterator>::const_iterator it = metadexTxIndex.find(txid);
+    if (it != metadexTxIndex.end()) return &(*it->second);
     return (CMPMetaDEx*) NULL;
 }
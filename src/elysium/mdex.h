@@ -18,6 +18,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 
 typedef boost::rational<boost::multiprecision::checked_int128_t> rational_t;
 
@@ -114,14 +115,15 @@ struct MetaDEx_compare
 typedef std::set<CMPMetaDEx, MetaDEx_compare> md_Set;
 //! Map of prices; there is a set of sorted objects for each price
 typedef std::map<rational_t, md_Set> md_PricesMap;
-//! Map of properties; there is a map of prices for each property
-typedef std::map<uint32_t, md_PricesMap> md_PropertiesMap;
+//! Pair of property for sale and property desired
+typedef std::pair<uint32_t, uint32_t> md_PropertyPair;
+//! Map of trading pairs; there is a map of prices for each pair
+typedef std::map<md_PropertyPair, md_PricesMap> md_PropertiesMap;
 
-//! Global map for price and order data
+//! Global map for price and order data, only to be modified by the MetaDEx_* functions
 extern md_PropertiesMap metadex;
 
-// TODO: explore a property-pair, instead of a single property as map's key........
-md_PricesMap* get_Prices(uint32_t prop);
+md_PricesMap* get_Prices(uint32_t prop, uint32_t desprop);
 md_Set* get_Indexes(md_PricesMap* p, rational_t price);
 // ---------------
 
@@ -132,6 +134,8 @@ int MetaDEx_CANCEL_EVERYTHING(const uint256& txid, uint32_t block, const std::st
 int MetaDEx_SHUTDOWN();
 int MetaDEx_SHUTDOWN_ALLPAIR();
 bool MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx);
+bool MetaDEx_ERASE(const uint256& txid);
+void MetaDEx_CLEAR();
 void MetaDEx_debug_print(bool bShowPriceLevel = false, bool bDisplay = false);
 bool MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale = 0);
 int MetaDEx_getStatus(const uint256& txid, uint32_t propertyIdForSale, int64_t amountForSale, int64_t totalSold = -1);
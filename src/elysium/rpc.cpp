@@ -28,6 +28,7 @@
 #include "tx.h"
 #include "utilsbitcoin.h"
 #include "version.h"
+#include "walletcache.h"
 #include "wallettxs.h"
 
 #ifdef ENABLE_WALLET
@@ -52,10 +53,12 @@
 
 #include <univalue.h>
 
+#include <algorithm>
 #include <map>
 #include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <inttypes.h>
 
@@ -865,20 +868,11 @@ UniValue elysium_getallbalancesforid(const UniValue& params, bool fHelp)
 
     LOCK(cs_main);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-        uint32_t id = 0;
-        bool includeAddress = false;
-        std::string address = it->first;
-        (it->second).init();
-        while (0 != (id = (it->second).next())) {
-            if (id == propertyId) {
-                includeAddress = true;
-                break;
-            }
-        }
-        if (!includeAddress) {
-            continue; // ignore this address, has never transacted in this propertyId
-        }
+    // only addresses, which have transacted in this propertyId
+    const HolderMap& holders = getHolders(propertyId);
+
+    for (HolderMap::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+        const std::string& address = it->first;
         UniValue balanceObj(UniValue::VOBJ);
         balanceObj.push_back(Pair("address", address));
         bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
@@ -1426,15 +1420,14 @@ UniValue elysium_getorderbook(const UniValue& params, bool fHelp)
     std::vector<CMPMetaDEx> vecMetaDexObjects;
     {
         LOCK(cs_main);
-        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        // the pairs selling the property are adjacent in the order book
+        md_PropertiesMap::const_iterator my_it = metadex.lower_bound(md_PropertyPair(propertyIdForSale, 0));
+        for (; my_it != metadex.end() && my_it->first.first == propertyIdForSale; ++my_it) {
+            if (filterDesired && my_it->first.second != propertyIdDesired) continue;
             const md_PricesMap& prices = my_it->second;
             for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
                 const md_Set& indexes = it->second;
-                for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                    const CMPMetaDEx& obj = *it;
-                    if (obj.getProperty() != propertyIdForSale) continue;
-                    if (!filterDesired || obj.getDesProperty() == propertyIdDesired) vecMetaDexObjects.push_back(obj);
-                }
+                vecMetaDexObjects.insert(vecMetaDexObjects.end(), indexes.begin(), indexes.end());
             }
         }
     }
@@ -1505,24 +1498,18 @@ UniValue elysium_gettradehistoryforaddress(const UniValue& params, bool fHelp)
         RequireExistingProperty(propertyId);
     }
 
-    // Obtain a sorted vector of txids for the address trade history
-    std::vector<uint256> vecTransactions;
-    {
-        LOCK(cs_main);
-        t_tradelistdb->getTradesForAddress(address, vecTransactions, propertyId);
-    }
-
-    // Populate the address trade history into JSON objects until we have processed count transactions
+    // Populate the address trade history into JSON objects, newest first, until we have processed count transactions
     UniValue response(UniValue::VARR);
-    uint32_t processed = 0;
-    for(std::vector<uint256>::reverse_iterator it = vecTransactions.rbegin(); it != vecTransactions.rend(); ++it) {
-        UniValue txobj(UniValue::VOBJ);
-        int populateResult = populateRPCTransactionObject(*it, txobj, "", true);
-        if (0 == populateResult) {
-            response.push_back(txobj);
-            processed++;
-            if (processed >= count) break;
-        }
+    if (count > 0) {
+        LOCK(cs_main);
+        t_tradelistdb->forEachTradeForAddress(address, propertyId, [&response, count](const uint256& txid) {
+            UniValue txobj(UniValue::VOBJ);
+            int populateResult = populateRPCTransactionObject(txid, txobj, "", true);
+            if (0 == populateResult) {
+                response.push_back(txobj);
+            }
+            return response.size() < count;
+        });
     }
 
     return response;
@@ -1721,30 +1708,22 @@ UniValue elysium_listblocktransactions(const UniValue& params, bool fHelp)
 
     RequireHeightInChain(blockHeight);
 
-    // next let's obtain the block for this height
-    CBlock block;
-    {
-        LOCK(cs_main);
-        CBlockIndex* pBlockIndex = chainActive[blockHeight];
-
-        if (!ReadBlockFromDisk(block, pBlockIndex, Params().GetConsensus())) {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to read block from disk");
-        }
-    }
-
     UniValue response(UniValue::VARR);
 
-    // now we want to loop through each of the transactions in the block and run against CMPTxList::exists
-    // those that return positive add to our response array
-
     LOCK(cs_main);
 
-    BOOST_FOREACH(const CTransaction&tx, block.vtx) {
-        if (p_txlistdb->exists(tx.GetHash())) {
-            // later we can add a verbose flag to decode here, but for now callers can send returned txids into gettransaction_MP
-            // add the txid into the response as it's an MP transaction
-            response.push_back(tx.GetHash().GetHex());
-        }
+    // the transactions of the block are taken from the block index of the transaction list,
+    // and ordered by their position in the block
+    std::vector<std::pair<uint32_t, uint256>> transactions;
+    std::vector<uint256> txids = p_txlistdb->getMPTransactionsBlock(blockHeight);
+    for (std::vector<uint256>::const_iterator it = txids.begin(); it != txids.end(); ++it) {
+        transactions.push_back(std::make_pair(p_ElysiumTXDB->FetchTransactionPosition(*it), *it));
+    }
+    std::sort(transactions.begin(), transactions.end());
+
+    for (std::vector<std::pair<uint32_t, uint256>>::const_iterator it = transactions.begin(); it != transactions.end(); ++it) {
+        // later we can add a verbose flag to decode here, but for now callers can send returned txids into gettransaction_MP
+        response.push_back(it->second.GetHex());
     }
 
     return response;
@@ -1841,31 +1820,21 @@ UniValue elysium_listtransactions(const UniValue& params, bool fHelp)
     if (params.size() > 4) nEndBlock = params[4].get_int64();
     if (nEndBlock < 0) throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative end block");
 
-    // obtain a sorted list of Elysium layer wallet transactions (including STO receipts and pending)
-    std::map<std::string,uint256> walletTransactions = FetchWalletElysiumTransactions(nFrom+nCount, nStartBlock, nEndBlock);
-
-    // reverse iterate over (now ordered) transactions and populate RPC objects for each one
+    // walk the Elysium layer wallet transactions (including STO receipts and pending), newest first,
+    // and stop as soon as enough of them matched the address filter
     UniValue response(UniValue::VARR);
-    for (std::map<std::string,uint256>::reverse_iterator it = walletTransactions.rbegin(); it != walletTransactions.rend(); it++) {
-        uint256 txHash = it->second;
+    WalletTxCursor cursor(nStartBlock, nEndBlock);
+    while (response.size() < static_cast<size_t>(nCount) && cursor.Next()) {
         UniValue txobj(UniValue::VOBJ);
-        int populateResult = populateRPCTransactionObject(txHash, txobj, addressParam);
-        if (0 == populateResult) response.push_back(txobj);
-    }
-
-    // TODO: reenable cutting!
-/*
-    // cut on nFrom and nCount
-    if (nFrom > (int)response.size()) nFrom = response.size();
-    if ((nFrom + nCount) > (int)response.size()) nCount = response.size() - nFrom;
-    UniValue::iterator first = response.begin();
-    std::advance(first, nFrom);
-    UniValue::iterator last = response.begin();
-    std::advance(last, nFrom+nCount);
-    if (last != response.end()) response.erase(last, response.end());
-    if (first != response.begin()) response.erase(response.begin(), first);
-    std::reverse(response.begin(), response.end());
-*/
+        int populateResult = populateRPCTransactionObject(cursor.GetTxid(), txobj, addressParam);
+        if (0 != populateResult) continue;
+        if (nFrom > 0) {
+            --nFrom;
+            continue;
+        }
+        response.push_back(txobj);
+    }
+
     return response;
 }
 
@@ -1972,6 +1941,63 @@ UniValue elysium_listpendingmints(const UniValue& params, bool fHelp)
 
     return SigmaMintsToJson(mints.begin(), mints.end());
 }
+
+UniValue elysium_getwalletbalancechanges(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "elysium_getwalletbalancechanges ( startblock )\n"
+            "\nReturns the token balances of wallet addresses, which changed at or after a given block.\n"
+            "\nArguments:\n"
+            "1. startblock           (number, optional) the first block to look for changes (default: 0)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"block\" : n,                  (number) the current block, to use as start block next time\n"
+            "  \"balances\" : [                (array of JSON objects) the changed balances, ordered by property and address\n"
+            "    {\n"
+            "      \"address\" : \"address\",      (string) the address\n"
+            "      \"propertyid\" : n,           (number) the property identifier\n"
+            "      \"balance\" : \"n.nnnnnnnn\",   (string) the available balance of the address\n"
+            "      \"reserved\" : \"n.nnnnnnnn\",  (string) the amount reserved by sell offers and accepts\n"
+            "      \"watchonly\" : true|false,   (boolean) whether the address is only watched\n"
+            "      \"block\" : n                 (number) the block, at which the balance last changed\n"
+            "    },\n"
+            "    ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("elysium_getwalletbalancechanges", "290000")
+            + HelpExampleRpc("elysium_getwalletbalancechanges", "290000")
+        );
+
+    int startHeight = 0;
+    if (params.size() > 0) {
+        startHeight = params[0].get_int();
+    }
+
+    std::map<uint32_t, WalletBalanceMap> changes = GetWalletBalanceChanges(startHeight);
+
+    UniValue balances(UniValue::VARR);
+    for (std::map<uint32_t, WalletBalanceMap>::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        uint32_t propertyId = it->first;
+        for (WalletBalanceMap::const_iterator balance = it->second.begin(); balance != it->second.end(); ++balance) {
+            UniValue balanceObj(UniValue::VOBJ);
+            balanceObj.push_back(Pair("address", balance->first));
+            balanceObj.push_back(Pair("propertyid", (uint64_t) propertyId));
+            balanceObj.push_back(Pair("balance", FormatMP(propertyId, balance->second.available)));
+            balanceObj.push_back(Pair("reserved", FormatMP(propertyId, balance->second.reserved)));
+            balanceObj.push_back(Pair("watchonly", balance->second.ismine != ISMINE_SPENDABLE));
+            balanceObj.push_back(Pair("block", balance->second.block));
+            balances.push_back(balanceObj);
+        }
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.push_back(Pair("block", GetHeight()));
+    response.push_back(Pair("balances", balances));
+
+    return response;
+}
 #endif
 
 UniValue elysium_listpendingtransactions(const UniValue& params, bool fHelp)
@@ -2431,6 +2457,7 @@ static const CRPCCommand commands[] =
     { "elysium (data retrieval)", "elysium_listtransactions",          &elysium_listtransactions,           false },
     { "elysium (data retrieval)", "elysium_listmints",                 &elysium_listmints,                  false },
     { "elysium (data retrieval)", "elysium_listpendingmints",          &elysium_listpendingmints,           false },
+    { "elysium (data retrieval)", "elysium_getwalletbalancechanges",   &elysium_getwalletbalancechanges,    false },
     { "elysium (data retrieval)", "elysium_getfeeshare",               &elysium_getfeeshare,                false },
     { "elysium (configuration)",  "elysium_setautocommit",             &elysium_setautocommit,              true  },
 #endif
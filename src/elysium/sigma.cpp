@@ -3,12 +3,6 @@
 #include "sigmadb.h"
 #include "sigmaprimitives.h"
 
-#include "../main.h"
-#include "../sync.h"
-
-#include <iterator>
-#include <vector>
-
 namespace elysium {
 
 bool VerifySigmaSpend(
@@ -20,19 +14,15 @@ bool VerifySigmaSpend(
     const secp_primitives::Scalar& serial,
     bool fPadding)
 {
-    std::vector<SigmaPublicKey> anonimitySet; // Don't preallocate the vector due to it will allow attacker to crash all client.
-
-    {
-        LOCK(cs_main);
-        sigmaDb->GetAnonimityGroup(property, denomination, group, groupSize, std::back_inserter(anonimitySet));
-    }
+    // The cached group is never copied, so a large groupSize can't make us allocate.
+    auto anonimitySet = sigmaDb->GetCachedAnonimityGroup(property, denomination, group);
 
     // If the size of anonimity set is not the expected once then no need to verify the proof.
-    if (anonimitySet.size() != groupSize) {
+    if (anonimitySet.size() < groupSize) {
         return false;
     }
 
-    return proof.Verify(serial, anonimitySet.begin(), anonimitySet.end(), fPadding);
+    return proof.Verify(serial, anonimitySet.begin(), anonimitySet.begin() + groupSize, fPadding);
 }
 
 } // namespace elysium
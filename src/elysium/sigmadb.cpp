@@ -16,6 +16,11 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -291,6 +296,7 @@ std::pair<SigmaMintGroup, SigmaMintIndex> SigmaDatabase::RecordMint(
     pubKey.commitment.serialize(buffer.data());
 
     AddEntry(key, GetSlice(buffer), height);
+    CacheMint(propertyId, denomination, lastGroup, nextIdx, pubKey);
 
     // Raise event.
     MintAdded(propertyId, denomination, lastGroup, nextIdx, pubKey, height);
@@ -368,6 +374,7 @@ void SigmaDatabase::DeleteAll(int startBlock)
 
     leveldb::WriteBatch batch;
     std::vector<std::function<void()>> defers; // functions to be called after delete whole keys
+    std::map<GroupKey, SigmaMintIndex> firstRemoved; // cached groups are truncated at these
     for (; it->Valid() && IsSequenceEntry(it.get()); it->Prev()) {
 
         CDataStream deserialized(
@@ -414,6 +421,9 @@ void SigmaDatabase::DeleteAll(int startBlock)
                 MintRemoved(propertyId, denomination, pub);
             });
 
+            auto removed = firstRemoved.emplace(GroupKey(propertyId, denomination, groupId), count);
+            removed.first->second = std::min(removed.first->second, count);
+
             batch.Delete(GetSlice(entry.data));
         } else if (entry.op == OpCode::StoreSpendSerial) {
             auto key = GetSlice(entry.data);
@@ -445,11 +455,21 @@ void SigmaDatabase::DeleteAll(int startBlock)
         throw std::runtime_error("Fail to update database");
     }
 
+    UncacheMints(firstRemoved);
+
     for (auto &defer : defers) {
         defer();
     }
 }
 
+void SigmaDatabase::Clear()
+{
+    CDBBase::Clear();
+
+    std::lock_guard<std::mutex> lock(cachedGroupsMutex);
+    cachedGroups.clear();
+}
+
 void SigmaDatabase::RecordGroupSize(uint16_t groupSize)
 {
     auto key = CreateGroupSizeKey();
@@ -553,6 +573,72 @@ size_t SigmaDatabase::GetAnonimityGroup(
     return i;
 }
 
+SigmaAnonimityGroup SigmaDatabase::GetCachedAnonimityGroup(
+    PropertyId propertyId, SigmaDenomination denomination, SigmaMintGroup groupId)
+{
+    std::lock_guard<std::mutex> lock(cachedGroupsMutex);
+
+    GroupKey key(propertyId, denomination, groupId);
+    auto it = cachedGroups.find(key);
+    if (it == cachedGroups.end()) {
+        // Loaded while holding the lock, so mints recorded meanwhile are applied after.
+        auto coins = std::make_shared<std::vector<SigmaPublicKey>>();
+        auto mintCount = GetMintCount(propertyId, denomination, groupId);
+        coins->reserve(mintCount);
+        GetAnonimityGroup(propertyId, denomination, groupId, mintCount, std::back_inserter(*coins));
+        it = cachedGroups.emplace(key, std::move(coins)).first;
+    }
+
+    return SigmaAnonimityGroup(it->second, it->second->size());
+}
+
+void SigmaDatabase::CacheMint(
+    PropertyId propertyId, SigmaDenomination denomination, SigmaMintGroup groupId, SigmaMintIndex index,
+    const SigmaPublicKey& pubKey)
+{
+    std::lock_guard<std::mutex> lock(cachedGroupsMutex);
+
+    auto it = cachedGroups.find(GroupKey(propertyId, denomination, groupId));
+    if (it == cachedGroups.end()) {
+        return;
+    }
+
+    auto& coins = it->second;
+    if (coins->size() > index) {
+        return; // loaded after the mint was written
+    }
+
+    if (coins->size() < index) {
+        cachedGroups.erase(it); // should not happen, read it again on next use
+        return;
+    }
+
+    if (coins->size() == coins->capacity()) {
+        auto grown = std::make_shared<std::vector<SigmaPublicKey>>();
+        grown->reserve(std::max<size_t>(2 * coins->capacity(), 16));
+        grown->insert(grown->end(), coins->begin(), coins->end());
+        coins = std::move(grown);
+    }
+
+    coins->push_back(pubKey);
+}
+
+void SigmaDatabase::UncacheMints(const std::map<GroupKey, SigmaMintIndex>& firstRemoved)
+{
+    std::lock_guard<std::mutex> lock(cachedGroupsMutex);
+
+    for (auto& removed : firstRemoved) {
+        auto it = cachedGroups.find(removed.first);
+        if (it == cachedGroups.end() || it->second->size() <= removed.second) {
+            continue;
+        }
+
+        // replace rather than truncate, the removed coins may still be in use
+        it->second = std::make_shared<std::vector<SigmaPublicKey>>(
+            it->second->begin(), it->second->begin() + removed.second);
+    }
+}
+
 uint32_t SigmaDatabase::GetLastGroupId(
     uint32_t propertyId,
     uint8_t denomination)
@@ -15,7 +15,11 @@
 
 #include <leveldb/slice.h>
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <inttypes.h>
@@ -34,6 +38,33 @@ struct is_iterator<T, typename std::enable_if<!std::is_same<typename std::iterat
 
 namespace elysium {
 
+/**
+ * Coins of an anonimity group, as they were when the group was taken from the
+ * cache of SigmaDatabase. It isn't changed by mints added or removed later.
+ */
+class SigmaAnonimityGroup
+{
+public:
+    SigmaAnonimityGroup() : first(nullptr), count(0)
+    {
+    }
+
+    SigmaAnonimityGroup(std::shared_ptr<const std::vector<SigmaPublicKey>> coins, size_t count) :
+        coins(std::move(coins)), first(this->coins->data()), count(count)
+    {
+    }
+
+    const SigmaPublicKey* begin() const { return first; }
+    const SigmaPublicKey* end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    std::shared_ptr<const std::vector<SigmaPublicKey>> coins;
+    const SigmaPublicKey* first;
+    size_t count;
+};
+
 class SigmaDatabase : public CDBBase
 {
 public:
@@ -84,7 +115,15 @@ public:
         return firstIt;
     }
 
+    /**
+     * Returns the coins of an anonimity group from memory. Groups are read from
+     * the database on first use, and then follow RecordMint() and DeleteAll(),
+     * so this doesn't need cs_main.
+     */
+    SigmaAnonimityGroup GetCachedAnonimityGroup(PropertyId propertyId, SigmaDenomination denomination, SigmaMintGroup groupId);
+
     void DeleteAll(int startBlock);
+    void Clear() override;
 
     uint32_t GetLastGroupId(uint32_t propertyId, uint8_t denomination);
     size_t GetMintCount(uint32_t propertyId, uint8_t denomination, uint32_t groupId);
@@ -105,6 +144,11 @@ protected:
     void AddEntry(const leveldb::Slice& key, const leveldb::Slice& value, int block);
 
 private:
+    typedef std::tuple<PropertyId, SigmaDenomination, SigmaMintGroup> GroupKey;
+
+    void CacheMint(PropertyId propertyId, SigmaDenomination denomination, SigmaMintGroup groupId, SigmaMintIndex index, const SigmaPublicKey& pubKey);
+    void UncacheMints(const std::map<GroupKey, SigmaMintIndex>& firstRemoved);
+
     void RecordGroupSize(uint16_t groupSize);
 
     std::unique_ptr<leveldb::Iterator> NewIterator() const;
@@ -112,6 +156,12 @@ private:
 protected:
     uint16_t InitGroupSize(uint16_t groupSize);
     uint16_t GetGroupSize();
+
+private:
+    // Coins are only appended in place while the vector has capacity left, otherwise the vector
+    // is replaced, so coins handed out in a SigmaAnonimityGroup are never moved or changed.
+    std::map<GroupKey, std::shared_ptr<std::vector<SigmaPublicKey>>> cachedGroups;
+    std::mutex cachedGroupsMutex;
 };
 
 extern SigmaDatabase *sigmaDb;
@@ -4,6 +4,7 @@
 #include "elysium.h"
 #include "packetencoder.h"
 #include "uint256_extensions.h"
+#include "undo.h"
 #include "utilsbitcoin.h"
 
 #include "../arith_uint256.h"
@@ -49,6 +50,20 @@ bool CMPSPInfo::Entry::isDivisible() const
     return false;
 }
 
+CMPSPInfo::Traits::Traits(const Entry& info)
+  : prop_type(info.prop_type), fixed(info.fixed), manual(info.manual), name(info.name) {}
+
+bool CMPSPInfo::Traits::isDivisible() const
+{
+    switch (prop_type) {
+        case ELYSIUM_PROPERTY_TYPE_DIVISIBLE:
+        case ELYSIUM_PROPERTY_TYPE_DIVISIBLE_REPLACING:
+        case ELYSIUM_PROPERTY_TYPE_DIVISIBLE_APPENDING:
+            return true;
+    }
+    return false;
+}
+
 void CMPSPInfo::Entry::print() const
 {
     PrintToLog("%s:%s(Fixed=%s,Divisible=%s):%d:%s/%s, %s %s\n",
@@ -93,10 +108,50 @@ CMPSPInfo::~CMPSPInfo()
 
 void CMPSPInfo::Clear()
 {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
     // wipe database via parent class
     CDBBase::Clear();
     // reset "next property identifiers"
     init();
+    // and forget the entries read from it
+    uncacheAll();
+}
+
+void CMPSPInfo::cacheEntry(uint32_t propertyId, const Entry& info) const
+{
+    auto it = cachedEntries.find(propertyId);
+    if (it != cachedEntries.end()) {
+        it->second.first = info;
+        cachedOrder.splice(cachedOrder.begin(), cachedOrder, it->second.second);
+        return;
+    }
+
+    // drop the least recently used entry
+    if (cachedEntries.size() >= MAX_CACHED_SP_ENTRIES) {
+        cachedEntries.erase(cachedOrder.back());
+        cachedOrder.pop_back();
+    }
+
+    cachedOrder.push_front(propertyId);
+    cachedEntries.emplace(propertyId, std::make_pair(info, cachedOrder.begin()));
+}
+
+void CMPSPInfo::uncacheEntry(uint32_t propertyId)
+{
+    auto it = cachedEntries.find(propertyId);
+    if (it != cachedEntries.end()) {
+        cachedOrder.erase(it->second.second);
+        cachedEntries.erase(it);
+    }
+    cachedTraits.erase(propertyId);
+}
+
+void CMPSPInfo::uncacheAll()
+{
+    cachedOrder.clear();
+    cachedEntries.clear();
+    cachedTraits.clear();
 }
 
 void CMPSPInfo::init(uint32_t nextSPID, uint32_t nextTestSPID)
@@ -148,6 +203,8 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
     ssSpPrevKey << propertyId;
     leveldb::Slice slSpPrevKey(&ssSpPrevKey[0], ssSpPrevKey.size());
 
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
     leveldb::WriteBatch batch;
     std::string strSpPrevValue;
 
@@ -160,9 +217,12 @@ bool CMPSPInfo::updateSP(uint32_t propertyId, const Entry& info)
 
     if (!status.ok()) {
         PrintToLog("%s(): ERROR for SP %d: %s\n", __func__, propertyId, status.ToString());
+        uncacheEntry(propertyId); // the write may have partially succeeded
         return false;
     }
 
+    cacheEntry(propertyId, info);
+
     PrintToLog("%s(): updated entry for SP %d successfully\n", __func__, propertyId);
     return true;
 }
@@ -218,6 +278,11 @@ uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
     batch.Put(slSpKey, slSpValue);
     batch.Put(slTxIndexKey, slTxValue);
 
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    // an identifier may be used again, e.g. for non-standard ecosystems or after a reorg
+    uncacheEntry(propertyId);
+
     leveldb::Status status = pdb->Write(syncoptions, &batch);
 
     if (!status.ok()) {
@@ -228,6 +293,33 @@ uint32_t CMPSPInfo::putSP(uint8_t ecosystem, const Entry& info)
 }
 
 bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    return readSP(propertyId, info);
+}
+
+std::shared_ptr<const CMPSPInfo::Traits> CMPSPInfo::getTraits(uint32_t propertyId) const
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = cachedTraits.find(propertyId);
+    if (it != cachedTraits.end()) {
+        return it->second;
+    }
+
+    Entry info;
+    if (!readSP(propertyId, info)) {
+        return nullptr;
+    }
+
+    auto traits = std::make_shared<const Traits>(info);
+    cachedTraits.emplace(propertyId, traits);
+
+    return traits;
+}
+
+bool CMPSPInfo::readSP(uint32_t propertyId, Entry& info) const
 {
     // special cases for constant SPs ELYSIUM and TELYSIUM
     if (ELYSIUM_PROPERTY_ELYSIUM == propertyId) {
@@ -238,6 +330,13 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
         return true;
     }
 
+    auto it = cachedEntries.find(propertyId);
+    if (it != cachedEntries.end()) {
+        cachedOrder.splice(cachedOrder.begin(), cachedOrder, it->second.second);
+        info = it->second.first;
+        return true;
+    }
+
     // DB key for property entry
     CDataStream ssSpKey(SER_DISK, CLIENT_VERSION);
     ssSpKey << std::make_pair('s', propertyId);
@@ -261,6 +360,8 @@ bool CMPSPInfo::getSP(uint32_t propertyId, Entry& info) const
         return false;
     }
 
+    cacheEntry(propertyId, info);
+
     return true;
 }
 
@@ -271,6 +372,13 @@ bool CMPSPInfo::hasSP(uint32_t propertyId) const
         return true;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        if (cachedEntries.count(propertyId) || cachedTraits.count(propertyId)) {
+            return true;
+        }
+    }
+
     // DB key for property entry
     CDataStream ssSpKey(SER_DISK, CLIENT_VERSION);
     ssSpKey << std::make_pair('s', propertyId);
@@ -380,6 +488,11 @@ int64_t CMPSPInfo::popBlock(const uint256& block_hash)
     // clean up the iterator
     delete iter;
 
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    // entries of the block are rolled back, and properties created in it are gone
+    uncacheAll();
+
     leveldb::Status status = pdb->Write(syncoptions, &commitBatch);
 
     if (!status.ok()) {
@@ -710,18 +823,17 @@ std::string std::to_string(SigmaStatus status)
 
 bool elysium::isPropertyDivisible(uint32_t propertyId)
 {
-    // TODO: is a lock here needed
-    CMPSPInfo::Entry sp;
+    std::shared_ptr<const CMPSPInfo::Traits> traits = _my_sps->getTraits(propertyId);
 
-    if (_my_sps->getSP(propertyId, sp)) return sp.isDivisible();
+    if (traits) return traits->isDivisible();
 
     return true;
 }
 
 std::string elysium::getPropertyName(uint32_t propertyId)
 {
-    CMPSPInfo::Entry sp;
-    if (_my_sps->getSP(propertyId, sp)) return sp.name;
+    std::shared_ptr<const CMPSPInfo::Traits> traits = _my_sps->getTraits(propertyId);
+    if (traits) return traits->name;
     return "Property Name Not Found";
 }
 
@@ -949,6 +1061,7 @@ void elysium::eraseMaxedCrowdsale(const std::string& address, int64_t blockTime,
         assert(_my_sps->updateSP(crowdsale.getPropertyId(), sp));
 
         // no calculate fractional calls here, no more tokens (at MAX)
+        RecordCrowdsaleUndo(address);
         my_crowds.erase(it);
     }
 }
@@ -995,6 +1108,7 @@ unsigned int elysium::eraseExpiredCrowdsale(const CBlockIndex* pBlockIndex)
                 assert(update_tally_map(sp.issuer, crowdsale.getPropertyId(), missedTokens, BALANCE));
             }
 
+            RecordCrowdsaleUndo(address);
             my_crowds.erase(my_it++);
 
             ++how_many_erased;
@@ -16,8 +16,12 @@
 #include <fstream>
 #include <ios>
 #include <limits>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -29,6 +33,9 @@ namespace elysium {
 
 constexpr size_t MAX_DENOMINATIONS = std::numeric_limits<uint8_t>::max();
 
+//! Number of decoded property entries CMPSPInfo keeps in memory
+constexpr size_t MAX_CACHED_SP_ENTRIES = 1000;
+
 } // namespace elysium
 
 /** LevelDB based storage for currencies, smart properties and tokens.
@@ -161,6 +168,18 @@ public:
         void print() const;
     };
 
+    /** Fields of a property, which don't change after it was created. */
+    struct Traits {
+        uint16_t prop_type;
+        bool fixed;
+        bool manual;
+        std::string name;
+
+        explicit Traits(const Entry& info);
+
+        bool isDivisible() const;
+    };
+
 private:
     // implied version of ELYSIUM and TELYSIUM so they don't hit the leveldb
     Entry implied_elysium;
@@ -169,6 +188,19 @@ private:
     uint32_t next_spid;
     uint32_t next_test_spid;
 
+    // decoded entries of the most recently used properties, most recent first
+    mutable std::list<uint32_t> cachedOrder;
+    mutable std::unordered_map<uint32_t, std::pair<Entry, std::list<uint32_t>::iterator>> cachedEntries;
+    // traits of all properties looked up so far, only dropped when a property is removed
+    mutable std::unordered_map<uint32_t, std::shared_ptr<const Traits>> cachedTraits;
+    mutable std::mutex cacheMutex;
+
+    // the following require cacheMutex to be held
+    bool readSP(uint32_t propertyId, Entry& info) const;
+    void cacheEntry(uint32_t propertyId, const Entry& info) const;
+    void uncacheEntry(uint32_t propertyId);
+    void uncacheAll();
+
 public:
     CMPSPInfo(const boost::filesystem::path& path, bool fWipe);
     virtual ~CMPSPInfo();
@@ -183,6 +215,14 @@ public:
     uint32_t putSP(uint8_t ecosystem, const Entry& info);
     bool getSP(uint32_t propertyId, Entry& info) const;
     bool hasSP(uint32_t propertyId) const;
+
+    /**
+     * Returns the traits of a property, or nullptr, if it doesn't exist.
+     *
+     * Unlike getSP(), this doesn't copy the entry, and after the first lookup only
+     * reads from memory, so it's meant for checks like divisibility or names.
+     */
+    std::shared_ptr<const Traits> getTraits(uint32_t propertyId) const;
     uint32_t findSPByTX(const uint256& txid) const;
 
     int64_t popBlock(const uint256& block_hash);
@@ -41,17 +41,11 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
 
     {
         LOCK(cs_main);
-        std::unordered_map<std::string, CMPTally>::iterator it;
+        const HolderMap& holders = getHolders(property);
 
-        for (it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+        for (HolderMap::const_iterator it = holders.begin(); it != holders.end(); ++it) {
             const std::string& address = it->first;
-            const CMPTally& tally = it->second;
-
-            int64_t tokens = 0;
-            tokens += tally.getMoney(property, BALANCE);
-            tokens += tally.getMoney(property, SELLOFFER_RESERVE);
-            tokens += tally.getMoney(property, ACCEPT_RESERVE);
-            tokens += tally.getMoney(property, METADEX_RESERVE);
+            const int64_t tokens = it->second;
 
             // Do not include the sender
             if (address == sender) {
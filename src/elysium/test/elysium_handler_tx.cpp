@@ -195,4 +195,35 @@ BOOST_AUTO_TEST_CASE(elysium_parse_sigma_tx_with_spend)
     BOOST_CHECK_EQUAL(0, ParseTransaction(sigmaTx, chainActive.Height(), 1, mp_obj, block.GetBlockTime()));
 }
 
+BOOST_AUTO_TEST_CASE(elysium_connect_block_records_height)
+{
+    mapArgs["-elysium"] = "1";
+    elysium_init();
+
+    pwalletMain->SetBroadcastTransactions(true);
+    std::string fromAddress = CBitcoinAddress(pubkey.GetID()).ToString();
+
+    std::vector<unsigned char> payload = CreatePayload_IssuanceFixed(
+        2, 1, 0, "Companies", "", "connected", "", "", 1
+    );
+
+    uint256 txid;
+    std::string rawHex;
+    BOOST_CHECK_EQUAL(
+        0, // No error
+        elysium::WalletTxBuilder(fromAddress, "", "", 0, payload, txid, rawHex, true)
+    );
+
+    CreateAndProcessBlock({}, scriptPubKey);
+    BOOST_CHECK_EQUAL(2, getHeighestBlock().vtx.size());
+
+    // the transaction was prepared before the tip moved, it still has to be recorded at the new height
+    BOOST_CHECK(elysium::p_txlistdb->exists(txid));
+    int block = -1;
+    elysium::getValidMPTX(txid, &block);
+    BOOST_CHECK_EQUAL(chainActive.Height(), block);
+
+    mapArgs.erase("-elysium");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include "elysium/fees.h"
+
+#include "elysium/elysium.h"
+#include "elysium/rules.h"
+#include "elysium/sp.h"
+#include "elysium/tally.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+
+#include <stdint.h>
+
+using namespace elysium;
+
+BOOST_FIXTURE_TEST_SUITE(elysium_fees_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(fee_cache_rollback)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    p_feecache = new CElysiumFeeCache(pathTemp / "MP_feecache_test", true);
+    p_feehistory = new CElysiumFeeHistory(pathTemp / "MP_feehistory_test", true);
+    clear_tally_map();
+
+    CMPSPInfo::Entry sp;
+    uint32_t property = _my_sps->putSP(ELYSIUM_PROPERTY_ELYSIUM, sp);
+    BOOST_CHECK(update_tally_map("bob", property, 100000000, BALANCE));
+    p_feecache->UpdateDistributionThresholds(property);
+    BOOST_CHECK_EQUAL(p_feecache->GetDistributionThreshold(property), 100000000 / ELYSIUM_FEE_THRESHOLD);
+
+    p_feecache->AddFee(property, 100, 200);
+    p_feecache->AddFee(property, 100, 100);
+    p_feecache->AddFee(property, 101, 50);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 350);
+    BOOST_CHECK(p_feecache->GetCacheHistory(property) == std::set<feeCacheItem>({{100, 300}, {101, 350}}));
+    BOOST_CHECK_EQUAL(getTotalTokens(property), 100000350);
+
+    p_feecache->RollBackCache(101);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 300);
+
+    // the entry is read back from the database
+    delete p_feecache;
+    p_feecache = new CElysiumFeeCache(pathTemp / "MP_feecache_test", false);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 300);
+    BOOST_CHECK(p_feecache->GetCacheHistory(property) == std::set<feeCacheItem>({{100, 300}}));
+
+    // changes older than MAX_STATE_HISTORY blocks are pruned, but still count
+    p_feecache->AddFee(property, 100 + MAX_STATE_HISTORY + 1, 10);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 310);
+    BOOST_CHECK_EQUAL(p_feecache->GetCacheHistory(property).size(), 1U);
+
+    p_feecache->RollBackCache(100 + MAX_STATE_HISTORY + 1);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 300);
+
+    p_feecache->Clear();
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 0);
+}
+
+BOOST_AUTO_TEST_CASE(fee_distribution)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    p_feecache = new CElysiumFeeCache(pathTemp / "MP_feecache_test", true);
+    p_feehistory = new CElysiumFeeHistory(pathTemp / "MP_feehistory_test", true);
+    clear_tally_map();
+
+    CMPSPInfo::Entry sp;
+    uint32_t property = _my_sps->putSP(ELYSIUM_PROPERTY_ELYSIUM, sp);
+    BOOST_CHECK(update_tally_map("bob", property, 100000000, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", ELYSIUM_PROPERTY_ELYSIUM, 300, BALANCE));
+    BOOST_CHECK(update_tally_map("carol", ELYSIUM_PROPERTY_ELYSIUM, 100, BALANCE));
+    p_feecache->UpdateDistributionThresholds(property);
+
+    // reaching the threshold distributes the cache to the holders of ELYSIUM
+    p_feecache->AddFee(property, 100, 600);
+    p_feecache->AddFee(property, 101, 400);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 0);
+    BOOST_CHECK_EQUAL(getMPbalance("alice", property, BALANCE), 750);
+    BOOST_CHECK_EQUAL(getMPbalance("carol", property, BALANCE), 250);
+    BOOST_CHECK_EQUAL(p_feehistory->CountRecords(), 1);
+    BOOST_CHECK(p_feehistory->GetDistributionsForProperty(property) == std::set<int>({1}));
+
+    uint32_t distributedProperty = 0;
+    int block = 0;
+    int64_t total = 0;
+    BOOST_CHECK(p_feehistory->GetDistributionData(1, &distributedProperty, &block, &total));
+    BOOST_CHECK_EQUAL(distributedProperty, property);
+    BOOST_CHECK_EQUAL(block, 101);
+    BOOST_CHECK_EQUAL(total, 1000);
+
+    // the fee and the distribution of block 101 are rolled back together
+    p_feecache->RollBackCache(101);
+    p_feehistory->RollBackHistory(101);
+    BOOST_CHECK_EQUAL(p_feecache->GetCachedAmount(property), 600);
+    BOOST_CHECK_EQUAL(p_feehistory->CountRecords(), 0);
+
+    p_feecache->AddFee(property, 101, 400);
+    BOOST_CHECK_EQUAL(p_feehistory->CountRecords(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
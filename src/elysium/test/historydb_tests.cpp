@@ -0,0 +1,235 @@
+#include "elysium/elysium.h"
+#include "elysium/fetchwallettx.h"
+#include "elysium/sp.h"
+#include "elysium/tx.h"
+
+#include "arith_uint256.h"
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "leveldb/db.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace elysium;
+
+namespace {
+
+const uint32_t PROPERTY_A = 1;
+const uint32_t PROPERTY_B = 3;
+const uint32_t PROPERTY_C = 4;
+
+uint256 Txid(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(elysium_historydb_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(trade_indexes)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    t_tradelistdb = new CMPTradeList(pathTemp / "MP_tradelist_test", true);
+
+    t_tradelistdb->recordNewTrade(Txid(3), "alice", PROPERTY_A, PROPERTY_B, 101, 2);
+    t_tradelistdb->recordNewTrade(Txid(1), "alice", PROPERTY_A, PROPERTY_B, 100, 7);
+    t_tradelistdb->recordNewTrade(Txid(2), "bob", PROPERTY_B, PROPERTY_A, 100, 8);
+    t_tradelistdb->recordNewTrade(Txid(4), "alice", PROPERTY_C, PROPERTY_A, 101, 1);
+    t_tradelistdb->recordNewTrade(Txid(5), "alicea", PROPERTY_C, PROPERTY_A, 101, 3);
+    t_tradelistdb->recordMatchedTrade(Txid(2), Txid(1), "bob", "alice", PROPERTY_B, PROPERTY_A, 500, 50, 100, 0);
+    t_tradelistdb->recordMatchedTrade(Txid(3), Txid(2), "alice", "bob", PROPERTY_A, PROPERTY_B, 10, 100, 101, 0);
+    t_tradelistdb->recordMatchedTrade(Txid(5), Txid(4), "alicea", "alice", PROPERTY_C, PROPERTY_A, 10, 1, 101, 0);
+
+    // by block, then by position in block, and exact addresses only
+    std::vector<uint256> trades;
+    t_tradelistdb->getTradesForAddress("alice", trades);
+    BOOST_CHECK(trades == std::vector<uint256>({Txid(1), Txid(4), Txid(3)}));
+
+    trades.clear();
+    t_tradelistdb->getTradesForAddress("alice", trades, PROPERTY_C);
+    BOOST_CHECK(trades == std::vector<uint256>({Txid(4)}));
+
+    // newest first, until the callback stops
+    trades.clear();
+    t_tradelistdb->forEachTradeForAddress("alice", 0, [&trades](const uint256& txid) {
+        trades.push_back(txid);
+        return trades.size() < 2;
+    });
+    BOOST_CHECK(trades == std::vector<uint256>({Txid(3), Txid(4)}));
+
+    UniValue pair(UniValue::VARR);
+    t_tradelistdb->getTradesForPair(PROPERTY_A, PROPERTY_B, pair, 10);
+    BOOST_CHECK_EQUAL(pair.size(), 2);
+
+    UniValue matches(UniValue::VARR);
+    int64_t totalSold = 0, totalBought = 0;
+    BOOST_CHECK(t_tradelistdb->getMatchingTrades(Txid(2), PROPERTY_B, matches, totalSold, totalBought));
+    BOOST_CHECK_EQUAL(matches.size(), 2);
+    BOOST_CHECK_EQUAL(totalSold, 500 + 100);
+    BOOST_CHECK_EQUAL(totalBought, 50 + 10);
+
+    // three trades and two matches from block 101 on
+    BOOST_CHECK_EQUAL(t_tradelistdb->deleteAboveBlock(101), 5);
+    BOOST_CHECK_EQUAL(t_tradelistdb->getMPTradeCountTotal(), 3);
+
+    trades.clear();
+    t_tradelistdb->getTradesForAddress("alice", trades);
+    BOOST_CHECK(trades == std::vector<uint256>({Txid(1)}));
+
+    matches = UniValue(UniValue::VARR);
+    BOOST_CHECK(t_tradelistdb->getMatchingTrades(Txid(2), PROPERTY_B, matches, totalSold, totalBought));
+    BOOST_CHECK_EQUAL(matches.size(), 1);
+
+    pair = UniValue(UniValue::VARR);
+    t_tradelistdb->getTradesForPair(PROPERTY_C, PROPERTY_A, pair, 10);
+    BOOST_CHECK_EQUAL(pair.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(sto_indexes)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    s_stolistdb = new CMPSTOList(pathTemp / "MP_stolist_test", true);
+
+    s_stolistdb->recordSTOReceive("alice", Txid(1), 100, PROPERTY_B, 10);
+    s_stolistdb->recordSTOReceive("bob", Txid(1), 100, PROPERTY_B, 20);
+    s_stolistdb->recordSTOReceive("alice", Txid(2), 101, PROPERTY_B, 30);
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0, numRecipients = 0;
+    s_stolistdb->getRecipients(Txid(1), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2);
+    BOOST_CHECK_EQUAL(recipients.size(), 2);
+    BOOST_CHECK_EQUAL(total, 30);
+
+    // filtered recipients still count for the fee
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    s_stolistdb->getRecipients(Txid(1), "bob", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2);
+    BOOST_CHECK_EQUAL(recipients.size(), 1);
+    BOOST_CHECK_EQUAL(total, 20);
+
+    BOOST_CHECK_EQUAL(s_stolistdb->deleteAboveBlock(101), 1);
+
+    recipients = UniValue(UniValue::VARR);
+    total = 0;
+    s_stolistdb->getRecipients(Txid(2), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 0);
+
+    recipients = UniValue(UniValue::VARR);
+    s_stolistdb->getRecipients(Txid(1), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 2);
+}
+
+BOOST_AUTO_TEST_CASE(txlist_block_index)
+{
+    p_txlistdb = new CMPTxList(pathTemp / "MP_txlist_test", true);
+
+    p_txlistdb->recordTX(Txid(1), true, 100, ELYSIUM_TYPE_SIMPLE_SEND, 1);
+    p_txlistdb->recordTX(Txid(2), true, 101, ELYSIUM_TYPE_SEND_ALL, 0);
+    p_txlistdb->recordSendAllSubRecord(Txid(2), 101, 1, PROPERTY_B, 100);
+    p_txlistdb->recordTX(Txid(3), false, 102, ELYSIUM_TYPE_SIMPLE_SEND, 1);
+
+    BOOST_CHECK_EQUAL(p_txlistdb->getMPTransactionCountBlock(101), 1);
+    BOOST_CHECK(p_txlistdb->getMPTransactionsBlock(101) == std::vector<uint256>({Txid(2)}));
+    BOOST_CHECK_EQUAL(p_txlistdb->getMPTransactionCountTotal(), 3);
+    BOOST_CHECK(p_txlistdb->GetSeedBlocks(0, 101) == std::set<int>({100, 101}));
+
+    BOOST_CHECK(p_txlistdb->isMPinBlockRange(101, 101, false));
+    BOOST_CHECK(!p_txlistdb->isMPinBlockRange(103, 200, false));
+
+    // the sub record goes with its transaction
+    BOOST_CHECK(p_txlistdb->isMPinBlockRange(101, 200, true));
+    BOOST_CHECK(p_txlistdb->exists(Txid(1)));
+    BOOST_CHECK(!p_txlistdb->exists(Txid(2)));
+    BOOST_CHECK(!p_txlistdb->exists(Txid(3)));
+    uint32_t propertyId = 0;
+    int64_t amount = 0;
+    BOOST_CHECK(!p_txlistdb->getSendAllDetails(Txid(2), 1, propertyId, amount));
+    BOOST_CHECK(!p_txlistdb->isMPinBlockRange(101, 200, false));
+}
+
+BOOST_AUTO_TEST_CASE(wallet_tx_index)
+{
+    p_txlistdb = new CMPTxList(pathTemp / "MP_txlist_test", true);
+    s_stolistdb = new CMPSTOList(pathTemp / "MP_stolist_test", true);
+    WalletTxIndexClear();
+
+    WalletTxIndexAdd(Txid(1), 100, 3);
+    WalletTxIndexAdd(Txid(2), 101, 1);
+    WalletTxIndexAdd(Txid(3), 100, 7);
+
+    // newest first, within the block range
+    std::vector<uint256> txids;
+    WalletTxCursor cursor(0, 100);
+    while (cursor.Next()) {
+        txids.push_back(cursor.GetTxid());
+        // entries below the current position are still listed
+        if (txids.size() == 1) WalletTxIndexAdd(Txid(4), 100, 5);
+    }
+    BOOST_CHECK(txids == std::vector<uint256>({Txid(3), Txid(4), Txid(1)}));
+
+    WalletTxIndexRemoveAbove(101);
+    BOOST_CHECK_EQUAL(FetchWalletElysiumTransactions(10).size(), 3);
+    BOOST_CHECK(FetchWalletElysiumTransactions(1).begin()->second == Txid(3));
+
+    WalletTxIndexClear();
+}
+
+BOOST_AUTO_TEST_CASE(upgrade_builds_indexes)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    boost::filesystem::path pathTrades = pathTemp / "MP_tradelist_upgrade";
+    boost::filesystem::path pathSTO = pathTemp / "MP_stolist_upgrade";
+
+    // records as written before the indexes existed
+    {
+        leveldb::Options options;
+        options.create_if_missing = true;
+        leveldb::DB* db = nullptr;
+        BOOST_REQUIRE(leveldb::DB::Open(options, pathTrades.string(), &db).ok());
+        std::unique_ptr<leveldb::DB> trades(db);
+        trades->Put(leveldb::WriteOptions(), Txid(1).ToString(), "alice:1:3:100:7");
+        trades->Put(leveldb::WriteOptions(), Txid(2).ToString(), "bob:3:1:100:8");
+        trades->Put(leveldb::WriteOptions(), Txid(2).ToString() + "+" + Txid(1).ToString(), "bob:alice:3:1:500:50:100:0");
+
+        BOOST_REQUIRE(leveldb::DB::Open(options, pathSTO.string(), &db).ok());
+        std::unique_ptr<leveldb::DB> sto(db);
+        sto->Put(leveldb::WriteOptions(), "alice", strprintf("%s:100:3:10,%s:101:3:30,", Txid(1).ToString(), Txid(2).ToString()));
+    }
+
+    t_tradelistdb = new CMPTradeList(pathTrades, false);
+    s_stolistdb = new CMPSTOList(pathSTO, false);
+
+    std::vector<uint256> trades;
+    t_tradelistdb->getTradesForAddress("alice", trades);
+    BOOST_CHECK(trades == std::vector<uint256>({Txid(1)}));
+    BOOST_CHECK_EQUAL(t_tradelistdb->getMPTradeCountTotal(), 3);
+
+    UniValue matches(UniValue::VARR);
+    int64_t totalSold = 0, totalBought = 0;
+    BOOST_CHECK(t_tradelistdb->getMatchingTrades(Txid(1), PROPERTY_A, matches, totalSold, totalBought));
+    BOOST_CHECK_EQUAL(totalSold, 50);
+
+    UniValue recipients(UniValue::VARR);
+    uint64_t total = 0, numRecipients = 0;
+    s_stolistdb->getRecipients(Txid(2), "*", &recipients, &total, &numRecipients);
+    BOOST_CHECK_EQUAL(numRecipients, 1);
+    BOOST_CHECK_EQUAL(total, 30);
+
+    BOOST_CHECK_EQUAL(t_tradelistdb->deleteAboveBlock(100), 3);
+    BOOST_CHECK_EQUAL(t_tradelistdb->getMPTradeCountTotal(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
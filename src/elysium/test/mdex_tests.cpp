@@ -0,0 +1,275 @@
+#include "elysium/mdex.h"
+
+#include "elysium/elysium.h"
+#include "elysium/tally.h"
+#include "elysium/uint256_extensions.h"
+
+#include "arith_uint256.h"
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace elysium;
+
+namespace {
+
+const uint32_t PROPERTY_A = ELYSIUM_PROPERTY_ELYSIUM;
+const uint32_t PROPERTY_B = 3;
+const uint32_t PROPERTY_C = 4;
+const int64_t FUNDING = 1000000000000LL;
+
+/**
+ * The order book as it was kept before it was keyed by trading pair: orders
+ * are looked up by the property for sale alone, walked by price, block and
+ * position in block, and skipped if they don't desire the property offered.
+ * Only pairs with an Elysium side are used, so no trading fee applies.
+ */
+class ReferenceOrderBook
+{
+public:
+    std::vector<CMPMetaDEx> orders;
+    std::map<std::pair<std::string, uint32_t>, int64_t> balance;
+    std::map<std::pair<std::string, uint32_t>, int64_t> reserve;
+
+    void Add(CMPMetaDEx pnew)
+    {
+        std::vector<size_t> candidates;
+        for (size_t i = 0; i < orders.size(); ++i) {
+            if (orders[i].getProperty() == pnew.getDesProperty()) candidates.push_back(i);
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+            if (orders[a].unitPrice() != orders[b].unitPrice()) return orders[a].unitPrice() < orders[b].unitPrice();
+            return MetaDEx_compare()(orders[a], orders[b]);
+        });
+
+        for (size_t i : candidates) {
+            CMPMetaDEx& pold = orders[i];
+            if (pnew.inversePrice() < pold.unitPrice()) continue;
+            if (pold.getDesProperty() != pnew.getProperty()) continue;
+
+            arith_uint256 iCouldBuy = (ConvertTo256(pnew.getAmountRemaining()) * ConvertTo256(pold.getAmountForSale())) / ConvertTo256(pold.getAmountDesired());
+            int64_t nCouldBuy = (iCouldBuy < ConvertTo256(pold.getAmountRemaining())) ? ConvertTo64(iCouldBuy) : pold.getAmountRemaining();
+            if (nCouldBuy == 0) continue;
+
+            int64_t nWouldPay = ConvertTo64(DivideAndRoundUp(ConvertTo256(nCouldBuy) * ConvertTo256(pold.getAmountDesired()), ConvertTo256(pold.getAmountForSale())));
+            if (rational_t(nWouldPay, nCouldBuy) > pnew.inversePrice()) continue;
+
+            balance[std::make_pair(pnew.getAddr(), pnew.getProperty())] -= nWouldPay;
+            balance[std::make_pair(pold.getAddr(), pold.getDesProperty())] += nWouldPay;
+            reserve[std::make_pair(pold.getAddr(), pold.getProperty())] -= nCouldBuy;
+            balance[std::make_pair(pnew.getAddr(), pnew.getDesProperty())] += nCouldBuy;
+
+            pold.setAmountRemaining(pold.getAmountRemaining() - nCouldBuy);
+            pnew.setAmountRemaining(pnew.getAmountRemaining() - nWouldPay);
+            if (pnew.getAmountRemaining() == 0) break;
+        }
+
+        orders.erase(std::remove_if(orders.begin(), orders.end(), [](const CMPMetaDEx& o) {
+            return o.getAmountRemaining() == 0;
+        }), orders.end());
+
+        if (pnew.getAmountRemaining() > 0) {
+            balance[std::make_pair(pnew.getAddr(), pnew.getProperty())] -= pnew.getAmountRemaining();
+            reserve[std::make_pair(pnew.getAddr(), pnew.getProperty())] += pnew.getAmountRemaining();
+            orders.push_back(pnew);
+        }
+    }
+
+    template<typename Predicate>
+    void Cancel(Predicate pred)
+    {
+        for (std::vector<CMPMetaDEx>::iterator it = orders.begin(); it != orders.end();) {
+            if (!pred(*it)) {
+                ++it;
+                continue;
+            }
+            reserve[std::make_pair(it->getAddr(), it->getProperty())] -= it->getAmountRemaining();
+            balance[std::make_pair(it->getAddr(), it->getProperty())] += it->getAmountRemaining();
+            it = orders.erase(it);
+        }
+    }
+};
+
+struct MetaDExTestingSetup : public TestingSetup
+{
+    CMPTxList *txlistdb;
+    CMPTradeList *tradelistdb;
+
+    MetaDExTestingSetup()
+        : txlistdb(p_txlistdb), tradelistdb(t_tradelistdb)
+    {
+        p_txlistdb = new CMPTxList(pathTemp / "MP_txlist_test", true);
+        t_tradelistdb = new CMPTradeList(pathTemp / "MP_tradelist_test", true);
+        MetaDEx_CLEAR();
+        clear_tally_map();
+    }
+
+    ~MetaDExTestingSetup()
+    {
+        MetaDEx_CLEAR();
+        clear_tally_map();
+        delete p_txlistdb;
+        delete t_tradelistdb;
+        p_txlistdb = txlistdb;
+        t_tradelistdb = tradelistdb;
+    }
+};
+
+uint256 TxId(int n)
+{
+    return ArithToUint256(arith_uint256(n + 1));
+}
+
+size_t CountOrders()
+{
+    size_t n = 0;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        for (md_PricesMap::const_iterator it = my_it->second.begin(); it != my_it->second.end(); ++it) {
+            BOOST_CHECK(!it->second.empty());
+            n += it->second.size();
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(elysium_mdex_tests, MetaDExTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pair_keyed_book)
+{
+    update_tally_map("alice", PROPERTY_A, 1000, BALANCE);
+    update_tally_map("bob", PROPERTY_B, 1000, BALANCE);
+    update_tally_map("carol", PROPERTY_C, 1000, BALANCE);
+
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("bob", PROPERTY_B, 100, 10, PROPERTY_A, 200, TxId(1), 1));
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("carol", PROPERTY_C, 100, 10, PROPERTY_A, 100, TxId(2), 2));
+
+    BOOST_CHECK(get_Prices(PROPERTY_B, PROPERTY_A) != NULL);
+    BOOST_CHECK(get_Prices(PROPERTY_C, PROPERTY_A) != NULL);
+    BOOST_CHECK(get_Prices(PROPERTY_A, PROPERTY_B) == NULL);
+    BOOST_CHECK(MetaDEx_isOpen(TxId(1)));
+    BOOST_CHECK(MetaDEx_isOpen(TxId(1), PROPERTY_B));
+    BOOST_CHECK(!MetaDEx_isOpen(TxId(1), PROPERTY_C));
+
+    // buying B for A only touches the offer selling B, even though C is cheaper
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("alice", PROPERTY_A, 100, 11, PROPERTY_B, 50, TxId(3), 1));
+    BOOST_CHECK_EQUAL(50, getMPbalance("alice", PROPERTY_B, BALANCE));
+    BOOST_CHECK_EQUAL(100, getMPbalance("bob", PROPERTY_A, BALANCE));
+    BOOST_CHECK_EQUAL(100, getMPbalance("carol", PROPERTY_C, METADEX_RESERVE));
+
+    const CMPMetaDEx* trade = MetaDEx_RetrieveTrade(TxId(1));
+    BOOST_REQUIRE(trade != NULL);
+    BOOST_CHECK_EQUAL(50, trade->getAmountRemaining());
+    BOOST_CHECK(MetaDEx_RetrieveTrade(TxId(3)) == NULL);
+
+    // filled orders leave no empty price levels or pairs behind
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("alice", PROPERTY_A, 100, 12, PROPERTY_B, 50, TxId(4), 1));
+    BOOST_CHECK(!MetaDEx_isOpen(TxId(1)));
+    BOOST_CHECK(get_Prices(PROPERTY_B, PROPERTY_A) == NULL);
+    BOOST_CHECK_EQUAL(1U, metadex.size());
+
+    BOOST_CHECK_EQUAL(0, MetaDEx_CANCEL_ALL_FOR_PAIR(TxId(5), 13, "carol", PROPERTY_C, PROPERTY_A));
+    BOOST_CHECK(metadex.empty());
+    BOOST_CHECK(MetaDEx_RetrieveTrade(TxId(2)) == NULL);
+    BOOST_CHECK_EQUAL(1000, getMPbalance("carol", PROPERTY_C, BALANCE));
+}
+
+BOOST_AUTO_TEST_CASE(shutdown_allpair)
+{
+    update_tally_map("bob", PROPERTY_B, 1000, BALANCE);
+
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("bob", PROPERTY_B, 100, 10, PROPERTY_A, 100, TxId(1), 1));
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("bob", PROPERTY_B, 100, 10, PROPERTY_C, 100, TxId(2), 2));
+
+    // only the order without an Elysium side is removed
+    MetaDEx_SHUTDOWN_ALLPAIR();
+    BOOST_CHECK(MetaDEx_isOpen(TxId(1)));
+    BOOST_CHECK(!MetaDEx_isOpen(TxId(2)));
+    BOOST_CHECK_EQUAL(900, getMPbalance("bob", PROPERTY_B, BALANCE));
+
+    MetaDEx_SHUTDOWN();
+    BOOST_CHECK(metadex.empty());
+    BOOST_CHECK(!MetaDEx_isOpen(TxId(1)));
+    BOOST_CHECK_EQUAL(1000, getMPbalance("bob", PROPERTY_B, BALANCE));
+}
+
+BOOST_AUTO_TEST_CASE(replay_matches_reference)
+{
+    const std::string addresses[] = {"alice", "bob", "carol", "dave"};
+    const std::pair<uint32_t, uint32_t> pairs[] = {
+        std::make_pair(PROPERTY_A, PROPERTY_B),
+        std::make_pair(PROPERTY_A, PROPERTY_C),
+        std::make_pair(PROPERTY_B, PROPERTY_A),
+        std::make_pair(PROPERTY_C, PROPERTY_A),
+    };
+    const uint32_t properties[] = {PROPERTY_A, PROPERTY_B, PROPERTY_C};
+
+    ReferenceOrderBook reference;
+    for (const std::string& addr : addresses) {
+        for (uint32_t prop : properties) {
+            update_tally_map(addr, prop, FUNDING, BALANCE);
+            reference.balance[std::make_pair(addr, prop)] = FUNDING;
+        }
+    }
+
+    std::mt19937 rng(31);
+    for (int n = 0; n < 3000; ++n) {
+        const std::string& addr = addresses[rng() % 4];
+        const std::pair<uint32_t, uint32_t>& pair = pairs[rng() % 4];
+        const int block = 100 + n / 8;
+        const unsigned int idx = 1 + n % 8;
+        const unsigned int action = rng() % 20;
+
+        if (action == 0) {
+            MetaDEx_CANCEL_ALL_FOR_PAIR(TxId(n), block, addr, pair.first, pair.second);
+            reference.Cancel([&](const CMPMetaDEx& o) {
+                return o.getAddr() == addr && o.getProperty() == pair.first && o.getDesProperty() == pair.second;
+            });
+        } else if (action == 1) {
+            MetaDEx_CANCEL_EVERYTHING(TxId(n), block, addr, ELYSIUM_PROPERTY_ELYSIUM);
+            reference.Cancel([&](const CMPMetaDEx& o) { return o.getAddr() == addr; });
+        } else if (action == 2 && !reference.orders.empty()) {
+            const CMPMetaDEx order = reference.orders[rng() % reference.orders.size()];
+            MetaDEx_CANCEL_AT_PRICE(TxId(n), block, order.getAddr(), order.getProperty(), order.getAmountForSale(), order.getDesProperty(), order.getAmountDesired());
+            reference.Cancel([&](const CMPMetaDEx& o) {
+                return o.getAddr() == order.getAddr() && o.getProperty() == order.getProperty() &&
+                    o.getDesProperty() == order.getDesProperty() && o.unitPrice() == order.unitPrice();
+            });
+        } else {
+            // a few price points per pair, so levels hold several orders
+            const int64_t amount = 1 + rng() % 1000;
+            const int64_t numerator = 1 + rng() % 4;
+            const int64_t denominator = 1 + rng() % 4;
+            const int64_t desired = std::max<int64_t>(1, amount * numerator / denominator);
+            BOOST_CHECK_EQUAL(0, MetaDEx_ADD(addr, pair.first, amount, block, pair.second, desired, TxId(n), idx));
+            reference.Add(CMPMetaDEx(addr, block, pair.first, amount, pair.second, desired, TxId(n), idx, CMPTransaction::ADD));
+        }
+
+        BOOST_REQUIRE_EQUAL(reference.orders.size(), CountOrders());
+        for (const CMPMetaDEx& order : reference.orders) {
+            const CMPMetaDEx* trade = MetaDEx_RetrieveTrade(order.getHash());
+            BOOST_REQUIRE(trade != NULL);
+            BOOST_REQUIRE_EQUAL(order.getAmountRemaining(), trade->getAmountRemaining());
+        }
+    }
+
+    for (const std::string& addr : addresses) {
+        for (uint32_t prop : properties) {
+            BOOST_CHECK_EQUAL(reference.balance[std::make_pair(addr, prop)], getMPbalance(addr, prop, BALANCE));
+            BOOST_CHECK_EQUAL(reference.reserve[std::make_pair(addr, prop)], getMPbalance(addr, prop, METADEX_RESERVE));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -504,6 +504,58 @@ BOOST_AUTO_TEST_CASE(get_anonimity_group_by_iterator)
     BOOST_CHECK_EQUAL(mints, result);
 }
 
+BOOST_AUTO_TEST_CASE(cached_anonimity_group_follows_mints)
+{
+    auto db = CreateDb();
+    auto mints = CreateMints(TEST_MAX_COINS_PER_GROUP + 2);
+
+    BOOST_CHECK(db->GetCachedAnonimityGroup(1, 1, 0).empty());
+
+    for (size_t i = 0; i < 5; i++) {
+        db->RecordMint(1, 1, mints[i], 10);
+    }
+
+    auto first = db->GetCachedAnonimityGroup(1, 1, 0);
+
+    for (size_t i = 5; i < mints.size(); i++) {
+        db->RecordMint(1, 1, mints[i], 11);
+    }
+
+    auto second = db->GetCachedAnonimityGroup(1, 1, 0);
+    auto next = db->GetCachedAnonimityGroup(1, 1, 1);
+
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 5), std::vector<SigmaPublicKey>(first.begin(), first.end()));
+    BOOST_CHECK_EQUAL(GetFirstN(mints, TEST_MAX_COINS_PER_GROUP), std::vector<SigmaPublicKey>(second.begin(), second.end()));
+    BOOST_CHECK_EQUAL(db->GetAnonimityGroupAsVector(1, 1, 0, TEST_MAX_COINS_PER_GROUP), std::vector<SigmaPublicKey>(second.begin(), second.end()));
+    BOOST_CHECK_EQUAL(2, next.size());
+    BOOST_CHECK(db->GetCachedAnonimityGroup(1, 2, 0).empty());
+}
+
+BOOST_AUTO_TEST_CASE(cached_anonimity_group_truncated_on_delete)
+{
+    auto db = CreateDb();
+    auto mints = CreateMints(10);
+
+    for (size_t i = 0; i < mints.size(); i++) {
+        db->RecordMint(1, 1, mints[i], 10 + i);
+    }
+
+    auto before = db->GetCachedAnonimityGroup(1, 1, 0);
+
+    db->DeleteAll(14);
+
+    auto after = db->GetCachedAnonimityGroup(1, 1, 0);
+    BOOST_CHECK_EQUAL(GetFirstN(mints, 4), std::vector<SigmaPublicKey>(after.begin(), after.end()));
+
+    // groups taken before the reorg are left as they were
+    BOOST_CHECK_EQUAL(mints, std::vector<SigmaPublicKey>(before.begin(), before.end()));
+
+    db->RecordMint(1, 1, mints[9], 14);
+    after = db->GetCachedAnonimityGroup(1, 1, 0);
+    BOOST_CHECK_EQUAL(5, after.size());
+    BOOST_CHECK_EQUAL(mints[9], *(after.end() - 1));
+}
+
 BOOST_AUTO_TEST_CASE(group_size_default)
 {
     auto db = CreateDb(0);
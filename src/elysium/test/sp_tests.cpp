@@ -1,5 +1,8 @@
 #include "../sp.h"
 
+#include "../elysium.h"
+
+#include "../../arith_uint256.h"
 #include "../../test/test_bitcoin.h"
 #include "../../main.h"
 #include "../../miner.h"
@@ -81,4 +84,57 @@ BOOST_AUTO_TEST_CASE(exist_denomination)
     BOOST_CHECK_EQUAL(0, db.getDenominationRemainingConfirmation(property, 0, 2));
 }
 
+BOOST_AUTO_TEST_CASE(cached_entries_follow_updates)
+{
+    uint256 block1 = ArithToUint256(arith_uint256(1));
+    uint256 block2 = ArithToUint256(arith_uint256(2));
+
+    CMPSPInfo::Entry sp;
+    sp.name = "token";
+    sp.prop_type = ELYSIUM_PROPERTY_TYPE_INDIVISIBLE;
+    sp.num_tokens = 100;
+    sp.txid = ArithToUint256(arith_uint256(3));
+    sp.creation_block = block1;
+    sp.update_block = block1;
+    auto property = db.putSP(ELYSIUM_PROPERTY_ELYSIUM, sp);
+
+    auto traits = db.getTraits(property);
+    BOOST_REQUIRE(traits);
+    BOOST_CHECK_EQUAL(traits->name, "token");
+    BOOST_CHECK(!traits->isDivisible());
+    BOOST_CHECK(db.getTraits(property) == traits);
+    BOOST_CHECK(!db.getTraits(property + 1));
+
+    // updates are visible right away, and rolled back with their block
+    sp.update_block = block2;
+    sp.num_tokens = 200;
+    BOOST_CHECK(db.updateSP(property, sp));
+    BOOST_CHECK(db.getSP(property, sp));
+    BOOST_CHECK_EQUAL(sp.num_tokens, 200);
+
+    BOOST_CHECK_EQUAL(db.popBlock(block2), 1);
+    BOOST_CHECK(db.getSP(property, sp));
+    BOOST_CHECK_EQUAL(sp.num_tokens, 100);
+    BOOST_CHECK(db.getTraits(property));
+
+    // a property created in a disconnected block is gone
+    BOOST_CHECK_EQUAL(db.popBlock(block1), 0);
+    BOOST_CHECK(!db.getSP(property, sp));
+    BOOST_CHECK(!db.hasSP(property));
+    BOOST_CHECK(!db.getTraits(property));
+
+    // more properties than are kept in memory
+    std::vector<uint32_t> properties;
+    for (size_t i = 0; i <= MAX_CACHED_SP_ENTRIES; i++) {
+        sp.num_tokens = i;
+        sp.txid = ArithToUint256(arith_uint256(100 + i));
+        properties.push_back(db.putSP(ELYSIUM_PROPERTY_ELYSIUM, sp));
+        BOOST_CHECK(db.getSP(properties.back(), sp));
+    }
+    for (size_t i = 0; i < properties.size(); i++) {
+        BOOST_CHECK(db.getSP(properties[i], sp));
+        BOOST_CHECK_EQUAL(sp.num_tokens, i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
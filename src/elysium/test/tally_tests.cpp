@@ -1,5 +1,8 @@
 #include "elysium/tally.h"
 
+#include "elysium/elysium.h"
+
+#include "main.h"
 #include "test/test_bitcoin.h"
 
 #include <stdint.h>
@@ -318,5 +321,36 @@ BOOST_AUTO_TEST_CASE(tally_overflow)
     BOOST_CHECK_EQUAL(tally.getMoneyReserved(3), int64_t(9223372036854775807LL));
 }
 
+BOOST_AUTO_TEST_CASE(holder_index)
+{
+    using namespace elysium;
+
+    LOCK(cs_main);
+    clear_tally_map();
+    BOOST_CHECK(getHolders(3).empty());
+
+    BOOST_CHECK(update_tally_map("bob", 3, 100, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 3, 50, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 3, -20, BALANCE));
+    BOOST_CHECK(update_tally_map("alice", 3, 20, METADEX_RESERVE));
+    BOOST_CHECK(update_tally_map("alice", 4, 7, SELLOFFER_RESERVE));
+
+    // pending amounts are not holdings, failed updates still create a record
+    BOOST_CHECK(update_tally_map("carol", 3, -5, PENDING));
+    BOOST_CHECK(!update_tally_map("dave", 3, -5, BALANCE));
+
+    const HolderMap& holders = getHolders(3);
+    BOOST_CHECK_EQUAL(holders.size(), 4U);
+    BOOST_CHECK_EQUAL(holders.begin()->first, "alice");
+    BOOST_CHECK_EQUAL(holders.at("alice"), 50);
+    BOOST_CHECK_EQUAL(holders.at("bob"), 100);
+    BOOST_CHECK_EQUAL(holders.at("carol"), 0);
+    BOOST_CHECK_EQUAL(holders.at("dave"), 0);
+    BOOST_CHECK_EQUAL(getHolders(4).at("alice"), 7);
+
+    clear_tally_map();
+    BOOST_CHECK(getHolders(3).empty());
+    BOOST_CHECK(mp_tally_map.empty());
+}
 
 BOOST_AUTO_TEST_SUITE_END()
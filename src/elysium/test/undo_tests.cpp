@@ -0,0 +1,110 @@
+#include "elysium/undo.h"
+
+#include "elysium/elysium.h"
+#include "elysium/mdex.h"
+#include "elysium/sp.h"
+#include "elysium/tally.h"
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdint.h>
+
+using namespace elysium;
+
+namespace {
+
+const uint32_t PROPERTY_A = ELYSIUM_PROPERTY_ELYSIUM;
+const uint32_t PROPERTY_B = 3;
+
+uint256 Hash(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(elysium_undo_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(disconnect_restores_state)
+{
+    _my_sps = new CMPSPInfo(pathTemp / "MP_spinfo_test", false);
+    p_txlistdb = new CMPTxList(pathTemp / "MP_txlist_test", true);
+    t_tradelistdb = new CMPTradeList(pathTemp / "MP_tradelist_test", true);
+    MetaDEx_CLEAR();
+    clear_tally_map();
+    ClearFreezeState();
+    ClearBlockUndo();
+
+    uint256 hashes[] = {Hash(100), Hash(101), Hash(102)};
+    CBlockIndex blocks[3];
+    for (int i = 0; i < 3; ++i) {
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].nHeight = 100 + i;
+        blocks[i].pprev = i > 0 ? &blocks[i - 1] : nullptr;
+    }
+
+    BOOST_CHECK(update_tally_map("alice", PROPERTY_A, 1000, BALANCE));
+    BOOST_CHECK(update_tally_map("bob", PROPERTY_B, 1000, BALANCE));
+
+    // block 101: an order is put into the book and freezing is enabled
+    StartBlockUndo(hashes[1], 0);
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("bob", PROPERTY_B, 100, 101, PROPERTY_A, 200, Hash(1), 1));
+    enableFreezing(PROPERTY_B, 101);
+    BOOST_CHECK(update_tally_map("carol", PROPERTY_B, 50, BALANCE));
+    FinishBlockUndo(hashes[1]);
+
+    // block 102: the order is partially filled and a frozen address receives tokens
+    StartBlockUndo(hashes[2], 0);
+    BOOST_CHECK_EQUAL(0, MetaDEx_ADD("alice", PROPERTY_A, 100, 102, PROPERTY_B, 50, Hash(2), 1));
+    freezeAddress("carol", PROPERTY_B);
+    BOOST_CHECK(update_tally_map("carol", PROPERTY_B, 25, BALANCE));
+    FinishBlockUndo(hashes[2]);
+
+    BOOST_CHECK_EQUAL(getMPbalance("alice", PROPERTY_B, BALANCE), 50);
+    BOOST_CHECK_EQUAL(MetaDEx_RetrieveTrade(Hash(1))->getAmountRemaining(), 50);
+
+    elysium_handler_disc_begin(102, &blocks[2]);
+
+    BOOST_CHECK_EQUAL(getMPbalance("alice", PROPERTY_A, BALANCE), 1000);
+    BOOST_CHECK_EQUAL(getMPbalance("alice", PROPERTY_B, BALANCE), 0);
+    BOOST_CHECK_EQUAL(getMPbalance("bob", PROPERTY_A, BALANCE), 0);
+    BOOST_CHECK_EQUAL(getMPbalance("bob", PROPERTY_B, METADEX_RESERVE), 100);
+    BOOST_CHECK_EQUAL(getMPbalance("carol", PROPERTY_B, BALANCE), 50);
+    BOOST_CHECK(!isAddressFrozen("carol", PROPERTY_B));
+    BOOST_CHECK(isFreezingEnabled(PROPERTY_B, 101));
+    BOOST_REQUIRE(MetaDEx_RetrieveTrade(Hash(1)));
+    BOOST_CHECK_EQUAL(MetaDEx_RetrieveTrade(Hash(1))->getAmountRemaining(), 100);
+    BOOST_CHECK(!MetaDEx_RetrieveTrade(Hash(2)));
+
+    elysium_handler_disc_begin(101, &blocks[1]);
+
+    BOOST_CHECK_EQUAL(getMPbalance("bob", PROPERTY_B, BALANCE), 1000);
+    BOOST_CHECK_EQUAL(getMPbalance("bob", PROPERTY_B, METADEX_RESERVE), 0);
+    BOOST_CHECK_EQUAL(getMPbalance("carol", PROPERTY_B, BALANCE), 0);
+    BOOST_CHECK(!isFreezingEnabled(PROPERTY_B, 101));
+    BOOST_CHECK(!MetaDEx_RetrieveTrade(Hash(1)));
+    BOOST_CHECK(metadex.empty());
+
+    int64_t holdings = 0;
+    const HolderMap& holders = getHolders(PROPERTY_B);
+    for (HolderMap::const_iterator it = holders.begin(); it != holders.end(); ++it) {
+        holdings += it->second;
+    }
+    BOOST_CHECK_EQUAL(holdings, 1000);
+
+    // without an undo record the state is left for the reload
+    BOOST_CHECK(update_tally_map("alice", PROPERTY_B, 10, BALANCE));
+    elysium_handler_disc_begin(100, &blocks[0]);
+    BOOST_CHECK_EQUAL(getMPbalance("alice", PROPERTY_B, BALANCE), 10);
+
+    MetaDEx_CLEAR();
+    clear_tally_map();
+    ClearFreezeState();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
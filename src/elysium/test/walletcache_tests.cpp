@@ -0,0 +1,82 @@
+#include "elysium/walletcache.h"
+
+#include "elysium/elysium.h"
+#include "elysium/tally.h"
+#include "elysium/utilsbitcoin.h"
+
+#include "base58.h"
+#include "main.h"
+#include "test/test_bitcoin.h"
+#include "wallet/wallet.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+using namespace elysium;
+
+namespace {
+
+const uint32_t PROPERTY = 3;
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(elysium_walletcache_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(incremental_updates)
+{
+    clear_tally_map();
+    WalletCacheInit();
+    WalletCacheUpdate();
+
+    CPubKey key;
+    BOOST_REQUIRE(pwalletMain->GetKeyFromPool(key));
+    std::string mine = CBitcoinAddress(key.GetID()).ToString();
+    std::string other = "aEF2uNSCLLVahxBQVhjx6wAKLRdvTNBAcN";
+
+    // balances of other addresses are not wallet changes
+    update_tally_map(other, PROPERTY, 100, BALANCE);
+    BOOST_CHECK_EQUAL(WalletCacheUpdate(), 0);
+
+    update_tally_map(mine, PROPERTY, 100, BALANCE);
+    update_tally_map(mine, PROPERTY, 40, METADEX_RESERVE);
+    BOOST_CHECK_EQUAL(WalletCacheUpdate(), 1);
+    BOOST_CHECK_EQUAL(global_balance_money[PROPERTY], 100);
+    BOOST_CHECK_EQUAL(global_balance_reserved[PROPERTY], 40);
+    BOOST_CHECK(global_wallet_property_list.count(PROPERTY));
+
+    // pending transactions reduce the available balance
+    update_tally_map(mine, PROPERTY, -30, PENDING);
+    BOOST_CHECK_EQUAL(WalletCacheUpdate(), 1);
+    BOOST_CHECK_EQUAL(global_balance_money[PROPERTY], 70);
+    BOOST_CHECK_EQUAL(WalletCacheUpdate(), 0);
+
+    {
+        LOCK(cs_main);
+        const WalletBalanceMap& balances = GetWalletBalances(PROPERTY);
+        BOOST_CHECK_EQUAL(balances.size(), 1);
+        BOOST_CHECK_EQUAL(balances.begin()->first, mine);
+        BOOST_CHECK_EQUAL(balances.begin()->second.available, 70);
+        BOOST_CHECK_EQUAL(balances.begin()->second.reserved, 40);
+        BOOST_CHECK_EQUAL(balances.begin()->second.block, GetHeight());
+    }
+
+    std::map<uint32_t, WalletBalanceMap> changes = GetWalletBalanceChanges(GetHeight());
+    BOOST_CHECK_EQUAL(changes.size(), 1);
+    BOOST_CHECK_EQUAL(changes[PROPERTY].count(mine), 1);
+    BOOST_CHECK(GetWalletBalanceChanges(GetHeight() + 1).empty());
+
+    // all balances are loaded again, once they were removed
+    clear_tally_map();
+    BOOST_CHECK_EQUAL(WalletCacheUpdate(), 1);
+    BOOST_CHECK_EQUAL(global_balance_money[PROPERTY], 0);
+    BOOST_CHECK_EQUAL(global_balance_reserved[PROPERTY], 0);
+    BOOST_CHECK(GetWalletBalanceChanges(0).empty());
+
+    WalletCacheShutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,7 @@
 #include "elysium/rules.h"
 #include "elysium/sp.h"
 #include "elysium/sto.h"
+#include "elysium/undo.h"
 #include "elysium/utils.h"
 #include "elysium/utilsbitcoin.h"
 #include "elysium/version.h"
@@ -101,6 +102,7 @@ void CMPTransaction::Set(
     raw.clear();
     raw.insert(raw.end(), p, p + size);
     this->referenceAmount = referenceAmount;
+    interpreted = boost::none;
 }
 
 /** Checks whether a pointer to the payload is past it's last position. */
@@ -204,6 +206,16 @@ bool CMPTransaction::interpret_Transaction()
     return false;
 }
 
+/** Parses the packet or payload once, so it can be done ahead of interpretPacket. */
+bool CMPTransaction::interpretPayload()
+{
+    if (!interpreted) {
+        interpreted = interpret_Transaction();
+    }
+
+    return *interpreted;
+}
+
 /** Version and type */
 bool CMPTransaction::interpret_TransactionType()
 {
@@ -1055,7 +1067,7 @@ int CMPTransaction::interpretPacket()
         return (PKT_ERROR -1);
     }
 
-    if (!interpret_Transaction()) {
+    if (!interpretPayload()) {
         return (PKT_ERROR -2);
     }
 
@@ -1216,6 +1228,7 @@ int CMPTransaction::logicHelper_CrowdsaleParticipation()
     }
 
     // Update the crowdsale object
+    RecordCrowdsaleUndo(receiver);
     pcrowdsale->incTokensUserCreated(tokens.first);
     pcrowdsale->incTokensIssuerCreated(tokens.second);
 
@@ -1434,7 +1447,7 @@ int CMPTransaction::logicMath_SendAll()
             ++numberOfPropertiesSent;
             assert(update_tally_map(sender, propertyId, -moneyAvailable, BALANCE));
             assert(update_tally_map(receiver, propertyId, moneyAvailable, BALANCE));
-            p_txlistdb->recordSendAllSubRecord(txid, numberOfPropertiesSent, propertyId, moneyAvailable);
+            p_txlistdb->recordSendAllSubRecord(txid, block, numberOfPropertiesSent, propertyId, moneyAvailable);
         }
     }
 
@@ -1956,6 +1969,7 @@ int CMPTransaction::logicMath_CreatePropertyVariable()
 
     const uint32_t propertyId = _my_sps->putSP(ecosystem, newSP);
     assert(propertyId > 0);
+    RecordCrowdsaleUndo(sender);
     my_crowds.insert(std::make_pair(sender, CMPCrowd(propertyId, nValue, property, deadline, early_bird, percentage, 0, 0)));
 
     PrintToLog("CREATED CROWDSALE id: %d value: %d property: %d\n", propertyId, nValue, property);
@@ -2023,6 +2037,7 @@ int CMPTransaction::logicMath_CloseCrowdsale()
     if (missedTokens > 0) {
         assert(update_tally_map(sp.issuer, property, missedTokens, BALANCE));
     }
+    RecordCrowdsaleUndo(sender);
     my_crowds.erase(it);
 
     if (elysium_debug_sp) PrintToLog("CLOSED CROWDSALE id: %d=%X\n", property, property);
@@ -330,6 +330,7 @@ public:
         min_client_version = 0;
         distribution_property = 0;
         sigmaStatus = SigmaStatus::SoftDisabled;
+        interpreted = boost::none;
     }
 
     /** Sets the given values. */
@@ -358,6 +359,9 @@ public:
     /** Parses the packet or payload. */
     bool interpret_Transaction();
 
+    /** Parses the packet or payload once, so it can be done ahead of interpretPacket. */
+    bool interpretPayload();
+
     /** Interprets the payload and executes the logic. */
     int interpretPacket();
 
@@ -376,6 +380,9 @@ private:
 
 private:
     std::vector<unsigned char> raw;
+
+    // Result of interpretPayload, if the payload was already parsed
+    boost::optional<bool> interpreted;
 };
 
 /** Parses a transaction and populates the CMPTransaction object. */
@@ -0,0 +1,135 @@
+#include "elysium/undo.h"
+
+#include "elysium/elysium.h"
+#include "elysium/log.h"
+
+#include <deque>
+#include <memory>
+
+namespace elysium {
+
+namespace {
+
+//! Record of the block being processed, if any
+std::unique_ptr<BlockUndo> pendingUndo;
+
+//! Records of the last blocks, the most recent one last
+std::deque<BlockUndo> blockUndos;
+
+} // anonymous namespace
+
+BlockUndo::BlockUndo() : develysium(0)
+{
+}
+
+BlockUndo::BlockUndo(const uint256& blockHash, int64_t develysium) : blockHash(blockHash), develysium(develysium)
+{
+}
+
+void StartBlockUndo(const uint256& blockHash, int64_t develysium)
+{
+    if (pendingUndo) {
+        // the last block was not finished, so its changes can't be undone
+        PrintToLog("%s(): block %s was not finished, dropping undo records\n", __func__, pendingUndo->blockHash.GetHex());
+        blockUndos.clear();
+    }
+
+    pendingUndo.reset(new BlockUndo(blockHash, develysium));
+}
+
+void FinishBlockUndo(const uint256& blockHash)
+{
+    if (!pendingUndo) return;
+
+    if (pendingUndo->blockHash != blockHash) {
+        PrintToLog("%s(): expected block %s, but got %s, dropping undo records\n", __func__,
+            pendingUndo->blockHash.GetHex(), blockHash.GetHex());
+        pendingUndo.reset();
+        blockUndos.clear();
+        return;
+    }
+
+    blockUndos.push_back(std::move(*pendingUndo));
+    pendingUndo.reset();
+
+    while (blockUndos.size() > static_cast<size_t>(MAX_STATE_HISTORY)) {
+        blockUndos.pop_front();
+    }
+}
+
+bool PopBlockUndo(const uint256& blockHash, BlockUndo& undo)
+{
+    if (pendingUndo || blockUndos.empty() || blockUndos.back().blockHash != blockHash) {
+        return false;
+    }
+
+    undo = std::move(blockUndos.back());
+    blockUndos.pop_back();
+
+    return true;
+}
+
+void ClearBlockUndo()
+{
+    pendingUndo.reset();
+    blockUndos.clear();
+}
+
+void RecordTallyUndo(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    if (!pendingUndo || ttype == PENDING) return;
+
+    pendingUndo->tallies[BlockUndo::TallyKey(address, propertyId, ttype)] += amount;
+}
+
+void RecordOfferUndo(const std::string& key)
+{
+    if (!pendingUndo || pendingUndo->offers.count(key)) return;
+
+    boost::optional<CMPOffer>& offer = pendingUndo->offers[key];
+    OfferMap::const_iterator it = my_offers.find(key);
+    if (it != my_offers.end()) offer = it->second;
+}
+
+void RecordAcceptUndo(const std::string& key)
+{
+    if (!pendingUndo || pendingUndo->accepts.count(key)) return;
+
+    boost::optional<CMPAccept>& accept = pendingUndo->accepts[key];
+    AcceptMap::const_iterator it = my_accepts.find(key);
+    if (it != my_accepts.end()) accept = it->second;
+}
+
+void RecordCrowdsaleUndo(const std::string& address)
+{
+    if (!pendingUndo || pendingUndo->crowdsales.count(address)) return;
+
+    boost::optional<CMPCrowd>& crowdsale = pendingUndo->crowdsales[address];
+    CrowdMap::const_iterator it = my_crowds.find(address);
+    if (it != my_crowds.end()) crowdsale = it->second;
+}
+
+void RecordMetaDExUndo(const uint256& txid)
+{
+    if (!pendingUndo || pendingUndo->orders.count(txid)) return;
+
+    boost::optional<CMPMetaDEx>& order = pendingUndo->orders[txid];
+    const CMPMetaDEx* pOrder = MetaDEx_RetrieveTrade(txid);
+    if (pOrder) order = *pOrder;
+}
+
+void RecordFrozenAddressUndo(const std::string& address, uint32_t propertyId)
+{
+    if (!pendingUndo) return;
+
+    pendingUndo->frozenAddresses.insert(std::make_pair(BlockUndo::AddressProperty(address, propertyId), isAddressFrozen(address, propertyId)));
+}
+
+void RecordFreezingUndo(uint32_t propertyId, int liveBlock, bool enabled)
+{
+    if (!pendingUndo) return;
+
+    pendingUndo->freezingEnabled.insert(std::make_pair(BlockUndo::FreezingEntry(propertyId, liveBlock), enabled));
+}
+
+} // namespace elysium
@@ -0,0 +1,84 @@
+#ifndef ELYSIUM_UNDO_H
+#define ELYSIUM_UNDO_H
+
+#include "elysium/dex.h"
+#include "elysium/mdex.h"
+#include "elysium/sp.h"
+#include "elysium/tally.h"
+
+#include "uint256.h"
+
+#include <boost/optional.hpp>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <stdint.h>
+
+namespace elysium {
+
+/**
+ * In-memory state changed by a single block.
+ *
+ * The first time a piece of state is touched while the block is processed,
+ * the value it had before the block is kept, so disconnecting the block only
+ * has to put those values back, instead of loading the persisted state of an
+ * older block and parsing the blocks after it again.
+ *
+ * Balances are kept as the net amount the block moved, because they are
+ * changed far more often than the other state.
+ */
+class BlockUndo
+{
+public:
+    typedef std::tuple<std::string, uint32_t, TallyType> TallyKey;
+    typedef std::pair<std::string, uint32_t> AddressProperty;
+    typedef std::pair<uint32_t, int> FreezingEntry;
+
+    uint256 blockHash;
+
+    //! "Dev ELYSIUM" vested before the block
+    int64_t develysium;
+
+    std::map<TallyKey, int64_t> tallies;
+    std::map<std::string, boost::optional<CMPOffer>> offers;
+    std::map<std::string, boost::optional<CMPAccept>> accepts;
+    std::map<std::string, boost::optional<CMPCrowd>> crowdsales;
+    std::map<uint256, boost::optional<CMPMetaDEx>> orders;
+    std::map<AddressProperty, bool> frozenAddresses;
+    std::map<FreezingEntry, bool> freezingEnabled;
+
+    BlockUndo();
+    BlockUndo(const uint256& blockHash, int64_t develysium);
+};
+
+/** Starts recording the changes of a block, any unfinished record is dropped. */
+void StartBlockUndo(const uint256& blockHash, int64_t develysium);
+
+/** Finishes the record of the block and keeps it for the last MAX_STATE_HISTORY blocks. */
+void FinishBlockUndo(const uint256& blockHash);
+
+/** Takes the record of a block, if it is the last one kept. */
+bool PopBlockUndo(const uint256& blockHash, BlockUndo& undo);
+
+/** Drops all records, once they no longer describe the in-memory state. */
+void ClearBlockUndo();
+
+/**
+ * Functions to record the state before it is changed.
+ *
+ * They do nothing, unless a block is being processed.
+ */
+void RecordTallyUndo(const std::string& address, uint32_t propertyId, int64_t amount, TallyType ttype);
+void RecordOfferUndo(const std::string& key);
+void RecordAcceptUndo(const std::string& key);
+void RecordCrowdsaleUndo(const std::string& address);
+void RecordMetaDExUndo(const uint256& txid);
+void RecordFrozenAddressUndo(const std::string& address, uint32_t propertyId);
+void RecordFreezingUndo(uint32_t propertyId, int liveBlock, bool enabled);
+
+} // namespace elysium
+
+#endif // ELYSIUM_UNDO_H
@@ -1,18 +1,24 @@
 #include "walletcache.h"
 
+#include "elysium.h"
 #include "log.h"
 #include "tally.h"
+#include "utilsbitcoin.h"
 #include "wallettxs.h"
 
 #include "../init.h"
 #include "../main.h"
+#include "../script/ismine.h"
 #include "../sync.h"
 #include "../uint256.h"
 #ifdef ENABLE_WALLET
 #include "../wallet/wallet.h"
 #endif
 
+#include <boost/signals2/connection.hpp>
+
 #include <algorithm>
+#include <forward_list>
 #include <list>
 #include <map>
 #include <set>
@@ -27,8 +33,19 @@ namespace elysium {
 //! Global vector of Elysium transactions in the wallet
 std::vector<uint256> walletTXIDCache;
 
-//! Map of wallet balances
-static std::map<std::string, CMPTally> walletBalancesCache;
+//! Wallet balances by property
+static std::map<uint32_t, WalletBalanceMap> walletBalances;
+
+//! Guards the changes collected since the last update
+static CCriticalSection cs_walletBalanceChanges;
+//! Balances of addresses for properties, which were changed since the last update
+static std::set<std::pair<std::string, uint32_t>> changedBalances;
+//! Addresses, which were added to the wallet since the last update
+static std::set<std::string> changedAddresses;
+//! Whether all balances must be loaded with the next update
+static bool fReloadBalances = true;
+
+static std::forward_list<boost::signals2::scoped_connection> balanceConnections;
 
 /**
  * Adds a txid to the wallet txid cache, performing duplicate detection.
@@ -70,64 +87,209 @@ void WalletTXIDCacheInit()
 #endif
 }
 
+static void OnTallyChanged(const std::string& address, uint32_t propertyId)
+{
+    LOCK(cs_walletBalanceChanges);
+    changedBalances.insert(std::make_pair(address, propertyId));
+}
+
+static void OnTallyCleared()
+{
+    LOCK(cs_walletBalanceChanges);
+    changedBalances.clear();
+    changedAddresses.clear();
+    fReloadBalances = true;
+}
+
+#ifdef ENABLE_WALLET
+static void OnAddressBookChanged(CWallet *wallet, const CTxDestination& address, const std::string& label,
+        bool isMine, const std::string& purpose, ChangeType status)
+{
+    // imported addresses may already have balances
+    if (status != CT_NEW) return;
+
+    LOCK(cs_walletBalanceChanges);
+    changedAddresses.insert(CBitcoinAddress(address).ToString());
+}
+#endif
+
 /**
- * Updates the cache with the latest state, returning true if changes were made to wallet addresses (including watch only).
+ * Starts following balance changes, all wallet balances are loaded with the next update.
+ */
+void WalletCacheInit()
+{
+    OnTallyCleared();
+
+    balanceConnections.emplace_front(TallyChanged.connect(&OnTallyChanged));
+    balanceConnections.emplace_front(TallyCleared.connect(&OnTallyCleared));
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        balanceConnections.emplace_front(pwalletMain->NotifyAddressBookChanged.connect(&OnAddressBookChanged));
+    }
+#endif
+}
+
+/**
+ * Stops following balance changes.
+ */
+void WalletCacheShutdown()
+{
+    balanceConnections.clear();
+
+    LOCK(cs_main);
+    walletBalances.clear();
+}
+
+/**
+ * Updates the cached balance of a wallet address and the wallet totals, returning true if it was changed.
+ */
+static bool UpdateWalletBalance(const std::string& address, uint32_t propertyId, int ismine, int nBlock)
+{
+    WalletBalanceMap& balances = walletBalances[propertyId];
+    WalletBalanceMap::iterator it = balances.find(address);
+
+    if (it != balances.end() && it->second.ismine == ISMINE_SPENDABLE) {
+        global_balance_money[propertyId] -= it->second.available;
+        global_balance_reserved[propertyId] -= it->second.reserved;
+    }
+
+    const CMPTally* tally = getTally(address);
+    if (!ismine || !tally) {
+        if (it == balances.end()) return false;
+        balances.erase(it);
+        return true;
+    }
+
+    WalletBalance balance;
+    balance.available = tally->getMoneyAvailable(propertyId);
+    balance.reserved = tally->getMoneyReserved(propertyId);
+    balance.ismine = ismine;
+    balance.block = nBlock;
+
+    // add to the global wallet property list, only spendable balances are included in totals
+    global_wallet_property_list.insert(propertyId);
+    if (ismine == ISMINE_SPENDABLE) {
+        global_balance_money[propertyId] += balance.available;
+        global_balance_reserved[propertyId] += balance.reserved;
+    }
+
+    if (it == balances.end()) {
+        balances.insert(std::make_pair(address, balance));
+        return true;
+    }
+
+    WalletBalance& cached = it->second;
+    if (cached.available == balance.available && cached.reserved == balance.reserved && cached.ismine == balance.ismine) {
+        return false;
+    }
+
+    cached = balance;
+    return true;
+}
+
+/**
+ * Updates the cache with the balance changes since the last update, returning true if changes were made to wallet
+ * addresses (including watch only).
  *
- * Also prepares a list of addresses that were changed (for future usage).
+ * The wallet totals are adjusted by the changed balances only.
  */
 int WalletCacheUpdate()
 {
     if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: Update requested\n");
     int numChanges = 0;
-    std::set<std::string> changedAddresses;
 
     LOCK(cs_main);
 
-    for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        const std::string& address = my_it->first;
+    std::set<std::pair<std::string, uint32_t>> balances;
+    std::set<std::string> addresses;
+    bool fReload;
+    {
+        LOCK(cs_walletBalanceChanges);
+        balances.swap(changedBalances);
+        addresses.swap(changedAddresses);
+        fReload = fReloadBalances;
+        fReloadBalances = false;
+    }
+
+    if (fReload) {
+        if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: Loading all balances\n");
+        if (!walletBalances.empty()) ++numChanges;
+        walletBalances.clear();
+        global_balance_money.clear();
+        global_balance_reserved.clear();
+
+        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+            addresses.insert(it->first);
+        }
+    }
+
+    for (std::set<std::string>::const_iterator it = addresses.begin(); it != addresses.end(); ++it) {
+        CMPTally* tally = getTally(*it);
+        if (!tally) continue;
 
-        // determine if this address is in the wallet
-        int addressIsMine = IsMyAddress(address);
-        if (!addressIsMine) {
-            if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: Ignoring non-wallet address %s\n", address);
-            continue; // ignore this address, not in wallet
+        tally->init();
+        uint32_t propertyId;
+        while (0 != (propertyId = tally->next())) {
+            balances.insert(std::make_pair(*it, propertyId));
         }
+    }
 
-        // obtain & init the tally
-        CMPTally& tally = my_it->second;
-        tally.init();
+    int nBlock = GetHeight();
+    std::string lastAddress;
+    int addressIsMine = 0;
 
-        // check cache for miss on address
-        std::map<std::string, CMPTally>::iterator search_it = walletBalancesCache.find(address);
-        if (search_it == walletBalancesCache.end()) { // cache miss, new address
-            ++numChanges;
-            changedAddresses.insert(address);
-            walletBalancesCache.insert(std::make_pair(address,tally));
-            if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
-            continue;
+    // changes are ordered by address, so each address is looked up in the wallet once
+    for (std::set<std::pair<std::string, uint32_t>>::const_iterator it = balances.begin(); it != balances.end(); ++it) {
+        const std::string& address = it->first;
+        if (it == balances.begin() || address != lastAddress) {
+            lastAddress = address;
+            addressIsMine = IsMyAddress(address);
         }
 
-        // check cache for miss on balance - TODO TRY AND OPTIMIZE THIS
-        CMPTally &cacheTally = search_it->second;
-        uint32_t propertyId;
-        while (0 != (propertyId = (tally.next()))) {
-            if (tally.getMoney(propertyId, BALANCE) != cacheTally.getMoney(propertyId, BALANCE) ||
-                    tally.getMoney(propertyId, PENDING) != cacheTally.getMoney(propertyId, PENDING) ||
-                    tally.getMoney(propertyId, SELLOFFER_RESERVE) != cacheTally.getMoney(propertyId, SELLOFFER_RESERVE) ||
-                    tally.getMoney(propertyId, ACCEPT_RESERVE) != cacheTally.getMoney(propertyId, ACCEPT_RESERVE) ||
-                    tally.getMoney(propertyId, METADEX_RESERVE) != cacheTally.getMoney(propertyId, METADEX_RESERVE)) { // cache miss, balance
-                ++numChanges;
-                changedAddresses.insert(address);
-                walletBalancesCache.erase(search_it);
-                walletBalancesCache.insert(std::make_pair(address,tally));
-                if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balance for property %d differs\n", address, propertyId);
-                break;
-            }
+        if (UpdateWalletBalance(address, it->second, addressIsMine, nBlock)) {
+            ++numChanges;
+            if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: %s balance for property %d changed\n", address, it->second);
         }
     }
+
     if (elysium_debug_walletcache) PrintToLog("WALLETCACHE: Update finished - there were %d changes\n", numChanges);
     return numChanges;
 }
 
+/**
+ * Returns the wallet balances of a property, ordered by address, as of the last update.
+ */
+const WalletBalanceMap& GetWalletBalances(uint32_t propertyId)
+{
+    static const WalletBalanceMap noBalances;
+
+    AssertLockHeld(cs_main);
+
+    std::map<uint32_t, WalletBalanceMap>::const_iterator it = walletBalances.find(propertyId);
+
+    if (it != walletBalances.end()) return it->second;
+
+    return noBalances;
+}
+
+/**
+ * Returns the wallet balances, which were changed at or after the given block, by property.
+ */
+std::map<uint32_t, WalletBalanceMap> GetWalletBalanceChanges(int nBlock)
+{
+    std::map<uint32_t, WalletBalanceMap> changes;
+
+    LOCK(cs_main);
+
+    for (std::map<uint32_t, WalletBalanceMap>::const_iterator it = walletBalances.begin(); it != walletBalances.end(); ++it) {
+        for (WalletBalanceMap::const_iterator balance = it->second.begin(); balance != it->second.end(); ++balance) {
+            if (balance->second.block >= nBlock) {
+                changes[it->first].insert(*balance);
+            }
+        }
+    }
+
+    return changes;
+}
 
 } // namespace elysium
@@ -3,8 +3,12 @@
 
 class uint256;
 
+#include <map>
+#include <string>
 #include <vector>
 
+#include <stdint.h>
+
 namespace elysium
 {
 //! Global vector of Elysium transactions in the wallet
@@ -16,8 +20,36 @@ void WalletTXIDCacheAdd(const uint256& hash);
 /** Performs initial population of the wallet txid cache */
 void WalletTXIDCacheInit();
 
+/** Balances of a wallet address for a property */
+struct WalletBalance
+{
+    //! Balance, reduced by pending transactions
+    int64_t available;
+    //! Tokens reserved by sell offers, accepts and MetaDEx trades
+    int64_t reserved;
+    //! How the address belongs to the wallet, see isminetype
+    int ismine;
+    //! Block, at which the balances were last changed
+    int block;
+};
+
+//! Wallet balances of a property, ordered by address
+typedef std::map<std::string, WalletBalance> WalletBalanceMap;
+
+/** Starts following balance changes, all wallet balances are loaded with the next update */
+void WalletCacheInit();
+
+/** Stops following balance changes */
+void WalletCacheShutdown();
+
 /** Updates the cache and returns whether any wallet addresses were changed */
 int WalletCacheUpdate();
+
+/** Returns the wallet balances of a property as of the last update */
+const WalletBalanceMap& GetWalletBalances(uint32_t propertyId);
+
+/** Returns the wallet balances, which were changed at or after the given block, by property */
+std::map<uint32_t, WalletBalanceMap> GetWalletBalanceChanges(int nBlock);
 }
 
 #endif // ELYSIUM_WALLETCACHE_H
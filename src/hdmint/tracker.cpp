@@ -32,6 +32,7 @@ CHDMintTracker::CHDMintTracker(std::string strWalletFile)
     this->strWalletFile = strWalletFile;
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    nUnusedValue = 0;
     fInitialized = false;
 }
 
@@ -75,8 +76,10 @@ bool CHDMintTracker::Archive(CMintMeta& meta)
 {
     uint256 hashPubcoin = meta.GetPubCoinValueHash();
 
-    if (HasSerialHash(meta.hashSerial))
+    if (HasSerialHash(meta.hashSerial)) {
         mapSerialHashes.at(meta.hashSerial).isArchived = true;
+        UpdateIndexes(mapSerialHashes.at(meta.hashSerial));
+    }
 
    CWalletDB walletdb(strWalletFile);
     CHDMint dMint;
@@ -140,14 +143,11 @@ bool CHDMintTracker::GetMetaFromSerial(const uint256 &hashSerial, CMintMeta& mMe
  */
 bool CHDMintTracker::GetMetaFromPubcoin(const uint256& hashPubcoin, CMintMeta& mMeta)
 {
-    for (auto it : mapSerialHashes) {
-        if (it.second.GetPubCoinValueHash() == hashPubcoin){
-            mMeta = it.second;
-            return true;
-        }
-    }
+    auto it = mapPubcoinHashes.find(hashPubcoin);
+    if (it == mapPubcoinHashes.end())
+        return false;
 
-    return false;
+    return GetMetaFromSerial(it->second, mMeta);
 }
 
 /**
@@ -177,12 +177,7 @@ std::vector<uint256> CHDMintTracker::GetSerialHashes()
  */
 bool CHDMintTracker::HasPubcoinHash(const uint256& hashPubcoin) const
 {
-    for (auto const & it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (meta.GetPubCoinValueHash() == hashPubcoin)
-            return true;
-    }
-    return false;
+    return mapPubcoinHashes.count(hashPubcoin) > 0;
 }
 
 /**
@@ -208,8 +203,20 @@ bool CHDMintTracker::HasSerialHash(const uint256& hashSerial) const
  */
 bool CHDMintTracker::UpdateState(const CMintMeta& meta)
 {
-    uint256 hashPubcoin = meta.GetPubCoinValueHash();
     CWalletDB walletdb(strWalletFile);
+    return UpdateState(meta, walletdb);
+}
+
+/**
+ * Update the tracker state, writing to the database through the given handle.
+ *
+ * @param meta the CMintMeta object used to update
+ * @param walletdb the database handle to write with
+ * @return success
+ */
+bool CHDMintTracker::UpdateState(const CMintMeta& meta, CWalletDB& walletdb)
+{
+    uint256 hashPubcoin = meta.GetPubCoinValueHash();
 
     if (meta.isDeterministic) {
         CHDMint dMint;
@@ -267,6 +274,7 @@ bool CHDMintTracker::UpdateState(const CMintMeta& meta)
     }
 
     mapSerialHashes[meta.hashSerial] = meta;
+    UpdateIndexes(meta);
 
     return true;
 }
@@ -297,6 +305,7 @@ void CHDMintTracker::Add(const CHDMint& dMint, bool isNew, bool isArchived)
     meta.isDeterministic = true;
     meta.isSeedCorrect = true;
     mapSerialHashes[meta.hashSerial] = meta;
+    UpdateIndexes(meta);
 
     pwalletMain->NotifyZerocoinChanged(
         pwalletMain,
@@ -308,6 +317,27 @@ void CHDMintTracker::Add(const CHDMint& dMint, bool isNew, bool isArchived)
         CWalletDB(strWalletFile).WriteHDMint(dMint);
 }
 
+/**
+ * Add mints that have just been created, writing them to the database in a single transaction.
+ *
+ * @param vDMints CHDMint objects to add
+ * @return void
+ */
+void CHDMintTracker::AddNew(const std::vector<CHDMint>& vDMints)
+{
+    if (vDMints.empty())
+        return;
+
+    CWalletDB walletdb(strWalletFile);
+    bool fTxn = walletdb.TxnBegin();
+    for (const CHDMint& dMint : vDMints) {
+        Add(dMint);
+        walletdb.WriteHDMint(dMint);
+    }
+    if (fTxn && !walletdb.TxnCommit())
+        LogPrintf("%s: failed to commit new mints to the database\n", __func__);
+}
+
 void CHDMintTracker::Add(const CSigmaEntry& sigma, bool isNew, bool isArchived)
 {
     CMintMeta meta;
@@ -322,6 +352,7 @@ void CHDMintTracker::Add(const CSigmaEntry& sigma, bool isNew, bool isArchived)
     meta.isDeterministic = false;
     meta.isSeedCorrect = true;
     mapSerialHashes[meta.hashSerial] = meta;
+    UpdateIndexes(meta);
 
     if (isNew)
         CWalletDB(strWalletFile).WriteSigmaEntry(sigma);
@@ -509,6 +540,27 @@ bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMint
     return false;
 }
 
+/**
+ * Update the tracker state of several mints.
+ *
+ * The mints are written in a single database transaction, rather than one each.
+ *
+ * @param vMeta the CMintMeta objects used to update
+ * @return void
+ */
+void CHDMintTracker::UpdateStates(const std::vector<CMintMeta>& vMeta)
+{
+    if (vMeta.empty())
+        return;
+
+    CWalletDB walletdb(strWalletFile);
+    bool fTxn = walletdb.TxnBegin();
+    for (const CMintMeta& meta : vMeta)
+        UpdateState(meta, walletdb);
+    if (fTxn && !walletdb.TxnCommit())
+        LogPrintf("%s: failed to commit mint updates to the database\n", __func__);
+}
+
 /**
  * Update mints found on-chain.
  * 
@@ -522,8 +574,7 @@ void CHDMintTracker::UpdateFromBlock(const std::list<std::pair<uint256, MintPool
     }
 
     //overwrite any updates
-    for (CMintMeta meta : updatedMeta)
-        UpdateState(meta);
+    UpdateStates(updatedMeta);
 }
 
 /**
@@ -769,12 +820,108 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
     }
 
     //overwrite any updates
-    for (CMintMeta& meta : vOverWrite)
-        UpdateState(meta);
+    UpdateStates(vOverWrite);
 
     return setMints;
 }
 
+/**
+ * Get the unused mints that can be spent, from the index of unused mints.
+ *
+ * Unlike ListMints, this doesn't look at any used or archived mint.
+ *
+ * @return vector of CMintMeta objects
+ */
+std::vector<CMintMeta> CHDMintTracker::ListUnusedMints() const
+{
+    std::vector<CMintMeta> vMints;
+    vMints.reserve(mapUnusedPubcoins.size());
+    for (auto const & it : mapUnusedPubcoins) {
+        auto itMeta = mapSerialHashes.find(it.second);
+        if (itMeta != mapSerialHashes.end())
+            vMints.push_back(itMeta->second);
+    }
+    return vMints;
+}
+
+/**
+ * Get the value of the unused mints, from the running total kept with the index of unused mints.
+ *
+ * Mints are confirmed once they have ZC_MINT_CONFIRMATIONS confirmations, only the value
+ * of the mints in the most recent blocks and of those not in a block yet is summed up.
+ *
+ * @param nAll reference to the value of all unused mints
+ * @param nConfirmed reference to the value of the confirmed unused mints
+ * @return void
+ */
+void CHDMintTracker::GetUnusedBalance(CAmount& nAll, CAmount& nConfirmed) const
+{
+    int nConfirmedHeight = chainActive.Height() - (ZC_MINT_CONFIRMATIONS-1);
+
+    CAmount nUnconfirmed = 0;
+    for (auto it = mapUnusedValueByHeight.begin(); it != mapUnusedValueByHeight.end() && it->first <= 0; ++it)
+        nUnconfirmed += it->second;
+    for (auto it = mapUnusedValueByHeight.upper_bound(std::max(nConfirmedHeight, 0)); it != mapUnusedValueByHeight.end(); ++it)
+        nUnconfirmed += it->second;
+
+    nAll = nUnusedValue;
+    nConfirmed = nUnusedValue - nUnconfirmed;
+}
+
+/**
+ * Get the output of a mint.
+ *
+ * Outputs are remembered once found. If the mint transaction is known, the output is
+ * looked up in the wallet, and the outputs of other unused mints of the same transaction
+ * are remembered on the way. Otherwise the mint is looked up in the chain.
+ *
+ * @param mint the CMintMeta object of the mint
+ * @param outPoint reference to the output of the mint
+ * @return success
+ */
+bool CHDMintTracker::GetMintOutPoint(const CMintMeta& mint, COutPoint& outPoint)
+{
+    uint256 hashPubcoin = mint.GetPubCoinValueHash();
+    auto it = mapMintOutPoints.find(hashPubcoin);
+    if (it != mapMintOutPoints.end() && (mint.txid.IsNull() || it->second.hash == mint.txid)) {
+        outPoint = it->second;
+        return true;
+    }
+
+    if (mint.txid.IsNull()) {
+        if (!GetOutPoint(outPoint, sigma::PublicCoin(mint.GetPubCoinValue(), mint.denom)))
+            return false;
+        mapMintOutPoints[hashPubcoin] = outPoint;
+        return true;
+    }
+
+    auto itTx = pwalletMain->mapWallet.find(mint.txid);
+    if (itTx == pwalletMain->mapWallet.end())
+        return false;
+
+    bool found = false;
+    const CWalletTx& wtx = itTx->second;
+    for (uint32_t i = 0; i < wtx.vout.size(); i++) {
+        if (!wtx.vout[i].scriptPubKey.IsSigmaMint())
+            continue;
+        GroupElement pubCoinValue;
+        try {
+            pubCoinValue = ParseSigmaMintScript(wtx.vout[i].scriptPubKey);
+        } catch (std::invalid_argument&) {
+            continue;
+        }
+        uint256 hashOutput = primitives::GetPubCoinValueHash(pubCoinValue);
+        if (hashOutput == hashPubcoin) {
+            outPoint = COutPoint(mint.txid, i);
+            found = true;
+        }
+        if (mapUnusedPubcoins.count(hashOutput))
+            mapMintOutPoints[hashOutput] = COutPoint(mint.txid, i);
+    }
+
+    return found;
+}
+
 /**
  * Get txids of all mempool entries.
  * 
@@ -792,11 +939,52 @@ std::set<uint256> CHDMintTracker::GetMempoolTxids(){
 }
 
 /**
- * map of serial hashes -> CMintMeta objects
+ * Clears the map of serial hashes -> CMintMeta objects and its indexes
  * 
  * @return void
  */
 void CHDMintTracker::Clear()
 {
     mapSerialHashes.clear();
+    mapPubcoinHashes.clear();
+    mapUnusedPubcoins.clear();
+    mapMintOutPoints.clear();
+    mapUnusedValues.clear();
+    mapUnusedValueByHeight.clear();
+    nUnusedValue = 0;
+}
+
+/**
+ * Keep the pubcoin hash index, the index of unused mints and their value in step with a mint stored in memory.
+ *
+ * @param meta the CMintMeta object stored in memory
+ * @return void
+ */
+void CHDMintTracker::UpdateIndexes(const CMintMeta& meta)
+{
+    uint256 hashPubcoin = meta.GetPubCoinValueHash();
+    mapPubcoinHashes[hashPubcoin] = meta.hashSerial;
+
+    auto itValue = mapUnusedValues.find(hashPubcoin);
+    if (itValue != mapUnusedValues.end()) {
+        auto itHeight = mapUnusedValueByHeight.find(itValue->second.first);
+        itHeight->second -= itValue->second.second;
+        if (itHeight->second == 0)
+            mapUnusedValueByHeight.erase(itHeight);
+        nUnusedValue -= itValue->second.second;
+        mapUnusedValues.erase(itValue);
+    }
+
+    if (meta.isUsed || meta.isArchived || !meta.isSeedCorrect) {
+        mapUnusedPubcoins.erase(hashPubcoin);
+        mapMintOutPoints.erase(hashPubcoin);
+    } else {
+        mapUnusedPubcoins[hashPubcoin] = meta.hashSerial;
+
+        int64_t nValue;
+        DenominationToInteger(meta.denom, nValue);
+        mapUnusedValues[hashPubcoin] = std::make_pair(meta.nHeight, nValue);
+        mapUnusedValueByHeight[meta.nHeight] += nValue;
+        nUnusedValue += nValue;
+    }
 }
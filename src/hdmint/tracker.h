@@ -5,12 +5,14 @@
 #ifndef ZCOIN_HDMINTTRACKER_H
 #define ZCOIN_HDMINTTRACKER_H
 
+#include "primitives/transaction.h"
 #include "primitives/zerocoin.h"
 #include "hdmint/mintpool.h"
 #include <list>
 
 class CHDMint;
 class CHDMintWallet;
+class CWalletDB;
 
 class CHDMintTracker
 {
@@ -18,15 +20,25 @@ private:
     bool fInitialized;
     std::string strWalletFile;
     std::map<uint256, CMintMeta> mapSerialHashes;
+    std::map<uint256, uint256> mapPubcoinHashes; //pubcoinhash, serialhash of all mints in mapSerialHashes
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+    std::map<uint256, uint256> mapUnusedPubcoins; //pubcoinhash, serialhash of unused mints that can be spent
+    std::map<uint256, COutPoint> mapMintOutPoints; //pubcoinhash, output of the mint once it was found
+    std::map<uint256, std::pair<int, CAmount>> mapUnusedValues; //pubcoinhash, height and value the unused mint is counted with
+    std::map<int, CAmount> mapUnusedValueByHeight; //height, value of unused mints at that height
+    CAmount nUnusedValue;
+    void UpdateIndexes(const CMintMeta& meta);
     bool IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial);
     bool UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend=false);
     std::set<uint256> GetMempoolTxids();
+    bool UpdateState(const CMintMeta& meta, CWalletDB& walletdb);
+    void UpdateStates(const std::vector<CMintMeta>& vMeta);
 public:
     CHDMintTracker(std::string strWalletFile);
     ~CHDMintTracker();
     void Add(const CHDMint& dMint, bool isNew = false, bool isArchived = false);
     void Add(const CSigmaEntry& sigma, bool isNew = false, bool isArchived = false);
+    void AddNew(const std::vector<CHDMint>& vDMints);
     bool Archive(CMintMeta& meta);
     bool HasPubcoinHash(const uint256& hashPubcoin) const;
     bool HasSerialHash(const uint256& hashSerial) const;
@@ -42,6 +54,9 @@ public:
     void UpdateSpendStateFromMempool(const vector<Scalar>& spentSerials);
     list<CSigmaEntry> MintsAsSigmaEntries(bool fUnusedOnly = true, bool fMatureOnly = true);
     std::vector<CMintMeta> ListMints(bool fUnusedOnly = true, bool fMatureOnly = true, bool fUpdateStatus = true, bool fLoad = false, bool fWrongSeed = false);
+    std::vector<CMintMeta> ListUnusedMints() const;
+    void GetUnusedBalance(CAmount& nAll, CAmount& nConfirmed) const;
+    bool GetMintOutPoint(const CMintMeta& mint, COutPoint& outPoint);
     void SetPubcoinUsed(const uint256& hashPubcoin, const uint256& txid);
     void SetPubcoinNotUsed(const uint256& hashPubcoin);
     bool UnArchive(const uint256& hashPubcoin, bool isDeterministic);
@@ -15,8 +15,29 @@
 #include "crypto/hmac_sha512.h"
 #include "keystore.h"
 #include <boost/optional.hpp>
+#include <boost/thread.hpp>
 #include "fivegnode-sync.h"
 
+/**
+ * Compute the mint seed of the key for the count passed: HMAC-SHA512(SHA256(count),key)
+ *
+ * @param key the key of the mint
+ * @param nCount count in the HD Chain of the mint
+ * @return the mint seed
+ */
+static uint512 KeyToMintSeed(const CKey& key, int32_t nCount)
+{
+    unsigned char countHash[CSHA256().OUTPUT_SIZE];
+    std::vector<unsigned char> result(CSHA512().OUTPUT_SIZE);
+
+    std::string nCountStr = to_string(nCount);
+    CSHA256().Write(reinterpret_cast<const unsigned char*>(nCountStr.c_str()), nCountStr.size()).Finalize(countHash);
+
+    CHMAC_SHA512(countHash, CSHA256().OUTPUT_SIZE).Write(key.begin(), key.size()).Finalize(&result[0]);
+
+    return uint512(result);
+}
+
 /**
  * Constructor for CHDMintWallet object.
  *
@@ -156,32 +177,87 @@ void CHDMintWallet::GenerateMintPool(int32_t nIndex)
     if(nIndex > 0 && nIndex >= nLastCount)
         nStop = nIndex + 20;
     LogPrintf("%s : nLastCount=%d nStop=%d\n", __func__, nLastCount, nStop - 1);
+
+    // With an HD wallet the keys not generated yet are added to the wallet together, then the
+    // keys of the whole range are derived from the mint chain in parallel
+    int32_t nFirstCount = nLastCount;
+    std::vector<CKey> vKeys;
+    std::vector<CPubKey> vPubKeys;
+    {
+        LOCK(pwalletMain->cs_wallet);
+        if (!pwalletMain->GetHDChain().masterKeyID.IsNull()) {
+            int32_t nChainIndex = pwalletMain->GetHDChain().nExternalChainCounters[BIP44_MINT_INDEX];
+            if (nFirstCount > nChainIndex)
+                throw ZerocoinException("Unable to retrieve mint seed ID (internal index greater than HDChain index). \n"
+                                        "We recommend restarting with -zapwalletmints.");
+            if (nStop >= nChainIndex)
+                pwalletMain->GenerateNewKeys(BIP44_MINT_INDEX, nStop + 1 - nChainIndex);
+            pwalletMain->DeriveHDKeys(BIP44_MINT_INDEX, nFirstCount, nStop + 1 - nFirstCount, vKeys, vPubKeys);
+        }
+    }
+
+    std::vector<int32_t> vCounts;
+    std::vector<CKeyID> vSeedIds;
+    std::vector<uint512> vMintSeeds;
     for (; nLastCount <= nStop; ++nLastCount) {
         if (ShutdownRequested())
             return;
 
         CKeyID seedId;
         uint512 mintSeed;
-        if(!CreateMintSeed(mintSeed, nLastCount, seedId))
+        if (!vKeys.empty()) {
+            seedId = vPubKeys[nLastCount - nFirstCount].GetID();
+            mintSeed = KeyToMintSeed(vKeys[nLastCount - nFirstCount], nLastCount);
+        } else if(!CreateMintSeed(mintSeed, nLastCount, seedId))
             continue;
 
-        GroupElement commitmentValue;
-        sigma::PrivateCoin coin(sigma::Params::get_default(), sigma::CoinDenomination::SIGMA_DENOM_1);
-        if(!SeedToMint(mintSeed, commitmentValue, coin))
+        vCounts.push_back(nLastCount);
+        vSeedIds.push_back(seedId);
+        vMintSeeds.push_back(mintSeed);
+    }
+
+    // The mints are computed from the seeds in parallel, a commitment each
+    std::vector<GroupElement> vCommitments(vMintSeeds.size());
+    std::vector<uint256> vHashSerials(vMintSeeds.size());
+    std::vector<char> vMinted(vMintSeeds.size(), false);
+    sigma::Params* params = sigma::Params::get_default();
+    auto seedsToMints = [&](size_t nStart, size_t nStep) {
+        sigma::PrivateCoin coin(params, sigma::CoinDenomination::SIGMA_DENOM_1);
+        for (size_t i = nStart; i < vMintSeeds.size(); i += nStep) {
+            if (SeedToMint(vMintSeeds[i], vCommitments[i], coin)) {
+                vHashSerials[i] = primitives::GetSerialHash(coin.getSerialNumber());
+                vMinted[i] = true;
+            }
+        }
+    };
+
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), vMintSeeds.size());
+    boost::thread_group threads;
+    for (size_t nThread = 1; nThread < nThreads; ++nThread)
+        threads.create_thread([&seedsToMints, nThread, nThreads] { seedsToMints(nThread, nThreads); });
+    seedsToMints(0, std::max<size_t>(nThreads, 1));
+    threads.join_all();
+
+    // The pool and the count are written in a single database transaction
+    bool fTxn = walletdb.TxnBegin();
+    for (size_t i = 0; i < vMintSeeds.size(); ++i) {
+        if (!vMinted[i])
             continue;
 
-        uint256 hashPubcoin = primitives::GetPubCoinValueHash(commitmentValue);
+        uint256 hashPubcoin = primitives::GetPubCoinValueHash(vCommitments[i]);
 
-        MintPoolEntry mintPoolEntry(hashSeedMaster, seedId, nLastCount);
+        MintPoolEntry mintPoolEntry(hashSeedMaster, vSeedIds[i], vCounts[i]);
         mintPool.Add(make_pair(hashPubcoin, mintPoolEntry));
-        CWalletDB(strWalletFile).WritePubcoin(primitives::GetSerialHash(coin.getSerialNumber()), commitmentValue);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashPubcoin, mintPoolEntry);
-        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seedId.GetHex(), nLastCount);
+        walletdb.WritePubcoin(vHashSerials[i], vCommitments[i]);
+        walletdb.WriteMintPoolPair(hashPubcoin, mintPoolEntry);
+        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), vSeedIds[i].GetHex(), vCounts[i]);
     }
 
     // Update local + DB entries for count last generated
     nCountNextGenerate = nLastCount;
     walletdb.WriteMintSeedCount(nCountNextGenerate);
+    if (fTxn && !walletdb.TxnCommit())
+        LogPrintf("%s : failed to commit the mint pool to the database\n", __func__);
 
 }
 
@@ -253,6 +329,17 @@ void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::l
             listMints = list<pair<uint256, MintPoolEntry>>();
             mintPool.List(listMints.get());
         }
+
+        // Look for all entries not checked yet in the chain at once
+        std::set<uint256> setHashPubcoin;
+        for (const pair<uint256, MintPoolEntry>& pMint : listMints.get()) {
+            if (!setChecked.count(pMint.first) && !tracker.HasPubcoinHash(pMint.first))
+                setHashPubcoin.insert(pMint.first);
+        }
+        std::map<uint256, ChainMint> mapChainMints;
+        std::map<uint256, CTransaction> mapTxs;
+        FindMintsInChain(setHashPubcoin, mapChainMints, mapTxs);
+
         for (pair<uint256, MintPoolEntry>& pMint : listMints.get()) {
             if (setChecked.count(pMint.first))
                 continue;
@@ -268,71 +355,26 @@ void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::l
             if (tracker.HasPubcoinHash(pMint.first))
                 continue;
 
-            COutPoint outPoint;
-            if (sigma::GetOutPoint(outPoint, pMint.first)) {
-                const uint256& txHash = outPoint.hash;
+            auto itChainMint = mapChainMints.find(pMint.first);
+            if (itChainMint != mapChainMints.end()) {
+                const ChainMint& chainMint = itChainMint->second;
+                const uint256& txHash = chainMint.txHash;
                 //this mint has already occurred on the chain, increment counter's state to reflect this
                 LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), mintCount, txHash.GetHex());
                 found = true;
 
-                uint256 hashBlock;
-                CTransaction tx;
-                if (!GetTransaction(txHash, tx, Params().GetConsensus(), hashBlock, true)) {
-                    LogPrintf("%s : failed to get transaction for mint %s!\n", __func__, pMint.first.GetHex());
-                    found = false;
-                    continue;
-                }
-
-                //Find the denomination
-                boost::optional<sigma::CoinDenomination> denomination = boost::none;
-                bool fFoundMint = false;
-                GroupElement bnValue;
-                for (const CTxOut& out : tx.vout) {
-                    if (!out.scriptPubKey.IsSigmaMint())
-                        continue;
-
-                    sigma::PublicCoin pubcoin;
-                    CValidationState state;
-                    if (!TxOutToPublicCoin(out, pubcoin, state)) {
-                        LogPrintf("%s : failed to get mint from txout for %s!\n", __func__, pMint.first.GetHex());
-                        continue;
-                    }
-
-                    // See if this is the mint that we are looking for
-                    uint256 hashPubcoin = primitives::GetPubCoinValueHash(pubcoin.getValue());
-                    if (pMint.first == hashPubcoin) {
-                        denomination = pubcoin.getDenomination();
-                        bnValue = pubcoin.getValue();
-                        fFoundMint = true;
-                        break;
-                    }
-                }
-
-                if (!fFoundMint || denomination == boost::none) {
-                    LogPrintf("%s : failed to get mint %s from tx %s!\n", __func__, pMint.first.GetHex(), tx.GetHash().GetHex());
-                    found = false;
-                    break;
-                }
-
-                CBlockIndex* pindex = nullptr;
-                if (mapBlockIndex.count(hashBlock))
-                    pindex = mapBlockIndex.at(hashBlock);
-
                 if (!setAddedTx.count(txHash)) {
-                    CBlock block;
-                    CWalletTx wtx(pwalletMain, tx);
-                    if (pindex && ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                        LOCK(cs_main);
-                        wtx.SetMerkleBranch(block);
-                    }
+                    CWalletTx wtx(pwalletMain, mapTxs.at(txHash));
+                    wtx.hashBlock = chainMint.pindex->GetBlockHash();
+                    wtx.nIndex = chainMint.nIndex;
 
                     //Fill out wtx so that a transaction record can be created
-                    wtx.nTimeReceived = pindex->GetBlockTime();
+                    wtx.nTimeReceived = chainMint.pindex->GetBlockTime();
                     pwalletMain->AddToWallet(wtx, false, &walletdb);
                     setAddedTx.insert(txHash);
                 }
 
-                if(!SetMintSeedSeen(pMint, pindex->nHeight, txHash, denomination.get()))
+                if(!SetMintSeedSeen(pMint, chainMint.pindex->nHeight, txHash, chainMint.denomination))
                     continue;
 
                 // Only update if the current hashSeedMaster matches the mints'
@@ -349,6 +391,68 @@ void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::l
     }
 }
 
+/**
+ * Find mints of the mint pool in the chain.
+ *
+ * Rather than looking up each mint on its own, the mints are matched against the minted coins of
+ * the chain in a single pass, and each block holding any of them is read once.
+ *
+ * @param setHashPubcoin pubcoin hashes of the mints to look for
+ * @param mapMints reference to the mints found, by pubcoin hash. Is set in this function
+ * @param mapTxs reference to the transactions of the mints found, by txid. Is set in this function
+ */
+void CHDMintWallet::FindMintsInChain(const std::set<uint256>& setHashPubcoin, std::map<uint256, ChainMint>& mapMints, std::map<uint256, CTransaction>& mapTxs)
+{
+    if (setHashPubcoin.empty())
+        return;
+
+    // Mints found, by the height of their block
+    std::map<int, std::set<uint256>> mapHeights;
+    {
+        LOCK(cs_main);
+        for (const auto& mint : sigma::CSigmaState::GetState()->GetMintsByHash(setHashPubcoin))
+            mapHeights[mint.second.nHeight].insert(mint.first.getValueHash());
+    }
+
+    for (const auto& height : mapHeights) {
+        if (ShutdownRequested())
+            return;
+
+        CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[height.first];
+        }
+        CBlock block;
+        if (!pindex || !ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            LogPrintf("%s : failed to read block %d!\n", __func__, height.first);
+            continue;
+        }
+
+        for (size_t nIndex = 0; nIndex < block.vtx.size(); ++nIndex) {
+            const CTransaction& tx = block.vtx[nIndex];
+            for (const CTxOut& out : tx.vout) {
+                if (!out.scriptPubKey.IsSigmaMint())
+                    continue;
+
+                sigma::PublicCoin pubcoin;
+                CValidationState state;
+                if (!TxOutToPublicCoin(out, pubcoin, state)) {
+                    LogPrintf("%s : failed to get mint from txout of %s!\n", __func__, tx.GetHash().GetHex());
+                    continue;
+                }
+
+                const uint256& hashPubcoin = pubcoin.getValueHash();
+                if (!height.second.count(hashPubcoin))
+                    continue;
+
+                mapMints[hashPubcoin] = ChainMint{tx.GetHash(), static_cast<int>(nIndex), pindex, pubcoin.getDenomination()};
+                mapTxs[tx.GetHash()] = tx;
+            }
+        }
+    }
+}
+
 /**
  * Add the mint from the chain to the mint tracker.
  *
@@ -470,8 +574,7 @@ bool CHDMintWallet::SeedToMint(const uint512& mintSeed, GroupElement& commit, si
     coin.setRandomness(randomness);
 
     // Generate a Pedersen commitment to the serial number
-    commit = sigma::SigmaPrimitives<Scalar, GroupElement>::commit(
-             coin.getParams()->get_g(), coin.getSerialNumber(), coin.getParams()->get_h0(), coin.getRandomness());
+    commit = coin.getParams()->commit(coin.getSerialNumber(), coin.getRandomness());
 
     return true;
 }
@@ -543,16 +646,7 @@ bool CHDMintWallet::CreateMintSeed(uint512& mintSeed, const int32_t& nCount, CKe
         throw ZerocoinException("Unable to retrieve generated key for mint seed. Is the wallet locked?");
     }
 
-    // HMAC-SHA512(SHA256(count),key)
-    unsigned char countHash[CSHA256().OUTPUT_SIZE];
-    std::vector<unsigned char> result(CSHA512().OUTPUT_SIZE);
-
-    std::string nCountStr = to_string(nCount);
-    CSHA256().Write(reinterpret_cast<const unsigned char*>(nCountStr.c_str()), nCountStr.size()).Finalize(countHash);
-
-    CHMAC_SHA512(countHash, CSHA256().OUTPUT_SIZE).Write(key.begin(), key.size()).Finalize(&result[0]);
-
-    mintSeed = uint512(result);
+    mintSeed = KeyToMintSeed(key, nCount);
 
     return true;
 }
@@ -708,6 +802,88 @@ bool CHDMintWallet::GenerateMint(const sigma::CoinDenomination denom, sigma::Pri
     return true;
 }
 
+/**
+ * Generate the CHDMint objects of several new mints at once.
+ *
+ * The counts and seeds of the mints are taken in order, then the coins are computed from the seeds in
+ * parallel. A mint that turns out to exist already is replaced by GenerateMint, which tries the next counts.
+ *
+ * @param vCoins private coins to set, with the denomination of each mint
+ * @param vDMints set to the CHDMint objects of the coins
+ * @return success
+ */
+bool CHDMintWallet::GenerateMints(std::vector<sigma::PrivateCoin>& vCoins, std::vector<CHDMint>& vDMints)
+{
+    if(!fivegnodeSync.IsBlockchainSynced() && !(Params().NetworkIDString() == CBaseChainParams::REGTEST))
+        throw ZerocoinException("Unable to generate mint: Blockchain not yet synced.");
+
+    if(hashSeedMaster.IsNull())
+        throw ZerocoinException("Unable to generate mint: HashSeedMaster not set");
+
+    std::vector<MintPoolEntry> vMintPoolEntries;
+    std::vector<uint512> vMintSeeds;
+    for (size_t i = 0; i < vCoins.size(); ++i) {
+        CKeyID seedId = GetMintSeedID(nCountNextUse);
+        MintPoolEntry mintPoolEntry(hashSeedMaster, seedId, nCountNextUse);
+        UpdateCountLocal();
+
+        uint512 mintSeed;
+        CreateMintSeed(mintSeed, get<2>(mintPoolEntry), get<1>(mintPoolEntry));
+        vMintPoolEntries.push_back(mintPoolEntry);
+        vMintSeeds.push_back(mintSeed);
+    }
+
+    std::vector<char> vMinted(vCoins.size(), false);
+    auto seedsToMints = [&](size_t nStart, size_t nStep) {
+        for (size_t i = nStart; i < vCoins.size(); i += nStep) {
+            GroupElement commitmentValue;
+            if (SeedToMint(vMintSeeds[i], commitmentValue, vCoins[i])) {
+                vCoins[i].setPublicCoin(sigma::PublicCoin(commitmentValue, vCoins[i].getPublicCoin().getDenomination()));
+                vMinted[i] = true;
+            }
+        }
+    };
+
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), vCoins.size());
+    boost::thread_group threads;
+    for (size_t nThread = 1; nThread < nThreads; ++nThread)
+        threads.create_thread([&seedsToMints, nThread, nThreads] { seedsToMints(nThread, nThreads); });
+    seedsToMints(0, std::max<size_t>(nThreads, 1));
+    threads.join_all();
+
+    CWalletDB walletdb(strWalletFile);
+    sigma::CSigmaState *sigmaState = sigma::CSigmaState::GetState();
+    vDMints.clear();
+    for (size_t i = 0; i < vCoins.size(); ++i) {
+        sigma::CoinDenomination denom = vCoins[i].getPublicCoin().getDenomination();
+        const MintPoolEntry& mintPoolEntry = vMintPoolEntries[i];
+
+        if (!vMinted[i])
+            return false;
+
+        uint256 hashSerial = primitives::GetSerialHash(vCoins[i].getSerialNumber());
+        CHDMint dMint(get<2>(mintPoolEntry), get<1>(mintPoolEntry), hashSerial, vCoins[i].getPublicCoin().getValue());
+
+        // New HDMint exists, generate this one with the next counts instead
+        if(walletdb.HasHDMint(dMint.GetPubcoinValue()) ||
+           sigmaState->HasCoin(vCoins[i].getPublicCoin())) {
+            LogPrintf("%s: Coin detected used, trying next. count: %d\n", __func__, get<2>(mintPoolEntry));
+            if (!GenerateMint(denom, vCoins[i], dMint))
+                return false;
+            vDMints.push_back(dMint);
+            continue;
+        }
+
+        dMint.SetDenomination(denom);
+        LogPrintf("GenerateMints: hashPubcoin: %s hashSeedMaster: %s seedId: %s nCount: %d\n",
+                 dMint.GetPubCoinHash().ToString(),
+                 get<0>(mintPoolEntry).GetHex(), get<1>(mintPoolEntry).GetHex(), get<2>(mintPoolEntry));
+        vDMints.push_back(dMint);
+    }
+
+    return true;
+}
+
 /**
  * Regenerate a CSigmaEntry (ie. mint object with private data)
  *
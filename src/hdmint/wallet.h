@@ -6,6 +6,7 @@
 #define ZCOIN_HDMINTWALLET_H
 
 #include <map>
+#include <set>
 #include "libzerocoin/Zerocoin.h"
 #include "hdmint/mintpool.h"
 #include "uint256.h"
@@ -34,6 +35,7 @@ public:
     void SyncWithChain(bool fGenerateMintPool = true, boost::optional<std::list<std::pair<uint256, MintPoolEntry>>> listMints = boost::none);
     bool GetHDMintFromMintPoolEntry(const sigma::CoinDenomination denom, sigma::PrivateCoin& coin, CHDMint& dMint, MintPoolEntry& mintPoolEntry);
     bool GenerateMint(const sigma::CoinDenomination denom, sigma::PrivateCoin& coin, CHDMint& dMint, boost::optional<MintPoolEntry> mintPoolEntry = boost::none, bool fAllowUnsynced=false);
+    bool GenerateMints(std::vector<sigma::PrivateCoin>& vCoins, std::vector<CHDMint>& vDMints);
     bool LoadMintPoolFromDB();
     bool RegenerateMint(const CHDMint& dMint, CSigmaEntry& sigma);
     bool GetSerialForPubcoin(const std::vector<std::pair<uint256, GroupElement>>& serialPubcoinPairs, const uint256& hashPubcoin, uint256& hashSerial);
@@ -53,6 +55,15 @@ public:
     void UpdateCount();
 
 private:
+    // A mint of the mint pool found in the chain
+    struct ChainMint {
+        uint256 txHash;
+        int nIndex; // position of the transaction in the block
+        CBlockIndex* pindex;
+        sigma::CoinDenomination denomination;
+    };
+
+    void FindMintsInChain(const std::set<uint256>& setHashPubcoin, std::map<uint256, ChainMint>& mapMints, std::map<uint256, CTransaction>& mapTxs);
     CKeyID GetMintSeedID(int32_t nCount);
     bool CreateMintSeed(uint512& mintSeed, const int32_t& n, CKeyID& seedId);
 };
@@ -11,6 +11,7 @@
 #include "init.h"
 
 #include "addrman.h"
+#include "blockcache.h"
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -244,6 +245,12 @@ void PrepareShutdown(){
     StopAPI();
 #endif
 
+    // Callers join the thread group before getting here, so the scheduler thread is gone:
+    // run what is left of its queue and deliver any later signals synchronously, before
+    // the wallets are flushed and deleted
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(false);
@@ -430,6 +437,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-par=<n>", strprintf(
             _("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
             -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-prevalidationthreads=<n>", strprintf(
+            _("Set the number of threads verifying relayed transactions before they enter the mempool (0 to %d, 0 = off, default: %d)"),
+            MAX_SCRIPTCHECK_THREADS, DEFAULT_PREVALIDATION_THREADS));
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(
             _("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex and -rescan. "
@@ -511,6 +521,9 @@ std::string HelpMessage(HelpMessageMode mode) {
             _("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"),
             DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>",
+                               strprintf(_("Socket events mode, which must be one of: %s (default: %s)"),
+                                         GetSupportedSocketEventsModes(), GetSocketEventsModeName(DEFAULT_SOCKETEVENTS)));
     strUsage += HelpMessageOpt("-timeout=<n>",
                                strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"),
                                          DEFAULT_CONNECT_TIMEOUT));
@@ -543,6 +556,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-maxuploadtarget=<n>", strprintf(
             _("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)"),
             DEFAULT_MAX_UPLOAD_TARGET));
+    strUsage += HelpMessageOpt("-recentblockcache=<n>", strprintf(
+            _("Keep the last <n> connected blocks serialized in memory to serve them to peers, 0 to disable (default: %u)"),
+            DEFAULT_RECENT_BLOCK_CACHE));
 
 #ifdef ENABLE_WALLET
     strUsage += CWallet::GetWalletHelpString(showDebug);
@@ -589,7 +605,7 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-bip9params=deployment:start:end",
                                    "Use given start/end times for specified bip9 deployment (regtest-only)");
     }
-    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq"; // Don't translate these and qt below
+    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, validation, zmq"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(
@@ -710,6 +726,7 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-elysium", "Enable Elysium");
     strUsage += HelpMessageOpt("-startclean", "Clear all persistence files on startup; triggers reparsing of Elysium transactions");
     strUsage += HelpMessageOpt("-elysiumtxcache=<num>", "The maximum number of transactions in the input transaction cache (default: 500000)");
+    strUsage += HelpMessageOpt("-elysiumparsethreads=<n>", strprintf("Set the number of threads parsing the Elysium transactions of a block (1 to %d, 0 = auto, default: %d)", MAX_SCRIPTCHECK_THREADS, DEFAULT_ELYSIUM_PARSE_THREADS));
     strUsage += HelpMessageOpt("-elysiumprogressfrequency=<seconds>", "Time in seconds after which the initial scanning progress is reported (default: 30)");
     strUsage += HelpMessageOpt("-elysiumdebug=<category>", "Enable or disable log categories, can be \"all\" or \"none\"");
     strUsage += HelpMessageOpt("-autocommit=<flag>", "Enable or disable broadcasting of transactions, when creating transactions (default: 1)");
@@ -1232,8 +1249,15 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
+    std::string strSocketEvents = GetArg("-socketevents", GetSocketEventsModeName(DEFAULT_SOCKETEVENTS));
+    if (!ParseSocketEventsMode(strSocketEvents, nSocketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"),
+                                   strSocketEvents, GetSupportedSocketEventsModes()));
+
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    // (select() cannot wait on descriptors beyond FD_SETSIZE, epoll has no such limit)
+    if (nSocketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int) (FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1298,6 +1322,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nPrevalidationThreads = std::max(0, std::min((int)GetArg("-prevalidationthreads", DEFAULT_PREVALIDATION_THREADS), MAX_SCRIPTCHECK_THREADS));
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1465,6 +1491,11 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
+
+    LogPrintf("Using %u threads for transaction prevalidation\n", nPrevalidationThreads);
+    // The thread calling PrevalidateTransaction() takes part in the checks as well
+    for (int i = 0; i < nPrevalidationThreads - 1; i++)
+        threadGroup.create_thread(&ThreadPrevalidationCheck);
 	    if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1475,6 +1506,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1668,8 +1701,14 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
         if(!(pzmqPublisherInterface) || !(pzmqReplierInterface))
             return InitError(_("Unable to start ZMQ API. See debug log for details."));
 
-        // register publisher with validation interface
-        RegisterValidationInterface(pzmqPublisherInterface);
+        // register publisher with validation interface; publishing must not hold up validation
+        RegisterValidationInterface(pzmqPublisherInterface,
+            VALIDATION_SIGNAL_UPDATED_BLOCK_TIP | VALIDATION_SIGNAL_WALLET_TRANSACTION |
+            VALIDATION_SIGNAL_NUM_CONNECTIONS_CHANGED | VALIDATION_SIGNAL_UPDATE_SYNC_STATUS |
+            VALIDATION_SIGNAL_UPDATED_FIVEGNODE | VALIDATION_SIGNAL_UPDATED_MINT_STATUS |
+            VALIDATION_SIGNAL_UPDATED_SETTINGS | VALIDATION_SIGNAL_NOTIFY_API_STATUS |
+            VALIDATION_SIGNAL_NOTIFY_FIVEGNODE_LIST | VALIDATION_SIGNAL_UPDATED_BALANCE,
+            "zmqpublisher");
 
         // ZMQ API
         RegisterAllCoreAPICommands(tableAPI);
@@ -1679,6 +1718,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (mapArgs.count("-maxuploadtarget")) {
         CNode::SetMaxOutboundTarget(GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET) * 1024 * 1024);
     }
+    recentBlockCache.SetMaxSize(std::max((int64_t)0, GetArg("-recentblockcache", DEFAULT_RECENT_BLOCK_CACHE)));
     if (GetBoolArg("-resync", false)) {
             //Clear banned on resync aswell
             uiInterface.InitMessage(_("Preparing for resync..."));
@@ -1995,6 +2035,16 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
             }
         }
 
+        int nElysiumParseThreads = GetArg("-elysiumparsethreads", DEFAULT_ELYSIUM_PARSE_THREADS);
+        if (nElysiumParseThreads <= 0)
+            nElysiumParseThreads = GetNumCores();
+        nElysiumParseThreads = std::max(1, std::min(nElysiumParseThreads, MAX_SCRIPTCHECK_THREADS));
+
+        LogPrintf("Using %u threads for parsing Elysium transactions\n", nElysiumParseThreads);
+        // The thread connecting the block takes part in parsing as well
+        for (int i = 0; i < nElysiumParseThreads - 1; i++)
+            threadGroup.create_thread(&ThreadElysiumParse);
+
         uiInterface.InitMessage(_("Parsing Elysium transactions..."));
         elysium_init();
 
@@ -15,7 +15,9 @@
 #include "pos.h"
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "blockencodings.h"
+#include "chainsnapshot.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -96,6 +98,7 @@ int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nPrevalidationThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = false;
@@ -1220,6 +1223,9 @@ bool CheckTransaction(
     return true;
 }
 
+/** Script verification flags AcceptToMemoryPool checks loose transactions with */
+static const unsigned int MEMPOOL_SCRIPT_VERIFY_FLAGS = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC;
+
 void LimitMempoolSize(CTxMemPool &pool, size_t limit, unsigned long age) {
     int expired = pool.Expire(GetTime() - age);
     if (expired != 0)
@@ -1754,7 +1760,7 @@ bool AcceptToMemoryPoolWorker(
 
             // Check against previous transactions
             // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-            unsigned int scriptVerifyFlags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC;
+            unsigned int scriptVerifyFlags = MEMPOOL_SCRIPT_VERIFY_FLAGS;
             //        if (!Params().RequireStandard()) {
             //            scriptVerifyFlags = GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
             //        }
@@ -1913,8 +1919,8 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
                bool fAllowSlow) {
     CBlockIndex *pindexSlow = NULL;
 
-    LOCK(cs_main);
-
+    // The mempool and the transaction index have their own locking, only the
+    // UTXO scan below needs cs_main
     std::shared_ptr<const CTransaction> ptx = mempool.get(hash);
     if (ptx) {
         txOut = *ptx;
@@ -1943,6 +1949,7 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
     }
 
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+        LOCK(cs_main);
         int nHeight = -1;
         {
             const CCoinsViewCache &view = *pcoinsTip;
@@ -2789,6 +2796,124 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/** A script check or a Sigma spend proof check, run by the prevalidation queue */
+class CPrevalidationCheck
+{
+private:
+    CScriptCheck scriptCheck;
+    sigma::CSigmaSpendCheck sigmaCheck;
+    bool fSigma;
+
+public:
+    CPrevalidationCheck() : fSigma(false) {}
+    explicit CPrevalidationCheck(CScriptCheck &check) : fSigma(false) { scriptCheck.swap(check); }
+    explicit CPrevalidationCheck(sigma::CSigmaSpendCheck &check) : fSigma(true) { sigmaCheck.swap(check); }
+
+    bool operator()() {
+        return fSigma ? sigmaCheck() : scriptCheck();
+    }
+
+    void swap(CPrevalidationCheck &check) {
+        scriptCheck.swap(check.scriptCheck);
+        sigmaCheck.swap(check.sigmaCheck);
+        std::swap(fSigma, check.fSigma);
+    }
+};
+
+static CCheckQueue<CPrevalidationCheck> prevalidationqueue(16);
+// CCheckQueueControl requires the queue to have a single controller at a time
+static CCriticalSection cs_prevalidation;
+
+void ThreadPrevalidationCheck() {
+    RenameThread("bitcoin-prevalid");
+    prevalidationqueue.Thread();
+}
+
+bool PrevalidateTransaction(const CTransaction &tx, CValidationState &state) {
+    if (nPrevalidationThreads <= 0 || tx.IsCoinBase() || tx.IsCoinStake())
+        return true;
+
+    int64_t nTimeStart = GetTimeMicros();
+    const uint256 hash = tx.GetHash();
+    std::vector<CPrevalidationCheck> vChecks;
+    PrecomputedTransactionData txdata(tx);
+
+    // Only gather what the checks need under the locks, the checks themselves
+    // run without cs_main
+    {
+        LOCK2(cs_main, mempool.cs);
+        if (mempool.exists(hash))
+            return true;
+
+        // Cheap checks first so junk doesn't get its scripts or proofs verified.
+        // The Sigma proofs are left out here, they are what the queue is for.
+        if (!CheckTransaction(tx, state, hash, false, INT_MAX, false, false))
+            return false;
+
+        // Policy failures aren't an offence, AcceptToMemoryPool reports them
+        bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
+        bool witnessEnabled = IsWitnessEnabled(chainActive.Tip(), Params().GetConsensus());
+        string reason;
+        if ((!fTestNet && fRequireStandard && !IsStandardTx(tx, reason, witnessEnabled)) ||
+                !CheckFinalTx(tx, STANDARD_LOCKTIME_VERIFY_FLAGS))
+            return true;
+
+        if (tx.IsSigmaSpend()) {
+            // Spends of unknown coin groups may just be ahead of our chain
+            std::vector<sigma::CSigmaSpendCheck> vSigmaChecks;
+            if (!sigma::GetSigmaSpendChecks(tx, vSigmaChecks))
+                return true;
+            BOOST_FOREACH(sigma::CSigmaSpendCheck &check, vSigmaChecks)
+                vChecks.push_back(CPrevalidationCheck(check));
+        } else {
+            CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+            CAmount nValueIn = 0;
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn &txin = tx.vin[i];
+                if (txin.IsZerocoinSpend() || txin.IsZerocoinRemint() || txin.prevout.IsNull())
+                    return true;
+
+                // Don't let prevalidation grow the coins cache, AcceptToMemoryPool
+                // uncaches the coins of transactions it rejects the same way
+                bool fHadCoins = pcoinsTip->HaveCoinsInCache(txin.prevout.hash);
+                CCoins coins;
+                bool fHaveCoins = viewMemPool.GetCoins(txin.prevout.hash, coins);
+                if (!fHadCoins)
+                    pcoinsTip->Uncache(txin.prevout.hash);
+                // Orphans and double spends are for AcceptToMemoryPool to sort out
+                if (!fHaveCoins || !coins.IsAvailable(txin.prevout.n))
+                    return true;
+                nValueIn += coins.vout[txin.prevout.n].nValue;
+
+                // Only the mandatory flags, so that a failure makes the transaction
+                // invalid rather than nonstandard. The signature cache doesn't
+                // depend on the flags, AcceptToMemoryPool still hits it.
+                CScriptCheck check(coins, tx, i, MANDATORY_SCRIPT_VERIFY_FLAGS, true, &txdata);
+                vChecks.push_back(CPrevalidationCheck(check));
+            }
+
+            if (nValueIn < tx.GetValueOut())
+                return state.DoS(100, false, REJECT_INVALID, "bad-txns-in-belowout");
+        }
+    }
+
+    size_t nChecks = vChecks.size();
+    bool fOk;
+    {
+        LOCK(cs_prevalidation);
+        CCheckQueueControl<CPrevalidationCheck> control(&prevalidationqueue);
+        control.Add(vChecks);
+        fOk = control.Wait();
+    }
+
+    LogPrint("mempool", "Prevalidated %s: %u checks %s in %.2fms\n", hash.ToString(), nChecks,
+             fOk ? "passed" : "failed", 0.001 * (GetTimeMicros() - nTimeStart));
+    if (!fOk)
+        return state.DoS(100, false, REJECT_INVALID, tx.IsSigmaSpend() ?
+                         "bad-txns-sigma-spend-proof" : "mandatory-script-verify-flag-failed");
+    return true;
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -3410,6 +3535,7 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams &chainParams) {
     // LogPrintf("UpdateTip() pindexNew.nHeight=%s\n", pindexNew->nHeight);
     chainActive.SetTip(pindexNew);
+    PublishChainTipSnapshot(pindexNew);
     mnodeman.UpdatedBlockTip(chainActive.Tip());
     darkSendPool.UpdatedBlockTip(chainActive.Tip());
     mnpayments.UpdatedBlockTip(chainActive.Tip());
@@ -3667,6 +3793,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     if (fElysium) {
         LogPrint("handler", "Elysium handler: block connect begin [height: %d]\n", GetHeight());
         elysium_handler_block_begin(GetHeight(), pindexNew);
+        elysium_handler_block_prepare(*pblock, pindexNew->nHeight, pindexNew);
     }
 #endif
 
@@ -3681,6 +3808,10 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
 
     // Update chainActive & related variables.
     UpdateTip(pindexNew, chainparams);
+
+    // Peers will ask for a new tip right after it is announced, have it ready to send
+    if (!IsInitialBlockDownload())
+        recentBlockCache.Add(*pblock, pindexNew->GetBlockHash());
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(
@@ -3688,18 +3819,18 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
         SyncWithWallets(tx, pindexNew, NULL);
     }
     // ... and about transactions that got confirmed:
-    BOOST_FOREACH(
-    const CTransaction &tx, pblock->vtx) {
-        SyncWithWallets(tx, pindexNew, pblock);
+    SyncBlockWithWallets(pindexNew, pblock);
 
 #ifdef ENABLE_ELYSIUM
+    BOOST_FOREACH(
+    const CTransaction &tx, pblock->vtx) {
         //! Elysium: new confirmed transaction notification
         if (fElysium) {
             LogPrint("handler", "Elysium handler: new confirmed transaction [height: %d, vgc: %u]\n", GetHeight(), nTxIdx);
             if (elysium_handler_tx(tx, GetHeight(), nTxIdx++, pindexNew)) ++nNumMetaTxs;
         }
-#endif
     }
+#endif
 
 #ifdef ENABLE_WALLET
     // Sync with HDMint wallet
@@ -5482,6 +5613,7 @@ bool static LoadBlockIndexDB() {
         return true;
     }
     chainActive.SetTip(it->second);
+    PublishChainTipSnapshot(it->second);
 
     PruneBlockIndexCandidates();
 
@@ -5708,6 +5840,7 @@ void UnloadBlockIndex() {
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    PublishChainTipSnapshot(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
@@ -6324,13 +6457,24 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
-                    else if (inv.type == MSG_WITNESS_BLOCK)
+                    // Send recently connected blocks from memory, anything else from disk
+                    CRecentBlockCache::Entry cached;
+                    std::shared_ptr<const CBlock> pblock;
+                    if (recentBlockCache.Get(inv.hash, cached)) {
+                        pblock = cached.block;
+                    } else {
+                        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                        if (!ReadBlockFromDisk(*pblockRead, (*mi).second, consensusParams))
+                            assert(!"cannot load block from disk");
+                        pblock = pblockRead;
+                    }
+                    const CBlock &block = *pblock;
+                    if (inv.type == MSG_BLOCK) {
+                        if (cached.blockMsg)
+                            pfrom->PushSerializedMessage(NetMsgType::BLOCK, cached.blockMsg);
+                        else
+                            pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
+                    } else if (inv.type == MSG_WITNESS_BLOCK)
                         pfrom->PushMessage(NetMsgType::BLOCK, block);
                     else if (inv.type == MSG_FILTERED_BLOCK) {
                         bool send = false;
@@ -6365,10 +6509,16 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                         bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
                         if (CanDirectFetch(consensusParams) &&
                                 mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
-                            CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
-                            pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
-                                    NetMsgType::CMPCTBLOCK, cmpctblock);
-                        } else
+                            if (!fPeerWantsWitness && cached.cmpctBlockMsg) {
+                                pfrom->PushSerializedMessage(NetMsgType::CMPCTBLOCK, cached.cmpctBlockMsg);
+                            } else {
+                                CBlockHeaderAndShortTxIDs cmpctblock(block, fPeerWantsWitness);
+                                pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
+                                        NetMsgType::CMPCTBLOCK, cmpctblock);
+                            }
+                        } else if (!fPeerWantsWitness && cached.blockMsg)
+                            pfrom->PushSerializedMessage(NetMsgType::BLOCK, cached.blockMsg);
+                        else
                             pfrom->PushMessageWithFlag(fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS,
                                     NetMsgType::BLOCK, block);
                     }
@@ -7232,6 +7382,34 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
             pmn->fAllowMixingTx = false;
         }
 
+        // Verify scripts and proofs before taking cs_main so the locked
+        // mempool acceptance below only hits the caches
+        bool fAlreadyHave;
+        {
+            LOCK(cs_main);
+            fAlreadyHave = AlreadyHave(inv);
+        }
+        CValidationState statePrevalidation;
+        if (!fAlreadyHave && !tx.IsZerocoinSpend() && !PrevalidateTransaction(tx, statePrevalidation)) {
+            LOCK(cs_main);
+            pfrom->setAskFor.erase(inv.hash);
+            mapAlreadyAskedFor.erase(inv.hash);
+            if (tx.wit.IsNull() && !statePrevalidation.CorruptionPossible()) {
+                assert(recentRejects);
+                recentRejects->insert(inv.hash);
+            }
+            int nDoS = 0;
+            if (statePrevalidation.IsInvalid(nDoS)) {
+                LogPrint("mempool", "%s from peer=%d failed prevalidation: %s\n", inv.hash.ToString(),
+                         pfrom->id, FormatStateMessage(statePrevalidation));
+                pfrom->PushMessage(NetMsgType::REJECT, strCommand, (unsigned char) statePrevalidation.GetRejectCode(),
+                                   statePrevalidation.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+                if (nDoS > 0)
+                    Misbehaving(pfrom->GetId(), nDoS);
+            }
+            return true;
+        }
+
         LOCK(cs_main);
 
         bool fMissingInputs = false;
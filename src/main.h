@@ -95,6 +95,8 @@ static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000; // 50KB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -prevalidationthreads default (threads verifying relayed transactions before cs_main is taken, 0 = off) */
+static const int DEFAULT_PREVALIDATION_THREADS = 2;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -201,6 +203,7 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nPrevalidationThreads;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
@@ -296,6 +299,17 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the transaction prevalidation thread */
+void ThreadPrevalidationCheck();
+/**
+ * Verify the input scripts or Sigma spend proofs of a loose transaction
+ * without holding cs_main, filling the signature and proof caches so the
+ * checks in AcceptToMemoryPool only need cache lookups. Returns false if the
+ * transaction is invalid, with state saying why. Transactions failing only
+ * policy checks, or whose inputs could not be found, are left to
+ * AcceptToMemoryPool.
+ */
+bool PrevalidateTransaction(const CTransaction &tx, CValidationState &state);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -155,7 +155,15 @@ NodeId nLastNodeId = 0;
 CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
-boost::condition_variable messageHandlerCondition;
+
+// Socket readiness backend of ThreadSocketHandler
+SocketEventsMode nSocketEventsMode = DEFAULT_SOCKETEVENTS;
+static CSocketEvents *psocketEvents = NULL;
+
+// Wakes ThreadMessageHandler; fMsgProcWake is set so a wakeup is not lost while it is busy
+static boost::mutex mutexMsgProc;
+static boost::condition_variable condMsgProc;
+static bool fMsgProcWake = false;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -507,6 +515,8 @@ void CNode::CloseSocketDisconnect() {
     fDisconnect = true;
     if (hSocket != INVALID_SOCKET) {
         LogPrint("net", "disconnecting peer=%d\n", id);
+        if (psocketEvents)
+            psocketEvents->RemoveSocket(hSocket);
         CloseSocket(hSocket);
     }
 
@@ -730,6 +740,19 @@ void CNode::copyStats(CNodeStats &stats) {
 
 #undef X
 
+void WakeMessageHandler() {
+    {
+        boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+        fMsgProcWake = true;
+    }
+    condMsgProc.notify_one();
+}
+
+void WakeSocketHandler() {
+    if (psocketEvents)
+        psocketEvents->Wake();
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes) {
     while (nBytes > 0) {
@@ -770,7 +793,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes) {
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
 
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            WakeMessageHandler();
         }
     }
 
@@ -825,10 +848,10 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes) {
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode) {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<std::shared_ptr<const CSerializeData> >::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
+        const CSerializeData &data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset,
                           MSG_NOSIGNAL | MSG_DONTWAIT);
@@ -1109,7 +1132,7 @@ static void AcceptConnection(const ListenSocket &hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (nSocketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1314,24 +1337,13 @@ void ThreadSocketHandler() {
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+        int64_t nTimeoutMs = 50; // frequency to poll pnode->vSend
+
+        CSocketEvents::InterestMap mapInterest;
 
         BOOST_FOREACH(
         const ListenSocket &hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+            mapInterest[hListenSocket.socket] = CSocketEvents::EVENT_RECV;
         }
 
         {
@@ -1340,18 +1352,17 @@ void ThreadSocketHandler() {
             {
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+                int &nInterest = mapInterest[pnode->hSocket];
+                nInterest = CSocketEvents::EVENT_ERR;
 
                 // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
+                // * If there is data to send, wait for sending data. As this only
                 //   happens when optimistic write failed, we choose to first drain the
                 //   write buffer in this case before receiving more. This avoids
                 //   needlessly queueing received data, if the remote peer is not themselves
                 //   receiving data. This means properly utilizing TCP flow control signalling.
                 // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
+                //   or there is space left in the buffer, wait for receiving data.
                 // * (if neither of the above applies, there is certainly one message
                 //   in the receiver buffer ready to be processed).
                 // Together, that means that at least one of the following is always possible,
@@ -1362,7 +1373,7 @@ void ThreadSocketHandler() {
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
                     if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
+                        nInterest |= CSocketEvents::EVENT_SEND;
                         continue;
                     }
                 }
@@ -1371,25 +1382,24 @@ void ThreadSocketHandler() {
                     if (lockRecv && (
                             pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
                             pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                        nInterest |= CSocketEvents::EVENT_RECV;
                 }
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        CSocketEvents::ReadyList vReady;
+        bool fWaitOk = psocketEvents->Wait(mapInterest, nTimeoutMs, vReady);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
+        std::map<SOCKET, int> mapReady(vReady.begin(), vReady.end());
+        if (!fWaitOk) {
+            if (!mapInterest.empty()) {
                 int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+                LogPrintf("socket %s error %s\n", GetSocketEventsModeName(psocketEvents->GetMode()), NetworkErrorString(nErr));
+                for (CSocketEvents::InterestMap::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it)
+                    mapReady[it->first] = CSocketEvents::EVENT_RECV;
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
+            MilliSleep(nTimeoutMs);
         }
 
         //
@@ -1398,7 +1408,7 @@ void ThreadSocketHandler() {
         BOOST_FOREACH(
         const ListenSocket &hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            if (hListenSocket.socket != INVALID_SOCKET && mapReady.count(hListenSocket.socket)) {
                 AcceptConnection(hListenSocket);
             }
         }
@@ -1422,7 +1432,9 @@ void ThreadSocketHandler() {
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            std::map<SOCKET, int>::const_iterator itReady = mapReady.find(pnode->hSocket);
+            int nReady = itReady != mapReady.end() ? itReady->second : 0;
+            if (nReady & (CSocketEvents::EVENT_RECV | CSocketEvents::EVENT_ERR)) {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
                     {
@@ -1459,7 +1471,7 @@ void ThreadSocketHandler() {
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            if (nReady & CSocketEvents::EVENT_SEND) {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
                     SocketSendData(pnode);
@@ -1990,9 +2002,6 @@ bool OpenNetworkConnection(
 
 
 void ThreadMessageHandler() {
-    boost::mutex condition_mutex;
-    boost::unique_lock<boost::mutex> lock(condition_mutex);
-
     while (true) {
         std::vector < CNode * > vNodesCopy;
         {
@@ -2015,9 +2024,14 @@ void ThreadMessageHandler() {
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                 if (lockRecv) {
+                    bool fFlooded = pnode->GetTotalRecvSize() > ReceiveFloodSize();
                     if (!GetNodeSignals().ProcessMessages(pnode))
                         pnode->CloseSocketDisconnect();
 
+                    // The socket handler stopped receiving from this peer, let it resume now
+                    if (fFlooded && pnode->GetTotalRecvSize() <= ReceiveFloodSize())
+                        WakeSocketHandler();
+
                     if (pnode->nSendSize < SendBufferSize()) {
                         if (!pnode->vRecvGetData.empty() ||
                             (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
@@ -2043,9 +2057,13 @@ void ThreadMessageHandler() {
             pnode->Release();
         }
 
-        if (fSleep)
-            messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() +
-                                                     boost::posix_time::milliseconds(100));
+        boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+        if (fSleep && !fMsgProcWake) {
+            // Woken when a message is received; the timeout drives SendMessages' timers
+            condMsgProc.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() +
+                                         boost::posix_time::milliseconds(100));
+        }
+        fMsgProcWake = false;
     }
 }
 
@@ -2342,6 +2360,16 @@ void StartNode(boost::thread_group &threadGroup, CScheduler &scheduler) {
     // Map ports with UPnP
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
+    if (psocketEvents == NULL) {
+        psocketEvents = CSocketEvents::Create(nSocketEventsMode);
+        if (psocketEvents == NULL) {
+            LogPrintf("Falling back to select() for socket events\n");
+            nSocketEventsMode = SOCKETEVENTS_SELECT;
+            psocketEvents = CSocketEvents::Create(nSocketEventsMode);
+        }
+        LogPrintf("Using %s for socket events\n", GetSocketEventsModeName(nSocketEventsMode));
+    }
+
     // Send and receive from sockets, accept connections
     threadGroup.create_thread(
         boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
@@ -2405,6 +2433,8 @@ public:
         vhListenSocket.clear();
         delete semOutbound;
         semOutbound = NULL;
+        delete psocketEvents;
+        psocketEvents = NULL;
         delete pnodeLocalHost;
         pnodeLocalHost = NULL;
 
@@ -2955,17 +2985,58 @@ void CNode::EndMessage(const char *pszCommand) UNLOCK_FUNCTION(cs_vSend) {
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    std::shared_ptr<CSerializeData> pmsg = std::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*pmsg);
+    nSendSize += pmsg->size();
+    vSendMsg.push_back(pmsg);
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1)
         SocketSendData(this);
 
+    // Data is left over, let the socket handler wait until the socket is writable
+    if (!vSendMsg.empty())
+        WakeSocketHandler();
+
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
 
+void CNode::PushSerializedMessage(const char *pszCommand, const std::shared_ptr<const CSerializeData> &pmsg) {
+    assert(pmsg->size() >= CMessageHeader::HEADER_SIZE);
+
+    LOCK(cs_vSend);
+    unsigned int nSize = pmsg->size() - CMessageHeader::HEADER_SIZE;
+    mapSendBytesPerMsgCmd[std::string(pszCommand)] += pmsg->size();
+    LogPrint("net", "sending: %s (%d bytes, prepared) peer=%d\n", SanitizeString(pszCommand), nSize, id);
+
+    nSendSize += pmsg->size();
+    vSendMsg.push_back(pmsg);
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SocketSendData(this);
+
+    if (!vSendMsg.empty())
+        WakeSocketHandler();
+}
+
+std::shared_ptr<const CSerializeData> MakeNetMessage(const char *pszCommand, const CDataStream &ssPayload) {
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    ssMsg << CMessageHeader(Params().MessageStart(), pszCommand, ssPayload.size());
+    if (!ssPayload.empty())
+        ssMsg.write(&ssPayload[0], ssPayload.size());
+
+    // Set the checksum
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    memcpy((char *) &ssMsg[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+
+    std::shared_ptr<CSerializeData> pmsg = std::make_shared<CSerializeData>();
+    ssMsg.GetAndClear(*pmsg);
+    return pmsg;
+}
+
 //
 // CBanDB
 //
@@ -14,6 +14,7 @@
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
+#include "socketevents.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
@@ -22,6 +23,7 @@
 
 #include <atomic>
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -103,6 +105,22 @@ bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode *pnode);
+/** Frame a serialized payload as a complete network message, header and checksum included */
+std::shared_ptr<const CSerializeData> MakeNetMessage(const char* pszCommand, const CDataStream& ssPayload);
+
+/** Serialize obj once as a complete network message, so it can be pushed to many peers with CNode::PushSerializedMessage */
+template<typename T>
+std::shared_ptr<const CSerializeData> SerializeNetMessage(const char* pszCommand, int nVersion, const T& obj)
+{
+    CDataStream ssPayload(SER_NETWORK, nVersion);
+    ssPayload << obj;
+    return MakeNetMessage(pszCommand, ssPayload);
+}
+
+/** Make ThreadMessageHandler look at the nodes again without waiting for its timeout */
+void WakeMessageHandler();
+/** Make ThreadSocketHandler recompute which sockets it waits for, e.g. after data was queued for sending */
+void WakeSocketHandler();
 
 struct CombinerAll
 {
@@ -170,6 +188,8 @@ extern CAddrMan addrman;
 
 /** Maximum number of connections to simultaneously allow (aka connection slots) */
 extern int nMaxConnections;
+/** How ThreadSocketHandler waits for socket readiness */
+extern SocketEventsMode nSocketEventsMode;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
@@ -335,7 +355,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<std::shared_ptr<const CSerializeData> > vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -608,6 +628,9 @@ public:
 
     void PushVersion();
 
+    /** Queue a complete message serialized beforehand (see SerializeNetMessage) without copying it */
+    void PushSerializedMessage(const char* pszCommand, const std::shared_ptr<const CSerializeData>& pmsg);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -12,6 +12,7 @@
 #include "elysium/elysium.h"
 #include "elysium/sp.h"
 #include "elysium/tally.h"
+#include "elysium/walletcache.h"
 #include "elysium/wallettxs.h"
 
 #include "amount.h"
@@ -207,33 +208,13 @@ void ElyAssetsDialog::PopulateBalances(unsigned int propertyId)
         ui->balancesTable->setHorizontalHeaderItem(1, new QTableWidgetItem("Address"));
         bool propertyIsDivisible = isPropertyDivisible(propertyId); // only fetch the SP once, not for every address
 
-        // iterate mp_tally_map looking for addresses that hold a balance in propertyId
-        for(std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+        // the wallet addresses that hold a balance in propertyId, as of the last wallet update
+        const WalletBalanceMap& balances = GetWalletBalances(propertyId);
+        for (WalletBalanceMap::const_iterator my_it = balances.begin(); my_it != balances.end(); ++my_it) {
             const std::string& address = my_it->first;
-            CMPTally& tally = my_it->second;
-            tally.init();
-
-            uint32_t id;
-            bool watchAddress = false, includeAddress = false;
-            while (0 != (id = (tally.next()))) {
-                if (id == propertyId) {
-                    includeAddress = true;
-                    break;
-                }
-            }
-            if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
-
-            // determine if this address is in the wallet
-            int addressIsMine = IsMyAddress(address);
-            if (!addressIsMine) continue; // ignore this address, not in wallet
-            if (addressIsMine != ISMINE_SPENDABLE) watchAddress = true;
-
-            // obtain the balances for the address directly form tally
-            int64_t available = tally.getMoney(propertyId, BALANCE);
-            available += tally.getMoney(propertyId, PENDING);
-            int64_t reserved = tally.getMoney(propertyId, SELLOFFER_RESERVE);
-            reserved += tally.getMoney(propertyId, ACCEPT_RESERVE);
-            reserved += tally.getMoney(propertyId, METADEX_RESERVE);
+            bool watchAddress = (my_it->second.ismine != ISMINE_SPENDABLE);
+            int64_t available = my_it->second.available;
+            int64_t reserved = my_it->second.reserved;
 
             // format the balances
             string reservedStr, availableStr;
@@ -21,6 +21,7 @@
 #include "elysium/sp.h"
 #include "elysium/tally.h"
 #include "elysium/utilsbitcoin.h"
+#include "elysium/walletcache.h"
 #include "elysium/wallettxs.h"
 #include "elysium/uint256_extensions.h"
 #include "amount.h"
@@ -137,16 +138,10 @@ void MetaDExDialog::PopulateAddresses()
         uint32_t propertyId = GetPropForSale();
         QString currentSetAddress = ui->comboAddress->currentText();
         ui->comboAddress->clear();
-        for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-            string address = (my_it->first).c_str();
-            uint32_t id;
-            (my_it->second).init();
-            while (0 != (id = (my_it->second).next())) {
-                if (id == propertyId) {
-                    if (!getUserAvailableMPbalance(address, propertyId)) continue; // ignore this address, has no available balance to spend
-                    if (IsMyAddress(address)) ui->comboAddress->addItem((my_it->first).c_str()); // only include wallet addresses
-                }
-            }
+        const WalletBalanceMap& balances = GetWalletBalances(propertyId);
+        for (WalletBalanceMap::const_iterator my_it = balances.begin(); my_it != balances.end(); ++my_it) {
+            if (!my_it->second.available) continue; // ignore this address, has no available balance to spend
+            ui->comboAddress->addItem((my_it->first).c_str());
         }
         int vgc = ui->comboAddress->findText(currentSetAddress);
         if (vgc != -1) { ui->comboAddress->setCurrentIndex(vgc); }
@@ -163,8 +158,11 @@ void MetaDExDialog::UpdateProperties()
     ui->comboPairTokenA->clear();
     ui->comboPairTokenB->clear();
 
+    uint32_t lastPropertyId = 0;
     for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        uint32_t propertyId = my_it->first;
+        uint32_t propertyId = my_it->first.first;
+        if (propertyId == lastPropertyId) continue; // already listed for another pair of the property
+        lastPropertyId = propertyId;
         if ((testEco && !isTestEcosystemProperty(propertyId)) || (!testEco && isTestEcosystemProperty(propertyId))) continue;
         string spName;
         spName = getPropertyName(propertyId).c_str();
@@ -347,8 +345,8 @@ void MetaDExDialog::UpdateOffers()
     bool divisSale = isPropertyDivisible(GetPropForSale());
     bool divisDes = isPropertyDivisible(GetPropDesired());
 
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if ((my_it->first != GetPropForSale())) continue; // not the property we're looking for, don't waste any more work
+    md_PropertiesMap::iterator my_it = metadex.find(md_PropertyPair(GetPropForSale(), GetPropDesired()));
+    if (my_it != metadex.end()) {
         md_PricesMap & prices = my_it->second;
         for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) { // loop through the sell prices for the property
             std::string unitPriceStr;
@@ -356,7 +354,6 @@ void MetaDExDialog::UpdateOffers()
             md_Set & indexes = (it->second);
             for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) { // multiple sell offers can exist at the same price, sum them for the UI
                 const CMPMetaDEx& obj = *it;
-                if ((obj.getDesProperty() != GetPropDesired())) continue; // not the property we're interested in
                 if (IsMyAddress(obj.getAddr())) includesMe = true;
                 std::string strAvail;
                 if (divisSale) {
@@ -20,6 +20,7 @@
 #include "../elysium/tally.h"
 #include "../elysium/tx.h"
 #include "../elysium/utilsbitcoin.h"
+#include "../elysium/walletcache.h"
 #include "../elysium/wallettxs.h"
 
 #include "../amount.h"
@@ -187,18 +188,12 @@ void SendMPDialog::updateProperty()
     QString spId = ui->propertyComboBox->itemData(ui->propertyComboBox->currentIndex()).toString();
     uint32_t propertyId = spId.toUInt();
     LOCK(cs_main);
-    for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        string address = (my_it->first).c_str();
-        uint32_t id = 0;
-        bool includeAddress=false;
-        (my_it->second).init();
-        while (0 != (id = (my_it->second).next())) {
-            if(id == propertyId) { includeAddress=true; break; }
-        }
-        if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
-        if (IsMyAddress(address) != ISMINE_SPENDABLE) continue; // ignore this address, it's not spendable
-        if (!getUserAvailableMPbalance(address, propertyId)) continue; // ignore this address, has no available balance to spend
-        ui->sendFromComboBox->addItem(QString::fromStdString(address + " \t" + FormatMP(propertyId, getUserAvailableMPbalance(address, propertyId)) + getTokenLabel(propertyId)));
+    const WalletBalanceMap& balances = GetWalletBalances(propertyId);
+    for (WalletBalanceMap::const_iterator my_it = balances.begin(); my_it != balances.end(); ++my_it) {
+        const string& address = my_it->first;
+        if (my_it->second.ismine != ISMINE_SPENDABLE) continue; // ignore this address, it's not spendable
+        if (!my_it->second.available) continue; // ignore this address, has no available balance to spend
+        ui->sendFromComboBox->addItem(QString::fromStdString(address + " \t" + FormatMP(propertyId, my_it->second.available) + getTokenLabel(propertyId)));
     }
 
     // attempt to set from address back to cached value
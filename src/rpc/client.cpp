@@ -163,6 +163,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
 	{ "elysium_listmints", 0 },
 	{ "elysium_listmints", 1 },
 	{ "elysium_listmints", 2 },
+	{ "elysium_getwalletbalancechanges", 0 },
 	{ "elysium_getallbalancesforid", 0 },
 	{ "elysium_listblocktransactions", 0 },
 	{ "elysium_getorderbook", 0 },
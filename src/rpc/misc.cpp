@@ -14,6 +14,7 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 #include "spork.h"
 #ifdef ENABLE_WALLET
 #include "fivegnode-sync.h"
@@ -1244,6 +1245,49 @@ UniValue getzerocoinsupply(const UniValue& params, bool fHelp)
     return result;
 }
 
+UniValue getvalidationqueueinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getvalidationqueueinfo\n"
+            "Returns the state of the asynchronous validation notification queue.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"pending\": n,                 (numeric) callbacks currently queued or running\n"
+            "  \"maxpending\": n,              (numeric) largest queue depth seen since startup\n"
+            "  \"subscribers\": [              (array) subscribers receiving asynchronous signals\n"
+            "    {\n"
+            "      \"name\": \"name\",           (string) the subscriber\n"
+            "      \"callbacks\": n,           (numeric) callbacks run so far\n"
+            "      \"totaltime\": n,           (numeric) total time spent in callbacks, in microseconds\n"
+            "      \"maxtime\": n              (numeric) longest single callback, in microseconds\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "")
+        );
+
+    UniValue subscribers(UniValue::VARR);
+    std::vector<CValidationInterfaceStats> vStats = GetValidationInterfaceStats();
+    BOOST_FOREACH(const CValidationInterfaceStats& stats, vStats) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("name", stats.strName));
+        entry.push_back(Pair("callbacks", stats.nCallbacks));
+        entry.push_back(Pair("totaltime", stats.nTotalTimeMicros));
+        entry.push_back(Pair("maxtime", stats.nMaxTimeMicros));
+        subscribers.push_back(entry);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("pending", (uint64_t)GetValidationInterfaceQueueSize()));
+    result.push_back(Pair("maxpending", (uint64_t)GetValidationInterfaceMaxQueueSize()));
+    result.push_back(Pair("subscribers", subscribers));
+
+    return result;
+}
+
 UniValue getinfoex(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -1313,6 +1357,7 @@ static const CRPCCommand commands[] =
     { "hidden",             "setmocktime",            &setmocktime,            true  },
     { "hidden",             "getzerocoinsupply",      &getzerocoinsupply,      false },
     { "hidden",             "getinfoex",              &getinfoex,              false },
+    { "hidden",             "getvalidationqueueinfo", &getvalidationqueueinfo, true  },
 
 };
 
@@ -4,6 +4,7 @@
 
 #include "rpc/server.h"
 
+#include "blockcache.h"
 #include "chainparams.h"
 #include "clientversion.h"
 #include "main.h"
@@ -353,6 +354,13 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"blockcache\":\n"
+            "  {\n"
+            "    \"size\": n,                              (numeric) Number of recent blocks kept ready to serve\n"
+            "    \"maxsize\": n,                           (numeric) Maximum number of blocks kept (-recentblockcache)\n"
+            "    \"hits\": n,                              (numeric) Block requests served from the cache\n"
+            "    \"misses\": n                             (numeric) Block requests read from disk\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -373,6 +381,13 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     outboundLimit.push_back(Pair("bytes_left_in_cycle", CNode::GetOutboundTargetBytesLeft()));
     outboundLimit.push_back(Pair("time_left_in_cycle", CNode::GetMaxOutboundTimeLeftInCycle()));
     obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    UniValue blockCache(UniValue::VOBJ);
+    blockCache.push_back(Pair("size", (uint64_t)recentBlockCache.Size()));
+    blockCache.push_back(Pair("maxsize", (uint64_t)recentBlockCache.MaxSize()));
+    blockCache.push_back(Pair("hits", recentBlockCache.GetHits()));
+    blockCache.push_back(Pair("misses", recentBlockCache.GetMisses()));
+    obj.push_back(Pair("blockcache", blockCache));
     return obj;
 }
 
@@ -5,6 +5,7 @@
 
 #include "base58.h"
 #include "chain.h"
+#include "chainsnapshot.h"
 #include "coins.h"
 #include "consensus/validation.h"
 #include "core_io.h"
@@ -174,12 +175,18 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
     if (!hashBlock.IsNull()) {
         entry.push_back(Pair("blockhash", hashBlock.GetHex()));
-        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-        if (mi != mapBlockIndex.end() && (*mi).second) {
-            CBlockIndex* pindex = (*mi).second;
-            if (chainActive.Contains(pindex)) {
+        const CBlockIndex* pindex = NULL;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (mi != mapBlockIndex.end())
+                pindex = (*mi).second;
+        }
+        if (pindex) {
+            std::shared_ptr<const CChainTipSnapshot> chain = GetChainTipSnapshot();
+            if (chain->Contains(pindex)) {
                 entry.push_back(Pair("height", pindex->nHeight));
-                entry.push_back(Pair("confirmations", 1 + chainActive.Height() - pindex->nHeight));
+                entry.push_back(Pair("confirmations", 1 + chain->Height() - pindex->nHeight));
                 entry.push_back(Pair("time", pindex->GetBlockTime()));
                 entry.push_back(Pair("blocktime", pindex->GetBlockTime()));
             }
@@ -262,7 +269,7 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getrawtransaction", "\"mytxid\", true")
         );
 
-    LOCK(cs_main);
+    // Served without cs_main: GetTransaction only locks it when scanning the UTXO set
 
     uint256 hash = ParseHashV(params[0], "parameter 1");
 
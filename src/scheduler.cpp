@@ -6,6 +6,7 @@
 
 #include "reverselock.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
@@ -131,3 +132,85 @@ size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
     }
     return result;
 }
+
+SingleThreadedSchedulerClient::SingleThreadedSchedulerClient(CScheduler* pschedulerIn) :
+    pscheduler(pschedulerIn), fCallbacksRunning(false), nMaxCallbacksPending(0)
+{
+}
+
+void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        // Try to avoid scheduling too many copies here, but if we
+        // accidentally have two ProcessQueue's scheduled at once its
+        // not a big deal.
+        if (fCallbacksRunning) return;
+        if (callbacksPending.empty()) return;
+    }
+    pscheduler->schedule(boost::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now());
+}
+
+void SingleThreadedSchedulerClient::ProcessQueue()
+{
+    CScheduler::Function callback;
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        if (fCallbacksRunning) return;
+        if (callbacksPending.empty()) return;
+        fCallbacksRunning = true;
+
+        callback = callbacksPending.front();
+        callbacksPending.pop_front();
+    }
+
+    // RAII the setting of fCallbacksRunning and calling MaybeScheduleProcessQueue
+    // to ensure both happen safely even if callback() throws.
+    struct RAIICallbacksRunning {
+        SingleThreadedSchedulerClient* instance;
+        RAIICallbacksRunning(SingleThreadedSchedulerClient* instanceIn) : instance(instanceIn) {}
+        ~RAIICallbacksRunning() {
+            {
+                boost::unique_lock<boost::mutex> lock(instance->cs_callbacksPending);
+                instance->fCallbacksRunning = false;
+            }
+            instance->MaybeScheduleProcessQueue();
+        }
+    } raiicallbacksrunning(this);
+
+    callback();
+}
+
+void SingleThreadedSchedulerClient::AddToProcessQueue(CScheduler::Function func)
+{
+    assert(pscheduler);
+
+    {
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        callbacksPending.push_back(func);
+        nMaxCallbacksPending = std::max(nMaxCallbacksPending, callbacksPending.size() + (fCallbacksRunning ? 1 : 0));
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SingleThreadedSchedulerClient::EmptyQueue()
+{
+    bool fShouldContinue = true;
+    while (fShouldContinue) {
+        ProcessQueue();
+        boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+        fShouldContinue = fCallbacksRunning || !callbacksPending.empty();
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPending() const
+{
+    boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+    return callbacksPending.size() + (fCallbacksRunning ? 1 : 0);
+}
+
+size_t SingleThreadedSchedulerClient::MaxCallbacksPending() const
+{
+    boost::unique_lock<boost::mutex> lock(cs_callbacksPending);
+    return nMaxCallbacksPending;
+}
@@ -13,6 +13,7 @@
 #include <boost/function.hpp>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
+#include <list>
 #include <map>
 
 //
@@ -80,4 +81,41 @@ private:
     bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
+//
+// Class used by CScheduler clients which may schedule multiple jobs
+// which are required to be run serially. Jobs may run on any thread
+// servicing the scheduler, but no two jobs of the same client will ever
+// be executed at the same time, and they run in the order they were added.
+//
+class SingleThreadedSchedulerClient
+{
+public:
+    explicit SingleThreadedSchedulerClient(CScheduler* pschedulerIn);
+
+    // Add a callback to be executed. Callbacks are executed serially
+    // and memory is release-acquire consistent between callback executions.
+    void AddToProcessQueue(CScheduler::Function func);
+
+    // Processes all remaining queue members on the calling thread, blocking until queue is empty.
+    // Must be called after the CScheduler has no remaining processing threads!
+    void EmptyQueue();
+
+    // Number of callbacks which are queued or currently running
+    size_t CallbacksPending() const;
+
+    // Largest value CallbacksPending() has reached since construction
+    size_t MaxCallbacksPending() const;
+
+private:
+    CScheduler* pscheduler;
+
+    mutable boost::mutex cs_callbacksPending;
+    std::list<CScheduler::Function> callbacksPending;
+    bool fCallbacksRunning;
+    size_t nMaxCallbacksPending;
+
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+};
+
 #endif
@@ -6,16 +6,57 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include "crypto/sha256.h"
 #include "script/interpreter.h"
+#include "uint256.h"
 
 #include <vector>
 
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/unordered_set.hpp>
+
 // DoS prevention: limit cache size to less than 40MB (over 500000
 // entries on 64-bit systems).
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
 
 class CPubKey;
 
+/**
+ * Set of expensive checks known to have passed, to avoid doing ECDSA
+ * signature checking or Sigma proof verification twice for every
+ * transaction (once when accepted into memory pool, and again when
+ * accepted into the block chain). Bounded by -maxsigcachesize.
+ *
+ * Callers identify a check by hashing its inputs with GetHasher(). We're
+ * hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ */
+class CCheckResultCache
+{
+private:
+    class Hasher
+    {
+    public:
+        size_t operator()(const uint256& key) const {
+            return key.GetCheapHash();
+        }
+    };
+
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, Hasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_cache;
+
+public:
+    CCheckResultCache();
+
+    /** SHA256 hasher already fed with this cache's nonce */
+    CSHA256 GetHasher() const;
+    /** Whether entry is cached, optionally erasing it when found */
+    bool Get(const uint256& entry, bool fErase);
+    void Set(const uint256& entry);
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -13,6 +13,7 @@
 #include "sigma/coinspend.h"
 #include "sigma/coin.h"
 #include "sigma/remint.h"
+#include "script/sigcache.h"
 #include "fivegnode-payments.h"
 #include "fivegnode-sync.h"
 #include "primitives/zerocoin.h"
@@ -176,6 +177,136 @@ bool CheckSigmaBlock(CValidationState &state, const CBlock& block) {
     return true;
 }
 
+// Hash of the transaction sans the sigma spend proofs, spends use it as metadata.
+static uint256 GetSigmaSpendMetadataHash(const CTransaction& tx)
+{
+    CMutableTransaction txTemp = tx;
+    BOOST_FOREACH(CTxIn &txTempIn, txTemp.vin) {
+        if (txTempIn.scriptSig.IsSigmaSpend()) {
+            txTempIn.scriptSig.clear();
+        }
+    }
+    return txTemp.GetHash();
+}
+
+static CCheckResultCache& GetSigmaSpendCache()
+{
+    static CCheckResultCache sigmaSpendCache;
+    return sigmaSpendCache;
+}
+
+CSigmaSpendCheck::CSigmaSpendCheck(
+        const CTxIn& txin,
+        std::unique_ptr<CoinSpend> spendIn,
+        const uint256& txHashForMetadata,
+        CoinDenomination denomination,
+        uint32_t coinGroupId,
+        const CSigmaState::SigmaCoinGroupInfo& coinGroup)
+    : spend(std::move(spendIn)),
+      anonymitySet(std::make_shared<std::vector<PublicCoin> >()),
+      metaData(std::make_shared<SpendMetaData>(coinGroupId, spend->getAccumulatorBlockHash(), txHashForMetadata)),
+      fPadding(spend->getVersion() >= ZEROCOIN_TX_VERSION_3_1),
+      fCached(false)
+{
+    // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
+    CBlockIndex *index = coinGroup.lastBlock;
+    while (index != coinGroup.firstBlock && index->GetBlockHash() != metaData->blockHash)
+        index = index->pprev;
+
+    // The anonymity set is fully determined by the blocks it spans, so they
+    // identify it in the cache entry together with the proof and metadata.
+    uint32_t nDenomination = static_cast<uint32_t>(denomination);
+    GetSigmaSpendCache().GetHasher()
+        .Write(&*txin.scriptSig.begin(), txin.scriptSig.size())
+        .Write((const unsigned char*)&coinGroupId, sizeof(coinGroupId))
+        .Write((const unsigned char*)&nDenomination, sizeof(nDenomination))
+        .Write(txHashForMetadata.begin(), 32)
+        .Write(index->phashBlock->begin(), 32)
+        .Write(coinGroup.firstBlock->phashBlock->begin(), 32)
+        .Finalize(cacheEntry.begin());
+
+    fCached = GetSigmaSpendCache().Get(cacheEntry, false);
+    if (fCached)
+        return;
+
+    // Build a vector with all the public coins with given denomination and accumulator id before
+    // the block on which the spend occured.
+    // This list of public coins is required by function "Verify" of CoinSpend.
+    pair<sigma::CoinDenomination, int> denominationAndId = std::make_pair(denomination, coinGroupId);
+    while(true) {
+        BOOST_FOREACH(const sigma::PublicCoin& pubCoinValue,
+                index->sigmaMintedPubCoins[denominationAndId]) {
+            anonymitySet->push_back(pubCoinValue);
+        }
+        if (index == coinGroup.firstBlock)
+            break;
+        index = index->pprev;
+    }
+}
+
+bool CSigmaSpendCheck::operator()()
+{
+    if (fCached)
+        return true;
+
+    if (!spend->Verify(*anonymitySet, *metaData, fPadding))
+        return false;
+
+    GetSigmaSpendCache().Set(cacheEntry);
+    return true;
+}
+
+void CSigmaSpendCheck::swap(CSigmaSpendCheck& check)
+{
+    std::swap(spend, check.spend);
+    std::swap(anonymitySet, check.anonymitySet);
+    std::swap(metaData, check.metaData);
+    std::swap(fPadding, check.fPadding);
+    std::swap(fCached, check.fCached);
+    std::swap(cacheEntry, check.cacheEntry);
+}
+
+std::unique_ptr<CoinSpend> CSigmaSpendCheck::ReleaseSpend()
+{
+    return std::move(spend);
+}
+
+bool GetSigmaSpendChecks(const CTransaction& tx, std::vector<CSigmaSpendCheck>& vChecks)
+{
+    AssertLockHeld(cs_main);
+
+    if (!tx.IsSigmaSpend() || tx.vin.size() > ::Params().GetConsensus().nMaxSigmaInputPerTransaction)
+        return false;
+
+    uint256 txHashForMetadata = GetSigmaSpendMetadataHash(tx);
+
+    for (const CTxIn &txin : tx.vin) {
+        if (!txin.scriptSig.IsSigmaSpend())
+            return false;
+
+        std::unique_ptr<sigma::CoinSpend> spend;
+        uint32_t coinGroupId;
+        try {
+            std::tie(spend, coinGroupId) = ParseSigmaSpend(txin);
+        } catch (CBadTxIn&) {
+            return false;
+        } catch (const std::ios_base::failure&) {
+            return false;
+        }
+
+        CoinDenomination denomination;
+        if (!IntegerToDenomination(spend->getIntDenomination(), denomination))
+            return false;
+
+        CSigmaState::SigmaCoinGroupInfo coinGroup;
+        if (!sigmaState.GetCoinGroupInfo(denomination, coinGroupId, coinGroup))
+            return false;
+
+        vChecks.push_back(CSigmaSpendCheck(txin, std::move(spend), txHashForMetadata, denomination, coinGroupId, coinGroup));
+    }
+    return true;
+}
+
 // Will return false for V1, V1.5 and V2 spends.
 // Mixing V2 and sigma spends into the same transaction will fail.
 bool CheckSigmaSpendTransaction(
@@ -195,6 +326,8 @@ bool CheckSigmaSpendTransaction(
 
     Consensus::Params const & params = ::Params().GetConsensus();
 
+    uint256 txHashForMetadata = GetSigmaSpendMetadataHash(tx);
+
     if(!isVerifyDB && !isCheckWallet) {
         if(nRealHeight >= params.nDisableUnpaddedSigmaBlock && nRealHeight < params.nSigmaPaddingBlock)
              return state.DoS(100, error("Sigma is disabled at this period."));
@@ -228,17 +361,6 @@ bool CheckSigmaSpendTransaction(
                              "CTransaction::CheckTransaction() : Error: incorrect spend transaction verion");
         }
 
-        uint256 txHashForMetadata;
-
-        // Obtain the hash of the transaction sans the zerocoin part
-        CMutableTransaction txTemp = tx;
-        BOOST_FOREACH(CTxIn &txTempIn, txTemp.vin) {
-            if (txTempIn.scriptSig.IsSigmaSpend()) {
-                txTempIn.scriptSig.clear();
-            }
-        }
-        txHashForMetadata = txTemp.GetHash();
-
         LogPrintf("CheckSigmaSpendTransaction: tx version=%d, tx metadata hash=%s, serial=%s\n",
                 spend->getVersion(), txHashForMetadata.ToString(),
                 spend->getCoinSerialNumber().tostring());
@@ -252,37 +374,6 @@ bool CheckSigmaSpendTransaction(
             return state.DoS(100, false, NO_MINT_ZEROCOIN,
                     "CheckSigmaSpendTransaction: Error: no coins were minted with such parameters");
 
-        bool passVerify = false;
-        CBlockIndex *index = coinGroup.lastBlock;
-        pair<sigma::CoinDenomination, int> denominationAndId = std::make_pair(
-            targetDenominations[vinIndex], coinGroupId);
-
-        uint256 accumulatorBlockHash = spend->getAccumulatorBlockHash();
-
-        // We use incomplete transaction hash as metadata.
-        sigma::SpendMetaData newMetaData(
-            coinGroupId,
-            accumulatorBlockHash,
-            txHashForMetadata);
-
-        // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-        while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-            index = index->pprev;
-
-        // Build a vector with all the public coins with given denomination and accumulator id before
-        // the block on which the spend occured.
-        // This list of public coins is required by function "Verify" of CoinSpend.
-        std::vector<sigma::PublicCoin> anonymity_set;
-        while(true) {
-            BOOST_FOREACH(const sigma::PublicCoin& pubCoinValue,
-                    index->sigmaMintedPubCoins[denominationAndId]) {
-                anonymity_set.push_back(pubCoinValue);
-            }
-            if (index == coinGroup.firstBlock)
-                break;
-            index = index->pprev;
-        }
-
         bool fPadding = spend->getVersion() >= ZEROCOIN_TX_VERSION_3_1;
         if (!isVerifyDB) {
             bool fShouldPad = (nHeight != INT_MAX && nHeight >= params.nSigmaPaddingBlock) ||
@@ -291,7 +382,10 @@ bool CheckSigmaSpendTransaction(
                 return state.DoS(1, error("Incorrect sigma spend transaction version"));
         }
 
-        passVerify = spend->Verify(anonymity_set, newMetaData, fPadding);
+        // The proof may already have been verified, e.g. by mempool prevalidation
+        CSigmaSpendCheck check(txin, std::move(spend), txHashForMetadata, targetDenominations[vinIndex], coinGroupId, coinGroup);
+        bool passVerify = check();
+        spend = check.ReleaseSpend();
         if (passVerify) {
             Scalar serial = spend->getCoinSerialNumber();
             // do not check for duplicates in case we've seen exact copy of this tx in this block before
@@ -1010,6 +1104,18 @@ bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoin
     return false;
 }
 
+std::vector<std::pair<sigma::PublicCoin, CMintedCoinInfo>> CSigmaState::GetMintsByHash(const std::set<uint256> &pubCoinValueHashes) const {
+    std::vector<std::pair<sigma::PublicCoin, CMintedCoinInfo>> result;
+    if (pubCoinValueHashes.empty())
+        return result;
+
+    for (auto it = GetMints().begin(); it != GetMints().end(); ++it) {
+        if (pubCoinValueHashes.count(it->first.getValueHash()))
+            result.push_back(*it);
+    }
+    return result;
+}
+
 int CSigmaState::GetCoinSetForSpend(
         CChain *chain,
         int maxHeight,
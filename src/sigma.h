@@ -12,6 +12,9 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <memory>
+#include <set>
+#include <vector>
 #include "coin_containers.h"
 
 //tests
@@ -140,6 +143,8 @@ public:
     bool HasCoin(const sigma::PublicCoin& pubCoin);
     // Query if there is a coin with given hash of a pubCoin value. If so, store preimage in pubCoin param
     bool HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash);
+    // Query the coins with any of the given hashes of pubCoin values, in a single pass over the minted coins
+    std::vector<std::pair<sigma::PublicCoin, CMintedCoinInfo>> GetMintsByHash(const std::set<uint256> &pubCoinValueHashes) const;
 
     // Given denomination and id returns latest accumulator value and corresponding block hash
     // Do not take into account coins with height more than maxHeight
@@ -253,6 +258,47 @@ private:
     friend class sigma_partialspend_mempool_tests::partialspend;
 };
 
+/**
+ * Verification of a single sigma spend proof, detached from the chain state
+ * so it can run without cs_main. Construction (under cs_main) collects the
+ * anonymity set; proofs that verify are remembered so later checks of the
+ * same spend against the same set, e.g. when the transaction is accepted to
+ * the mempool or connected in a block, skip the proof.
+ */
+class CSigmaSpendCheck
+{
+public:
+    CSigmaSpendCheck() : fPadding(false), fCached(false) {}
+    CSigmaSpendCheck(
+        const CTxIn& txin,
+        std::unique_ptr<CoinSpend> spendIn,
+        const uint256& txHashForMetadata,
+        CoinDenomination denomination,
+        uint32_t coinGroupId,
+        const CSigmaState::SigmaCoinGroupInfo& coinGroup);
+
+    bool operator()();
+
+    void swap(CSigmaSpendCheck& check);
+
+    std::unique_ptr<CoinSpend> ReleaseSpend();
+
+private:
+    std::unique_ptr<CoinSpend> spend;
+    std::shared_ptr<std::vector<PublicCoin> > anonymitySet;
+    std::shared_ptr<SpendMetaData> metaData;
+    bool fPadding;
+    bool fCached;
+    uint256 cacheEntry;
+};
+
+/**
+ * Collect the proof checks of a sigma spend transaction against the current
+ * chain. Returns false if the transaction is malformed or spends from unknown
+ * coin groups; the stateful checks report the actual error.
+ */
+bool GetSigmaSpendChecks(const CTransaction& tx, std::vector<CSigmaSpendCheck>& vChecks);
+
 } // end of namespace sigma.
 
 #endif // _MAIN_SIGMA_H__
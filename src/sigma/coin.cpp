@@ -278,8 +278,7 @@ void PrivateCoin::mintCoin(const CoinDenomination denomination){
         OpenSSLContext::get_context(), &pubkey);
 
     randomness.randomize();
-    GroupElement commit = SigmaPrimitives<Scalar, GroupElement>::commit(
-            params->get_g(), serialNumber, params->get_h0(), randomness);
+    GroupElement commit = params->commit(serialNumber, randomness);
     publicCoin = PublicCoin(commit, denomination);
 }
 
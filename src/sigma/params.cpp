@@ -3,6 +3,44 @@
 
 namespace sigma {
 
+namespace {
+
+// A scalar is split in bytes, the table has the multiples of the base by every byte value at
+// every position, so multiplying the base takes one addition per non-zero byte and no doubling.
+// Like secp256k1_ecmult, this doesn't run in constant time.
+const int TABLE_WINDOWS = 32;
+const int TABLE_WINDOW_SIZE = 255;
+
+void build_table(const GroupElement& base, std::vector<GroupElement>& table) {
+    table.reserve(TABLE_WINDOWS * TABLE_WINDOW_SIZE);
+    GroupElement window_base(base);
+    for (int w = 0; w < TABLE_WINDOWS; ++w) {
+        GroupElement multiple(window_base);
+        for (int d = 1; d <= TABLE_WINDOW_SIZE; ++d) {
+            table.push_back(multiple);
+            multiple += window_base;
+        }
+        // 256 times the base of this window
+        window_base = multiple;
+    }
+}
+
+GroupElement table_multiply(const std::vector<GroupElement>& table, const Scalar& s) {
+    unsigned char bin[32];
+    s.serialize(bin);
+
+    GroupElement result;
+    for (int w = 0; w < TABLE_WINDOWS; ++w) {
+        // big endian, the first window is the last byte
+        unsigned char d = bin[31 - w];
+        if (d != 0)
+            result += table[w * TABLE_WINDOW_SIZE + d - 1];
+    }
+    return result;
+}
+
+} // namespace
+
 Params* Params::instance;
 Params* Params::get_default() {
     if(instance != nullptr)
@@ -71,4 +109,12 @@ uint64_t Params::get_m() const{
     return m_;
 }
 
+GroupElement Params::commit(const Scalar& m, const Scalar& r) const{
+    std::call_once(tables_built_, [this] {
+        build_table(g_, g_table_);
+        build_table(h_[0], h0_table_);
+    });
+    return table_multiply(g_table_, m) + table_multiply(h0_table_, r);
+}
+
 } //namespace sigma
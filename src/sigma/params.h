@@ -4,6 +4,9 @@
 #include <secp256k1/include/GroupElement.h>
 #include <serialize.h>
 
+#include <mutex>
+#include <vector>
+
 using namespace secp_primitives;
 
 namespace sigma {
@@ -17,6 +20,9 @@ public:
     uint64_t get_n() const;
     uint64_t get_m() const;
 
+    /** Commitment g^m * h0^r to a coin, from precomputed multiples of g and h0. */
+    GroupElement commit(const Scalar& m, const Scalar& r) const;
+
 private:
    Params(const GroupElement& g, int n, int m);
     ~Params();
@@ -27,6 +33,10 @@ private:
     std::vector<GroupElement> h_;
     int m_;
     int n_;
+    // Built on first use, only minting needs them
+    mutable std::once_flag tables_built_;
+    mutable std::vector<GroupElement> g_table_;
+    mutable std::vector<GroupElement> h0_table_;
 };
 
 }//namespace sigma
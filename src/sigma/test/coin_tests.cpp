@@ -1,5 +1,6 @@
 #include "../coin.h"
 #include "../params.h"
+#include "../sigma_primitives.h"
 
 #include "../../streams.h"
 
@@ -58,4 +59,30 @@ BOOST_AUTO_TEST_CASE(getter_setter_priv)
     BOOST_CHECK(new_privcoin.getVersion() == 2);
 }
 
+BOOST_AUTO_TEST_CASE(fixed_base_commit)
+{
+    auto params = sigma::Params::get_default();
+
+    std::vector<secp_primitives::Scalar> values = {
+        secp_primitives::Scalar(uint64_t(0)),
+        secp_primitives::Scalar(uint64_t(1)),
+        secp_primitives::Scalar(uint64_t(255)),
+        secp_primitives::Scalar(uint64_t(256)),
+        secp_primitives::Scalar(uint64_t(1)).negate()
+    };
+    for (int i = 0; i < 10; i++) {
+        secp_primitives::Scalar value;
+        value.randomize();
+        values.push_back(value);
+    }
+
+    // The same as multiplying the generators
+    typedef sigma::SigmaPrimitives<secp_primitives::Scalar, secp_primitives::GroupElement> primitives;
+    for (auto& m : values) {
+        for (auto& r : values) {
+            BOOST_CHECK(params->commit(m, r) == primitives::commit(params->get_g(), m, params->get_h0(), r));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
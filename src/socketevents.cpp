@@ -0,0 +1,327 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "socketevents.h"
+
+#include "netbase.h"
+#include "sync.h"
+#include "util.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeOut)
+{
+    if (strMode == "select") {
+        modeOut = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        modeOut = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT: return "select";
+    case SOCKETEVENTS_EPOLL: return "epoll";
+    }
+    return "unknown";
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+#ifdef USE_EPOLL
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+namespace {
+
+class CSelectSocketEvents : public CSocketEvents
+{
+public:
+    CSelectSocketEvents()
+    {
+        hWakeRead = hWakeWrite = INVALID_SOCKET;
+#ifndef WIN32
+        int fds[2];
+        if (pipe(fds) == 0) {
+            hWakeRead = fds[0];
+            hWakeWrite = fds[1];
+            SetSocketNonBlocking(hWakeRead, true);
+            SetSocketNonBlocking(hWakeWrite, true);
+        }
+#endif
+    }
+
+    ~CSelectSocketEvents()
+    {
+#ifndef WIN32
+        if (hWakeRead != INVALID_SOCKET)
+            close(hWakeRead);
+        if (hWakeWrite != INVALID_SOCKET)
+            close(hWakeWrite);
+#endif
+    }
+
+    bool Wait(const InterestMap& mapInterest, int64_t nTimeoutMs, ReadyList& vReady)
+    {
+        vReady.clear();
+
+        struct timeval timeout;
+        timeout.tv_sec = nTimeoutMs / 1000;
+        timeout.tv_usec = (nTimeoutMs % 1000) * 1000;
+
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+        bool have_fds = false;
+
+        for (InterestMap::const_iterator it = mapInterest.begin(); it != mapInterest.end(); ++it) {
+            if (it->second & EVENT_RECV)
+                FD_SET(it->first, &fdsetRecv);
+            if (it->second & EVENT_SEND)
+                FD_SET(it->first, &fdsetSend);
+            if (it->second & EVENT_ERR)
+                FD_SET(it->first, &fdsetError);
+            hSocketMax = std::max(hSocketMax, it->first);
+            have_fds = true;
+        }
+        if (hWakeRead != INVALID_SOCKET) {
+            FD_SET(hWakeRead, &fdsetRecv);
+            hSocketMax = std::max(hSocketMax, hWakeRead);
+            have_fds = true;
+        }
+
+        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (nSelect == SOCKET_ERROR)
+            return false;
+
+        if (hWakeRead != INVALID_SOCKET && FD_ISSET(hWakeRead, &fdsetRecv)) {
+            char buf[128];
+            while (read(hWakeRead, buf, sizeof(buf)) > 0) {}
+        }
+
+        for (InterestMap::const_iterator it = mapInterest.begin(); it != mapInterest.end() && nSelect > 0; ++it) {
+            int nEvents = 0;
+            if (FD_ISSET(it->first, &fdsetRecv))
+                nEvents |= EVENT_RECV;
+            if (FD_ISSET(it->first, &fdsetSend))
+                nEvents |= EVENT_SEND;
+            if (FD_ISSET(it->first, &fdsetError))
+                nEvents |= EVENT_ERR;
+            if (nEvents)
+                vReady.push_back(std::make_pair(it->first, nEvents));
+        }
+        return true;
+    }
+
+    void Wake()
+    {
+#ifndef WIN32
+        if (hWakeWrite != INVALID_SOCKET) {
+            char c = 0;
+            if (write(hWakeWrite, &c, 1) < 0) {
+                // pipe full, a wakeup is pending already
+            }
+        }
+#endif
+    }
+
+    SocketEventsMode GetMode() const { return SOCKETEVENTS_SELECT; }
+
+private:
+    SOCKET hWakeRead;
+    SOCKET hWakeWrite;
+};
+
+#ifdef USE_EPOLL
+class CEpollSocketEvents : public CSocketEvents
+{
+public:
+    CEpollSocketEvents() : hEpoll(-1), hWake(-1) {}
+
+    ~CEpollSocketEvents()
+    {
+        if (hWake != -1)
+            close(hWake);
+        if (hEpoll != -1)
+            close(hEpoll);
+    }
+
+    bool Init()
+    {
+        hEpoll = epoll_create1(EPOLL_CLOEXEC);
+        if (hEpoll == -1)
+            return false;
+        hWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (hWake == -1)
+            return false;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = hWake;
+        return epoll_ctl(hEpoll, EPOLL_CTL_ADD, hWake, &event) == 0;
+    }
+
+    bool Wait(const InterestMap& mapInterest, int64_t nTimeoutMs, ReadyList& vReady)
+    {
+        vReady.clear();
+
+        vEvents.resize(Update(mapInterest) + 1);
+
+        int nReady = epoll_wait(hEpoll, &vEvents[0], vEvents.size(), nTimeoutMs);
+        if (nReady < 0)
+            return nReady == -1 && errno == EINTR;
+
+        for (int i = 0; i < nReady; i++) {
+            const struct epoll_event& event = vEvents[i];
+            if (event.data.fd == hWake) {
+                uint64_t nCount;
+                if (read(hWake, &nCount, sizeof(nCount)) < 0) {
+                    // already drained
+                }
+                continue;
+            }
+            int nEvents = 0;
+            if (event.events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))
+                nEvents |= EVENT_RECV;
+            if (event.events & EPOLLOUT)
+                nEvents |= EVENT_SEND;
+            if (event.events & EPOLLERR)
+                nEvents |= EVENT_ERR;
+            vReady.push_back(std::make_pair((SOCKET)event.data.fd, nEvents));
+        }
+        return true;
+    }
+
+    void RemoveSocket(SOCKET hSocket)
+    {
+        LOCK(cs_registered);
+        InterestMap::iterator it = mapRegistered.find(hSocket);
+        if (it != mapRegistered.end()) {
+            Control(EPOLL_CTL_DEL, hSocket, 0);
+            mapRegistered.erase(it);
+        }
+    }
+
+    void Wake()
+    {
+        uint64_t nOne = 1;
+        if (write(hWake, &nOne, sizeof(nOne)) < 0) {
+            // counter saturated, a wakeup is pending already
+        }
+    }
+
+    SocketEventsMode GetMode() const { return SOCKETEVENTS_EPOLL; }
+
+private:
+    int hEpoll;
+    int hWake;
+    //! Guards mapRegistered, Wait() runs on the socket thread while other threads close sockets
+    CCriticalSection cs_registered;
+    InterestMap mapRegistered;
+    std::vector<struct epoll_event> vEvents;
+
+    /** Registers the changes in interest with the kernel, returns the number of sockets registered */
+    size_t Update(const InterestMap& mapInterest)
+    {
+        LOCK(cs_registered);
+
+        // Walk the requested and registered interest sets side by side and
+        // only tell the kernel about the differences.
+        InterestMap::const_iterator itNew = mapInterest.begin();
+        InterestMap::iterator itOld = mapRegistered.begin();
+        while (itNew != mapInterest.end() || itOld != mapRegistered.end()) {
+            if (itOld == mapRegistered.end() || (itNew != mapInterest.end() && itNew->first < itOld->first)) {
+                // The socket may have been closed since the interest set was made
+                if (itNew->second != 0 && Control(EPOLL_CTL_ADD, itNew->first, itNew->second))
+                    mapRegistered.insert(itOld, *itNew);
+                ++itNew;
+            } else if (itNew == mapInterest.end() || itOld->first < itNew->first) {
+                // Closing a socket removes it from the epoll set already, ignore errors
+                Control(EPOLL_CTL_DEL, itOld->first, 0);
+                mapRegistered.erase(itOld++);
+            } else {
+                if (itNew->second == 0) {
+                    Control(EPOLL_CTL_DEL, itOld->first, 0);
+                    mapRegistered.erase(itOld++);
+                } else if (itNew->second != itOld->second) {
+                    if (Control(EPOLL_CTL_MOD, itOld->first, itNew->second)) {
+                        itOld->second = itNew->second;
+                        ++itOld;
+                    } else {
+                        mapRegistered.erase(itOld++);
+                    }
+                } else {
+                    ++itOld;
+                }
+                ++itNew;
+            }
+        }
+
+        return mapRegistered.size();
+    }
+
+    bool Control(int nOp, SOCKET hSocket, int nInterest)
+    {
+        struct epoll_event event;
+        event.events = 0;
+        if (nInterest & EVENT_RECV)
+            event.events |= EPOLLIN | EPOLLRDHUP;
+        if (nInterest & EVENT_SEND)
+            event.events |= EPOLLOUT;
+        // EPOLLERR and EPOLLHUP are always reported
+        event.data.u64 = 0;
+        event.data.fd = hSocket;
+
+        if (epoll_ctl(hEpoll, nOp, hSocket, &event) == 0)
+            return true;
+
+        // A descriptor number may have been closed and reused behind our back
+        if (nOp == EPOLL_CTL_MOD && errno == ENOENT && epoll_ctl(hEpoll, EPOLL_CTL_ADD, hSocket, &event) == 0)
+            return true;
+        if (nOp == EPOLL_CTL_ADD && errno == EEXIST && epoll_ctl(hEpoll, EPOLL_CTL_MOD, hSocket, &event) == 0)
+            return true;
+        if (nOp != EPOLL_CTL_DEL)
+            LogPrint("net", "%s: epoll_ctl failed for socket %d: %s\n", __func__, hSocket, NetworkErrorString(errno));
+        return false;
+    }
+};
+#endif
+
+} // namespace
+
+CSocketEvents* CSocketEvents::Create(SocketEventsMode mode)
+{
+#ifdef USE_EPOLL
+    if (mode == SOCKETEVENTS_EPOLL) {
+        CEpollSocketEvents* pevents = new CEpollSocketEvents();
+        if (!pevents->Init()) {
+            LogPrintf("%s: failed to create epoll instance: %s\n", __func__, NetworkErrorString(errno));
+            delete pevents;
+            return NULL;
+        }
+        return pevents;
+    }
+#endif
+    if (mode == SOCKETEVENTS_SELECT)
+        return new CSelectSocketEvents();
+    return NULL;
+}
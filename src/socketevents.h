@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SOCKETEVENTS_H
+#define BITCOIN_SOCKETEVENTS_H
+
+#include "compat.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#define USE_EPOLL 1
+#endif
+
+/** How the socket handler waits for socket readiness (-socketevents) */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1,
+};
+
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_EPOLL;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_SELECT;
+#endif
+
+/** Parse a -socketevents value, returns false if it is unknown or unsupported on this platform */
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& modeOut);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** Comma separated list of the modes supported on this platform */
+std::string GetSupportedSocketEventsModes();
+
+/**
+ * Waits until any of a set of sockets is ready for the events the caller is
+ * interested in, or until woken from another thread.
+ *
+ * The caller passes its complete interest set to every Wait(). The select()
+ * backend hands all of it to the kernel each time; the epoll backend keeps a
+ * persistent kernel registration and only issues epoll_ctl() for sockets whose
+ * interest changed, so a wait costs O(changed + ready) system call work rather
+ * than O(sockets).
+ *
+ * Sockets must be removed with RemoveSocket() before they are closed: the
+ * kernel forgets a closed descriptor on its own, and a new socket that reuses
+ * its number would otherwise look already registered to the epoll backend.
+ */
+class CSocketEvents
+{
+public:
+    enum {
+        EVENT_RECV = (1 << 0),
+        EVENT_SEND = (1 << 1),
+        EVENT_ERR = (1 << 2),
+    };
+
+    typedef std::map<SOCKET, int> InterestMap;
+    typedef std::vector<std::pair<SOCKET, int> > ReadyList;
+
+    /** Returns NULL if the backend cannot be initialised */
+    static CSocketEvents* Create(SocketEventsMode mode);
+
+    virtual ~CSocketEvents() {}
+
+    /**
+     * Wait up to nTimeoutMs for any socket in mapInterest to become ready.
+     * Ready sockets and their events are stored in vReady. Returns false on a
+     * wait error, in which case vReady is left empty.
+     */
+    virtual bool Wait(const InterestMap& mapInterest, int64_t nTimeoutMs, ReadyList& vReady) = 0;
+
+    /** Forget a socket that is about to be closed. Thread safe. */
+    virtual void RemoveSocket(SOCKET hSocket) {}
+
+    /** Make a Wait() in progress, or the next one, return immediately. Thread safe. */
+    virtual void Wake() = 0;
+
+    virtual SocketEventsMode GetMode() const = 0;
+};
+
+#endif // BITCOIN_SOCKETEVENTS_H
@@ -0,0 +1,95 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+#include "blockencodings.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "net.h"
+#include "random.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BasicTestingSetup)
+
+static CBlock BuildBlock()
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    CBlock block;
+    block.nVersion = 42;
+    block.hashPrevBlock = GetRandHash();
+    block.vtx.push_back(tx);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_lru)
+{
+    CRecentBlockCache cache(2);
+    CBlock block1 = BuildBlock(), block2 = BuildBlock(), block3 = BuildBlock();
+    uint256 hash1 = GetRandHash(), hash2 = GetRandHash(), hash3 = GetRandHash();
+    CRecentBlockCache::Entry entry;
+
+    cache.Add(block1, hash1);
+    cache.Add(block2, hash2);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+
+    // Touch block1 so block2 is the one evicted
+    BOOST_CHECK(cache.Get(hash1, entry));
+    cache.Add(block3, hash3);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(cache.Get(hash1, entry));
+    BOOST_CHECK(!cache.Get(hash2, entry));
+    BOOST_CHECK(cache.Get(hash3, entry));
+    BOOST_CHECK_EQUAL(cache.GetHits(), 3U);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1U);
+
+    cache.SetMaxSize(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    cache.Add(block1, hash1);
+    BOOST_CHECK(!cache.Get(hash1, entry));
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_messages)
+{
+    CRecentBlockCache cache;
+    CBlock block = BuildBlock();
+    uint256 hash = GetRandHash();
+    cache.Add(block, hash);
+
+    CRecentBlockCache::Entry entry;
+    BOOST_REQUIRE(cache.Get(hash, entry));
+    BOOST_REQUIRE(entry.blockMsg && entry.cmpctBlockMsg && entry.cmpctBlock);
+
+    // The prepared message is a valid header followed by the block serialization
+    CDataStream ssMsg(entry.blockMsg->begin(), entry.blockMsg->end(), SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr(Params().MessageStart());
+    ssMsg >> hdr;
+    BOOST_CHECK(hdr.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(hdr.GetCommand(), NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, ssMsg.size());
+
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+    ssBlock << block;
+    BOOST_CHECK(std::equal(ssBlock.begin(), ssBlock.end(), ssMsg.begin()));
+
+    uint256 hashPayload = Hash(ssMsg.begin(), ssMsg.end());
+    BOOST_CHECK(memcmp(hashPayload.begin(), &hdr.nChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+
+    CDataStream ssCmpct(entry.cmpctBlockMsg->begin() + CMessageHeader::HEADER_SIZE, entry.cmpctBlockMsg->end(), SER_NETWORK, PROTOCOL_VERSION);
+    CBlockHeaderAndShortTxIDs cmpctblock;
+    ssCmpct >> cmpctblock;
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), block.vtx.size());
+    BOOST_CHECK(cmpctblock.header.hashMerkleRoot == block.hashMerkleRoot);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
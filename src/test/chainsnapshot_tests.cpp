@@ -0,0 +1,108 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainsnapshot.h"
+#include "test/test_bitcoin.h"
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(chainsnapshot_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(chainsnapshot_matches_chain)
+{
+    // A main chain of 1000 blocks and a fork off it at height 500
+    std::vector<CBlockIndex> vMain(1000), vFork(100);
+    for (unsigned int i = 0; i < vMain.size(); i++) {
+        vMain[i].nHeight = i;
+        vMain[i].pprev = i ? &vMain[i - 1] : NULL;
+        vMain[i].BuildSkip();
+    }
+    for (unsigned int i = 0; i < vFork.size(); i++) {
+        vFork[i].nHeight = 501 + i;
+        vFork[i].pprev = i ? &vFork[i - 1] : &vMain[500];
+        vFork[i].BuildSkip();
+    }
+
+    CChain chain;
+    chain.SetTip(&vMain.back());
+    CChainTipSnapshot snapshot(&vMain.back());
+
+    BOOST_CHECK_EQUAL(snapshot.Height(), chain.Height());
+    BOOST_CHECK(snapshot.Tip() == chain.Tip());
+    for (int i = 0; i <= chain.Height(); i += 7) {
+        BOOST_CHECK(snapshot[i] == chain[i]);
+        BOOST_CHECK(snapshot.Next(chain[i]) == chain.Next(chain[i]));
+    }
+    BOOST_CHECK(snapshot[-1] == NULL);
+    BOOST_CHECK(snapshot[chain.Height() + 1] == NULL);
+    BOOST_CHECK(snapshot.Next(snapshot.Tip()) == NULL);
+
+    BOOST_CHECK(snapshot.Contains(&vMain[500]));
+    BOOST_CHECK(!snapshot.Contains(&vFork[0]));
+    BOOST_CHECK(snapshot.Next(&vFork[0]) == NULL);
+    BOOST_CHECK(!snapshot.Contains(NULL));
+
+    CChainTipSnapshot empty(NULL);
+    BOOST_CHECK_EQUAL(empty.Height(), -1);
+    BOOST_CHECK(empty[0] == NULL);
+    BOOST_CHECK(!empty.Contains(&vMain[0]));
+}
+
+BOOST_AUTO_TEST_CASE(chainsnapshot_publish)
+{
+    std::vector<CBlockIndex> vIndex(10);
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].BuildSkip();
+    }
+
+    std::shared_ptr<const CChainTipSnapshot> before = GetChainTipSnapshot();
+    PublishChainTipSnapshot(&vIndex[5]);
+    std::shared_ptr<const CChainTipSnapshot> after = GetChainTipSnapshot();
+
+    // Readers holding an older snapshot keep a consistent view
+    BOOST_CHECK(before != after);
+    BOOST_CHECK(after->Tip() == &vIndex[5]);
+    BOOST_CHECK(after->Contains(&vIndex[3]));
+    BOOST_CHECK(!after->Contains(&vIndex[6]));
+
+    PublishChainTipSnapshot(before->Tip());
+}
+
+BOOST_AUTO_TEST_CASE(chainsnapshot_difficulty)
+{
+    // Proof of work up to height 20, then mostly proof of stake
+    std::vector<CBlockIndex> vIndex(60);
+    for (unsigned int i = 0; i < vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].nBits = 0x1d00ffff - i;
+        vIndex[i].nNonce = (i <= 20 || i % 17 == 0) ? 1 : 0;
+        vIndex[i].BuildSkip();
+    }
+
+    // Snapshots taken over from the previous one match ones computed afresh,
+    // both when connecting blocks and when disconnecting them
+    std::unique_ptr<CChainTipSnapshot> prev(new CChainTipSnapshot(NULL));
+    for (int i = 0; i < 120; i++) {
+        int nHeight = i < 60 ? i : 119 - i;
+        std::unique_ptr<CChainTipSnapshot> next(new CChainTipSnapshot(&vIndex[nHeight], prev.get()));
+        CChainTipSnapshot fresh(&vIndex[nHeight]);
+        BOOST_CHECK_EQUAL(next->GetDifficultyPoW(), fresh.GetDifficultyPoW());
+        BOOST_CHECK_EQUAL(next->GetDifficultyPoS(), fresh.GetDifficultyPoS());
+        prev.swap(next);
+    }
+
+    // A jump to an unrelated tip walks the chain again
+    CChainTipSnapshot jumped(&vIndex[40], prev.get());
+    BOOST_CHECK_EQUAL(jumped.GetDifficultyPoW(), vIndex[34].GetBlockDifficulty());
+    BOOST_CHECK_EQUAL(jumped.GetDifficultyPoS(), vIndex[40].GetBlockDifficulty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
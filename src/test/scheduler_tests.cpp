@@ -116,4 +116,49 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+static void appendTask(boost::mutex& mutex, std::vector<int>& order, int n)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    order.push_back(n);
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
+{
+    CScheduler scheduler;
+
+    // each queue should be well ordered with respect to itself but not other queues
+    SingleThreadedSchedulerClient queue1(&scheduler);
+    SingleThreadedSchedulerClient queue2(&scheduler);
+
+    boost::mutex mutex;
+    std::vector<int> order1, order2;
+
+    for (int i = 0; i < 100; i++) {
+        queue1.AddToProcessQueue(boost::bind(&appendTask, boost::ref(mutex), boost::ref(order1), i));
+        queue2.AddToProcessQueue(boost::bind(&appendTask, boost::ref(mutex), boost::ref(order2), i));
+    }
+    BOOST_CHECK(queue1.MaxCallbacksPending() >= queue1.CallbacksPending());
+
+    // several threads service the scheduler, callbacks of one client must still run in order
+    boost::thread_group threads;
+    for (int i = 0; i < 5; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    // anything not picked up before the threads stopped runs here
+    queue1.EmptyQueue();
+    queue2.EmptyQueue();
+    BOOST_CHECK_EQUAL(queue1.CallbacksPending(), 0U);
+    BOOST_CHECK_EQUAL(queue2.CallbacksPending(), 0U);
+
+    BOOST_REQUIRE_EQUAL(order1.size(), 100U);
+    BOOST_REQUIRE_EQUAL(order2.size(), 100U);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(order1[i], i);
+        BOOST_CHECK_EQUAL(order2[i], i);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
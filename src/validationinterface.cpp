@@ -4,57 +4,244 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "validationinterface.h"
+#include "fivegnode.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "scheduler.h"
+#include "sync.h"
 #include "util.h"
+#include "utiltime.h"
+
+#include <map>
+#include <memory>
+
+#include <boost/scoped_ptr.hpp>
 
 static CMainSignals g_signals;
 
+/** Queue serialising asynchronous callbacks, NULL until a background scheduler is registered */
+static boost::scoped_ptr<SingleThreadedSchedulerClient> pschedulerClient;
+
+/** Subscribers with asynchronous signals and their callback statistics */
+static CCriticalSection cs_asyncSubscribers;
+static std::map<CValidationInterface*, CValidationInterfaceStats> mapAsyncSubscribers;
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
-    g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.WalletTransaction.connect(boost::bind(&CValidationInterface::WalletTransaction, pwalletIn, _1));
-    g_signals.SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+    assert(!pschedulerClient);
+    pschedulerClient.reset(new SingleThreadedSchedulerClient(&scheduler));
+}
+
+void CMainSignals::UnregisterBackgroundSignalScheduler() {
+    pschedulerClient.reset();
+}
+
+void CMainSignals::FlushBackgroundCallbacks() {
+    if (pschedulerClient)
+        pschedulerClient->EmptyQueue();
+}
+
+/**
+ * Slots connected for asynchronously delivered signals. Each copies whatever
+ * the signal arguments refer to and queues the real callback on the
+ * background scheduler client.
+ */
+struct CValidationInterfaceQueue
+{
+    static void Run(CValidationInterface* pwalletIn, const boost::function<void (void)>& func)
+    {
+        {
+            LOCK(cs_asyncSubscribers);
+            // Subscriber was unregistered while the callback was queued
+            if (!mapAsyncSubscribers.count(pwalletIn))
+                return;
+        }
+
+        int64_t nTimeStart = GetTimeMicros();
+        func();
+        int64_t nTimeElapsed = GetTimeMicros() - nTimeStart;
+
+        LOCK(cs_asyncSubscribers);
+        std::map<CValidationInterface*, CValidationInterfaceStats>::iterator it = mapAsyncSubscribers.find(pwalletIn);
+        if (it == mapAsyncSubscribers.end())
+            return;
+        CValidationInterfaceStats& stats = it->second;
+        stats.nCallbacks++;
+        stats.nTotalTimeMicros += nTimeElapsed;
+        if (nTimeElapsed > stats.nMaxTimeMicros)
+            stats.nMaxTimeMicros = nTimeElapsed;
+        LogPrint("validation", "%s: %s callback took %.2fms, %u pending\n", __func__, stats.strName, nTimeElapsed * 0.001, GetValidationInterfaceQueueSize());
+    }
+
+    static void Add(CValidationInterface* pwalletIn, const boost::function<void (void)>& func)
+    {
+        if (pschedulerClient)
+            pschedulerClient->AddToProcessQueue(boost::bind(&CValidationInterfaceQueue::Run, pwalletIn, func));
+        else
+            Run(pwalletIn, func);
+    }
+
+    /**
+     * Blocks are copied once and shared by the SyncTransaction callbacks of
+     * all of their transactions; the caller's block may not outlive the signal.
+     */
+    static std::shared_ptr<const CBlock> ShareBlock(const CBlock* pblock)
+    {
+        static CCriticalSection cs_lastBlock;
+        static const CBlock* plastBlock = NULL;
+        static std::shared_ptr<const CBlock> lastBlockCopy;
+
+        if (!pblock)
+            return std::shared_ptr<const CBlock>();
+
+        LOCK(cs_lastBlock);
+        if (plastBlock != pblock || !lastBlockCopy ||
+                lastBlockCopy->hashPrevBlock != pblock->hashPrevBlock ||
+                lastBlockCopy->hashMerkleRoot != pblock->hashMerkleRoot ||
+                lastBlockCopy->nNonce != pblock->nNonce ||
+                lastBlockCopy->vtx.size() != pblock->vtx.size()) {
+            lastBlockCopy = std::make_shared<const CBlock>(*pblock);
+            plastBlock = pblock;
+        }
+        return lastBlockCopy;
+    }
+
+    static void DoSyncTransaction(CValidationInterface* pwalletIn, const CTransaction& tx, const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& pblock)
+    {
+        pwalletIn->SyncTransaction(tx, pindex, pblock.get());
+    }
+
+    static void DoSyncBlockTransactions(CValidationInterface* pwalletIn, const CBlockIndex* pindex, const std::shared_ptr<const CBlock>& pblock)
+    {
+        pwalletIn->SyncBlockTransactions(pindex, pblock.get());
+    }
+
+    static void DoUpdatedFivegnode(CValidationInterface* pwalletIn, CFivegnode fivegnode)
+    {
+        pwalletIn->UpdatedFivegnode(fivegnode);
+    }
+
+    static void UpdatedBlockTip(CValidationInterface* pwalletIn, const CBlockIndex *pindex) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, pindex));
+    }
+    static void SyncTransaction(CValidationInterface* pwalletIn, const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock) {
+        Add(pwalletIn, boost::bind(&CValidationInterfaceQueue::DoSyncTransaction, pwalletIn, tx, pindex, ShareBlock(pblock)));
+    }
+    static void SyncBlockTransactions(CValidationInterface* pwalletIn, const CBlockIndex *pindex, const CBlock *pblock) {
+        Add(pwalletIn, boost::bind(&CValidationInterfaceQueue::DoSyncBlockTransactions, pwalletIn, pindex, ShareBlock(pblock)));
+    }
+    static void WalletTransaction(CValidationInterface* pwalletIn, const CTransaction &tx) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::WalletTransaction, pwalletIn, tx));
+    }
+    static void UpdatedTransaction(CValidationInterface* pwalletIn, const uint256 &hash) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, hash));
+    }
+    static void SetBestChain(CValidationInterface* pwalletIn, const CBlockLocator &locator) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::SetBestChain, pwalletIn, locator));
+    }
+    static void Inventory(CValidationInterface* pwalletIn, const uint256 &hash) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::Inventory, pwalletIn, hash));
+    }
+    static void NumConnectionsChanged(CValidationInterface* pwalletIn) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::NumConnectionsChanged, pwalletIn));
+    }
+    static void UpdateSyncStatus(CValidationInterface* pwalletIn) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdateSyncStatus, pwalletIn));
+    }
+    static void UpdatedFivegnode(CValidationInterface* pwalletIn, CFivegnode &fivegnode) {
+        Add(pwalletIn, boost::bind(&CValidationInterfaceQueue::DoUpdatedFivegnode, pwalletIn, fivegnode));
+    }
+    static void UpdatedMintStatus(CValidationInterface* pwalletIn, std::string update) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdatedMintStatus, pwalletIn, update));
+    }
+    static void UpdatedSettings(CValidationInterface* pwalletIn, std::string update) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdatedSettings, pwalletIn, update));
+    }
+    static void NotifyAPIStatus(CValidationInterface* pwalletIn) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::NotifyAPIStatus, pwalletIn));
+    }
+    static void NotifyFivegnodeList(CValidationInterface* pwalletIn) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::NotifyFivegnodeList, pwalletIn));
+    }
+    static void UpdatedBalance(CValidationInterface* pwalletIn) {
+        Add(pwalletIn, boost::bind(&CValidationInterface::UpdatedBalance, pwalletIn));
+    }
+};
+
+#define CONNECT_SIGNAL(flag, signal, ...)                                                           \
+    if (nAsyncSignals & flag)                                                                       \
+        g_signals.signal.connect(boost::bind(&CValidationInterfaceQueue::signal, pwalletIn, ##__VA_ARGS__)); \
+    else                                                                                            \
+        g_signals.signal.connect(boost::bind(&CValidationInterface::signal, pwalletIn, ##__VA_ARGS__));
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, unsigned int nAsyncSignals, const std::string& strName) {
+    if (nAsyncSignals != VALIDATION_SIGNAL_NONE) {
+        LOCK(cs_asyncSubscribers);
+        CValidationInterfaceStats& stats = mapAsyncSubscribers[pwalletIn];
+        stats.strName = strName.empty() ? strprintf("%p", pwalletIn) : strName;
+    }
+
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_BLOCK_TIP, UpdatedBlockTip, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_SYNC_TRANSACTION, SyncTransaction, _1, _2, _3);
+    // Queued along with SyncTransaction so that the wallet sees transactions in order
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_SYNC_TRANSACTION, SyncBlockTransactions, _1, _2);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_TRANSACTION, UpdatedTransaction, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_WALLET_TRANSACTION, WalletTransaction, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_SET_BEST_CHAIN, SetBestChain, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_INVENTORY, Inventory, _1);
     g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1));
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
-    g_signals.NumConnectionsChanged.connect(boost::bind(&CValidationInterface::NumConnectionsChanged, pwalletIn));
-    g_signals.UpdateSyncStatus.connect(boost::bind(&CValidationInterface::UpdateSyncStatus, pwalletIn));
-    g_signals.UpdatedFivegnode.connect(boost::bind(&CValidationInterface::UpdatedFivegnode, pwalletIn, _1));
-    g_signals.UpdatedMintStatus.connect(boost::bind(&CValidationInterface::UpdatedMintStatus, pwalletIn, _1));
-    g_signals.UpdatedSettings.connect(boost::bind(&CValidationInterface::UpdatedSettings, pwalletIn, _1));
-    g_signals.NotifyAPIStatus.connect(boost::bind(&CValidationInterface::NotifyAPIStatus, pwalletIn));
-    g_signals.NotifyFivegnodeList.connect(boost::bind(&CValidationInterface::NotifyFivegnodeList, pwalletIn));
-    g_signals.UpdatedBalance.connect(boost::bind(&CValidationInterface::UpdatedBalance, pwalletIn));
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_NUM_CONNECTIONS_CHANGED, NumConnectionsChanged);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATE_SYNC_STATUS, UpdateSyncStatus);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_FIVEGNODE, UpdatedFivegnode, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_MINT_STATUS, UpdatedMintStatus, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_SETTINGS, UpdatedSettings, _1);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_NOTIFY_API_STATUS, NotifyAPIStatus);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_NOTIFY_FIVEGNODE_LIST, NotifyFivegnodeList);
+    CONNECT_SIGNAL(VALIDATION_SIGNAL_UPDATED_BALANCE, UpdatedBalance);
 }
 
+#undef CONNECT_SIGNAL
+
+// Slots may have been connected either way, so disconnect both
+#define DISCONNECT_SIGNAL(signal, ...)                                                              \
+    g_signals.signal.disconnect(boost::bind(&CValidationInterfaceQueue::signal, pwalletIn, ##__VA_ARGS__)); \
+    g_signals.signal.disconnect(boost::bind(&CValidationInterface::signal, pwalletIn, ##__VA_ARGS__));
+
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1));
-    g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
-    g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2, _3));
-    g_signals.WalletTransaction.disconnect(boost::bind(&CValidationInterface::WalletTransaction, pwalletIn, _1));
-    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
-    g_signals.NumConnectionsChanged.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn));
-    g_signals.UpdateSyncStatus.disconnect(boost::bind(&CValidationInterface::UpdateSyncStatus, pwalletIn));
-    g_signals.UpdatedFivegnode.disconnect(boost::bind(&CValidationInterface::UpdatedFivegnode, pwalletIn, _1));
-    g_signals.UpdatedMintStatus.disconnect(boost::bind(&CValidationInterface::UpdatedMintStatus, pwalletIn, _1));
-    g_signals.UpdatedSettings.disconnect(boost::bind(&CValidationInterface::UpdatedSettings, pwalletIn, _1));
-    g_signals.NotifyAPIStatus.disconnect(boost::bind(&CValidationInterface::NotifyAPIStatus, pwalletIn));
-    g_signals.NotifyFivegnodeList.disconnect(boost::bind(&CValidationInterface::NotifyFivegnodeList, pwalletIn));
-    g_signals.UpdatedBalance.disconnect(boost::bind(&CValidationInterface::UpdatedBalance, pwalletIn));
+    DISCONNECT_SIGNAL(Inventory, _1);
+    DISCONNECT_SIGNAL(SetBestChain, _1);
+    DISCONNECT_SIGNAL(UpdatedTransaction, _1);
+    DISCONNECT_SIGNAL(SyncBlockTransactions, _1, _2);
+    DISCONNECT_SIGNAL(SyncTransaction, _1, _2, _3);
+    DISCONNECT_SIGNAL(WalletTransaction, _1);
+    DISCONNECT_SIGNAL(UpdatedBlockTip, _1);
+    DISCONNECT_SIGNAL(NumConnectionsChanged);
+    DISCONNECT_SIGNAL(UpdateSyncStatus);
+    DISCONNECT_SIGNAL(UpdatedFivegnode, _1);
+    DISCONNECT_SIGNAL(UpdatedMintStatus, _1);
+    DISCONNECT_SIGNAL(UpdatedSettings, _1);
+    DISCONNECT_SIGNAL(NotifyAPIStatus);
+    DISCONNECT_SIGNAL(NotifyFivegnodeList);
+    DISCONNECT_SIGNAL(UpdatedBalance);
+
+    // Any of its callbacks still queued will be dropped
+    LOCK(cs_asyncSubscribers);
+    mapAsyncSubscribers.erase(pwalletIn);
 }
 
+#undef DISCONNECT_SIGNAL
+
 void UnregisterAllValidationInterfaces() {
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
@@ -63,6 +250,7 @@ void UnregisterAllValidationInterfaces() {
     g_signals.Inventory.disconnect_all_slots();
     g_signals.SetBestChain.disconnect_all_slots();
     g_signals.UpdatedTransaction.disconnect_all_slots();
+    g_signals.SyncBlockTransactions.disconnect_all_slots();
     g_signals.SyncTransaction.disconnect_all_slots();
     g_signals.WalletTransaction.disconnect_all_slots();
     g_signals.UpdatedBlockTip.disconnect_all_slots();
@@ -74,8 +262,49 @@ void UnregisterAllValidationInterfaces() {
     g_signals.NotifyAPIStatus.disconnect_all_slots();
     g_signals.NotifyFivegnodeList.disconnect_all_slots();
     g_signals.UpdatedBalance.disconnect_all_slots();
+
+    LOCK(cs_asyncSubscribers);
+    mapAsyncSubscribers.clear();
 }
 
 void SyncWithWallets(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock) {
     g_signals.SyncTransaction(tx, pindex, pblock);
 }
+
+void SyncBlockWithWallets(const CBlockIndex *pindex, const CBlock *pblock) {
+    g_signals.SyncBlockTransactions(pindex, pblock);
+}
+
+void CValidationInterface::SyncBlockTransactions(const CBlockIndex *pindex, const CBlock *pblock) {
+    for (const CTransaction &tx : pblock->vtx)
+        SyncTransaction(tx, pindex, pblock);
+}
+
+static void ReleaseQueueWaiter(CSemaphore* psem) {
+    psem->post();
+}
+
+void SyncWithValidationInterfaceQueue() {
+    if (!pschedulerClient)
+        return;
+    // Queue a marker behind everything added so far and wait for it to run
+    CSemaphore sem(0);
+    pschedulerClient->AddToProcessQueue(boost::bind(&ReleaseQueueWaiter, &sem));
+    sem.wait();
+}
+
+size_t GetValidationInterfaceQueueSize() {
+    return pschedulerClient ? pschedulerClient->CallbacksPending() : 0;
+}
+
+size_t GetValidationInterfaceMaxQueueSize() {
+    return pschedulerClient ? pschedulerClient->MaxCallbacksPending() : 0;
+}
+
+std::vector<CValidationInterfaceStats> GetValidationInterfaceStats() {
+    std::vector<CValidationInterfaceStats> vStats;
+    LOCK(cs_asyncSubscribers);
+    for (std::map<CValidationInterface*, CValidationInterfaceStats>::const_iterator it = mapAsyncSubscribers.begin(); it != mapAsyncSubscribers.end(); ++it)
+        vStats.push_back(it->second);
+    return vStats;
+}
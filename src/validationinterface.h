@@ -9,6 +9,10 @@
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 class CBlock;
 class CBlockIndex;
 struct CBlockLocator;
@@ -19,22 +23,79 @@ class CValidationInterface;
 class CValidationState;
 class uint256;
 class CFivegnode;
+class CScheduler;
+
+/**
+ * Signals a subscriber may ask to receive asynchronously. Callbacks for these
+ * signals are queued in order on a single CScheduler client instead of being
+ * run inline by the thread firing the signal (which usually holds cs_main).
+ * Signals with out-parameters or whose callers rely on immediate effects
+ * (BlockChecked, Broadcast, ScriptForMining, BlockFound) are always synchronous.
+ */
+enum ValidationSignal {
+    VALIDATION_SIGNAL_NONE                    = 0,
+    VALIDATION_SIGNAL_UPDATED_BLOCK_TIP       = (1U << 0),
+    VALIDATION_SIGNAL_SYNC_TRANSACTION        = (1U << 1),
+    VALIDATION_SIGNAL_WALLET_TRANSACTION      = (1U << 2),
+    VALIDATION_SIGNAL_UPDATED_TRANSACTION     = (1U << 3),
+    VALIDATION_SIGNAL_SET_BEST_CHAIN          = (1U << 4),
+    VALIDATION_SIGNAL_INVENTORY               = (1U << 5),
+    VALIDATION_SIGNAL_NUM_CONNECTIONS_CHANGED = (1U << 6),
+    VALIDATION_SIGNAL_UPDATE_SYNC_STATUS      = (1U << 7),
+    VALIDATION_SIGNAL_UPDATED_FIVEGNODE       = (1U << 8),
+    VALIDATION_SIGNAL_UPDATED_MINT_STATUS     = (1U << 9),
+    VALIDATION_SIGNAL_UPDATED_SETTINGS        = (1U << 10),
+    VALIDATION_SIGNAL_NOTIFY_API_STATUS       = (1U << 11),
+    VALIDATION_SIGNAL_NOTIFY_FIVEGNODE_LIST   = (1U << 12),
+    VALIDATION_SIGNAL_UPDATED_BALANCE         = (1U << 13),
+};
+
+/** Callback statistics of one subscriber's asynchronous callbacks */
+struct CValidationInterfaceStats {
+    std::string strName;
+    uint64_t nCallbacks;
+    int64_t nTotalTimeMicros;
+    int64_t nMaxTimeMicros;
+
+    CValidationInterfaceStats() : nCallbacks(0), nTotalTimeMicros(0), nMaxTimeMicros(0) {}
+};
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core.
+ * Signals whose bit is set in nAsyncSignals (see ValidationSignal) are delivered on the
+ * background scheduler registered with CMainSignals::RegisterBackgroundSignalScheduler,
+ * falling back to synchronous delivery if none is registered. strName labels the
+ * subscriber in callback statistics.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, unsigned int nAsyncSignals = VALIDATION_SIGNAL_NONE, const std::string& strName = "");
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
 void SyncWithWallets(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock = NULL);
+/** Push all transactions of a connected block to all registered wallets */
+void SyncBlockWithWallets(const CBlockIndex *pindex, const CBlock* pblock);
+/**
+ * Block until all asynchronous callbacks queued so far have been run.
+ * Must not be called while holding cs_main or any lock a subscriber takes.
+ */
+void SyncWithValidationInterfaceQueue();
+/** Number of asynchronous validation callbacks queued or running */
+size_t GetValidationInterfaceQueueSize();
+/** Largest queue size observed since the background scheduler was registered */
+size_t GetValidationInterfaceMaxQueueSize();
+/** Callback statistics of all subscribers which registered asynchronous signals */
+std::vector<CValidationInterfaceStats> GetValidationInterfaceStats();
 
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock) {}
+    /** Calls SyncTransaction for each transaction of the block unless overridden, e.g. to batch them */
+    virtual void SyncBlockTransactions(const CBlockIndex *pindex, const CBlock *pblock);
     virtual void WalletTransaction(const CTransaction &tx) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
@@ -51,9 +112,10 @@ protected:
     virtual void NotifyAPIStatus() {}
     virtual void NotifyFivegnodeList() {}
     virtual void UpdatedBalance() {}
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, unsigned int, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend struct CValidationInterfaceQueue;
 };
 
 struct CMainSignals {
@@ -61,6 +123,8 @@ struct CMainSignals {
     boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in). */
     boost::signals2::signal<void (const CTransaction &, const CBlockIndex *pindex, const CBlock *)> SyncTransaction;
+    /** Notifies listeners of all transactions of a block connected to the chain. */
+    boost::signals2::signal<void (const CBlockIndex *pindex, const CBlock *)> SyncBlockTransactions;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<void (const CTransaction &)> WalletTransaction;
     /** Notifies listeners of a valid wallet transaction (decoupled from SyncTransaction in order to allow wallet update). */
@@ -93,6 +157,13 @@ struct CMainSignals {
     boost::signals2::signal<void ()> NotifyFivegnodeList;
     /** Notifies listeners of balance */
     boost::signals2::signal<void ()> UpdatedBalance;
+
+    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
+    void UnregisterBackgroundSignalScheduler();
+    /** Call any remaining callbacks on the calling thread */
+    void FlushBackgroundCallbacks();
 };
 
 CMainSignals& GetMainSignals();
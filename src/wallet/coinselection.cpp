@@ -0,0 +1,284 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/coinselection.h"
+
+#include "random.h"
+#include "util.h"
+#include "utilmoneystr.h"
+#include "wallet/wallet.h"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+bool SelectCoinsBnB(const std::vector<CAmount>& vValues, const CAmount& nTargetValue,
+                    std::vector<char>& vfSelected, bool& fSearchedAll)
+{
+    vfSelected.clear();
+    fSearchedAll = false;
+
+    // Total of the values not decided on yet
+    CAmount nAvailable = 0;
+    for (const CAmount& n : vValues)
+        nAvailable += n;
+
+    // Include / exclude decisions for the values walked so far
+    std::vector<char> vfCurrent;
+    vfCurrent.reserve(vValues.size());
+    CAmount nCurrent = 0;
+
+    for (size_t nTries = 0; nTries < MAX_BNB_TRIES; ++nTries) {
+        if (nCurrent == nTargetValue) {
+            vfSelected = vfCurrent;
+            vfSelected.resize(vValues.size(), false);
+            return true;
+        }
+
+        if (nCurrent > nTargetValue || nCurrent + nAvailable < nTargetValue) {
+            // Drop the excluded values at the end, then exclude the last included one
+            while (!vfCurrent.empty() && !vfCurrent.back()) {
+                vfCurrent.pop_back();
+                nAvailable += vValues[vfCurrent.size()];
+            }
+            if (vfCurrent.empty()) {
+                fSearchedAll = true;
+                return false;
+            }
+            vfCurrent.back() = false;
+            nCurrent -= vValues[vfCurrent.size() - 1];
+        } else {
+            size_t i = vfCurrent.size();
+            if (i > 0 && !vfCurrent.back() && vValues[i] == vValues[i - 1]) {
+                // Including a value right after excluding an equal one only repeats
+                // subsets already tried, so skip the whole run of equal values
+                for (CAmount n = vValues[i - 1]; i < vValues.size() && vValues[i] == n; ++i) {
+                    nAvailable -= vValues[i];
+                    vfCurrent.push_back(false);
+                }
+            } else {
+                nAvailable -= vValues[i];
+                vfCurrent.push_back(true);
+                nCurrent += vValues[i];
+            }
+        }
+    }
+
+    return false;
+}
+
+void ApproximateBestSubset(const std::vector<CAmount>& vValues, const CAmount& nTotalLower,
+                           const CAmount& nTargetValue, std::vector<char>& vfBest, CAmount& nBest,
+                           int iterations)
+{
+    // Values are only ever removed right after being added, so the included
+    // values are kept as a stack as well; it is usually far smaller than the
+    // flags, and is what gets copied when a better subset is found.
+    std::vector<char> vfIncluded;
+    std::vector<unsigned int> vIncluded, vBest;
+    bool fFound = false;
+
+    nBest = nTotalLower;
+
+    seed_insecure_rand();
+
+    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++) {
+        vfIncluded.assign(vValues.size(), false);
+        vIncluded.clear();
+        CAmount nTotal = 0;
+        bool fReachedTarget = false;
+        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++) {
+            for (unsigned int i = 0; i < vValues.size(); i++) {
+                //The solver here uses a randomized algorithm,
+                //the randomness serves no real security purpose but is just
+                //needed to prevent degenerate behavior and it is important
+                //that the rng is fast. We do not use a constant random sequence,
+                //because there may be some privacy improvement by making
+                //the selection random.
+                if (nPass == 0 ? insecure_rand() & 1 : !vfIncluded[i]) {
+                    nTotal += vValues[i];
+                    vfIncluded[i] = true;
+                    vIncluded.push_back(i);
+                    if (nTotal >= nTargetValue) {
+                        fReachedTarget = true;
+                        if (nTotal < nBest) {
+                            nBest = nTotal;
+                            vBest = vIncluded;
+                            fFound = true;
+                        }
+                        nTotal -= vValues[i];
+                        vfIncluded[i] = false;
+                        vIncluded.pop_back();
+                    }
+                }
+            }
+        }
+    }
+
+    vfBest.assign(vValues.size(), !fFound);
+    for (unsigned int i : vBest)
+        vfBest[i] = true;
+}
+
+bool SelectCoinsForValue(const std::vector<CAmount>& vValues, const CAmount& nTargetValue,
+                         std::vector<size_t>& vSelected, CAmount& nValueRet)
+{
+    vSelected.clear();
+    nValueRet = 0;
+
+    // Values less than target plus minimum change, and the lowest larger value
+    std::vector<size_t> vLower;
+    CAmount nTotalLower = 0;
+    size_t nLowestLarger = vValues.size();
+
+    for (size_t i = 0; i < vValues.size(); ++i) {
+        CAmount n = vValues[i];
+
+        if (n == nTargetValue) {
+            vSelected.push_back(i);
+            nValueRet = n;
+            return true;
+        } else if (n < nTargetValue + MIN_CHANGE) {
+            vLower.push_back(i);
+            nTotalLower += n;
+        } else if (nLowestLarger == vValues.size() || n < vValues[nLowestLarger]) {
+            nLowestLarger = i;
+        }
+    }
+
+    if (nTotalLower == nTargetValue) {
+        vSelected = vLower;
+        nValueRet = nTotalLower;
+        return true;
+    }
+
+    if (nTotalLower < nTargetValue) {
+        if (nLowestLarger == vValues.size())
+            return false;
+        vSelected.push_back(nLowestLarger);
+        nValueRet = vValues[nLowestLarger];
+        return true;
+    }
+
+    // Both searches walk the values from the largest down
+    std::sort(vLower.begin(), vLower.end(), [&vValues](size_t a, size_t b) {
+        return vValues[a] > vValues[b];
+    });
+    std::vector<CAmount> vLowerValues;
+    vLowerValues.reserve(vLower.size());
+    for (size_t i : vLower)
+        vLowerValues.push_back(vValues[i]);
+
+    std::vector<char> vfBest;
+    CAmount nBest;
+    bool fSearchedAll;
+
+    if (SelectCoinsBnB(vLowerValues, nTargetValue, vfBest, fSearchedAll)) {
+        nBest = nTargetValue;
+    } else {
+        // The exact match pass is only needed if branch and bound gave up early,
+        // or if there isn't enough for the minimum change anyway.
+        bool fMinChange = nTotalLower >= nTargetValue + MIN_CHANGE;
+        int iterations = std::max<size_t>(1, std::min<size_t>(1000, MAX_KNAPSACK_VISITS / vLowerValues.size()));
+        if (!fSearchedAll || !fMinChange)
+            ApproximateBestSubset(vLowerValues, nTotalLower, nTargetValue, vfBest, nBest, iterations);
+        if (fMinChange && (fSearchedAll || nBest != nTargetValue))
+            ApproximateBestSubset(vLowerValues, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest, iterations);
+    }
+
+    // If we have a bigger coin and (either the subset search didn't find a good solution,
+    //                               or the next bigger coin is closer), return the bigger coin
+    if (nLowestLarger != vValues.size() &&
+        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || vValues[nLowestLarger] <= nBest)) {
+        vSelected.push_back(nLowestLarger);
+        nValueRet = vValues[nLowestLarger];
+    } else {
+        for (size_t i = 0; i < vLower.size(); i++)
+            if (vfBest[i]) {
+                vSelected.push_back(vLower[i]);
+                nValueRet += vLowerValues[i];
+            }
+
+        LogPrint("selectcoins", "SelectCoins() best subset: ");
+        for (size_t i = 0; i < vLower.size(); i++)
+            if (vfBest[i])
+                LogPrint("selectcoins", "%s ", FormatMoney(vLowerValues[i]));
+        LogPrint("selectcoins", "total %s\n", FormatMoney(nBest));
+    }
+
+    return true;
+}
+
+const uint32_t CDenominationSelector::UNREACHABLE;
+const size_t CDenominationSelector::UNLIMITED;
+
+CDenominationSelector::CDenominationSelector(const std::vector<int64_t>& denominations, const std::vector<size_t>& available, int64_t maxAmount)
+    : denominations(denominations), available(available), maxAmount(std::max<int64_t>(maxAmount, 0))
+{
+    rows.resize(denominations.size());
+
+    for (size_t k = 0; k < denominations.size(); ++k) {
+        int64_t d = denominations[k];
+        int64_t limit = this->maxAmount / d;
+        if (available[k] != UNLIMITED && int64_t(available[k]) < limit)
+            limit = available[k];
+
+        std::vector<uint32_t>& row = rows[k];
+        row.assign(this->maxAmount + 1, UNREACHABLE);
+
+        // Amounts that differ by a multiple of d only reach each other, so for
+        // every residue the fewest coins is a sliding window minimum over the
+        // previous row, with windows of limit + 1 coins of this denomination.
+        for (int64_t r = 0; r < d && r <= this->maxAmount; ++r) {
+            std::deque<std::pair<int64_t, int64_t>> window;
+            for (int64_t m = 0, j = r; j <= this->maxAmount; ++m, j += d) {
+                uint32_t prev = k == 0 ? (j == 0 ? 0 : UNREACHABLE) : rows[k - 1][j];
+                if (prev != UNREACHABLE) {
+                    int64_t key = int64_t(prev) - m;
+                    while (!window.empty() && window.back().second >= key)
+                        window.pop_back();
+                    window.emplace_back(m, key);
+                }
+                while (!window.empty() && m - window.front().first > limit)
+                    window.pop_front();
+                if (!window.empty())
+                    row[j] = window.front().second + m;
+            }
+        }
+    }
+}
+
+uint32_t CDenominationSelector::GetCoinCount(int64_t amount) const
+{
+    if (amount < 0 || amount > maxAmount)
+        return UNREACHABLE;
+    if (rows.empty())
+        return amount == 0 ? 0 : UNREACHABLE;
+    return rows.back()[amount];
+}
+
+bool CDenominationSelector::GetCoins(int64_t amount, std::vector<size_t>& counts) const
+{
+    counts.assign(denominations.size(), 0);
+
+    if (GetCoinCount(amount) == UNREACHABLE)
+        return false;
+
+    // Walk back from the smallest denomination, taking as few of each as possible
+    for (size_t k = denominations.size(); k-- > 0; ) {
+        int64_t d = denominations[k];
+        uint32_t count = rows[k][amount];
+        for (int64_t t = 0; t * d <= amount && (available[k] == UNLIMITED || t <= int64_t(available[k])); ++t) {
+            int64_t rest = amount - t * d;
+            uint32_t prev = k == 0 ? (rest == 0 ? 0 : UNREACHABLE) : rows[k - 1][rest];
+            if (prev != UNREACHABLE && prev + t == count) {
+                counts[k] = t;
+                amount = rest;
+                break;
+            }
+        }
+    }
+
+    return amount == 0;
+}
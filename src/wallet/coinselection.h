@@ -0,0 +1,89 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_COINSELECTION_H
+#define BITCOIN_WALLET_COINSELECTION_H
+
+#include "amount.h"
+
+#include <limits>
+#include <vector>
+
+#include <stdint.h>
+
+//! Maximum number of steps of the branch and bound search for an exact match
+static const size_t MAX_BNB_TRIES = 100000;
+//! Values the knapsack search may visit in total, large wallets get fewer iterations
+static const size_t MAX_KNAPSACK_VISITS = 2000000;
+
+/**
+ * Looks for a subset of the values that adds up to exactly the target, so that
+ * no change output is needed. The values must be sorted in descending order.
+ *
+ * The search is a depth first walk over the include / exclude tree of the
+ * values, cutting branches which can no longer reach the target or already
+ * exceed it. It gives up after MAX_BNB_TRIES steps; fSearchedAll tells whether
+ * the whole tree was walked, in which case no exact match exists.
+ */
+bool SelectCoinsBnB(const std::vector<CAmount>& vValues, const CAmount& nTargetValue,
+                    std::vector<char>& vfSelected, bool& fSearchedAll);
+
+/**
+ * Randomized knapsack search for the subset of the values with the smallest
+ * total at or above the target. nBest is the total of the subset found.
+ */
+void ApproximateBestSubset(const std::vector<CAmount>& vValues, const CAmount& nTotalLower,
+                           const CAmount& nTargetValue, std::vector<char>& vfBest, CAmount& nBest,
+                           int iterations = 1000);
+
+/**
+ * Selects the values to spend for the target: a single value matching it, an
+ * exact match found by branch and bound, or else the knapsack approximation
+ * leaving at least MIN_CHANGE of change, unless a single larger value is closer.
+ * The knapsack search does up to 1000 iterations, less when there are so many
+ * values that it would visit more than MAX_KNAPSACK_VISITS of them.
+ *
+ * \returns false if the values don't add up to the target.
+ */
+bool SelectCoinsForValue(const std::vector<CAmount>& vValues, const CAmount& nTargetValue,
+                         std::vector<size_t>& vSelected, CAmount& nValueRet);
+
+/**
+ * Fewest coins of a set of denominations adding up to each amount up to a
+ * maximum, with a limited number of coins available of every denomination.
+ * Denominations and amounts are in the same units, e.g. multiples of the
+ * smallest Sigma denomination, so that the tables stay small.
+ */
+class CDenominationSelector
+{
+public:
+    //! Coin count of amounts which can't be made
+    static const uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+    //! Number of coins available of a denomination that may be used any number of times
+    static const size_t UNLIMITED = std::numeric_limits<size_t>::max();
+
+    /**
+     * \param denominations the values of the denominations, largest first.
+     * \param available number of coins available of each denomination.
+     * \param maxAmount largest amount that will be asked for.
+     */
+    CDenominationSelector(const std::vector<int64_t>& denominations, const std::vector<size_t>& available, int64_t maxAmount);
+
+    int64_t GetMaxAmount() const { return maxAmount; }
+
+    /** Returns the fewest coins adding up to the amount, or UNREACHABLE. */
+    uint32_t GetCoinCount(int64_t amount) const;
+
+    /** Gets the number of coins of each denomination that make up the amount with the fewest coins. */
+    bool GetCoins(int64_t amount, std::vector<size_t>& counts) const;
+
+private:
+    std::vector<int64_t> denominations;
+    std::vector<size_t> available;
+    int64_t maxAmount;
+    //! Fewest coins of the first i + 1 denominations adding up to each amount
+    std::vector<std::vector<uint32_t>> rows;
+};
+
+#endif // BITCOIN_WALLET_COINSELECTION_H
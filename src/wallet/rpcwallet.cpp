@@ -1799,17 +1799,13 @@ UniValue listsinceblock(const UniValue& params, bool fHelp)
         if(params[2].get_bool())
             filter = filter | ISMINE_WATCH_ONLY;
 
-    int depth = pindex ? (1 + chainActive.Height() - pindex->nHeight) : -1;
-
     UniValue transactions(UniValue::VARR);
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++)
-    {
-        CWalletTx tx = (*it).second;
-
-        if (depth == -1 || tx.GetDepthInMainChain() < depth)
-            ListTransactions(tx, "*", 0, true, transactions, filter);
-    }
+    // Transactions in later blocks and those not in a block, from the wallet history
+    CWalletHistoryPos pos;
+    std::vector<const CWalletTx*> vHistory = pwalletMain->GetHistory(pos, pindex ? pindex->nHeight + 1 : 0, std::numeric_limits<size_t>::max());
+    BOOST_REVERSE_FOREACH(const CWalletTx* pwtx, vHistory)
+        ListTransactions(*pwtx, "*", 0, true, transactions, filter);
 
     CBlockIndex *pblockLast = chainActive[chainActive.Height() + 1 - target_confirms];
     uint256 lastblock = pblockLast ? pblockLast->GetBlockHash() : uint256();
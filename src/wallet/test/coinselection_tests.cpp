@@ -0,0 +1,123 @@
+// Copyright (c) 2020 The FivegX Project developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/coinselection.h"
+#include "wallet/wallet.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(coinselection_tests, BasicTestingSetup)
+
+static CAmount SelectedTotal(const std::vector<CAmount>& vValues, const std::vector<size_t>& vSelected)
+{
+    CAmount nTotal = 0;
+    for (size_t i : vSelected)
+        nTotal += vValues[i];
+    return nTotal;
+}
+
+BOOST_AUTO_TEST_CASE(bnb_exact_match)
+{
+    std::vector<CAmount> vValues = {8 * CENT, 7 * CENT, 5 * CENT, 3 * CENT, 3 * CENT, 1 * CENT};
+    std::vector<char> vfSelected;
+    bool fSearchedAll;
+
+    BOOST_CHECK(SelectCoinsBnB(vValues, 11 * CENT, vfSelected, fSearchedAll));
+    CAmount nTotal = 0;
+    for (size_t i = 0; i < vValues.size(); i++)
+        if (vfSelected[i])
+            nTotal += vValues[i];
+    BOOST_CHECK_EQUAL(nTotal, 11 * CENT);
+
+    // 27 is the total of all values, 28 is more than that, 2 can't be made
+    BOOST_CHECK(SelectCoinsBnB(vValues, 27 * CENT, vfSelected, fSearchedAll));
+    BOOST_CHECK(!SelectCoinsBnB(vValues, 28 * CENT, vfSelected, fSearchedAll));
+    BOOST_CHECK(fSearchedAll);
+    BOOST_CHECK(!SelectCoinsBnB(vValues, 2 * CENT, vfSelected, fSearchedAll));
+    BOOST_CHECK(fSearchedAll);
+
+    // runs of equal values are only tried once
+    std::vector<CAmount> vMany(10000, 2 * CENT);
+    BOOST_CHECK(SelectCoinsBnB(vMany, 2000 * CENT, vfSelected, fSearchedAll));
+    BOOST_CHECK(!SelectCoinsBnB(vMany, 2001 * CENT, vfSelected, fSearchedAll));
+    BOOST_CHECK(fSearchedAll);
+    vMany.push_back(1 * CENT);
+    BOOST_CHECK(SelectCoinsBnB(vMany, 2001 * CENT, vfSelected, fSearchedAll));
+}
+
+BOOST_AUTO_TEST_CASE(select_coins_for_value)
+{
+    std::vector<size_t> vSelected;
+    CAmount nValueRet;
+
+    // a single value matching the target
+    std::vector<CAmount> vValues = {1 * COIN, 3 * CENT, 2 * CENT};
+    BOOST_CHECK(SelectCoinsForValue(vValues, 2 * CENT, vSelected, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 2 * CENT);
+    BOOST_CHECK_EQUAL(vSelected.size(), 1U);
+
+    // not enough
+    BOOST_CHECK(!SelectCoinsForValue(vValues, 2 * COIN, vSelected, nValueRet));
+
+    // the smaller values add up exactly, so the big one isn't touched
+    vValues = {1 * COIN, 6 * CENT, 5 * CENT, 4 * CENT, 2 * CENT};
+    BOOST_CHECK(SelectCoinsForValue(vValues, 9 * CENT, vSelected, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 9 * CENT);
+    BOOST_CHECK_EQUAL(SelectedTotal(vValues, vSelected), 9 * CENT);
+
+    // no exact match, the smaller values leave enough change
+    BOOST_CHECK(SelectCoinsForValue(vValues, 16 * CENT, vSelected, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 17 * CENT);
+
+    // no exact match and no subset leaves the minimum change, the larger value is used
+    vValues = {50 * CENT, 9 * CENT, 8 * CENT};
+    BOOST_CHECK(SelectCoinsForValue(vValues, 16 * CENT + CENT / 2, vSelected, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 50 * CENT);
+
+    // a large wallet of small values
+    vValues.assign(100000, 3 * CENT);
+    vValues.push_back(1 * CENT);
+    BOOST_CHECK(SelectCoinsForValue(vValues, 1000 * CENT, vSelected, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 1000 * CENT);
+    BOOST_CHECK_EQUAL(SelectedTotal(vValues, vSelected), 1000 * CENT);
+}
+
+BOOST_AUTO_TEST_CASE(denomination_selector)
+{
+    // 100, 25, 10, 1 in units of the smallest one
+    std::vector<int64_t> denominations = {100, 25, 10, 1};
+    std::vector<size_t> counts;
+
+    // greedy would take 25 and then fail to find 5 more
+    CDenominationSelector spend(denominations, {0, 1, 3, 0}, 200);
+    BOOST_CHECK_EQUAL(spend.GetCoinCount(30), 3U);
+    BOOST_CHECK(spend.GetCoins(30, counts));
+    BOOST_CHECK(counts == std::vector<size_t>({0, 0, 3, 0}));
+    BOOST_CHECK_EQUAL(spend.GetCoinCount(35), 2U);
+    BOOST_CHECK_EQUAL(spend.GetCoinCount(55), 4U);
+    BOOST_CHECK_EQUAL(spend.GetCoinCount(60), CDenominationSelector::UNREACHABLE);
+    BOOST_CHECK(!spend.GetCoins(60, counts));
+    BOOST_CHECK_EQUAL(spend.GetCoinCount(201), CDenominationSelector::UNREACHABLE);
+
+    // any number of coins of each denomination
+    std::vector<size_t> unlimited(denominations.size(), CDenominationSelector::UNLIMITED);
+    CDenominationSelector mint(denominations, unlimited, 1000);
+    BOOST_CHECK_EQUAL(mint.GetCoinCount(0), 0U);
+    BOOST_CHECK_EQUAL(mint.GetCoinCount(30), 3U);
+    BOOST_CHECK_EQUAL(mint.GetCoinCount(999), 9U + 3U + 2U + 4U);
+    BOOST_CHECK(mint.GetCoins(999, counts));
+    BOOST_CHECK(counts == std::vector<size_t>({9, 3, 2, 4}));
+
+    // limited coins of the larger denominations
+    CDenominationSelector limited(denominations, {2, 0, 5, CDenominationSelector::UNLIMITED}, 1000);
+    BOOST_CHECK_EQUAL(limited.GetCoinCount(300), 2U + 5U + 50U);
+    BOOST_CHECK(limited.GetCoins(300, counts));
+    BOOST_CHECK(counts == std::vector<size_t>({2, 0, 5, 50}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
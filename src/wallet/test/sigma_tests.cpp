@@ -378,6 +378,31 @@ BOOST_AUTO_TEST_CASE(get_coin_minimize_coins_spend)
     sigmaState->Reset();
 }
 
+BOOST_AUTO_TEST_CASE(get_coin_minimize_coins_spend_mixed_denominations)
+{
+    std::vector<std::pair<sigma::CoinDenomination, int>> newCoins;
+    AddOneCoinForEachGroup();
+    GetCoinSetByDenominationAmount(newCoins, 0, 0, 0, 0, 3, 1, 0);
+    GenerateBlockWithCoins(newCoins);
+    GenerateEmptyBlocks(5);
+
+    // Taking the SIGMA_DENOM_25 first leaves 5 that the other coins can't make
+    CAmount require(30 * COIN);
+
+    std::vector<CSigmaEntry> coins;
+    std::vector<sigma::CoinDenomination> coinsToMint;
+    BOOST_CHECK_MESSAGE(pwalletMain->GetCoinsToSpend(require, coins, coinsToMint),
+      "Expect enough coins for 30 without re-mint.");
+
+    std::vector<std::pair<sigma::CoinDenomination, int>> expectedCoins;
+    GetCoinSetByDenominationAmount(expectedCoins, 0, 0, 0, 0, 3, 0, 0);
+
+    BOOST_CHECK_MESSAGE(CheckDenominationCoins(expectedCoins, coins),
+      "Expect three SIGMA_DENOM_10");
+    BOOST_CHECK(coinsToMint.empty());
+    sigmaState->Reset();
+}
+
 BOOST_AUTO_TEST_CASE(get_coin_choose_smallest_enough)
 {
     std::vector<std::pair<sigma::CoinDenomination, int>> newCoins;
@@ -421,6 +446,55 @@ BOOST_AUTO_TEST_CASE(get_coin_by_limit_max_to_1)
     sigmaState->Reset();
 }
 
+BOOST_AUTO_TEST_CASE(list_unused_mints)
+{
+    CHDMintTracker& tracker = zwalletMain->GetTracker();
+    size_t unused = tracker.ListUnusedMints().size();
+
+    std::vector<std::pair<sigma::CoinDenomination, int>> newCoins;
+    GetCoinSetByDenominationAmount(newCoins, 1, 1, 0, 0, 0, 0, 0);
+    GenerateBlockWithCoins(newCoins);
+
+    std::vector<CMintMeta> mints = tracker.ListUnusedMints();
+    BOOST_CHECK_EQUAL(mints.size(), unused + 2);
+
+    // the running balance matches the unused mints
+    CAmount expected = 0;
+    for (const CMintMeta& mint : mints) {
+        int64_t value;
+        BOOST_CHECK(sigma::DenominationToInteger(mint.denom, value));
+        expected += value;
+    }
+    CAmount all = 0, confirmed = 0;
+    tracker.GetUnusedBalance(all, confirmed);
+    BOOST_CHECK_EQUAL(all, expected);
+    BOOST_CHECK(confirmed <= all);
+
+    // used mints leave the index, and come back when they are unused again
+    CMintMeta meta = mints.front();
+    int64_t metaValue;
+    BOOST_CHECK(sigma::DenominationToInteger(meta.denom, metaValue));
+    meta.isUsed = true;
+    BOOST_CHECK(tracker.UpdateState(meta));
+    BOOST_CHECK_EQUAL(tracker.ListUnusedMints().size(), unused + 1);
+    tracker.GetUnusedBalance(all, confirmed);
+    BOOST_CHECK_EQUAL(all, expected - metaValue);
+
+    tracker.SetPubcoinNotUsed(meta.GetPubCoinValueHash());
+    BOOST_CHECK_EQUAL(tracker.ListUnusedMints().size(), unused + 2);
+    tracker.GetUnusedBalance(all, confirmed);
+    BOOST_CHECK_EQUAL(all, expected);
+
+    // mints are found by pubcoin hash
+    CMintMeta found;
+    BOOST_CHECK(tracker.HasPubcoinHash(meta.GetPubCoinValueHash()));
+    BOOST_CHECK(tracker.GetMetaFromPubcoin(meta.GetPubCoinValueHash(), found));
+    BOOST_CHECK(found.hashSerial == meta.hashSerial);
+    BOOST_CHECK(!tracker.HasPubcoinHash(uint256()));
+
+    sigmaState->Reset();
+}
+
 BOOST_AUTO_TEST_CASE(create_spend_with_insufficient_coins)
 {
     CAmount fee;
@@ -351,4 +351,120 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
 }*/
 
+BOOST_AUTO_TEST_CASE(wallet_history)
+{
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    vector<uint256> hashes;
+    for (int i = 0; i < 5; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = i;
+        CWalletTx wtx(pwalletMain, tx);
+        BOOST_CHECK(pwalletMain->AddToWallet(wtx, false, &walletdb));
+        hashes.push_back(wtx.GetHash());
+    }
+    int64_t nChange = pwalletMain->GetHistoryChange();
+
+    // Pages of two, newest first
+    CWalletHistoryPos pos;
+    vector<const CWalletTx*> page = pwalletMain->GetHistory(pos, 0, 2);
+    BOOST_CHECK_EQUAL(page.size(), 2U);
+    BOOST_CHECK(page[0]->GetHash() == hashes[4]);
+    BOOST_CHECK(page[1]->GetHash() == hashes[3]);
+    BOOST_CHECK(pos.hash == hashes[3]);
+
+    page = pwalletMain->GetHistory(pos, 0, 2);
+    BOOST_CHECK_EQUAL(page.size(), 2U);
+    BOOST_CHECK(page[0]->GetHash() == hashes[2]);
+    BOOST_CHECK(page[1]->GetHash() == hashes[1]);
+
+    // Not in a block, so not listed from a height up only
+    CWalletHistoryPos posConfirmed(0, 0, uint256());
+    BOOST_CHECK(pwalletMain->GetHistory(posConfirmed, 0, 2).empty());
+
+    // Nothing changed since the listing
+    vector<const CWalletTx*> vChanged;
+    vector<uint256> vRemoved;
+    int64_t nChangeAfter = nChange;
+    pwalletMain->GetHistoryChanges(nChangeAfter, 10, vChanged, vRemoved);
+    BOOST_CHECK(vChanged.empty());
+    BOOST_CHECK(vRemoved.empty());
+    BOOST_CHECK_EQUAL(nChangeAfter, nChange);
+
+    // A change and a removal, in the order they happened
+    pwalletMain->mapWallet[hashes[1]].MarkDirty();
+    pwalletMain->EraseFromWallet(hashes[3]);
+    pwalletMain->GetHistoryChanges(nChangeAfter, 10, vChanged, vRemoved);
+    BOOST_CHECK_EQUAL(vChanged.size(), 1U);
+    BOOST_CHECK(vChanged[0]->GetHash() == hashes[1]);
+    BOOST_CHECK_EQUAL(vRemoved.size(), 1U);
+    BOOST_CHECK(vRemoved[0] == hashes[3]);
+    BOOST_CHECK_EQUAL(nChangeAfter, pwalletMain->GetHistoryChange());
+
+    // The removed transaction is no longer listed
+    pos = CWalletHistoryPos();
+    page = pwalletMain->GetHistory(pos, 0, 2);
+    BOOST_CHECK_EQUAL(page.size(), 2U);
+    BOOST_CHECK(page[0]->GetHash() == hashes[4]);
+    BOOST_CHECK(page[1]->GetHash() == hashes[2]);
+}
+
+static bool IsWalletTxInDB(const uint256& hash)
+{
+    CWallet wallet;
+    vector<uint256> vTxHash;
+    vector<CWalletTx> vWtx;
+    CWalletDB(pwalletMain->strWalletFile).FindWalletTx(&wallet, vTxHash, vWtx);
+    return std::find(vTxHash.begin(), vTxHash.end(), hash) != vTxHash.end();
+}
+
+BOOST_AUTO_TEST_CASE(wallet_tx_batch)
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    // Transactions added through a batch are in the wallet right away, and in
+    // the database once the batch is committed
+    CWalletTxBatch batch(pwalletMain->strWalletFile);
+    vector<uint256> hashes;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = 100 + i;
+        CWalletTx wtx(pwalletMain, tx);
+        BOOST_CHECK(pwalletMain->AddToWallet(wtx, false, &batch));
+        hashes.push_back(wtx.GetHash());
+    }
+    BOOST_CHECK(pwalletMain->mapWallet.count(hashes[0]));
+    BOOST_CHECK(!IsWalletTxInDB(hashes[0]));
+
+    // Erasing after writing leaves it out
+    batch.EraseTx(hashes[2]);
+    BOOST_CHECK(batch.Commit());
+    BOOST_CHECK(IsWalletTxInDB(hashes[0]));
+    BOOST_CHECK(IsWalletTxInDB(hashes[1]));
+    BOOST_CHECK(!IsWalletTxInDB(hashes[2]));
+
+    // Nothing left to write
+    BOOST_CHECK(batch.Commit());
+}
+
+BOOST_AUTO_TEST_CASE(hd_key_generation)
+{
+    LOCK(pwalletMain->cs_wallet);
+
+    uint32_t nFirst = pwalletMain->GetHDChain().nExternalChainCounters[0];
+    vector<CPubKey> vPubKeys = pwalletMain->GenerateNewKeys(0, 10);
+    BOOST_CHECK_EQUAL(vPubKeys.size(), 10U);
+    BOOST_CHECK_EQUAL(pwalletMain->GetHDChain().nExternalChainCounters[0], nFirst + 10);
+
+    // The keys are the ones of their path, in order
+    for (uint32_t i = 0; i < vPubKeys.size(); i++) {
+        BOOST_CHECK(pwalletMain->HaveKey(vPubKeys[i].GetID()));
+        BOOST_CHECK(pwalletMain->GetKeyFromKeypath(0, nFirst + i) == vPubKeys[i]);
+    }
+
+    // The next key follows them
+    BOOST_CHECK(pwalletMain->GenerateNewKey(0) == pwalletMain->GetKeyFromKeypath(0, nFirst + 10));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
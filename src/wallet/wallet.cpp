@@ -5,6 +5,7 @@
 
 #include "wallet.h"
 #include "walletexcept.h"
+#include "coinselection.h"
 #include "sigmaspendbuilder.h"
 #include "amount.h"
 #include "base58.h"
@@ -91,13 +92,6 @@ const uint256 CMerkleTx::ABANDON_HASH(uint256S("00000000000000000000000000000000
  * @{
  */
 
-struct CompareValueOnly {
-    bool operator()(const pair <CAmount, pair<const CWalletTx *, unsigned int>> &t1,
-                    const pair <CAmount, pair<const CWalletTx *, unsigned int>> &t2) const {
-        return t1.first < t2.first;
-    }
-};
-
 struct CompareByPriority
 {
     bool operator()(const COutput& t1,
@@ -144,8 +138,15 @@ const CWalletTx *CWallet::GetWalletTx(const uint256 &hash) const {
     return &(it->second);
 }
 
-CPubKey CWallet::GetKeyFromKeypath(uint32_t nChange, uint32_t nChild) {
-    AssertLockHeld(cs_wallet); // mapKeyMetadata
+void CWallet::GetHDChainKey(uint32_t nChange, CExtKey& chainKey) {
+    AssertLockHeld(cs_wallet); // mapHDChainKeys
+
+    std::pair<CKeyID, uint32_t> chainId(hdChain.masterKeyID, nChange);
+    std::map<std::pair<CKeyID, uint32_t>, SecureVector>::const_iterator it = mapHDChainKeys.find(chainId);
+    if (it != mapHDChainKeys.end()) {
+        chainKey.Decode(&it->second[0]);
+        return;
+    }
 
     boost::optional<bool> regTest = GetOptBoolArg("-regtest")
     , testNet = GetOptBoolArg("-testnet");
@@ -161,9 +162,8 @@ CPubKey CWallet::GetKeyFromKeypath(uint32_t nChange, uint32_t nChild) {
     CExtKey purposeKey;            //key at m/44'
     CExtKey coinTypeKey;           //key at m/44'/<1/136>' (Testnet or Index Coin Type respectively, according to SLIP-0044)
     CExtKey accountKey;            //key at m/44'/<1/136>'/0'
-    CExtKey externalChainChildKey; //key at m/44'/<1/136>'/0'/<c> (Standard: 0/1, Mints: 2)
-    CExtKey childKey;              //key at m/44'/<1/136>'/0'/<c>/<n>
 
+    //For bip39 we use it's original way for generating keys to make it compatible with hardware and software wallets
     if(hdChain.nVersion >= CHDChain::VERSION_WITH_BIP39){
         MnemonicContainer mContainer = mnemonicContainer;
         DecryptMnemonicContainer(mContainer);
@@ -186,108 +186,150 @@ CPubKey CWallet::GetKeyFromKeypath(uint32_t nChange, uint32_t nChild) {
     // derive m/44'/136'/0'
     coinTypeKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
 
-    // derive m/44'/136'/0'/<c>
-    accountKey.Derive(externalChainChildKey, nChange);
+    // derive m/44'/136'/0'/<c> (Standard: 0/1, Mints: 2)
+    accountKey.Derive(chainKey, nChange);
 
-    // derive m/44'/136'/0'/<c>/<n>
-    externalChainChildKey.Derive(childKey, nChild);
+    // Keep it in locked memory until the wallet is locked, so that the path isn't derived
+    // from the seed again for every key
+    if (!IsLocked()) {
+        SecureVector code(BIP32_EXTKEY_SIZE);
+        chainKey.Encode(&code[0]);
+        mapHDChainKeys.insert(std::make_pair(chainId, code));
+    }
+}
 
-    CKey secret = childKey.key;
+void CWallet::DeriveHDKeys(uint32_t nChange, uint32_t nFirst, size_t nCount, std::vector<CKey>& vKeys, std::vector<CPubKey>& vPubKeys) {
+    AssertLockHeld(cs_wallet); // mapHDChainKeys
 
-    CPubKey pubkey = secret.GetPubKey();
-    assert(secret.VerifyPubKey(pubkey));
+    CExtKey chainKey;
+    GetHDChainKey(nChange, chainKey);
 
-    return pubkey;
+    // Children only depend on the chain key, so they are derived in parallel
+    vKeys.assign(nCount, CKey());
+    vPubKeys.assign(nCount, CPubKey());
+    auto deriveKeys = [&](size_t nStart, size_t nStep) {
+        CExtKey childKey;
+        for (size_t i = nStart; i < nCount; i += nStep) {
+            // derive m/44'/136'/0'/<c>/<n>
+            chainKey.Derive(childKey, nFirst + i);
+            vKeys[i] = childKey.key;
+            vPubKeys[i] = childKey.key.GetPubKey();
+            assert(vKeys[i].VerifyPubKey(vPubKeys[i]));
+        }
+    };
+
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), nCount);
+    boost::thread_group threads;
+    for (size_t nThread = 1; nThread < nThreads; ++nThread)
+        threads.create_thread([&deriveKeys, nThread, nThreads] { deriveKeys(nThread, nThreads); });
+    deriveKeys(0, std::max<size_t>(nThreads, 1));
+    threads.join_all();
 }
 
-CPubKey CWallet::GenerateNewKey(uint32_t nChange) {
+CPubKey CWallet::GetKeyFromKeypath(uint32_t nChange, uint32_t nChild) {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
-    CWalletDB walletdb(strWalletFile);
-    bool fCompressed = CanSupportFeature(
-            FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-    CKey secret;
+    std::vector<CKey> vKeys;
+    std::vector<CPubKey> vPubKeys;
+    DeriveHDKeys(nChange, nChild, 1, vKeys, vPubKeys);
 
-    // Create new metadata
-    int64_t nCreationTime = GetTime();
-    CKeyMetadata metadata(nCreationTime);
-    metadata.nChange = Component(nChange, false);
+    return vPubKeys[0];
+}
+
+void CWallet::AddGeneratedKey(const CKey& secret, const CPubKey& pubkey, const CKeyMetadata& metadata) {
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+
+    // Compressed public keys were introduced in version 0.6.0
+    if (secret.IsCompressed())
+        SetMinVersion(FEATURE_COMPRPUBKEY);
+
+    mapKeyMetadata[pubkey.GetID()] = metadata;
+    if (!nTimeFirstKey || metadata.nCreateTime < nTimeFirstKey)
+        nTimeFirstKey = metadata.nCreateTime;
+
+    if (!AddKeyPubKey(secret, pubkey))
+        throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+}
+
+std::vector<CPubKey> CWallet::GenerateNewKeys(uint32_t nChange, size_t nCount) {
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+
+    std::vector<CPubKey> vPubKeys;
+
+    if (hdChain.masterKeyID.IsNull()) {
+        while (vPubKeys.size() < nCount)
+            vPubKeys.push_back(GenerateNewKey(nChange));
+        return vPubKeys;
+    }
 
     boost::optional<bool> regTest = GetOptBoolArg("-regtest")
     , testNet = GetOptBoolArg("-testnet");
-
     uint32_t nIndex = (regTest || testNet) ? BIP44_TEST_INDEX : BIP44_ZCOIN_INDEX;
 
-    // use HD key derivation if HD was enabled during wallet creation
-    if (!hdChain.masterKeyID.IsNull()) {
-        // use BIP44 keypath: m / purpose' / coin_type' / account' / change / address_index
-        CKey key;                      //master key seed (256bit)
-        CExtKey masterKey;             //hd master key
-        CExtKey purposeKey;            //key at m/44'
-        CExtKey coinTypeKey;           //key at m/44'/<1/136>' (Testnet or Index Coin Type respectively, according to SLIP-0044)
-        CExtKey accountKey;            //key at m/44'/<1/136>'/0'
-        CExtKey externalChainChildKey; //key at m/44'/<1/136>'/0'/<c> (Standard: 0/1, Mints: 2)
-        CExtKey childKey;              //key at m/44'/<1/136>'/0'/<c>/<n>
-        //For bip39 we use it's original way for generating keys to make it compatible with hardware and software wallets
-        if(hdChain.nVersion >= CHDChain::VERSION_WITH_BIP39){
-            MnemonicContainer mContainer = mnemonicContainer;
-            DecryptMnemonicContainer(mContainer);
-            SecureVector seed = mContainer.GetSeed();
-            masterKey.SetMaster(&seed[0], seed.size());
-        } else {
-            // try to get the master key
-            if (!GetKey(hdChain.masterKeyID, key))
-                throw std::runtime_error(std::string(__func__) + ": Master key not found");
-            masterKey.SetMaster(key.begin(), key.size());
+    int64_t nCreationTime = GetTime();
+
+    while (vPubKeys.size() < nCount) {
+        uint32_t nFirst = hdChain.nExternalChainCounters[nChange];
+        std::vector<CKey> vKeys;
+        std::vector<CPubKey> vDerivedPubKeys;
+        DeriveHDKeys(nChange, nFirst, nCount - vPubKeys.size(), vKeys, vDerivedPubKeys);
+
+        for (size_t i = 0; i < vKeys.size(); ++i) {
+            // increment childkey index, skip keys already known to the wallet
+            hdChain.nExternalChainCounters[nChange]++;
+            if (HaveKey(vDerivedPubKeys[i].GetID()))
+                continue;
+
+            CKeyMetadata metadata(nCreationTime);
+            metadata.nChange = Component(nChange, false);
+            metadata.hdKeypath = "m/44'/" + std::to_string(nIndex) + "'/0'/" + std::to_string(nChange) + "/" + std::to_string(nFirst + i);
+            metadata.hdMasterKeyID = hdChain.masterKeyID;
+            metadata.nChild = Component(nFirst + i, false);
+
+            AddGeneratedKey(vKeys[i], vDerivedPubKeys[i], metadata);
+            vPubKeys.push_back(vDerivedPubKeys[i]);
         }
+    }
 
-        // derive m/44'
-        // use hardened derivation (child keys >= 0x80000000 are hardened after bip32)
-        masterKey.Derive(purposeKey, BIP44_INDEX | BIP32_HARDENED_KEY_LIMIT);
+    // update the chain model in the database
+    if (!CWalletDB(strWalletFile).WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 
-        // derive m/44'/136'
-        purposeKey.Derive(coinTypeKey, nIndex | BIP32_HARDENED_KEY_LIMIT);
+    return vPubKeys;
+}
 
-        // derive m/44'/136'/0'
-        coinTypeKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
+CPubKey CWallet::GenerateNewKey(uint32_t nChange) {
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
 
-        // derive m/44'/136'/0'/<c>
-        accountKey.Derive(externalChainChildKey, nChange);
+    // use HD key derivation if HD was enabled during wallet creation
+    if (!hdChain.masterKeyID.IsNull())
+        return GenerateNewKeys(nChange, 1)[0];
 
-        // derive child key at next index, skip keys already known to the wallet
-        do {
-            externalChainChildKey.Derive(childKey, hdChain.nExternalChainCounters[nChange]);
-            metadata.hdKeypath = "m/44'/" + std::to_string(nIndex) + "'/0'/" + std::to_string(nChange) + "/" + std::to_string(hdChain.nExternalChainCounters[nChange]);
-            metadata.hdMasterKeyID = hdChain.masterKeyID;
-            metadata.nChild = Component(hdChain.nExternalChainCounters[nChange], false);
-            // increment childkey index
-            hdChain.nExternalChainCounters[nChange]++;
-        } while (HaveKey(childKey.key.GetPubKey().GetID()));
-        secret = childKey.key;
+    bool fCompressed = CanSupportFeature(
+            FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-        // update the chain model in the database
-        if (!walletdb.WriteHDChain(hdChain))
-            throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
-    } else {
-        secret.MakeNewKey(fCompressed);
-    }
+    // Create new metadata
+    CKeyMetadata metadata(GetTime());
+    metadata.nChange = Component(nChange, false);
 
-    // Compressed public keys were introduced in version 0.6.0
-    if (fCompressed)
-        SetMinVersion(FEATURE_COMPRPUBKEY);
+    CKey secret;
+    secret.MakeNewKey(fCompressed);
 
     CPubKey pubkey = secret.GetPubKey();
     assert(secret.VerifyPubKey(pubkey));
 
-    mapKeyMetadata[pubkey.GetID()] = metadata;
-    if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
-        nTimeFirstKey = nCreationTime;
-
-    if (!AddKeyPubKey(secret, pubkey))
-        throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+    AddGeneratedKey(secret, pubkey, metadata);
     return pubkey;
 }
 
+bool CWallet::Lock() {
+    {
+        LOCK(cs_wallet);
+        mapHDChainKeys.clear();
+    }
+    return CCryptoKeyStore::Lock();
+}
+
 bool CWallet::AddKeyPubKey(const CKey &secret, const CPubKey &pubkey) {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
@@ -301,6 +343,7 @@ bool CWallet::AddKeyPubKey(const CKey &secret, const CPubKey &pubkey) {
     script = GetScriptForRawPubKey(pubkey);
     if (HaveWatchOnly(script))
         RemoveWatchOnly(script);
+    MarkUnspentOutputsDirty();
 
     if (!fFileBacked)
         return true;
@@ -348,6 +391,7 @@ bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigne
 bool CWallet::AddCScript(const CScript &redeemScript) {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    MarkUnspentOutputsDirty();
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -372,6 +416,7 @@ bool CWallet::AddWatchOnly(const CScript &dest) {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
+    MarkUnspentOutputsDirty();
     NotifyWatchonlyChanged(true);
     if (!fFileBacked)
         return true;
@@ -382,6 +427,7 @@ bool CWallet::RemoveWatchOnly(const CScript &dest) {
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    MarkUnspentOutputsDirty();
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (fFileBacked)
@@ -675,6 +721,7 @@ bool CWallet::IsSpent(const uint256 &hash, unsigned int n) const {
 
 void CWallet::AddToSpends(const COutPoint &outpoint, const uint256 &wtxid) {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
+    MarkBalanceDirty(outpoint.hash);
 
     pair <TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -709,6 +756,13 @@ void CWallet::RemoveFromSpends(const COutPoint& outpoint, const uint256& wtxid)
     }
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+    MarkBalanceDirty(outpoint.hash);
+
+    if (fUnspentOutputsLoaded) {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+        if (mi != mapWallet.end() && outpoint.n < mi->second.vout.size())
+            AddUnspentOutput(mi->second, outpoint.n);
+    }
 }
 
 void CWallet::RemoveFromSpends(const uint256& wtxid)
@@ -722,17 +776,73 @@ void CWallet::RemoveFromSpends(const uint256& wtxid)
         RemoveFromSpends(txin.prevout, wtxid);
 }
 
+void CWallet::AddUnspentOutput(const CWalletTx &wtx, unsigned int n) const {
+    const CTxOut &txout = wtx.vout[n];
+    isminetype mine = IsMine(txout);
+    if (mine == ISMINE_NO || txout.nValue <= 0)
+        return;
+
+    UnspentOutput &output = mapUnspentOutputs[COutPoint(wtx.GetHash(), n)];
+    output.nValue = txout.nValue;
+    output.mine = mine;
+    output.fMint = txout.scriptPubKey.IsZerocoinMint() || txout.scriptPubKey.IsSigmaMint() || txout.scriptPubKey.IsZerocoinRemint();
+}
+
+void CWallet::MarkUnspentOutputsDirty() const {
+    LOCK(cs_wallet);
+    fUnspentOutputsLoaded = false;
+}
+
+bool CWallet::IsSpentInChain(const uint256 &hash, unsigned int n) const {
+    pair <TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, n));
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
+        map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain() > 0)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::LoadUnspentOutputs() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    if (fUnspentOutputsLoaded)
+        return;
+
+    mapUnspentOutputs.clear();
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        for (unsigned int i = 0; i < it->second.vout.size(); i++) {
+            if (!IsSpentInChain(it->first, i))
+                AddUnspentOutput(it->second, i);
+        }
+    }
+    fUnspentOutputsLoaded = true;
+}
+
 void CWallet::AvailableCoinsForStaking(std::vector<COutput>& vCoins) const
 {
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        LoadUnspentOutputs();
+
+        const CWalletTx* pcoin = NULL;
+        int nDepth = 0;
+        for (map<COutPoint, UnspentOutput>::const_iterator it = mapUnspentOutputs.begin(); it != mapUnspentOutputs.end(); ++it)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
-            int nDepth = pcoin->GetDepthInMainChain();
+            const uint256& wtxid = it->first.hash;
+            unsigned int i = it->first.n;
+            const UnspentOutput& output = it->second;
+
+            // Outputs of a transaction are next to each other in the index
+            if (!pcoin || pcoin->GetHash() != wtxid) {
+                pcoin = GetWalletTx(wtxid);
+                nDepth = pcoin ? pcoin->GetDepthInMainChain() : 0;
+                if (pcoin && pcoin->GetBlocksToMaturity() > 0)
+                    nDepth = 0;
+            }
 
             if (nDepth < 1)
                 continue;
@@ -740,18 +850,11 @@ void CWallet::AvailableCoinsForStaking(std::vector<COutput>& vCoins) const
             if (nDepth < COINBASE_MATURITY)
                 continue;
 
-            if (pcoin->GetBlocksToMaturity() > 0)
-                continue;
-
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) && (pcoin->vout[i].nValue > 0))
-                    vCoins.push_back(COutput(pcoin, i, nDepth,
-                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                             (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO,
-                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
-            }
+            if (!(IsSpent(wtxid, i)) && !IsLockedCoin(wtxid, i))
+                vCoins.push_back(COutput(pcoin, i, nDepth,
+                                         ((output.mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                         (output.mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO,
+                                         (output.mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
         }
     }
 }
@@ -1103,7 +1206,7 @@ bool CWallet::EncryptWallet(const SecureString &strWalletPassphrase) {
     return true;
 }
 
-int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb) {
+int64_t CWallet::IncOrderPosNext(CWalletTxStore *pwalletdb) {
     AssertLockHeld(cs_wallet); // nOrderPosNext
     int64_t nRet = nOrderPosNext++;
     if (pwalletdb) {
@@ -1114,6 +1217,54 @@ int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb) {
     return nRet;
 }
 
+bool CWalletTxBatch::WriteTx(const CWalletTx &wtx) {
+    uint256 hash = wtx.GetHash();
+    mapWrite.erase(hash);
+    mapWrite.insert(make_pair(hash, wtx));
+    setErase.erase(hash);
+    return true;
+}
+
+bool CWalletTxBatch::EraseTx(uint256 hash) {
+    mapWrite.erase(hash);
+    setErase.insert(hash);
+    return true;
+}
+
+bool CWalletTxBatch::WriteOrderPosNext(int64_t nOrderPosNextIn) {
+    nOrderPosNext = nOrderPosNextIn;
+    fOrderPosNext = true;
+    return true;
+}
+
+bool CWalletTxBatch::Commit() {
+    if (mapWrite.empty() && setErase.empty() && !fOrderPosNext)
+        return true;
+
+    // Do not flush the wallet here for performance reasons, as in AddToWalletIfInvolvingMe
+    CWalletDB walletdb(strWalletFile, "r+", false);
+    bool fTxn = walletdb.TxnBegin();
+    bool fOk = true;
+    for (map<uint256, CWalletTx>::const_iterator it = mapWrite.begin(); it != mapWrite.end(); ++it)
+        fOk = walletdb.WriteTx(it->second) && fOk;
+    BOOST_FOREACH(const uint256 &hash, setErase)
+        fOk = walletdb.EraseTx(hash) && fOk;
+    if (fOrderPosNext)
+        fOk = walletdb.WriteOrderPosNext(nOrderPosNext) && fOk;
+
+    if (fTxn) {
+        if (fOk)
+            fOk = walletdb.TxnCommit();
+        else
+            walletdb.TxnAbort();
+    }
+
+    mapWrite.clear();
+    setErase.clear();
+    fOrderPosNext = false;
+    return fOk;
+}
+
 bool CWallet::AccountMove(std::string strFrom, std::string strTo, CAmount nAmount, std::string strComment) {
     CWalletDB walletdb(strWalletFile);
     if (!walletdb.TxnBegin())
@@ -1192,7 +1343,7 @@ void CWallet::MarkDirty() {
     }
 }
 
-bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletDB *pwalletdb) {
+bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletTxStore *pwalletdb) {
     LogPrintf("CWallet::AddToWallet\n");
     uint256 hash = wtxIn.GetHash();
     LogPrintf("hash=%s\n", hash.ToString());
@@ -1295,6 +1446,14 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
             if (!pwalletdb->WriteTx(wtx))
                 return false;
 
+        // Outputs not spent by a transaction in the chain yet are available
+        if (fUnspentOutputsLoaded) {
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                if (!IsSpentInChain(hash, i))
+                    AddUnspentOutput(wtx, i);
+            }
+        }
+
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
@@ -1335,7 +1494,7 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
  * pblock is optional, but should be provided if the transaction is known to be in a block.
  * If fUpdate is true, existing transactions will be updated.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransaction &tx, const CBlock *pblock, bool fUpdate) {
+bool CWallet::AddToWalletIfInvolvingMe(const CTransaction &tx, const CBlock *pblock, bool fUpdate, CWalletTxStore *pwalletdb) {
     {
 //        LogPrintf("CWallet::AddToWalletIfInvolvingMe, tx=%s\n", tx.GetHash().ToString());
         AssertLockHeld(cs_wallet);
@@ -1364,11 +1523,24 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction &tx, const CBlock *pbl
             if (pblock)
                 wtx.SetMerkleBranch(*pblock);
 
-            // Do not flush the wallet here for performance reasons
-            // this is safe, as in case of a crash, we rescan the necessary blocks on startup through our SetBestChain-mechanism
-            CWalletDB walletdb(strWalletFile, "r+", false);
+            if (pwalletdb) {
+                if (!AddToWallet(wtx, false, pwalletdb))
+                    return false;
+            } else {
+                // Do not flush the wallet here for performance reasons
+                // this is safe, as in case of a crash, we rescan the necessary blocks on startup through our SetBestChain-mechanism
+                CWalletDB walletdb(strWalletFile, "r+", false);
+
+                if (!AddToWallet(wtx, false, &walletdb))
+                    return false;
+            }
 
-            return AddToWallet(wtx, false, &walletdb);
+            // The coins it spends are spent in the chain now
+            if (pblock && fUnspentOutputsLoaded && !tx.IsCoinBase()) {
+                BOOST_FOREACH(const CTxIn &txin, tx.vin)
+                    mapUnspentOutputs.erase(txin.prevout);
+            }
+            return true;
         }
     }
 //    LogPrintf("CWallet::AddToWalletIfInvolvingMe -> out false!\n");
@@ -1557,18 +1729,46 @@ void CWallet::MarkConflicted(const uint256 &hashBlock, const uint256 &hashTx) {
 void CWallet::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock) {
 //    LogPrintf("SyncTransaction()\n");
     LOCK2(cs_main, cs_wallet);
+    if (!SyncWalletTransaction(tx, pblock, NULL))
+        return;
+
+    // Notify of wallet transaction
+    GetMainSignals().WalletTransaction(tx);
+}
+
+void CWallet::SyncBlockTransactions(const CBlockIndex *pindex, const CBlock *pblock) {
+    std::vector<const CTransaction*> vNotify;
+    {
+        LOCK2(cs_main, cs_wallet);
+        CWalletTxBatch batch(strWalletFile);
+        BOOST_FOREACH(const CTransaction &tx, pblock->vtx) {
+            if (SyncWalletTransaction(tx, pblock, &batch))
+                vNotify.push_back(&tx);
+        }
+        if (fFileBacked && !batch.Commit())
+            LogPrintf("%s: failed to write the wallet transactions of block %s\n", __func__, pblock->GetHash().ToString());
+    }
+
+    // Notify of wallet transactions once they are written
+    BOOST_FOREACH(const CTransaction *ptx, vNotify)
+        GetMainSignals().WalletTransaction(*ptx);
+}
+
+bool CWallet::SyncWalletTransaction(const CTransaction &tx, const CBlock *pblock, CWalletTxStore *pwalletdb) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
     if (!pblock) {
         // wallets need to refund inputs when disconnecting coinstake
         if (tx.IsCoinStake()) {
             if (IsFromMe(tx)) {
                 DisableTransaction(tx);
-                return;
+                return false;
             }
         }
     }
-    if (!AddToWalletIfInvolvingMe(tx, pblock, true)) {
+    if (!AddToWalletIfInvolvingMe(tx, pblock, true, pwalletdb)) {
 //        LogPrintf("Not mine!\n");
-        return; // Not one of ours
+        return false; // Not one of ours
     }
 
     // If a transaction changes 'conflicted' state, that changes the balance
@@ -1576,12 +1776,19 @@ void CWallet::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex,
     // recomputed, also:
     BOOST_FOREACH(const CTxIn &txin, tx.vin)
     {
-        if (mapWallet.count(txin.prevout.hash))
-            mapWallet[txin.prevout.hash].MarkDirty();
+        if (mapWallet.count(txin.prevout.hash)) {
+            CWalletTx &prevtx = mapWallet[txin.prevout.hash];
+            prevtx.MarkDirty();
+
+            // Not spent in the chain anymore if its block was disconnected, unless another
+            // spend of it was confirmed (a conflicted transaction leaving the mempool)
+            if (!pblock && fUnspentOutputsLoaded && txin.prevout.n < prevtx.vout.size() &&
+                    !IsSpentInChain(prevtx.GetHash(), txin.prevout.n))
+                AddUnspentOutput(prevtx, txin.prevout.n);
+        }
     }
 
-    // Notify of wallet transaction
-    GetMainSignals().WalletTransaction(tx);
+    return true;
 }
 
 
@@ -2101,11 +2308,14 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
 
             CBlock block;
             ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+            CWalletTxBatch batch(strWalletFile);
             BOOST_FOREACH(CTransaction & tx, block.vtx)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate, &batch))
                     ret++;
             }
+            if (fFileBacked && !batch.Commit())
+                LogPrintf("%s: failed to write the wallet transactions of block %s\n", __func__, pindex->GetBlockHash().ToString());
             pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
@@ -2202,6 +2412,22 @@ set <uint256> CWalletTx::GetConflicts() const {
     return result;
 }
 
+void CWalletTx::MarkDirty() {
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet) {
+        pwallet->MarkBalanceDirty(GetHash());
+        pwallet->MarkHistoryDirty(GetHash());
+    }
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter &filter) const {
     if (vin.empty())
         return 0;
@@ -2516,18 +2742,238 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime) {
  */
 
 
-CAmount CWallet::GetBalance(bool fExcludeLocked) const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit(true, fExcludeLocked);
+void CWallet::MarkBalanceDirty(const uint256 &hashTx) const {
+    LOCK(cs_wallet);
+    if (fBalancesLoaded)
+        setBalanceDirty.insert(hashTx);
+}
+
+CWalletBalances CWallet::ComputeTxBalances(const CWalletTx &wtx) const {
+    CWalletBalances txBalances;
+
+    if (wtx.IsTrusted()) {
+        txBalances.nTrusted = wtx.GetAvailableCredit();
+        if (txBalances.nTrusted > 0) {
+            uint256 hashTx = wtx.GetHash();
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                const CTxOut &txout = wtx.vout[i];
+                if (txout.scriptPubKey.IsZerocoinMint() || txout.scriptPubKey.IsSigmaMint() || IsSpent(hashTx, i))
+                    continue;
+                CAmount nCredit = GetCredit(txout, ISMINE_SPENDABLE);
+                if (IsLockedCoin(hashTx, i))
+                    txBalances.nLocked += nCredit;
+            }
         }
+    } else if (wtx.GetDepthInMainChain() == 0 && (wtx.InMempool() || wtx.InStempool())) {
+        txBalances.nUnconfirmed = wtx.GetAvailableCredit();
     }
 
-    return nTotal;
+    txBalances.nImmature = wtx.GetImmatureCredit();
+    txBalances.nStake = wtx.GetImmatureStakeCredit();
+
+    return txBalances;
+}
+
+void CWallet::UpdateTxBalances(const uint256 &hashTx) const {
+    map<uint256, CWalletBalances>::iterator it = mapTxBalances.find(hashTx);
+    if (it != mapTxBalances.end()) {
+        balances -= it->second;
+        mapTxBalances.erase(it);
+    }
+    setBalanceUnconfirmed.erase(hashTx);
+    setBalanceTipDependent.erase(hashTx);
+
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
+    if (mi == mapWallet.end())
+        return;
+    const CWalletTx &wtx = mi->second;
+
+    CWalletBalances txBalances = ComputeTxBalances(wtx);
+    if (txBalances != CWalletBalances()) {
+        balances += txBalances;
+        mapTxBalances.insert(make_pair(hashTx, txBalances));
+    }
+
+    int nDepth = wtx.GetDepthInMainChain();
+    if (nDepth == 0 && !wtx.isAbandoned())
+        setBalanceUnconfirmed.insert(hashTx);
+    else if (nDepth < 0 || wtx.GetBlocksToMaturity() > 0)
+        setBalanceTipDependent.insert(hashTx);
+}
+
+void CWallet::UpdateBalances() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const CBlockIndex *pindexTip = chainActive.Tip();
+    bool fReorg = pindexBalanceTip != pindexTip && (!pindexBalanceTip || !chainActive.Contains(pindexBalanceTip));
+
+    if (!fBalancesLoaded || fReorg) {
+        balances = CWalletBalances();
+        mapTxBalances.clear();
+        setBalanceDirty.clear();
+        setBalanceUnconfirmed.clear();
+        setBalanceTipDependent.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateTxBalances(it->first);
+        fBalancesLoaded = true;
+        pindexBalanceTip = pindexTip;
+        return;
+    }
+
+    std::vector<uint256> vVolatile(setBalanceUnconfirmed.begin(), setBalanceUnconfirmed.end());
+    if (pindexBalanceTip != pindexTip) {
+        vVolatile.insert(vVolatile.end(), setBalanceTipDependent.begin(), setBalanceTipDependent.end());
+        pindexBalanceTip = pindexTip;
+    }
+
+    std::set<uint256> setUpdate;
+    setUpdate.swap(setBalanceDirty);
+    BOOST_FOREACH(const uint256 &hashTx, vVolatile) {
+        setUpdate.insert(hashTx);
+
+        // Whether these get into a block or conflict decides whether the coins they spend are spent
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
+        if (mi == mapWallet.end())
+            continue;
+        BOOST_FOREACH(const CTxIn &txin, mi->second.vin) {
+            if (mapWallet.count(txin.prevout.hash))
+                setUpdate.insert(txin.prevout.hash);
+        }
+    }
+
+    BOOST_FOREACH(const uint256 &hashTx, setUpdate)
+        UpdateTxBalances(hashTx);
+}
+
+CWalletBalances CWallet::GetBalances() const {
+    LOCK2(cs_main, cs_wallet);
+    UpdateBalances();
+
+    if (GetBoolArg("-checkwalletbalances", DEFAULT_CHECK_WALLET_BALANCES)) {
+        CWalletBalances total;
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            total += ComputeTxBalances(it->second);
+        assert(total == balances);
+    }
+
+    return balances;
+}
+
+void CWallet::MarkHistoryDirty(const uint256 &hashTx) const {
+    LOCK(cs_wallet);
+    if (fHistoryLoaded)
+        setHistoryDirty.insert(hashTx);
+}
+
+void CWallet::UpdateHistoryTx(const uint256 &hashTx) const {
+    map<uint256, CWalletHistoryPos>::iterator it = mapHistoryPos.find(hashTx);
+    if (it != mapHistoryPos.end()) {
+        setHistory.erase(it->second);
+        mapHistoryPos.erase(it);
+    }
+
+    map<uint256, int64_t>::iterator itChange = mapHistoryChangeNum.find(hashTx);
+    if (itChange != mapHistoryChangeNum.end()) {
+        mapHistoryChanges.erase(itChange->second);
+        itChange->second = nHistoryChangeNext;
+    } else {
+        mapHistoryChangeNum.insert(make_pair(hashTx, nHistoryChangeNext));
+    }
+    mapHistoryChanges.insert(make_pair(nHistoryChangeNext++, hashTx));
+
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
+    if (mi == mapWallet.end())
+        return;
+    const CWalletTx &wtx = mi->second;
+
+    const CBlockIndex *pindex;
+    int nHeight = wtx.GetDepthInMainChain(pindex) > 0 ? pindex->nHeight : CWalletHistoryPos::PENDING;
+    CWalletHistoryPos pos(nHeight, wtx.nOrderPos, hashTx);
+    setHistory.insert(pos);
+    mapHistoryPos.insert(make_pair(hashTx, pos));
+}
+
+void CWallet::UpdateHistory() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const CBlockIndex *pindexTip = chainActive.Tip();
+
+    if (!fHistoryLoaded) {
+        nHistoryChangeNext = GetTimeMicros();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateHistoryTx(it->first);
+        fHistoryLoaded = true;
+        pindexHistoryTip = pindexTip;
+        return;
+    }
+
+    // Transactions in blocks that are no longer in the chain are pending again
+    if (pindexHistoryTip && pindexHistoryTip != pindexTip && !chainActive.Contains(pindexHistoryTip)) {
+        const CBlockIndex *pindexFork = chainActive.FindFork(pindexHistoryTip);
+        CWalletHistoryPos posFork(pindexFork ? pindexFork->nHeight + 1 : 0, std::numeric_limits<int64_t>::min(), uint256());
+        for (std::set<CWalletHistoryPos>::const_iterator it = setHistory.lower_bound(posFork);
+             it != setHistory.end() && it->nHeight != CWalletHistoryPos::PENDING; ++it)
+            setHistoryDirty.insert(it->hash);
+    }
+    pindexHistoryTip = pindexTip;
+
+    std::set<uint256> setUpdate;
+    setUpdate.swap(setHistoryDirty);
+    BOOST_FOREACH(const uint256 &hashTx, setUpdate)
+        UpdateHistoryTx(hashTx);
+}
+
+std::vector<const CWalletTx*> CWallet::GetHistory(CWalletHistoryPos &pos, int nMinHeight, size_t nCount) const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    UpdateHistory();
+
+    std::vector<const CWalletTx*> vHistory;
+    std::set<CWalletHistoryPos>::const_iterator it = setHistory.lower_bound(pos);
+    while (vHistory.size() < nCount && it != setHistory.begin()) {
+        --it;
+        if (it->nHeight < nMinHeight)
+            break;
+        pos = *it;
+        // Skip anything taken out of mapWallet without being marked dirty
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(it->hash);
+        if (mi != mapWallet.end())
+            vHistory.push_back(&mi->second);
+    }
+
+    return vHistory;
+}
+
+void CWallet::GetHistoryChanges(int64_t &nChange, size_t nCount, std::vector<const CWalletTx*> &vChanged, std::vector<uint256> &vRemoved) const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    UpdateHistory();
+
+    size_t nChanges = 0;
+    for (map<int64_t, uint256>::const_iterator it = mapHistoryChanges.upper_bound(nChange);
+         nChanges < nCount && it != mapHistoryChanges.end(); ++it, ++nChanges) {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(it->second);
+        if (mi != mapWallet.end())
+            vChanged.push_back(&mi->second);
+        else
+            vRemoved.push_back(it->second);
+        nChange = it->first;
+    }
+}
+
+int64_t CWallet::GetHistoryChange() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    UpdateHistory();
+
+    return nHistoryChangeNext - 1;
+}
+
+CAmount CWallet::GetBalance(bool fExcludeLocked) const {
+    CWalletBalances walletBalances = GetBalances();
+    return fExcludeLocked ? walletBalances.nTrusted - walletBalances.nLocked : walletBalances.nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated) const {
@@ -2651,40 +3097,37 @@ std::vector<CRecipient> CWallet::CreateSigmaMintRecipients(
 
     zwalletMain->ResetCount(); // Before starting to mint, ensure mint count is correct
 
-    std::transform(coins.begin(), coins.end(), std::back_inserter(vecSend),
-        [&vDMints](sigma::PrivateCoin& coin) -> CRecipient {
-
-            // Generate and store secrets deterministically in the following function.
-            CHDMint dMint;
-            zwalletMain->GenerateMint(coin.getPublicCoin().getDenomination(), coin, dMint);
-
-
-            // Get a copy of the 'public' portion of the coin. You should
-            // embed this into a Zerocoin 'MINT' transaction along with a series
-            // of currency inputs totaling the assigned value of one zerocoin.
-            auto& pubCoin = coin.getPublicCoin();
+    // Generate and store secrets deterministically for all coins at once.
+    std::vector<CHDMint> vNewDMints;
+    if (!zwalletMain->GenerateMints(coins, vNewDMints)) {
+        throw std::runtime_error("Unable to mint a sigma coin.");
+    }
 
-            if (!pubCoin.validate()) {
-                throw std::runtime_error("Unable to mint a sigma coin.");
-            }
+    for (size_t i = 0; i < coins.size(); ++i) {
+        // Get a copy of the 'public' portion of the coin. You should
+        // embed this into a Zerocoin 'MINT' transaction along with a series
+        // of currency inputs totaling the assigned value of one zerocoin.
+        auto& pubCoin = coins[i].getPublicCoin();
 
-            // Create script for coin
-            CScript scriptSerializedCoin;
-            // opcode is inserted as 1 byte according to file script/script.h
-            scriptSerializedCoin << OP_SIGMAMINT;
+        if (!pubCoin.validate()) {
+            throw std::runtime_error("Unable to mint a sigma coin.");
+        }
 
-            // and this one will write the size in different byte lengths depending on the length of vector. If vector size is <0.4c, which is 76, will write the size of vector in just 1 byte. In our case the size is always 34, so must write that 34 in 1 byte.
-            std::vector<unsigned char> vch = pubCoin.getValue().getvch();
-            scriptSerializedCoin.insert(scriptSerializedCoin.end(), vch.begin(), vch.end());
+        // Create script for coin
+        CScript scriptSerializedCoin;
+        // opcode is inserted as 1 byte according to file script/script.h
+        scriptSerializedCoin << OP_SIGMAMINT;
 
-            CAmount v;
-            DenominationToInteger(pubCoin.getDenomination(), v);
+        // and this one will write the size in different byte lengths depending on the length of vector. If vector size is <0.4c, which is 76, will write the size of vector in just 1 byte. In our case the size is always 34, so must write that 34 in 1 byte.
+        std::vector<unsigned char> vch = pubCoin.getValue().getvch();
+        scriptSerializedCoin.insert(scriptSerializedCoin.end(), vch.begin(), vch.end());
 
-            vDMints.push_back(dMint);
+        CAmount v;
+        DenominationToInteger(pubCoin.getDenomination(), v);
 
-            return {scriptSerializedCoin, v, false};
-        }
-    );
+        vecSend.push_back({scriptSerializedCoin, v, false});
+        vDMints.push_back(vNewDMints[i]);
+    }
 
     return vecSend;
 }
@@ -2925,112 +3368,103 @@ bool CWallet::GetCoinsToSpend(
     // then we trim it out because we never use it.
     val = std::min(val, limitVal);
 
-    // We need only last 2 rows of matrix of knapsack algorithm.
-    std::vector<uint64_t> prev_row;
-    prev_row.resize(val + 1);
+    // If coinControl, want to use all inputs
+    if (coinControl != NULL && coinControl->HasSelected()) {
+        CAmount best_spend_val = availableBalance;
+
+        if (SelectMintCoinsForAmount(best_spend_val - roundedRequired * zeros, denominations, coinsToMint_out) != best_spend_val - roundedRequired * zeros) {
+            throw std::runtime_error(
+                _("Problem with coin selection for re-mint while spending."));
+        }
+        if (SelectSpendCoinsForAmount(best_spend_val, coins, coinsToSpend_out) != best_spend_val) {
+            throw std::runtime_error(
+                _("Problem with coin selection for spend."));
+        }
 
-    std::vector<uint64_t> next_row(val + 1, (INT_MAX - 1) / 2);
+        return true;
+    }
 
-    auto coinIt = coins.rbegin();
-    next_row[0] = 0;
-    next_row[coinIt->get_denomination_value() / zeros] = 1;
-    ++coinIt;
+    // Denominations in units of the smallest one, and how many coins we have of each.
+    std::vector<int64_t> denomUnits;
+    for (sigma::CoinDenomination denomination : denominations) {
+        CAmount denom;
+        DenominationToInteger(denomination, denom);
+        denomUnits.push_back(denom / zeros);
+    }
 
-    for (; coinIt != coins.rend(); coinIt++) {
-        std::swap(prev_row, next_row);
-        CAmount denom_i = coinIt->get_denomination_value() / zeros;
-        for (int j = 1; j <= val; j++) {
-            next_row[j] = prev_row[j];
-            if (j >= denom_i &&  next_row[j] > prev_row[j - denom_i] + 1) {
-                    next_row[j] = prev_row[j - denom_i] + 1;
-            }
+    std::vector<size_t> denomAvailable(denominations.size(), 0);
+    for (const CSigmaEntry& coin : coins) {
+        auto it = std::find(denomUnits.begin(), denomUnits.end(), coin.get_denomination_value() / zeros);
+        if (it == denomUnits.end()) {
+            throw runtime_error("Unknown sigma denomination.\n");
         }
+        ++denomAvailable[it - denomUnits.begin()];
     }
 
-    int index = val;
-    uint64_t best_spend_val = 0;
+    // Fewest coins to spend for every amount in range, and fewest coins to re-mint
+    // the difference to the required amount, each denomination as often as needed.
+    CDenominationSelector spendSelector(denomUnits, denomAvailable, val);
+    CDenominationSelector mintSelector(
+        denomUnits,
+        std::vector<size_t>(denomUnits.size(), CDenominationSelector::UNLIMITED),
+        val - roundedRequired);
 
-    // If coinControl, want to use all inputs
-    bool coinControlUsed = false;
-    if(coinControl != NULL){
-        if(coinControl->HasSelected()){
-            auto coinIt = coins.rbegin();
-            for (; coinIt != coins.rend(); coinIt++) {
-                best_spend_val += coinIt->get_denomination_value();
-            }
-            coinControlUsed = true;
-        }
-    }
-    if(!coinControlUsed) {
-        best_spend_val = val;
-        int minimum = INT_MAX - 1;
-        while(index >= roundedRequired) {
-            int temp_min = next_row[index] + GetRequiredCoinCountForAmount(
-                (index - roundedRequired) * zeros, denominations);
-            if (minimum > temp_min && next_row[index] != (INT_MAX - 1) / 2 && next_row[index] <= coinsToSpendLimit) {
-                best_spend_val = index;
-                minimum = temp_min;
-            }
-            --index;
-        }
-        best_spend_val *= zeros;
+    int best_spend_val = -1;
+    uint64_t minimum = std::numeric_limits<uint64_t>::max();
+    for (int index = val; index >= roundedRequired; --index) {
+        uint32_t spendCount = spendSelector.GetCoinCount(index);
+        if (spendCount == CDenominationSelector::UNREACHABLE || spendCount > coinsToSpendLimit)
+            continue;
 
-        if (minimum == INT_MAX - 1)
-            throw std::runtime_error(
-                _("Can not choose coins within limit."));
+        uint64_t temp_min = uint64_t(spendCount) + mintSelector.GetCoinCount(index - roundedRequired);
+        if (minimum > temp_min) {
+            best_spend_val = index;
+            minimum = temp_min;
+        }
     }
 
-    if (SelectMintCoinsForAmount(best_spend_val - roundedRequired * zeros, denominations, coinsToMint_out) != best_spend_val - roundedRequired * zeros) {
+    if (best_spend_val < 0)
+        throw std::runtime_error(
+            _("Can not choose coins within limit."));
+
+    std::vector<size_t> mintCounts;
+    if (!mintSelector.GetCoins(best_spend_val - roundedRequired, mintCounts)) {
         throw std::runtime_error(
             _("Problem with coin selection for re-mint while spending."));
     }
-    if (SelectSpendCoinsForAmount(best_spend_val, coins, coinsToSpend_out) != best_spend_val) {
+    for (size_t i = 0; i < denominations.size(); i++) {
+        coinsToMint_out.insert(coinsToMint_out.end(), mintCounts[i], denominations[i]);
+    }
+
+    std::vector<size_t> spendCounts;
+    if (!spendSelector.GetCoins(best_spend_val, spendCounts)) {
         throw std::runtime_error(
             _("Problem with coin selection for spend."));
     }
+    // Coins are sorted by denomination and then by height, so this takes the oldest ones.
+    for (const CSigmaEntry& coin : coins) {
+        size_t i = std::find(denomUnits.begin(), denomUnits.end(), coin.get_denomination_value() / zeros) - denomUnits.begin();
+        if (spendCounts[i] > 0) {
+            coinsToSpend_out.push_back(coin);
+            --spendCounts[i];
+        }
+    }
 
     return true;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 // peercoin: total coins staked (non-spendable until maturity)
 CAmount CWallet::GetStake() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            nTotal += pcoin->GetImmatureStakeCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nStake;
 }
 
 
@@ -3232,72 +3666,86 @@ void CWallet::AvailableCoins(vector <COutput> &vCoins, bool fOnlyConfirmed, cons
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256 &wtxid = it->first;
-            const CWalletTx *pcoin = &(*it).second;
+        LoadUnspentOutputs();
+
+        const CWalletTx *pcoin = NULL;
+        bool fAvailable = false;
+        int nDepth = 0;
+        for (map<COutPoint, UnspentOutput>::const_iterator it = mapUnspentOutputs.begin(); it != mapUnspentOutputs.end(); ++it) {
+            const uint256 &wtxid = it->first.hash;
+            unsigned int i = it->first.n;
+            const UnspentOutput &output = it->second;
+
+            // Outputs of a transaction are next to each other in the index
+            if (!pcoin || pcoin->GetHash() != wtxid) {
+                pcoin = GetWalletTx(wtxid);
+                fAvailable = false;
+                if (!pcoin)
+                    continue;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-//            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-//                continue;
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+//                if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+//                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
+
+                fAvailable = true;
+            }
+            if (!fAvailable)
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ALL_COINS){
-                    // We are now taking ALL_COINS to mean everything sans mints
-                    found = !(pcoin->vout[i].scriptPubKey.IsZerocoinMint() || pcoin->vout[i].scriptPubKey.IsSigmaMint() || pcoin->vout[i].scriptPubKey.IsZerocoinRemint());
-                } else if(nCoinType == ONLY_MINTS){
-                    // Do not consider anything other than mints
-                    found = (pcoin->vout[i].scriptPubKey.IsZerocoinMint() || pcoin->vout[i].scriptPubKey.IsSigmaMint() || pcoin->vout[i].scriptPubKey.IsZerocoinRemint());
-                } else if (nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NOT1000IFMN) {
-                    found = !(fFivegNode && pcoin->vout[i].nValue == FIVEGNODE_COIN_REQUIRED * COIN);
-                } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && fFivegNode) found = pcoin->vout[i].nValue != FIVEGNODE_COIN_REQUIRED * COIN; // do not use Hot MN funds
-                } else if (nCoinType == ONLY_1000) {
-                    found = pcoin->vout[i].nValue == FIVEGNODE_COIN_REQUIRED * COIN;
-                } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if (!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) &&
-                        mine != ISMINE_NO &&
-                        (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
-                        (pcoin->vout[i].nValue > nMinimumInputValue) &&
-                        (
-                                !coinControl ||
-                                !coinControl->HasSelected() ||
-                                coinControl->fAllowOtherInputs ||
-                                coinControl->IsSelected(COutPoint((*it).first, i))
-                        )
-                    ) {
-                    vCoins.push_back(COutput(pcoin, i, nDepth,
-                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                             (coinControl && coinControl->fAllowWatchOnly &&
-                                              (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
-                }
+            bool found = false;
+            if(nCoinType == ALL_COINS){
+                // We are now taking ALL_COINS to mean everything sans mints
+                found = !output.fMint;
+            } else if(nCoinType == ONLY_MINTS){
+                // Do not consider anything other than mints
+                found = output.fMint;
+            } else if (nCoinType == ONLY_DENOMINATED) {
+                found = IsDenominatedAmount(output.nValue);
+            } else if (nCoinType == ONLY_NOT1000IFMN) {
+                found = !(fFivegNode && output.nValue == FIVEGNODE_COIN_REQUIRED * COIN);
+            } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
+                if (IsCollateralAmount(output.nValue)) continue; // do not use collateral amounts
+                found = !IsDenominatedAmount(output.nValue);
+                if (found && fFivegNode) found = output.nValue != FIVEGNODE_COIN_REQUIRED * COIN; // do not use Hot MN funds
+            } else if (nCoinType == ONLY_1000) {
+                found = output.nValue == FIVEGNODE_COIN_REQUIRED * COIN;
+            } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                found = IsCollateralAmount(output.nValue);
+            } else {
+                found = true;
+            }
+            if (!found) continue;
+
+            if (!(IsSpent(wtxid, i)) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
+                    (output.nValue > nMinimumInputValue) &&
+                    (
+                            !coinControl ||
+                            !coinControl->HasSelected() ||
+                            coinControl->fAllowOtherInputs ||
+                            coinControl->IsSelected(it->first)
+                    )
+                ) {
+                vCoins.push_back(COutput(pcoin, i, nDepth,
+                                         ((output.mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                         (coinControl && coinControl->fAllowWatchOnly &&
+                                          (output.mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                         (output.mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO));
             }
         }
     }
@@ -3560,92 +4008,35 @@ void CWallet::ListAvailableSigmaMintCoins(vector<COutput> &vCoins, bool fOnlyCon
 
     vCoins.clear();
     LOCK2(cs_main, cs_wallet);
-    list<CSigmaEntry> listOwnCoins;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    listOwnCoins = zwalletMain->GetTracker().MintsAsSigmaEntries(true, false);
-    LogPrintf("listOwnCoins.size()=%s\n", listOwnCoins.size());
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+
+    // Only the unused mints of the wallet are looked at, the tracker keeps an index of them
+    CHDMintTracker& tracker = zwalletMain->GetTracker();
+    std::vector<CMintMeta> listOwnCoins = tracker.ListUnusedMints();
+    LogPrint("zero", "listOwnCoins.size()=%s\n", listOwnCoins.size());
+    for (const CMintMeta& mint : listOwnCoins) {
+        COutPoint outPoint;
+        if (!tracker.GetMintOutPoint(mint, outPoint))
+            continue;
+
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outPoint.hash);
+        if (it == mapWallet.end())
+            continue;
         const CWalletTx *pcoin = &(*it).second;
-//        LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
-        if (!CheckFinalTx(*pcoin)) {
-            LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
+
+        if (!CheckFinalTx(*pcoin))
             continue;
-        }
 
-        if (fOnlyConfirmed && !pcoin->IsTrusted()) {
-            LogPrintf("fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
+        if (fOnlyConfirmed && !pcoin->IsTrusted())
             continue;
-        }
 
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) {
-            LogPrintf("Not trusted\n");
+        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
             continue;
-        }
 
         int nDepth = pcoin->GetDepthInMainChain();
-        if (nDepth < 0) {
-            LogPrintf("nDepth=%s\n", nDepth);
+        if (nDepth < 0)
             continue;
-        }
-        LogPrintf("pcoin->vout.size()=%s\n", pcoin->vout.size());
-
-        for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-            if (pcoin->vout[i].scriptPubKey.IsSigmaMint()) {
-                CTxOut txout = pcoin->vout[i];
-                secp_primitives::GroupElement pubCoin = sigma::ParseSigmaMintScript(
-                    txout.scriptPubKey);
-                LogPrintf("Pubcoin=%s\n", pubCoin.tostring());
-                // CHECKING PROCESS
-                BOOST_FOREACH(const CSigmaEntry &ownCoinItem, listOwnCoins) {
-                   if (ownCoinItem.value == pubCoin && ownCoinItem.IsUsed == false &&
-                        ownCoinItem.randomness != uint64_t(0) && ownCoinItem.serialNumber != uint64_t(0)) {
-                        vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
-                        LogPrintf("-->OK\n");
-                    }
-                }
-            }
-        }
-    }
-}
 
-static void ApproximateBestSubset(vector <pair<CAmount, pair<const CWalletTx *, unsigned int> >> vValue,
-                                  const CAmount &nTotalLower,
-                                  const CAmount &nTargetValue,
-                                  vector<char> &vfBest, CAmount &nBest, int iterations = 1000) {
-    vector<char> vfIncluded;
-
-    vfBest.assign(vValue.size(), true);
-    nBest = nTotalLower;
-
-    seed_insecure_rand();
-
-    for (int nRep = 0; nRep < iterations && nBest != nTargetValue; nRep++) {
-        vfIncluded.assign(vValue.size(), false);
-        CAmount nTotal = 0;
-        bool fReachedTarget = false;
-        for (int nPass = 0; nPass < 2 && !fReachedTarget; nPass++) {
-            for (unsigned int i = 0; i < vValue.size(); i++) {
-                //The solver here uses a randomized algorithm,
-                //the randomness serves no real security purpose but is just
-                //needed to prevent degenerate behavior and it is important
-                //that the rng is fast. We do not use a constant random sequence,
-                //because there may be some privacy improvement by making
-                //the selection random.
-                if (nPass == 0 ? insecure_rand() & 1 : !vfIncluded[i]) {
-                    nTotal += vValue[i].first;
-                    vfIncluded[i] = true;
-                    if (nTotal >= nTargetValue) {
-                        fReachedTarget = true;
-                        if (nTotal < nBest) {
-                            nBest = nTotal;
-                            vfBest = vfIncluded;
-                        }
-                        nTotal -= vValue[i].first;
-                        vfIncluded[i] = false;
-                    }
-                }
-            }
-        }
+        vCoins.push_back(COutput(pcoin, outPoint.n, nDepth, true, true));
     }
 }
 
@@ -3656,12 +4047,11 @@ bool CWallet::SelectCoinsMinConf(const CAmount &nTargetValue, const int nConfMin
     setCoinsRet.clear();
     nValueRet = 0;
 
-    // List of values less than target
-    pair <CAmount, pair<const CWalletTx *, unsigned int>> coinLowestLarger;
-    coinLowestLarger.first = std::numeric_limits<CAmount>::max();
-    coinLowestLarger.second.first = NULL;
-    vector <pair<CAmount, pair<const CWalletTx *, unsigned int> >> vValue;
-    CAmount nTotalLower = 0;
+    // Values of the eligible outputs, and the outputs they belong to
+    vector<CAmount> vValues;
+    vector<pair<const CWalletTx *, unsigned int>> vOutputs;
+    vValues.reserve(vCoins.size());
+    vOutputs.reserve(vCoins.size());
 
     random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
 
@@ -3679,67 +4069,16 @@ bool CWallet::SelectCoinsMinConf(const CAmount &nTargetValue, const int nConfMin
             continue;
 
         int i = output.i;
-        CAmount n = pcoin->vout[i].nValue;
-
-        pair <CAmount, pair<const CWalletTx *, unsigned int>> coin = make_pair(n, make_pair(pcoin, i));
-
-        if (n == nTargetValue) {
-            setCoinsRet.insert(coin.second);
-            nValueRet += coin.first;
-            return true;
-        } else if (n < nTargetValue + MIN_CHANGE) {
-            vValue.push_back(coin);
-            nTotalLower += n;
-        } else if (n < coinLowestLarger.first) {
-            coinLowestLarger = coin;
-        }
-    }
-
-    if (nTotalLower == nTargetValue) {
-        for (unsigned int i = 0; i < vValue.size(); ++i) {
-            setCoinsRet.insert(vValue[i].second);
-            nValueRet += vValue[i].first;
-        }
-        return true;
-    }
-
-    if (nTotalLower < nTargetValue) {
-        if (coinLowestLarger.second.first == NULL)
-            return false;
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
-        return true;
+        vValues.push_back(pcoin->vout[i].nValue);
+        vOutputs.push_back(make_pair(pcoin, i));
     }
 
-    // Solve subset sum by stochastic approximation
-    std::sort(vValue.begin(), vValue.end(), CompareValueOnly());
-    std::reverse(vValue.begin(), vValue.end());
-    vector<char> vfBest;
-    CAmount nBest;
-
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
-    if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE)
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + MIN_CHANGE, vfBest, nBest);
-
-    // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
-    //                                   or the next bigger coin is closer), return the bigger coin
-    if (coinLowestLarger.second.first &&
-        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || coinLowestLarger.first <= nBest)) {
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
-    } else {
-        for (unsigned int i = 0; i < vValue.size(); i++)
-            if (vfBest[i]) {
-                setCoinsRet.insert(vValue[i].second);
-                nValueRet += vValue[i].first;
-            }
+    vector<size_t> vSelected;
+    if (!SelectCoinsForValue(vValues, nTargetValue, vSelected, nValueRet))
+        return false;
 
-        LogPrint("selectcoins", "SelectCoins() best subset: ");
-        for (unsigned int i = 0; i < vValue.size(); i++)
-            if (vfBest[i])
-                LogPrint("selectcoins", "%s ", FormatMoney(vValue[i].first));
-        LogPrint("selectcoins", "total %s\n", FormatMoney(nBest));
-    }
+    for (size_t i : vSelected)
+        setCoinsRet.insert(vOutputs[i]);
 
     return true;
 }
@@ -4529,12 +4868,22 @@ bool CWallet::EraseFromWallet(uint256 hash) {
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.count(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
+        UnloadFromWallet(hash);
     }
     return true;
 }
 
+void CWallet::UnloadFromWallet(const uint256 &hash) {
+    AssertLockHeld(cs_wallet);
+    mapWallet.erase(hash);
+    MarkBalanceDirty(hash);
+    MarkHistoryDirty(hash);
+    mapUnspentOutputs.erase(mapUnspentOutputs.lower_bound(COutPoint(hash, 0)),
+                            mapUnspentOutputs.lower_bound(COutPoint(hash, std::numeric_limits<uint32_t>::max())));
+}
+
 bool CWallet::CreateZerocoinMintModel(
         string &stringError,
         const std::vector<std::pair<std::string,int>>& denominationPairs,
@@ -4605,7 +4954,8 @@ bool CWallet::CreateSigmaMintModel(
     vector<CRecipient> vecSend;
     vector<sigma::PrivateCoin> privCoins;
     CWalletTx wtx;
-    CHDMint dMint;
+
+    sigma::Params* sigmaParams = sigma::Params::get_default();
 
     for(const std::pair<sigma::CoinDenomination, int>& denominationPair: denominationPairs) {
         sigma::CoinDenomination denomination = denominationPair.first;
@@ -4624,50 +4974,51 @@ bool CWallet::CreateSigmaMintModel(
             throw runtime_error("Coin count negative (\"fivegaddress\")\n");
         }
 
-        sigma::Params* sigmaParams = sigma::Params::get_default();
-
-        for(int64_t i = 0; i < coinCount; i++) {
-            // The following constructor does all the work of minting a brand
-            // new zerocoin. It stores all the private values inside the
-            // PrivateCoin object. This includes the coin secrets, which must be
-            // stored in a secure location (wallet) at the client.
+        if (coinCount == 0)
+            continue;
 
-            sigma::PrivateCoin newCoin(sigmaParams, denomination, ZEROCOIN_TX_VERSION_3);
+        // The secrets of every coin are replaced by the deterministic ones
+        // below, so a single freshly minted coin serves as the template for
+        // all coins of this denomination.
+        sigma::PrivateCoin newCoin(sigmaParams, denomination, ZEROCOIN_TX_VERSION_3);
+        privCoins.insert(privCoins.end(), coinCount, newCoin);
+    }
 
-            // Generate and store secrets deterministically in the following function.
-            dMint.SetNull();
-            zwalletMain->GenerateMint(denomination, newCoin, dMint);
+    // Generate and store secrets deterministically for all coins at once.
+    vector<CHDMint> vNewDMints;
+    if (!zwalletMain->GenerateMints(privCoins, vNewDMints)) {
+        stringError = "Unable to mint a sigma coin.";
+        return false;
+    }
 
-            // Get a copy of the 'public' portion of the coin. You should
-            // embed this into a Zerocoin 'MINT' transaction along with a series
-            // of currency inputs totaling the assigned value of one zerocoin.
-            sigma::PublicCoin pubCoin = newCoin.getPublicCoin();
+    for (size_t i = 0; i < privCoins.size(); ++i) {
+        // Get a copy of the 'public' portion of the coin. You should
+        // embed this into a Zerocoin 'MINT' transaction along with a series
+        // of currency inputs totaling the assigned value of one zerocoin.
+        sigma::PublicCoin pubCoin = privCoins[i].getPublicCoin();
 
-            // Validate
-            if (!pubCoin.validate()) {
-                stringError = "Unable to mint a sigma coin.";
-                return false;
-            }
+        // Validate
+        if (!pubCoin.validate()) {
+            stringError = "Unable to mint a sigma coin.";
+            return false;
+        }
 
-            // Create script for coin
-            CScript scriptSerializedCoin;
-            // opcode is inserted as 1 byte according to file script/script.h
-            scriptSerializedCoin << OP_SIGMAMINT;
+        // Create script for coin
+        CScript scriptSerializedCoin;
+        // opcode is inserted as 1 byte according to file script/script.h
+        scriptSerializedCoin << OP_SIGMAMINT;
 
-            // MARTUN: Commenting this for now.
-            // this one will probably be written as int64_t, which means it will be written in as few bytes as necessary, and one more byte for sign. In our case our 34 will take 2 bytes, 1 for the number 34 and another one for the sign.
-            // scriptSerializedCoin << pubCoin.getValue().memoryRequired();
+        // and this one will write the size in different byte lengths depending on the length of vector. If vector size is <0.4c, which is 76, will write the size of vector in just 1 byte. In our case the size is always 34, so must write that 34 in 1 byte.
+        std::vector<unsigned char> vch = pubCoin.getValue().getvch();
+        scriptSerializedCoin.insert(scriptSerializedCoin.end(), vch.begin(), vch.end());
 
-            // and this one will write the size in different byte lengths depending on the length of vector. If vector size is <0.4c, which is 76, will write the size of vector in just 1 byte. In our case the size is always 34, so must write that 34 in 1 byte.
-            std::vector<unsigned char> vch = pubCoin.getValue().getvch();
-            scriptSerializedCoin.insert(scriptSerializedCoin.end(), vch.begin(), vch.end());
+        int64_t denominationValue;
+        DenominationToInteger(pubCoin.getDenomination(), denominationValue);
 
-            CRecipient recipient = {scriptSerializedCoin, denominationValue, false};
+        CRecipient recipient = {scriptSerializedCoin, denominationValue, false};
 
-            vecSend.push_back(recipient);
-            privCoins.push_back(newCoin);
-            vDMints.push_back(dMint);
-        }
+        vecSend.push_back(recipient);
+        vDMints.push_back(vNewDMints[i]);
     }
 
     stringError = pwalletMain->MintAndStoreSigma(vecSend, privCoins, vDMints, wtx);
@@ -7280,11 +7631,11 @@ string CWallet::MintAndStoreSigma(const vector<CRecipient>& vecSend,
     }
 
 
-    //update mints with full transaction hash and then database them
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    for (CHDMint dMint : vDMints) {
+    //update mints with full transaction hash and then database them, all in one go
+    for (CHDMint& dMint : vDMints)
         dMint.SetTxHash(wtxNew.GetHash());
-        zwalletMain->GetTracker().Add(dMint, true);
+    zwalletMain->GetTracker().AddNew(vDMints);
+    for (const CHDMint& dMint : vDMints) {
         NotifyZerocoinChanged(this,
              dMint.GetPubcoinValue().GetHex(),
             "New (" + std::to_string(dMint.GetDenominationValue()) + " mint)",
@@ -7849,6 +8200,11 @@ DBErrors CWallet::ZapSelectTx(vector <uint256> &vHashIn, vector <uint256> &vHash
     if (!fFileBacked)
         return DB_LOAD_OK;
     DBErrors nZapSelectTxRet = CWalletDB(strWalletFile, "cr+").ZapSelectTx(this, vHashIn, vHashOut);
+    {
+        LOCK(cs_wallet);
+        BOOST_FOREACH(const uint256 &hash, vHashOut)
+            UnloadFromWallet(hash);
+    }
     if (nZapSelectTxRet == DB_NEED_REWRITE) {
         if (CDB::Rewrite(strWalletFile, "\x04pool")) {
             LOCK(cs_wallet);
@@ -7995,14 +8351,18 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize) {
         else
             nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0);
 
-        while (setKeyPool.size() < (nTargetSize + 1)) {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty())
-                nEnd = *(--setKeyPool.end()) + 1;
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey())))
-                throw runtime_error(std::string(__func__) + ": writing generated key failed");
-            setKeyPool.insert(nEnd);
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+        if (setKeyPool.size() < (nTargetSize + 1)) {
+            // The missing keys are generated together, HD keys are derived in parallel
+            std::vector<CPubKey> vPubKeys = GenerateNewKeys(0, nTargetSize + 1 - setKeyPool.size());
+            BOOST_FOREACH(const CPubKey& pubKey, vPubKeys) {
+                int64_t nEnd = 1;
+                if (!setKeyPool.empty())
+                    nEnd = *(--setKeyPool.end()) + 1;
+                if (!walletdb.WritePool(nEnd, CKeyPool(pubKey)))
+                    throw runtime_error(std::string(__func__) + ": writing generated key failed");
+                setKeyPool.insert(nEnd);
+                LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+            }
         }
     }
     return true;
@@ -8351,15 +8711,19 @@ void CWallet::GetScriptForMining(boost::shared_ptr <CReserveScript> &script) {
 void CWallet::LockCoin(const COutPoint &output) {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    MarkBalanceDirty(output.hash);
 }
 
 void CWallet::UnlockCoin(const COutPoint &output) {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    MarkBalanceDirty(output.hash);
 }
 
 void CWallet::UnlockAllCoins() {
     AssertLockHeld(cs_wallet); // setLockedCoins
+    for (const COutPoint& output : setLockedCoins)
+        MarkBalanceDirty(output.hash);
     setLockedCoins.clear();
 }
 
@@ -8603,6 +8967,9 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
     if (showDebug) {
         strUsage += HelpMessageGroup(_("Wallet debugging/testing options:"));
 
+        strUsage += HelpMessageOpt("-checkwalletbalances", strprintf(
+                "Check the cached wallet balances against all wallet transactions on every use (default: %u)",
+                DEFAULT_CHECK_WALLET_BALANCES));
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf(
                 "Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)",
                 DEFAULT_WALLET_DBLOGSIZE));
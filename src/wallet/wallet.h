@@ -31,11 +31,13 @@
 
 
 #include <algorithm>
+#include <limits>
 #include <map>
 #include <set>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -83,6 +85,9 @@ static const bool DEFAULT_USE_HD_WALLET = true;
 //! if set, all keys will be derived by using BIP39
 static const bool DEFAULT_USE_MNEMONIC = true;
 
+//! -checkwalletbalances default
+static const bool DEFAULT_CHECK_WALLET_BALANCES = false;
+
 extern const char * DEFAULT_WALLET_DAT;
 
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
@@ -445,17 +450,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -504,6 +499,30 @@ public:
 };
 
 
+/**
+ * Collects the wallet transactions written while a block is synced and writes them to the
+ * database in one transaction on Commit, so that nothing is left half written. Nothing is
+ * written to the database before that, which leaves the wallet free to read from it meanwhile.
+ */
+class CWalletTxBatch : public CWalletTxStore
+{
+private:
+    std::string strWalletFile;
+    std::map<uint256, CWalletTx> mapWrite;
+    std::set<uint256> setErase;
+    int64_t nOrderPosNext;
+    bool fOrderPosNext;
+
+public:
+    explicit CWalletTxBatch(const std::string& strWalletFileIn) : strWalletFile(strWalletFileIn), nOrderPosNext(0), fOrderPosNext(false) {}
+
+    bool WriteTx(const CWalletTx& wtx);
+    bool EraseTx(uint256 hash);
+    bool WriteOrderPosNext(int64_t nOrderPosNextIn);
+
+    /** Writes what was collected so far, returns false if the database transaction failed */
+    bool Commit();
+};
 
 
 class COutput
@@ -634,6 +653,76 @@ private:
     std::vector<char> _ssExtra;
 };
 
+/** Balances of a wallet by category, or the part of them held by a single transaction. */
+struct CWalletBalances
+{
+    //! Spendable coins of trusted transactions
+    CAmount nTrusted;
+    //! The part of nTrusted in locked coins
+    CAmount nLocked;
+    //! Spendable coins of untrusted transactions in the mempool
+    CAmount nUnconfirmed;
+    //! Coinbase outputs that are not mature yet
+    CAmount nImmature;
+    //! Coinstake outputs that are not mature yet
+    CAmount nStake;
+
+    CWalletBalances() : nTrusted(0), nLocked(0), nUnconfirmed(0), nImmature(0), nStake(0) {}
+
+    CWalletBalances& operator+=(const CWalletBalances& other)
+    {
+        nTrusted += other.nTrusted;
+        nLocked += other.nLocked;
+        nUnconfirmed += other.nUnconfirmed;
+        nImmature += other.nImmature;
+        nStake += other.nStake;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& other)
+    {
+        nTrusted -= other.nTrusted;
+        nLocked -= other.nLocked;
+        nUnconfirmed -= other.nUnconfirmed;
+        nImmature -= other.nImmature;
+        nStake -= other.nStake;
+        return *this;
+    }
+
+    friend bool operator==(const CWalletBalances& a, const CWalletBalances& b)
+    {
+        return a.nTrusted == b.nTrusted && a.nLocked == b.nLocked &&
+               a.nUnconfirmed == b.nUnconfirmed && a.nImmature == b.nImmature && a.nStake == b.nStake;
+    }
+
+    friend bool operator!=(const CWalletBalances& a, const CWalletBalances& b)
+    {
+        return !(a == b);
+    }
+};
+
+/**
+ * Position of a wallet transaction in the history: the height of its block, with transactions
+ * not in the main chain after all blocks, then the order it was added to the wallet in.
+ */
+struct CWalletHistoryPos
+{
+    static const int PENDING = std::numeric_limits<int>::max();
+
+    int nHeight;
+    int64_t nOrderPos;
+    uint256 hash;
+
+    //! After all transactions, where listing the history starts
+    CWalletHistoryPos() : nHeight(PENDING), nOrderPos(std::numeric_limits<int64_t>::max()) {}
+    CWalletHistoryPos(int nHeightIn, int64_t nOrderPosIn, const uint256& hashIn) : nHeight(nHeightIn), nOrderPos(nOrderPosIn), hash(hashIn) {}
+
+    friend bool operator<(const CWalletHistoryPos& a, const CWalletHistoryPos& b)
+    {
+        return std::tie(a.nHeight, a.nOrderPos, a.hash) < std::tie(b.nHeight, b.nOrderPos, b.hash);
+    }
+};
+
 enum MintAlgorithm {
     ZEROCOIN = 1,
     SIGMA = 2
@@ -687,6 +776,74 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Running balances of the wallet and the part of them held by each transaction.
+     * A transaction is recomputed when it's marked dirty, when it's not in a block yet
+     * (it can leave the mempool at any time) and, if its part depends on its depth,
+     * when the tip changes. A reorg recomputes everything.
+     */
+    mutable bool fBalancesLoaded;
+    mutable CWalletBalances balances;
+    mutable std::map<uint256, CWalletBalances> mapTxBalances;
+    mutable std::set<uint256> setBalanceDirty;
+    mutable std::set<uint256> setBalanceUnconfirmed;
+    mutable std::set<uint256> setBalanceTipDependent;
+    mutable const CBlockIndex* pindexBalanceTip;
+    CWalletBalances ComputeTxBalances(const CWalletTx& wtx) const;
+    void UpdateTxBalances(const uint256& hashTx) const;
+    void UpdateBalances() const;
+
+    /**
+     * Outputs of wallet transactions that pay to the wallet and are not spent by a transaction
+     * in the chain, so that available coins don't have to be searched for in all transactions.
+     * Outputs leave the index when a block spending them is connected and come back when it's
+     * disconnected. Spends not in a block yet are left to IsSpent.
+     */
+    struct UnspentOutput
+    {
+        CAmount nValue;
+        isminetype mine;
+        //! Zerocoin or Sigma mint, or Zerocoin remint
+        bool fMint;
+    };
+    mutable bool fUnspentOutputsLoaded;
+    mutable std::map<COutPoint, UnspentOutput> mapUnspentOutputs;
+    void AddUnspentOutput(const CWalletTx& wtx, unsigned int n) const;
+    //! Rebuild the index when next used, for when the keys or scripts that are ours change
+    void MarkUnspentOutputsDirty() const;
+    bool IsSpentInChain(const uint256& hash, unsigned int n) const;
+    void LoadUnspentOutputs() const;
+
+    /** SyncTransaction without the locks and the notification, returns whether to notify. */
+    bool SyncWalletTransaction(const CTransaction& tx, const CBlock* pblock, CWalletTxStore* pwalletdb);
+
+    /**
+     * Wallet transactions by position in the history, and the last change to each of them by
+     * number, so that the history can be listed a page at a time and changes since a listing
+     * can be found. A transaction marked dirty gets a new change number and is moved when the
+     * index is next used. A reorg moves the transactions in the disconnected blocks. Change
+     * numbers start from the time the index is loaded, so they keep increasing across restarts.
+     */
+    mutable bool fHistoryLoaded;
+    mutable std::set<CWalletHistoryPos> setHistory;
+    mutable std::map<uint256, CWalletHistoryPos> mapHistoryPos;
+    mutable std::map<int64_t, uint256> mapHistoryChanges;
+    mutable std::map<uint256, int64_t> mapHistoryChangeNum;
+    mutable std::set<uint256> setHistoryDirty;
+    mutable int64_t nHistoryChangeNext;
+    mutable const CBlockIndex* pindexHistoryTip;
+    void UpdateHistoryTx(const uint256& hashTx) const;
+    void UpdateHistory() const;
+
+    /**
+     * Extended keys of the HD chains (m/44'/<coin>'/0'/<c>) by master key and chain, encoded in
+     * locked memory. Derived once from the seed, which may need to be decrypted, and dropped when
+     * the wallet is locked.
+     */
+    std::map<std::pair<CKeyID, uint32_t>, SecureVector> mapHDChainKeys;
+    void GetHDChainKey(uint32_t nChange, CExtKey& chainKey);
+    void AddGeneratedKey(const CKey& secret, const CPubKey& pubkey, const CKeyMetadata& metadata);
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
     MnemonicContainer mnemonicContainer;
@@ -748,11 +905,19 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        fBalancesLoaded = false;
+        pindexBalanceTip = NULL;
+        fUnspentOutputsLoaded = false;
+        fHistoryLoaded = false;
+        nHistoryChangeNext = 0;
+        pindexHistoryTip = NULL;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
     std::list<CAccountingEntry> laccentries;
     bool EraseFromWallet(uint256 hash);
+    /** Removes a transaction from mapWallet only, keeping the caches built from it in step. */
+    void UnloadFromWallet(const uint256 &hash);
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
     typedef std::multimap<int64_t, TxPair > TxItems;
     TxItems wtxOrdered;
@@ -809,13 +974,19 @@ public:
     int  CountInputsWithAmount(CAmount nInputAmount);
 
     CPubKey GetKeyFromKeypath(uint32_t nChange, uint32_t nChild);
+    /** Derives the HD keys m/44'/<coin>'/0'/<nChange>/<nFirst..nFirst+nCount-1>, in parallel. */
+    void DeriveHDKeys(uint32_t nChange, uint32_t nFirst, size_t nCount, std::vector<CKey>& vKeys, std::vector<CPubKey>& vPubKeys);
     /**
      * keystore implementation
      * Generate a new key
      */
     CPubKey GenerateNewKey(uint32_t nChange=0);
+    /** Generates nCount new keys, deriving them together if the wallet is HD. */
+    std::vector<CPubKey> GenerateNewKeys(uint32_t nChange, size_t nCount);
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey);
+    //! Locks the wallet and drops the cached HD chain keys
+    bool Lock();
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
     bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
     //! Load metadata (used by LoadWallet)
@@ -855,19 +1026,39 @@ public:
      * Increment the next transaction order id
      * @return next transaction order id
      */
-    int64_t IncOrderPosNext(CWalletDB *pwalletdb = NULL);
+    int64_t IncOrderPosNext(CWalletTxStore *pwalletdb = NULL);
     bool AccountMove(std::string strFrom, std::string strTo, CAmount nAmount, std::string strComment = "");
     bool GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bForceNew = false);
 
     void MarkDirty();
-    bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
+    bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletTxStore* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
-    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    /** Syncs all transactions of a connected block, writing them to the database in one batch. */
+    void SyncBlockTransactions(const CBlockIndex *pindex, const CBlock* pblock);
+    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate, CWalletTxStore* pwalletdb = NULL);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
     //fivegnode
+    /** Marks the part of the balances held by a transaction to be recomputed. */
+    void MarkBalanceDirty(const uint256& hashTx) const;
+    /** Gets the balances of the wallet, without going through all of its transactions. */
+    CWalletBalances GetBalances() const;
+    /** Marks a transaction to be moved in the history and listed as changed. */
+    void MarkHistoryDirty(const uint256& hashTx) const;
+    /**
+     * Gets up to nCount wallet transactions in blocks from nMinHeight up or not in a block, newest
+     * first, starting after pos. pos is moved to the last transaction returned.
+     */
+    std::vector<const CWalletTx*> GetHistory(CWalletHistoryPos& pos, int nMinHeight, size_t nCount) const;
+    /**
+     * Gets up to nCount transactions changed after change nChange, in the order they changed, and
+     * moves nChange to the last change returned. Transactions no longer in the wallet are in vRemoved.
+     */
+    void GetHistoryChanges(int64_t& nChange, size_t nCount, std::vector<const CWalletTx*>& vChanged, std::vector<uint256>& vRemoved) const;
+    /** Gets the number of the last change to the history. */
+    int64_t GetHistoryChange() const;
     CAmount GetBalance(bool fExcludeLocked = false) const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
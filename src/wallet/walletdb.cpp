@@ -551,6 +551,97 @@ public:
     }
 };
 
+/** Checks a decoded wallet transaction record and adds the transaction to the wallet. */
+static bool LoadWalletTx(CWallet *pwallet, const uint256 &hash, CWalletTx &wtx, CDataStream &ssValue,
+                         CWalletScanState &wss, string &strErr) {
+    CValidationState state;
+//    LogPrintf("CheckTransaction wtx.GetHash()=%s, hash=%s, state.IsValid()=%s\n", wtx.GetHash().ToString(),
+//              hash.ToString(), state.IsValid());
+    if (!(CheckTransaction(wtx, state, wtx.GetHash(), true, INT_MAX, false, false) && (wtx.GetHash() == hash) &&
+          state.IsValid())) {
+//        LogPrintf("ReadKeyValue|CheckTransaction(), wtx.GetHash() = &s\n", wtx.GetHash().ToString());
+        return false;
+    }
+//    LogPrintf("done ->readkeyvalue()\n");
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
+        if (!ssValue.empty()) {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        } else {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime,
+                               hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        wss.vWalletUpgrade.push_back(hash);
+    }
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+    LogPrintf("readkeyvalue -> AddToWallet\n");
+    pwallet->AddToWallet(wtx, true, NULL);
+    return true;
+}
+
+/** A wallet transaction record, decoded apart from the records of other types. */
+struct WalletTxRecord {
+    CDataStream ssKey;
+    CDataStream ssValue;
+    uint256 hash;
+    CWalletTx wtx;
+    bool fDecoded;
+
+    WalletTxRecord(const CDataStream &ssKeyIn, const CDataStream &ssValueIn)
+        : ssKey(ssKeyIn), ssValue(ssValueIn), fDecoded(false) {}
+};
+
+static bool IsWalletTxRecord(const CDataStream &ssKey) {
+    try {
+        CDataStream ssType(ssKey);
+        string strType;
+        ssType >> strType;
+        return strType == "tx";
+    } catch (...) {
+        return false;
+    }
+}
+
+/**
+ * Decodes wallet transaction records on all cores. Decoding doesn't touch the wallet,
+ * checking the transactions and adding them to the wallet is left to the caller.
+ */
+static void DecodeWalletTxRecords(vector<WalletTxRecord> &vRecords) {
+    auto decode = [&vRecords](size_t nStart, size_t nStep) {
+        for (size_t i = nStart; i < vRecords.size(); i += nStep) {
+            WalletTxRecord &record = vRecords[i];
+            try {
+                string strType;
+                record.ssKey >> strType >> record.hash;
+                record.ssValue >> record.wtx;
+                record.fDecoded = true;
+            } catch (...) {
+                record.fDecoded = false;
+            }
+
+            // The raw record isn't needed anymore, unless it is an old one which LoadWalletTx upgrades
+            record.ssKey = CDataStream(SER_DISK, CLIENT_VERSION);
+            if (!(31404 <= record.wtx.fTimeReceivedIsTxTime && record.wtx.fTimeReceivedIsTxTime <= 31703))
+                record.ssValue = CDataStream(SER_DISK, CLIENT_VERSION);
+        }
+    };
+
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores(), 1), vRecords.size());
+    boost::thread_group threads;
+    for (size_t nThread = 1; nThread < nThreads; ++nThread)
+        threads.create_thread([&decode, nThread, nThreads] { decode(nThread, nThreads); });
+    decode(0, std::max<size_t>(nThreads, 1));
+    threads.join_all();
+}
+
 bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey, CDataStream &ssValue,
                   CWalletScanState &wss, string &strType, string &strErr) {
     try {
@@ -572,36 +663,8 @@ bool ReadKeyValue(CWallet *pwallet, CDataStream &ssKey, CDataStream &ssValue,
             ssKey >> hash;
             CWalletTx wtx;
             ssValue >> wtx;
-            CValidationState state;
-//            LogPrintf("CheckTransaction wtx.GetHash()=%s, hash=%s, state.IsValid()=%s\n", wtx.GetHash().ToString(),
-//                      hash.ToString(), state.IsValid());
-            if (!(CheckTransaction(wtx, state, wtx.GetHash(), true, INT_MAX, false, false) && (wtx.GetHash() == hash) &&
-                  state.IsValid())) {
-//                LogPrintf("ReadKeyValue|CheckTransaction(), wtx.GetHash() = &s\n", wtx.GetHash().ToString());
+            if (!LoadWalletTx(pwallet, hash, wtx, ssValue, wss, strErr))
                 return false;
-            }
-//            LogPrintf("done ->readkeyvalue()\n");
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
-                if (!ssValue.empty()) {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                } else {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime,
-                                       hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-            LogPrintf("readkeyvalue -> AddToWallet\n");
-            pwallet->AddToWallet(wtx, true, NULL);
         } else if (strType == "acentry") {
             string strAccount;
             ssKey >> strAccount;
@@ -811,6 +874,10 @@ DBErrors CWalletDB::LoadWallet(CWallet *pwallet) {
             return DB_CORRUPT;
         }
 
+        // Transactions are decoded once all records are read, on all cores, and added
+        // to the wallet in their order in the database after the records of other types
+        vector<WalletTxRecord> vTxRecords;
+
         while (true) {
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -823,6 +890,11 @@ DBErrors CWalletDB::LoadWallet(CWallet *pwallet) {
                 return DB_CORRUPT;
             }
 
+            if (IsWalletTxRecord(ssKey)) {
+                vTxRecords.emplace_back(ssKey, ssValue);
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) {
@@ -845,6 +917,29 @@ DBErrors CWalletDB::LoadWallet(CWallet *pwallet) {
                 LogPrintf("%s\n", strErr);
         }
         pcursor->close();
+
+        DecodeWalletTxRecords(vTxRecords);
+        BOOST_FOREACH(WalletTxRecord &record, vTxRecords)
+        {
+            string strErr;
+            bool fLoaded = false;
+            try {
+                fLoaded = record.fDecoded && LoadWalletTx(pwallet, record.hash, record.wtx, record.ssValue, wss, strErr);
+            } catch (...) {
+                fLoaded = false;
+            }
+            if (!fLoaded) {
+                LogPrintf("ReadKeyValue() failed, strType=tx\n");
+                // Rescan if there is a bad transaction record:
+                SoftSetBoolArg("-rescan", true);
+            }
+            if (!strErr.empty())
+                LogPrintf("%s\n", strErr);
+
+            // The wallet has its own copy now
+            record.ssValue = CDataStream(SER_DISK, CLIENT_VERSION);
+            record.wtx = CWalletTx();
+        }
     }
     catch (const boost::thread_interrupted &) {
         throw;
@@ -984,7 +1079,7 @@ DBErrors CWalletDB::ZapSelectTx(CWallet *pwallet, vector <uint256> &vTxHashIn, v
         if (it == vTxHashIn.end()) {
             break;
         } else if ((*it) == hash) {
-            pwallet->mapWallet.erase(hash);
+            // The wallet unloads the transactions in vTxHashOut itself
             if (!EraseTx(hash)) {
                 LogPrint("db", "Transaction was found for deletion but returned database error: %s\n", hash.GetHex());
                 delerror = true;
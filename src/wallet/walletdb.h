@@ -181,8 +181,22 @@ public:
     }
 };
 
+/**
+ * Where wallet transactions get written to as they are added to the wallet. CWalletDB writes
+ * them straight to Berkeley DB, CWalletTxBatch collects them and writes them all at once.
+ */
+class CWalletTxStore
+{
+public:
+    virtual ~CWalletTxStore() {}
+
+    virtual bool WriteTx(const CWalletTx& wtx) = 0;
+    virtual bool EraseTx(uint256 hash) = 0;
+    virtual bool WriteOrderPosNext(int64_t nOrderPosNext) = 0;
+};
+
 /** Access to the wallet database */
-class CWalletDB : public CDB
+class CWalletDB : public CDB, public CWalletTxStore
 {
 public:
     CWalletDB(const std::string& strFilename, const char* pszMode = "r+", bool fFlushOnClose = true) : CDB(strFilename, pszMode, fFlushOnClose)